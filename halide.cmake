@@ -502,6 +502,7 @@ function(_halide_runtime_target_name HALIDE_TARGET OUTVAR)
         strict_float
         legacy_buffer_wrappers
         tsan
+        plan_memory
       )
     # Synthesize a one-or-two-char abbreviation based on the feature's position
     # in the KNOWN_FEATURES list.
@@ -3344,6 +3344,10 @@ bool inline_all_element_wise_functions(const vector<Function> &outputs,
 // the schedules. The target architecture is specified by 'target'.
 string generate_schedules(const vector<Function> &outputs, const Target &target,
                           const MachineParams &arch_params) {
+    // Region and cost analysis query the bounds of the same
+    // expressions many times.
+    BoundsMemoScope bounds_memo;
+
     // Make an environment map which is used throughout the auto scheduling process.
     map<string, Function> env;
     for (Function f : outputs) {
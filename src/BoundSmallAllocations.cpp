@@ -1,5 +1,6 @@
 #include "BoundSmallAllocations.h"
 #include "Bounds.h"
+#include "CodeGen_Internal.h"
 #include "IRMutator.h"
 #include "Simplify.h"
 
@@ -27,6 +28,12 @@ class BoundSmallAllocations : public IRMutator2 {
 
     bool in_thread_loop = false;
 
+    // The body of a parallel loop runs on a worker thread's stack, in
+    // a function of its own. We track how much of that stack the
+    // enclosing allocations already use.
+    bool in_parallel_loop = false;
+    int64_t stack_bytes_used = 0;
+
     Stmt visit(const For *op) override {
         Interval min_bounds = find_constant_bounds(op->min, scope);
         Interval max_bounds = find_constant_bounds(op->min + op->extent - 1, scope);
@@ -36,6 +43,9 @@ class BoundSmallAllocations : public IRMutator2 {
         ScopedBinding<Interval> bind(scope, op->name, b);
         ScopedValue<bool> old_in_thread_loop(in_thread_loop, in_thread_loop ||
                                              op->for_type == ForType::GPUThread);
+        bool is_parallel = op->for_type == ForType::Parallel;
+        ScopedValue<bool> old_in_parallel_loop(in_parallel_loop, in_parallel_loop || is_parallel);
+        ScopedValue<int64_t> old_stack_bytes_used(stack_bytes_used, is_parallel ? 0 : stack_bytes_used);
         return IRMutator2::visit(op);
     }
 
@@ -59,15 +69,39 @@ class BoundSmallAllocations : public IRMutator2 {
         // halide_malloc. For now we are very conservative, and only
         // round sizes up to a constant if they're smaller than that.
         Expr malloc_overhead = 128 / op->type.bytes();
+        MemoryType memory_type = op->memory_type;
+        int64_t stack_bytes = 0;
+        if (bound.defined()) {
+            bound = simplify(bound);
+            const int64_t *elems = as_const_int(bound);
+            if (elems && *elems > 0) {
+                stack_bytes = *elems * op->type.bytes();
+            }
+        }
+        // Per-tile scratch inside a parallel loop that's small enough
+        // goes on the worker's stack instead of through halide_malloc
+        // on every iteration.
+        if (memory_type == MemoryType::Auto &&
+            !op->new_expr.defined() &&
+            in_parallel_loop &&
+            !in_thread_loop &&
+            stack_bytes > 0 &&
+            can_allocation_fit_on_stack(stack_bytes_used + stack_bytes)) {
+            memory_type = MemoryType::Stack;
+        }
+        bool on_stack = (memory_type == MemoryType::Stack ||
+                         memory_type == MemoryType::Register);
+        ScopedValue<int64_t> old_stack_bytes_used(stack_bytes_used,
+                                                  stack_bytes_used + (on_stack ? stack_bytes : 0));
         if (bound.defined() &&
             (in_thread_loop ||
-             op->memory_type == MemoryType::Stack ||
+             memory_type == MemoryType::Stack ||
              op->memory_type == MemoryType::Register ||
              (op->memory_type == MemoryType::Auto && can_prove(bound <= malloc_overhead)))) {
             user_assert(can_prove(bound <= Int(32).max()))
                 << "Allocation " << op->name << " has a size greater than 2^31: " << bound << "\n";
             bound = simplify(cast<int32_t>(bound));
-            return Allocate::make(op->name, op->type, op->memory_type, {bound}, op->condition,
+            return Allocate::make(op->name, op->type, memory_type, {bound}, op->condition,
                                   mutate(op->body), op->new_expr, op->free_function);
         } else {
             return IRMutator2::visit(op);
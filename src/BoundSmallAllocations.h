@@ -16,7 +16,9 @@ namespace Internal {
  * Use bounds analysis to attempt to bound the sizes of small
  * allocations. Inside GPU kernels this is necessary in order to
  * compile. On the CPU this is also useful, because it prevents malloc
- * calls for (provably) tiny allocations. */
+ * calls for (provably) tiny allocations. Allocations left to Halide's
+ * discretion inside a parallel loop are placed on the stack if their
+ * bound fits in the stack budget for the body of the loop. */
 Stmt bound_small_allocations(const Stmt &s);
 
 }  // namespace Internal
@@ -1,4 +1,5 @@
 #include <iostream>
+#include <memory>
 
 #include "Bounds.h"
 #include "CSE.h"
@@ -1040,7 +1041,10 @@ private:
     }
 };
 
-Interval bounds_of_expr_in_scope(Expr expr, const Scope<Interval> &scope, const FuncValueBounds &fb, bool const_bound) {
+namespace {
+
+Interval compute_bounds_of_expr_in_scope(const Expr &expr, const Scope<Interval> &scope,
+                                         const FuncValueBounds &fb, bool const_bound) {
     //debug(3) << "computing bounds_of_expr_in_scope " << expr << "\n";
     Bounds b(&scope, fb, const_bound);
     expr.accept(&b);
@@ -1061,6 +1065,229 @@ Interval bounds_of_expr_in_scope(Expr expr, const Scope<Interval> &scope, const
     return b.interval;
 }
 
+// The names in the scope and the function value bounds that the
+// Bounds visitor may look up when walking an Expr.
+class BoundsDependencies : public IRGraphVisitor {
+    using IRGraphVisitor::visit;
+
+    void visit(const Variable *op) override {
+        names.insert(op->name);
+    }
+
+    void visit(const Let *op) override {
+        // The bounds of the body refer to these.
+        names.insert(op->name + ".min");
+        names.insert(op->name + ".max");
+        IRGraphVisitor::visit(op);
+    }
+
+    void visit(const Call *op) override {
+        if (op->call_type == Call::Halide) {
+            calls.insert({op->name, op->value_index});
+        }
+        IRGraphVisitor::visit(op);
+    }
+
+    void visit(const Load *op) override {
+        has_load = true;
+        IRGraphVisitor::visit(op);
+    }
+
+public:
+    set<string> names;
+    set<pair<string, int>> calls;
+    // Loads carry alignment information that IR equality ignores.
+    bool has_load = false;
+};
+
+bool same_interval(const Interval &a, const Interval &b) {
+    return equal(a.min, b.min) && equal(a.max, b.max);
+}
+
+// The results remembered while a BoundsMemoScope exists. There's one
+// of these per thread.
+struct BoundsMemo {
+    struct Binding {
+        string name;
+        bool bound;
+        Interval interval;
+    };
+
+    struct Query {
+        vector<Binding> scope_bindings;
+        vector<pair<bool, Interval>> func_bounds;
+        bool const_bound;
+        Interval result;
+
+        bool matches(const Query &other) const {
+            if (const_bound != other.const_bound ||
+                scope_bindings.size() != other.scope_bindings.size() ||
+                func_bounds.size() != other.func_bounds.size()) {
+                return false;
+            }
+            for (size_t i = 0; i < scope_bindings.size(); i++) {
+                const Binding &a = scope_bindings[i], &b = other.scope_bindings[i];
+                if (a.name != b.name || a.bound != b.bound ||
+                    (a.bound && !same_interval(a.interval, b.interval))) {
+                    return false;
+                }
+            }
+            for (size_t i = 0; i < func_bounds.size(); i++) {
+                if (func_bounds[i].first != other.func_bounds[i].first ||
+                    (func_bounds[i].first &&
+                     !same_interval(func_bounds[i].second, other.func_bounds[i].second))) {
+                    return false;
+                }
+            }
+            return true;
+        }
+    };
+
+    struct Entry {
+        std::shared_ptr<const BoundsDependencies> deps;
+        vector<Query> queries;
+    };
+
+    int depth = 0;
+    IRCompareCache cache;
+    map<ExprWithCompareCache, Entry> entries;
+    map<Expr, Entry *, ExprCompare> seen;
+    int64_t hits = 0, misses = 0;
+
+    // Bound the memory the table can hold on to.
+    static const size_t max_entries = 1 << 16;
+    static const size_t max_queries_per_expr = 16;
+
+    BoundsMemo() : cache(8) {}
+
+    void clear() {
+        entries.clear();
+        seen.clear();
+        cache.clear();
+    }
+
+    Entry &find_entry(const Expr &e) {
+        auto s = seen.find(e);
+        if (s != seen.end()) {
+            return *(s->second);
+        }
+        if (entries.size() >= max_entries) {
+            clear();
+        }
+        Entry &entry = entries[ExprWithCompareCache(e, &cache)];
+        if (!entry.deps) {
+            std::shared_ptr<BoundsDependencies> deps = std::make_shared<BoundsDependencies>();
+            e.accept(deps.get());
+            entry.deps = deps;
+        }
+        seen.emplace(e, &entry);
+        return entry;
+    }
+
+    Query make_query(const BoundsDependencies &deps, const Scope<Interval> &scope,
+                     const FuncValueBounds &fb, bool const_bound) {
+        Query q;
+        q.const_bound = const_bound;
+        // The bounds of a divisor may be looked up again by name if
+        // they're just a variable, so follow those too.
+        vector<string> pending(deps.names.begin(), deps.names.end());
+        set<string> visited(deps.names.begin(), deps.names.end());
+        for (size_t i = 0; i < pending.size(); i++) {
+            Binding b;
+            b.name = pending[i];
+            b.bound = scope.contains(b.name);
+            if (b.bound) {
+                b.interval = scope.get(b.name);
+                for (const Expr &bound : {b.interval.min, b.interval.max}) {
+                    const Variable *v = bound.as<Variable>();
+                    if (v && visited.insert(v->name).second) {
+                        pending.push_back(v->name);
+                    }
+                }
+            }
+            q.scope_bindings.push_back(b);
+        }
+        for (const auto &c : deps.calls) {
+            auto it = fb.find(c);
+            if (it != fb.end()) {
+                q.func_bounds.push_back({true, it->second});
+            } else {
+                q.func_bounds.push_back({false, Interval()});
+            }
+        }
+        return q;
+    }
+
+    Interval bounds(const Expr &e, const Scope<Interval> &scope,
+                    const FuncValueBounds &fb, bool const_bound) {
+        std::shared_ptr<const BoundsDependencies> deps;
+        Query q;
+        {
+            Entry &entry = find_entry(e);
+            deps = entry.deps;
+            if (deps->has_load) {
+                return compute_bounds_of_expr_in_scope(e, scope, fb, const_bound);
+            }
+            q = make_query(*deps, scope, fb, const_bound);
+            for (const Query &old : entry.queries) {
+                if (old.matches(q)) {
+                    hits++;
+                    return old.result;
+                }
+            }
+        }
+
+        // Computing the bounds may recurse back in here and change
+        // the table, so look the entry up again afterwards.
+        misses++;
+        q.result = compute_bounds_of_expr_in_scope(e, scope, fb, const_bound);
+        Entry &entry = find_entry(e);
+        if (entry.queries.size() >= max_queries_per_expr) {
+            entry.queries.erase(entry.queries.begin());
+        }
+        entry.queries.push_back(q);
+        return q.result;
+    }
+};
+
+BoundsMemo &bounds_memo() {
+    thread_local BoundsMemo memo;
+    return memo;
+}
+
+bool bounds_memo_enabled() {
+    static bool enabled = get_env_variable("HL_BOUNDS_MEMO") != "0";
+    return enabled;
+}
+
+}  // namespace
+
+BoundsMemoScope::BoundsMemoScope() : enabled(bounds_memo_enabled()) {
+    if (enabled) {
+        bounds_memo().depth++;
+    }
+}
+
+BoundsMemoScope::~BoundsMemoScope() {
+    if (!enabled) {
+        return;
+    }
+    BoundsMemo &memo = bounds_memo();
+    if (--memo.depth == 0) {
+        debug(2) << "Bounds memo: " << memo.hits << " hits, " << memo.misses << " misses\n";
+        memo.clear();
+        memo.hits = memo.misses = 0;
+    }
+}
+
+Interval bounds_of_expr_in_scope(Expr expr, const Scope<Interval> &scope, const FuncValueBounds &fb, bool const_bound) {
+    BoundsMemo &memo = bounds_memo();
+    if (memo.depth > 0 && expr.defined() && !is_const(expr) && !expr.as<Variable>()) {
+        return memo.bounds(expr, scope, fb, const_bound);
+    }
+    return compute_bounds_of_expr_in_scope(expr, scope, fb, const_bound);
+}
+
 Region region_union(const Region &a, const Region &b) {
     internal_assert(a.size() == b.size()) << "Mismatched dimensionality in region union\n";
     Region result;
@@ -32,6 +32,26 @@ Interval bounds_of_expr_in_scope(Expr expr,
                                  const FuncValueBounds &func_bounds = FuncValueBounds(),
                                  bool const_bound = false);
 
+/** While an object of this type exists, calls to
+ * bounds_of_expr_in_scope on the current thread remember their
+ * results, keyed on the Expr (structurally) together with the scope
+ * bindings and function value bounds it depends on, so repeated
+ * queries with the same context are only computed once. Names must
+ * refer to the same Funcs and Parameters for the lifetime of the
+ * scope, as they do within the lowering of a single pipeline. Scopes
+ * nest; the results are dropped when the outermost one ends. Setting
+ * HL_BOUNDS_MEMO=0 in the environment turns this off. */
+class BoundsMemoScope {
+    bool enabled;
+
+public:
+    BoundsMemoScope();
+    ~BoundsMemoScope();
+
+    BoundsMemoScope(const BoundsMemoScope &) = delete;
+    BoundsMemoScope &operator=(const BoundsMemoScope &) = delete;
+};
+
 /** Given a varying expression, try to find a constant that is either:
  * An upper bound (always greater than or equal to the expression), or
  * A lower bound (always less than or equal to the expression)
@@ -1,4 +1,7 @@
+#include <algorithm>
+#include <functional>
 #include <map>
+#include <set>
 
 #include "CSE.h"
 #include "IREquality.h"
@@ -280,6 +283,530 @@ public:
     CSEEveryExprInStmt(bool l) : lift_all(l) {}
 };
 
+/** Get the immediate children of an Expr. */
+class DirectChildren : public IRMutator2 {
+    bool inside = false;
+
+public:
+    vector<Expr> children;
+
+    using IRMutator2::mutate;
+
+    Expr mutate(const Expr &e) override {
+        if (inside) {
+            children.push_back(e);
+        } else {
+            inside = true;
+            IRMutator2::mutate(e);
+            inside = false;
+        }
+        return e;
+    }
+};
+
+/** Find the buffers a Stmt stores to, and whether it calls anything
+ * that might write to memory or contains an assert. */
+class FindWrites : public IRGraphVisitor {
+    using IRGraphVisitor::visit;
+
+    void visit(const Store *op) override {
+        buffers.insert(op->name);
+        IRGraphVisitor::visit(op);
+    }
+
+    void visit(const AssertStmt *op) override {
+        writes_anything = true;
+        IRGraphVisitor::visit(op);
+    }
+
+    void visit(const Call *op) override {
+        if (!op->is_pure() && op->call_type != Call::Halide) {
+            writes_anything = true;
+        }
+        IRGraphVisitor::visit(op);
+    }
+
+public:
+    std::set<string> buffers;
+    bool writes_anything = false;
+};
+
+class FindVariables : public IRGraphVisitor {
+    using IRGraphVisitor::visit;
+
+    void visit(const Variable *op) override {
+        names.insert(op->name);
+    }
+
+public:
+    std::set<string> names;
+};
+
+/** Rename loads to say which write to the buffer they come after. */
+class RenameLoads : public IRGraphMutator2 {
+    using IRGraphMutator2::visit;
+
+    const std::function<string(const string &)> &rename;
+
+    Expr visit(const Load *op) override {
+        Expr e = IRGraphMutator2::visit(op);
+        op = e.as<Load>();
+        string name = rename(op->name);
+        if (name == op->name) {
+            return e;
+        }
+        return Load::make(op->type, name, op->index, op->image, op->param, op->predicate);
+    }
+
+public:
+    RenameLoads(const std::function<string(const string &)> &r) : rename(r) {}
+};
+
+/** Value-number the Exprs in each straight-line sequence of
+ * statements together, and put the common subexpressions in
+ * LetStmts at the innermost point that encloses all their uses. */
+class CSEAcrossStmts : public IRMutator2 {
+    bool lift_all;
+
+    // A statement in a sequence. The Exprs directly in it (e.g. the
+    // value and index of a Store) are numbered together with the
+    // rest of the sequence. LetStmts, ProducerConsumers and
+    // Allocates also contain a sequence of their own. Anything else
+    // is handled separately.
+    struct Item {
+        Stmt stmt;
+        vector<Expr> exprs;
+        vector<int> numbers;
+        int body = -1;
+        // Counts items in program order.
+        int time = 0;
+        // Whether this item is handled separately from the region.
+        bool opaque = false;
+        // The common subexpressions to put in a LetStmt just before
+        // this item, or in a Let around one of its Exprs.
+        vector<int> lets_before;
+        map<int, vector<int>> lets_in_expr;
+    };
+
+    struct Sequence {
+        vector<Item> items;
+    };
+
+    // A point in a sequence: the path of item indices from the
+    // outermost sequence in, and then either an Expr of that item,
+    // or -1 for just before it.
+    struct Position {
+        vector<int> path;
+        int expr;
+    };
+
+    static Position common_position(const Position &a, const Position &b) {
+        size_t i = 0;
+        while (i < a.path.size() && i < b.path.size() && a.path[i] == b.path[i]) {
+            i++;
+        }
+        if (i == a.path.size() && i == b.path.size()) {
+            if (a.expr == b.expr) {
+                return a;
+            }
+            return {a.path, -1};
+        } else if (i == a.path.size()) {
+            return {a.path, -1};
+        } else if (i == b.path.size()) {
+            return {b.path, -1};
+        }
+        vector<int> path(a.path.begin(), a.path.begin() + i);
+        path.push_back(std::min(a.path[i], b.path[i]));
+        return {path, -1};
+    }
+
+    class Region {
+        CSEAcrossStmts &parent;
+        vector<Sequence> sequences;
+        int time = 0;
+
+        // LetStmts to handle opaquely, because their names are used
+        // elsewhere in the region. Numbering their bodies together
+        // with the rest would confuse the two.
+        std::set<string> &shadowing;
+
+        // Loads are renamed to say which write to the buffer they
+        // come after, so loads separated by a store that may alias
+        // them don't get merged. Asserts and calls with side-effects
+        // count as writes to everything, so that loads don't get
+        // moved above them either.
+        map<string, int> last_write;
+        int last_write_to_anything = -1;
+        map<pair<string, int>, string> renamed;
+        map<string, pair<string, int>> original;
+
+        // Names the LetStmts in the region bind, and the variables
+        // its Exprs refer to so far.
+        std::set<string> bound, used;
+
+        // The LetStmts whose bodies are numbered with the region, with
+        // the times their bodies span, and the times at which each
+        // variable is used by the Exprs in the region.
+        struct LetRange {
+            string name;
+            int start, end;
+        };
+        vector<LetRange> lets;
+        map<string, vector<int>> use_times;
+
+        GVN gvn;
+        vector<int> load_time;
+
+        void note_write(const string &buffer, int t) {
+            last_write[buffer] = t;
+        }
+
+        string versioned_name(const string &buffer) {
+            auto it = last_write.find(buffer);
+            int t = std::max(it == last_write.end() ? -1 : it->second, last_write_to_anything);
+            if (t < 0) {
+                return buffer;
+            }
+            string &name = renamed[{buffer, t}];
+            if (name.empty()) {
+                name = unique_name(buffer);
+                original[name] = {buffer, t};
+            }
+            return name;
+        }
+
+        void add_expr(Item &item, const Expr &e) {
+            FindVariables vars;
+            e.accept(&vars);
+            for (const string &n : vars.names) {
+                used.insert(n);
+                use_times[n].push_back(item.time);
+            }
+            std::function<string(const string &)> rename = [&](const string &n) { return versioned_name(n); };
+            item.exprs.push_back(RenameLoads(rename).mutate(e));
+            // Loads in later Exprs mustn't move above any calls with
+            // side-effects in this one.
+            FindWrites writes;
+            e.accept(&writes);
+            if (writes.writes_anything) {
+                last_write_to_anything = item.time;
+            }
+        }
+
+        // Note the writes made by an item that isn't looked inside.
+        void note_opaque_writes(Item &item) {
+            item.opaque = true;
+            FindWrites writes;
+            item.stmt.accept(&writes);
+            for (const string &b : writes.buffers) {
+                note_write(b, item.time);
+            }
+            if (writes.writes_anything) {
+                last_write_to_anything = item.time;
+            }
+        }
+
+        void add_items(int seq, const Stmt &s) {
+            if (const Block *op = s.as<Block>()) {
+                add_items(seq, op->first);
+                add_items(seq, op->rest);
+                return;
+            }
+
+            Item item;
+            item.stmt = s;
+            item.time = time++;
+            int body = -1;
+            Stmt body_stmt;
+            if (const LetStmt *op = s.as<LetStmt>()) {
+                if (shadowing.count(op->name) || bound.count(op->name) || used.count(op->name)) {
+                    // This shadows something, so numbering its body
+                    // together with the rest would confuse the names.
+                    note_opaque_writes(item);
+                } else {
+                    add_expr(item, op->value);
+                    bound.insert(op->name);
+                    body_stmt = op->body;
+                    lets.push_back({op->name, item.time, -1});
+                }
+            } else if (const Store *op = s.as<Store>()) {
+                add_expr(item, op->value);
+                add_expr(item, op->index);
+                if (!is_one(op->predicate)) {
+                    add_expr(item, op->predicate);
+                }
+                note_write(op->name, item.time);
+            } else if (const Evaluate *op = s.as<Evaluate>()) {
+                add_expr(item, op->value);
+            } else if (const AssertStmt *op = s.as<AssertStmt>()) {
+                add_expr(item, op->condition);
+                add_expr(item, op->message);
+                last_write_to_anything = item.time;
+            } else if (const ProducerConsumer *op = s.as<ProducerConsumer>()) {
+                body_stmt = op->body;
+            } else if (const Allocate *op = s.as<Allocate>()) {
+                body_stmt = op->body;
+            } else {
+                note_opaque_writes(item);
+            }
+
+            if (body_stmt.defined()) {
+                size_t let = lets.size();
+                body = new_sequence(body_stmt);
+                if (let > 0 && lets[let - 1].start == item.time) {
+                    lets[let - 1].end = time;
+                }
+            }
+            item.body = body;
+            sequences[seq].items.push_back(std::move(item));
+        }
+
+        int new_sequence(const Stmt &s) {
+            int seq = (int)sequences.size();
+            sequences.emplace_back();
+            add_items(seq, s);
+            return seq;
+        }
+
+        Item &item_at(const vector<int> &path) {
+            int seq = 0;
+            for (size_t i = 0;; i++) {
+                Item &item = sequences[seq].items[path[i]];
+                if (i + 1 == path.size()) {
+                    return item;
+                }
+                seq = item.body;
+            }
+        }
+
+        // Number all the Exprs in the region, and find where each of
+        // them is used.
+        void number_exprs(int seq, vector<int> &path, vector<Position> &where, vector<char> &used_at_all) {
+            for (size_t i = 0; i < sequences[seq].items.size(); i++) {
+                path.push_back((int)i);
+                Item &item = sequences[seq].items[i];
+                for (size_t j = 0; j < item.exprs.size(); j++) {
+                    item.exprs[j] = gvn.mutate(item.exprs[j]);
+                    item.numbers.push_back(gvn.number);
+                    where.resize(gvn.entries.size());
+                    used_at_all.resize(gvn.entries.size(), false);
+                    Position p = {path, (int)j};
+                    int n = gvn.number;
+                    where[n] = used_at_all[n] ? common_position(where[n], p) : p;
+                    used_at_all[n] = true;
+                }
+                if (item.body >= 0) {
+                    number_exprs(item.body, path, where, used_at_all);
+                }
+                path.pop_back();
+            }
+        }
+
+        Stmt rebuild(int seq, const vector<string> &names, const vector<Expr> &values, RenameLoads &restore) {
+            Stmt result;
+            const vector<Item> &items = sequences[seq].items;
+            for (size_t i = items.size(); i > 0; i--) {
+                const Item &item = items[i - 1];
+                vector<Expr> exprs = item.exprs;
+                for (size_t j = 0; j < exprs.size(); j++) {
+                    auto it = item.lets_in_expr.find((int)j);
+                    if (it != item.lets_in_expr.end()) {
+                        for (size_t k = it->second.size(); k > 0; k--) {
+                            int n = it->second[k - 1];
+                            exprs[j] = Let::make(names[n], values[n], exprs[j]);
+                        }
+                    }
+                    exprs[j] = restore.mutate(exprs[j]);
+                }
+
+                Stmt s = item.stmt;
+                if (const LetStmt *op = s.as<LetStmt>()) {
+                    if (item.body >= 0) {
+                        s = LetStmt::make(op->name, exprs[0], rebuild(item.body, names, values, restore));
+                    }
+                } else if (const Store *op = s.as<Store>()) {
+                    Expr predicate = exprs.size() > 2 ? exprs[2] : op->predicate;
+                    s = Store::make(op->name, exprs[0], exprs[1], op->param, predicate);
+                } else if (s.as<Evaluate>()) {
+                    s = Evaluate::make(exprs[0]);
+                } else if (s.as<AssertStmt>()) {
+                    s = AssertStmt::make(exprs[0], exprs[1]);
+                } else if (const ProducerConsumer *op = s.as<ProducerConsumer>()) {
+                    s = ProducerConsumer::make(op->name, op->is_producer, rebuild(item.body, names, values, restore));
+                } else if (const Allocate *op = s.as<Allocate>()) {
+                    vector<Expr> extents;
+                    for (const Expr &e : op->extents) {
+                        extents.push_back(parent.mutate(e));
+                    }
+                    Expr new_expr = op->new_expr.defined() ? parent.mutate(op->new_expr) : Expr();
+                    s = Allocate::make(op->name, op->type, op->memory_type, extents, parent.mutate(op->condition),
+                                       rebuild(item.body, names, values, restore), new_expr, op->free_function);
+                }
+
+                result = result.defined() ? Block::make(s, result) : s;
+                for (size_t k = item.lets_before.size(); k > 0; k--) {
+                    int n = item.lets_before[k - 1];
+                    result = LetStmt::make(names[n], restore.mutate(values[n]), result);
+                }
+            }
+            return result;
+        }
+
+    public:
+        Region(CSEAcrossStmts &p, std::set<string> &s) : parent(p), shadowing(s) {}
+
+        // Gather the items in a region. Returns false if some LetStmt
+        // turns out to shadow a name used elsewhere in the region, in
+        // which case the region has to be gathered again.
+        bool add(const Stmt &s) {
+            new_sequence(s);
+            bool ok = true;
+            for (const LetRange &l : lets) {
+                for (int t : use_times[l.name]) {
+                    if (t <= l.start || t >= l.end) {
+                        shadowing.insert(l.name);
+                        ok = false;
+                        break;
+                    }
+                }
+            }
+            return ok;
+        }
+
+        Stmt run() {
+            // Anything not numbered with the region is a region (or
+            // several) of its own.
+            for (Sequence &seq : sequences) {
+                for (Item &item : seq.items) {
+                    if (item.opaque) {
+                        item.stmt = parent.IRMutator2::mutate(item.stmt);
+                    }
+                }
+            }
+
+            vector<int> path;
+            vector<Position> where;
+            vector<char> used_at_all;
+            number_exprs(0, path, where, used_at_all);
+            where.resize(gvn.entries.size());
+            used_at_all.resize(gvn.entries.size(), false);
+
+            ComputeUseCounts count_uses(gvn, parent.lift_all);
+            for (const Sequence &seq : sequences) {
+                for (const Item &item : seq.items) {
+                    for (const Expr &e : item.exprs) {
+                        count_uses.include(e);
+                    }
+                }
+            }
+
+            const size_t size = gvn.entries.size();
+            vector<vector<int>> children(size);
+            load_time.resize(size, -1);
+            for (size_t n = 0; n < size; n++) {
+                DirectChildren c;
+                c.mutate(gvn.entries[n].expr);
+                for (const Expr &e : c.children) {
+                    auto it = gvn.shallow_numbering.find(e);
+                    if (it != gvn.shallow_numbering.end()) {
+                        children[n].push_back(it->second);
+                        load_time[n] = std::max(load_time[n], load_time[it->second]);
+                    }
+                }
+                if (const Load *load = gvn.entries[n].expr.as<Load>()) {
+                    auto it = original.find(load->name);
+                    if (it != original.end()) {
+                        load_time[n] = std::max(load_time[n], it->second.second);
+                    }
+                }
+            }
+
+            // Decide what to lift, visiting users before the things
+            // they use, so that each Expr is placed where it is
+            // first needed.
+            vector<char> lift(size, false);
+            for (size_t i = size; i > 0; i--) {
+                int n = (int)i - 1;
+                if (!used_at_all[n]) {
+                    continue;
+                }
+                const Position &p = where[n];
+                // A load can't move above the last write it comes
+                // after.
+                lift[n] = (gvn.entries[n].use_count > 1 &&
+                           (p.expr >= 0 || load_time[n] < item_at(p.path).time));
+                for (int c : children[n]) {
+                    where[c] = used_at_all[c] ? common_position(where[c], p) : p;
+                    used_at_all[c] = true;
+                }
+            }
+
+            map<Expr, Expr, ExprCompare> replacements;
+            vector<string> names(size);
+            for (size_t n = 0; n < size; n++) {
+                if (lift[n]) {
+                    names[n] = unique_name('t');
+                    const Expr &e = gvn.entries[n].expr;
+                    replacements[e] = Variable::make(e.type(), names[n]);
+                    Item &item = item_at(where[n].path);
+                    if (where[n].expr >= 0) {
+                        item.lets_in_expr[where[n].expr].push_back((int)n);
+                    } else {
+                        item.lets_before.push_back((int)n);
+                    }
+                }
+            }
+
+            // Rebuild the Exprs to refer to the variables.
+            Replacer replacer(replacements);
+            for (Sequence &seq : sequences) {
+                for (Item &item : seq.items) {
+                    for (Expr &e : item.exprs) {
+                        e = replacer.mutate(e);
+                    }
+                }
+            }
+            vector<Expr> values(size);
+            for (size_t i = size; i > 0; i--) {
+                if (lift[i - 1]) {
+                    const Expr &e = gvn.entries[i - 1].expr;
+                    replacer.replacements.erase(e);
+                    values[i - 1] = replacer.mutate(e);
+                }
+            }
+
+            std::function<string(const string &)> restore_name = [&](const string &n) {
+                auto it = original.find(n);
+                return it == original.end() ? n : it->second.first;
+            };
+            RenameLoads restore(restore_name);
+            return rebuild(0, names, values, restore);
+        }
+    };
+
+public:
+    using IRMutator2::mutate;
+
+    Expr mutate(const Expr &e) override {
+        return common_subexpression_elimination(e, lift_all);
+    }
+
+    Stmt mutate(const Stmt &s) override {
+        if (!s.defined()) {
+            return s;
+        }
+        std::set<string> shadowing;
+        while (true) {
+            Region region(*this, shadowing);
+            if (region.add(s)) {
+                return region.run();
+            }
+        }
+    }
+
+    CSEAcrossStmts(bool l) : lift_all(l) {}
+};
+
 } // namespace
 
 Expr common_subexpression_elimination(const Expr &e_in, bool lift_all) {
@@ -339,6 +866,10 @@ Stmt common_subexpression_elimination(const Stmt &s, bool lift_all) {
     return CSEEveryExprInStmt(lift_all).mutate(s);
 }
 
+Stmt common_subexpression_elimination_across_stmts(const Stmt &s, bool lift_all) {
+    return CSEAcrossStmts(lift_all).mutate(s);
+}
+
 
 // Testing code.
 
@@ -364,12 +895,34 @@ class NormalizeVarNames : public IRMutator2 {
 
     Expr visit(const Let *let) override {
         string new_name = "t" + std::to_string(counter++);
-        new_names[let->name] = new_name;
         Expr value = mutate(let->value);
+        string old_name = rename(let->name, new_name);
         Expr body = mutate(let->body);
+        rename(let->name, old_name);
         return Let::make(new_name, value, body);
     }
 
+    Stmt visit(const LetStmt *let) override {
+        string new_name = "t" + std::to_string(counter++);
+        Expr value = mutate(let->value);
+        string old_name = rename(let->name, new_name);
+        Stmt body = mutate(let->body);
+        rename(let->name, old_name);
+        return LetStmt::make(new_name, value, body);
+    }
+
+    // Map a name to a new one (or to nothing, if empty) and return
+    // what it mapped to before.
+    string rename(const string &name, const string &new_name) {
+        string old_name = new_names[name];
+        if (new_name.empty()) {
+            new_names.erase(name);
+        } else {
+            new_names[name] = new_name;
+        }
+        return old_name;
+    }
+
 public:
     NormalizeVarNames() : counter(0) {}
 };
@@ -384,6 +937,16 @@ void check(Expr in, Expr correct) {
         << "\ninstead of:\n" << correct << "\n";
 }
 
+void check(Stmt in, Stmt correct) {
+    Stmt result = common_subexpression_elimination_across_stmts(in);
+    NormalizeVarNames n;
+    result = n.mutate(result);
+    internal_assert(equal(result, correct))
+        << "Incorrect CSE:\n" << in
+        << "\nbecame:\n" << result
+        << "\ninstead of:\n" << correct << "\n";
+}
+
 // Construct a nested block of lets. Variables of the form "tn" refer
 // to expr n in the vector.
 Expr ssa_block(vector<Expr> exprs) {
@@ -532,6 +1095,84 @@ void cse_test() {
         check(e, correct);
     }
 
+    {
+        // Index math shared between stores gets lifted out of both,
+        // and so do loads from a buffer that isn't stored to.
+        auto load = [](const string &buf, Expr index) {
+            return Load::make(Int(32), buf, index, Buffer<>(), Parameter(), const_true());
+        };
+        auto store = [](const string &buf, Expr value, Expr index) {
+            return Store::make(buf, value, index, Parameter(), const_true());
+        };
+        Stmt s = Block::make({store("f", load("g", x*y + y) * 2, x*y + y),
+                              store("h", load("g", x*y + y) + x, x*y + y)});
+        Stmt correct = LetStmt::make("t0", x*y + y,
+                                     LetStmt::make("t1", load("g", t[0]),
+                                                   Block::make({store("f", t[1] * 2, t[0]),
+                                                                store("h", t[1] + x, t[0])})));
+        check(s, correct);
+
+        // A store in between may change what a load gives, so the
+        // loads before and after it stay separate.
+        s = Block::make({store("f", load("g", x*y + y) * 2, x*y + y),
+                         store("g", y, x),
+                         store("h", load("g", x*y + y) + x, x*y + y)});
+        correct = LetStmt::make("t0", x*y + y,
+                                Block::make({store("f", load("g", t[0]) * 2, t[0]),
+                                             store("g", y, x),
+                                             store("h", load("g", t[0]) + x, t[0])}));
+        check(s, correct);
+
+        // Things used in more than one place are defined just before
+        // the first use, so they go inside the lets they depend on.
+        Expr z = Variable::make(Int(32), "z");
+        s = Block::make({store("f", x*y, x),
+                         LetStmt::make("z", load("g", y),
+                                       Block::make({store("f", x*y + z*z, y),
+                                                    store("h", z*z, z)}))});
+        correct = LetStmt::make("t0", x*y,
+                                Block::make(store("f", t[0], x),
+                                            LetStmt::make("t1", load("g", y),
+                                                          LetStmt::make("t2", t[1] * t[1],
+                                                                        Block::make(store("f", t[0] + t[2], y),
+                                                                                    store("h", t[2], t[1]))))));
+        check(s, correct);
+
+        // A LetStmt that reuses a name, as unrolling makes, is left
+        // alone, but a store inside it still separates the loads
+        // before and after it.
+        s = Block::make({store("f", load("g", x*y + y) * 2, x*y + y),
+                         LetStmt::make("z", y * 3, store("f", z, z)),
+                         LetStmt::make("z", x * 5, store("g", z, z)),
+                         store("h", load("g", x*y + y) + x, x*y + y)});
+        correct = LetStmt::make("t0", x*y + y,
+                                Block::make({store("f", load("g", t[0]) * 2, t[0]),
+                                             LetStmt::make("t1", y * 3, store("f", t[1], t[1])),
+                                             LetStmt::make("t2", x * 5, store("g", t[2], t[2])),
+                                             store("h", load("g", t[0]) + x, t[0])}));
+        check(s, correct);
+
+        // The same goes for a LetStmt whose name is used after it,
+        // where it refers to something else.
+        s = Block::make({LetStmt::make("z", y * 3, store("f", z + x, z)),
+                         store("g", z + x, x)});
+        correct = Block::make({LetStmt::make("t0", y * 3, store("f", t[0] + x, t[0])),
+                               store("g", z + x, x)});
+        check(s, correct);
+
+        // A call with side-effects anywhere in a statement separates
+        // the loads before and after it.
+        Expr side_effect = Call::make(Int(32), "side_effect", {x}, Call::Extern);
+        s = Block::make({store("f", load("g", x*y + y) * 2, x*y + y),
+                         store("h", side_effect, y),
+                         store("h", load("g", x*y + y) + x, x*y + y)});
+        correct = LetStmt::make("t0", x*y + y,
+                                Block::make({store("f", load("g", t[0]) * 2, t[0]),
+                                             store("h", side_effect, y),
+                                             store("h", load("g", t[0]) + x, t[0])}));
+        check(s, correct);
+    }
+
     debug(0) << "common_subexpression_elimination test passed\n";
 }
 
@@ -29,6 +29,14 @@ Expr common_subexpression_elimination(const Expr &, bool lift_all = false);
  * statement. Does not introduce let statements. */
 Stmt common_subexpression_elimination(const Stmt &, bool lift_all = false);
 
+/** Do common-subexpression-elimination across the statements in each
+ * straight-line part of a statement (e.g. the body of a loop), as
+ * well as within each expression. Subexpressions shared between
+ * statements are put in let statements at the innermost point that
+ * encloses all their uses. Loads are only merged if no store that
+ * might alias them happens in between. */
+Stmt common_subexpression_elimination_across_stmts(const Stmt &, bool lift_all = false);
+
 void cse_test();
 
 }  // namespace Internal
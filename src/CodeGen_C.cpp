@@ -50,6 +50,7 @@ const string globals = R"INLINE_CODE(
 extern "C" {
 int64_t halide_current_time_ns(void *ctx);
 void halide_profiler_pipeline_end(void *, void *);
+void halide_profiler_release_slot_as_destructor(void *, void *);
 }
 
 #ifdef _WIN32
@@ -168,6 +168,7 @@ bool function_takes_user_context(const std::string &name) {
         "halide_start_clock",
         "halide_trace",
         "halide_trace_helper",
+        "halide_trace_summary_helper",
         "halide_memoization_cache_lookup",
         "halide_memoization_cache_store",
         "halide_memoization_cache_release",
@@ -476,5 +477,15 @@ void set_function_attributes_for_target(llvm::Function *fn, Target t) {
     fn->addFnAttr("reciprocal-estimates", "none");
 }
 
+size_t count_llvm_instructions(const llvm::Module &module) {
+    size_t count = 0;
+    for (const llvm::Function &f : module) {
+        for (const llvm::BasicBlock &b : f) {
+            count += b.size();
+        }
+    }
+    return count;
+}
+
 }  // namespace Internal
 }  // namespace Halide
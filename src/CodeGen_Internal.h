@@ -91,6 +91,10 @@ std::unique_ptr<llvm::TargetMachine> make_target_machine(const llvm::Module &mod
 /** Set the appropriate llvm Function attributes given a Target. */
 void set_function_attributes_for_target(llvm::Function *, Target);
 
+/** Count the instructions in an llvm::Module. Used to report the size
+ * of the IR when profiling compilation. */
+size_t count_llvm_instructions(const llvm::Module &module);
+
 }  // namespace Internal
 }  // namespace Halide
 
@@ -13,6 +13,7 @@
 #include "CodeGen_MIPS.h"
 #include "CodeGen_PowerPC.h"
 #include "CodeGen_X86.h"
+#include "CompilerProfiling.h"
 #include "Debug.h"
 #include "Deinterleave.h"
 #include "IROperator.h"
@@ -511,6 +512,8 @@ MangledNames get_mangled_names(const LoweredFunc &f, const Target &target) {
 std::unique_ptr<llvm::Module> CodeGen_LLVM::compile(const Module &input) {
     input_module = &input;
 
+    CompileProfiler profiler(input.name());
+
     init_module();
 
     debug(1) << "Target triple of initial module: " << module->getTargetTriple() << "\n";
@@ -578,9 +581,11 @@ std::unique_ptr<llvm::Module> CodeGen_LLVM::compile(const Module &input) {
     // Verify the module is ok
     internal_assert(!verifyModule(*module, &llvm::errs()));
     debug(2) << "Done generating llvm bitcode\n";
+    profiler.phase("generating llvm bitcode", count_llvm_instructions(*module));
 
     // Optimize
     CodeGen_LLVM::optimize_module();
+    profiler.phase("llvm optimization", count_llvm_instructions(*module));
 
     input_module = nullptr;
 
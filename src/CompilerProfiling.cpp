@@ -0,0 +1,202 @@
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <vector>
+
+#include "CompilerProfiling.h"
+#include "IRVisitor.h"
+#include "Util.h"
+
+namespace Halide {
+namespace Internal {
+
+using std::map;
+using std::pair;
+using std::string;
+using std::vector;
+
+namespace {
+
+class CountNodes : public IRGraphVisitor {
+    std::set<const IRNode *> nodes;
+
+    using IRGraphVisitor::visit;
+
+    void include(const Expr &e) override {
+        if (nodes.insert(e.get()).second) {
+            e.accept(this);
+        }
+    }
+
+    void include(const Stmt &s) override {
+        if (nodes.insert(s.get()).second) {
+            s.accept(this);
+        }
+    }
+
+public:
+    size_t count(const Stmt &s) {
+        if (s.defined()) {
+            include(s);
+        }
+        return nodes.size();
+    }
+};
+
+struct PhaseStats {
+    // How many times the phase ran, and the total time it took.
+    int count = 0;
+    double seconds = 0;
+    // The IR size the last time the phase ran.
+    size_t size_before = 0, size_after = 0;
+};
+
+std::string json_escape(const std::string &str) {
+    std::ostringstream out;
+    for (char c : str) {
+        if (c == '"' || c == '\\') {
+            out << '\\' << c;
+        } else if ((unsigned char)c < 0x20) {
+            out << "\\u" << std::hex << std::setw(4) << std::setfill('0') << (int)c << std::dec;
+        } else {
+            out << c;
+        }
+    }
+    return out.str();
+}
+
+// The stats for every phase of every pipeline compiled, written out
+// when the process exits.
+class CompileProfile {
+    std::mutex mutex;
+    // The order in which phases were first recorded, and their stats.
+    vector<pair<string, string>> order;
+    map<pair<string, string>, PhaseStats> stats;
+
+    void report(std::ostream &out, bool json) {
+        vector<pair<string, string>> sorted = order;
+        std::stable_sort(sorted.begin(), sorted.end(),
+                         [&](const pair<string, string> &a, const pair<string, string> &b) {
+                             return stats[a].seconds > stats[b].seconds;
+                         });
+        if (json) {
+            out << "{\"phases\": [";
+            for (size_t i = 0; i < sorted.size(); i++) {
+                const PhaseStats &p = stats[sorted[i]];
+                out << (i == 0 ? "\n" : ",\n")
+                    << "  {\"pipeline\": \"" << json_escape(sorted[i].first) << "\""
+                    << ", \"phase\": \"" << json_escape(sorted[i].second) << "\""
+                    << ", \"count\": " << p.count
+                    << ", \"seconds\": " << p.seconds
+                    << ", \"ir_before\": " << p.size_before
+                    << ", \"ir_after\": " << p.size_after << "}";
+            }
+            out << "\n]}\n";
+            return;
+        }
+
+        map<string, double> totals;
+        for (const auto &p : order) {
+            totals[p.first] += stats[p].seconds;
+        }
+        out << "Compile profile:\n";
+        for (const auto &t : totals) {
+            out << "  " << t.first << ": " << t.second * 1000 << "ms\n";
+        }
+        out << std::setw(10) << "time (ms)" << std::setw(8) << "runs"
+            << std::setw(12) << "IR before" << std::setw(12) << "IR after"
+            << "  pipeline: phase\n";
+        for (const auto &k : sorted) {
+            const PhaseStats &p = stats[k];
+            out << std::setw(10) << std::fixed << std::setprecision(3) << p.seconds * 1000
+                << std::setw(8) << p.count
+                << std::setw(12) << p.size_before
+                << std::setw(12) << p.size_after
+                << "  " << k.first << ": " << k.second << "\n";
+        }
+    }
+
+public:
+    void record(const string &pipeline, const string &phase, double seconds,
+                size_t size_before, size_t size_after) {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto key = std::make_pair(pipeline, phase);
+        auto it = stats.find(key);
+        if (it == stats.end()) {
+            order.push_back(key);
+            it = stats.emplace(key, PhaseStats()).first;
+        }
+        PhaseStats &p = it->second;
+        p.count++;
+        p.seconds += seconds;
+        p.size_before = size_before;
+        p.size_after = size_after;
+    }
+
+    ~CompileProfile() {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (order.empty()) {
+            return;
+        }
+        bool json = get_env_variable("HL_COMPILE_PROFILE") == "json";
+        string filename = get_env_variable("HL_COMPILE_PROFILE_FILE");
+        if (filename.empty()) {
+            report(std::cerr, json);
+        } else {
+            std::ofstream out(filename.c_str());
+            report(out, json);
+        }
+    }
+};
+
+CompileProfile &compile_profile() {
+    static CompileProfile profile;
+    return profile;
+}
+
+}  // namespace
+
+size_t count_ir_nodes(const Stmt &s) {
+    return CountNodes().count(s);
+}
+
+bool CompileProfiler::enabled() {
+    static bool cached_enabled = !get_env_variable("HL_COMPILE_PROFILE").empty();
+    return cached_enabled;
+}
+
+CompileProfiler::CompileProfiler(const string &pipeline_name)
+    : pipeline_name(pipeline_name) {
+    if (enabled()) {
+        // Construct the report now, so that it's destroyed after
+        // anything that records to it.
+        compile_profile();
+        last_time = std::chrono::steady_clock::now();
+    }
+}
+
+void CompileProfiler::phase(const string &name, const Stmt &s) {
+    if (enabled()) {
+        phase(name, count_ir_nodes(s));
+    }
+}
+
+void CompileProfiler::phase(const string &name, size_t ir_size) {
+    if (!enabled()) {
+        return;
+    }
+    auto now = std::chrono::steady_clock::now();
+    double seconds = std::chrono::duration<double>(now - last_time).count();
+    compile_profile().record(pipeline_name, name, seconds, last_size, ir_size);
+    last_size = ir_size;
+    // Don't bill the time spent counting IR nodes to the next phase.
+    last_time = std::chrono::steady_clock::now();
+}
+
+}  // namespace Internal
+}  // namespace Halide
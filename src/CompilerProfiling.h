@@ -0,0 +1,60 @@
+#ifndef HALIDE_COMPILER_PROFILING_H
+#define HALIDE_COMPILER_PROFILING_H
+
+/** \file
+ * Defines a tool for measuring how long each phase of compilation takes.
+ */
+
+#include <chrono>
+#include <string>
+
+#include "Expr.h"
+
+namespace Halide {
+namespace Internal {
+
+/** Records the wall-clock time taken by each phase of compiling a
+ * pipeline, and the size of the IR before and after it. Does nothing
+ * unless the environment variable HL_COMPILE_PROFILE is set, in which
+ * case a report sorted by time is written to stderr (or to the file
+ * named by HL_COMPILE_PROFILE_FILE) when the process exits. If
+ * HL_COMPILE_PROFILE is "json", the report is JSON instead of text.
+ *
+ * Each phase is timed from the end of the previous phase recorded by
+ * the same CompileProfiler, or from its construction.
+ *
+ \code
+ CompileProfiler profiler(pipeline_name);
+ s = some_pass(s);
+ profiler.phase("some pass", s);
+ \endcode
+ */
+class CompileProfiler {
+public:
+    CompileProfiler(const std::string &pipeline_name);
+
+    /** Record the end of a phase that produced the given Stmt. The
+     * size of the IR is the number of unique IR nodes in it. */
+    void phase(const std::string &name, const Stmt &s);
+
+    /** Record the end of a phase that produced some other form of IR
+     * (e.g. LLVM instructions) of the given size. A size of zero
+     * means the size is unknown. */
+    void phase(const std::string &name, size_t ir_size = 0);
+
+    /** Whether HL_COMPILE_PROFILE is set. */
+    static bool enabled();
+
+private:
+    std::string pipeline_name;
+    std::chrono::steady_clock::time_point last_time;
+    size_t last_size = 0;
+};
+
+/** Count the unique IR nodes in a Stmt. */
+size_t count_ir_nodes(const Stmt &s);
+
+}  // namespace Internal
+}  // namespace Halide
+
+#endif
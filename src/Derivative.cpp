@@ -14,6 +14,8 @@
 
 #include <cmath>
 #include <iostream>
+#include <mutex>
+#include <sstream>
 
 namespace Halide {
 namespace Internal {
@@ -85,6 +87,11 @@ void ReverseAccumulationVisitor::propagate_adjoints(
     const Func &output,
     const Func &adjoint,
     const std::vector<std::pair<Expr, Expr>> &output_bounds) {
+    // The adjoints share many subexpressions, and bounds are inferred
+    // repeatedly for the same calls. Only compute each once.
+    SimplifyMemoScope simplify_memo;
+    BoundsMemoScope bounds_memo;
+
     // Topologically sort the functions
     std::map<std::string, Function> env = find_transitive_calls(output.function());
     std::vector<std::string> order =
@@ -1736,8 +1743,433 @@ Expr forward_accumulation(const Expr &expr,
     return forward_accumulation(expr, tangents, scope);
 }
 
+namespace {
+
+// What propagate_adjoints works on, up to the names of Functions,
+// parameters, buffers, reduction variables and lets, which differ
+// every time a pipeline is constructed. Pure variable names are
+// kept, because they are also the names of the adjoints' arguments.
+struct PipelineDescription {
+    std::string shape;
+    std::vector<Expr> exprs;
+    // The Functions, in the order they were found.
+    std::vector<Function> functions;
+    // Names to their canonical names and back.
+    std::map<std::string, std::string> names, originals;
+    // The things with a canonical name.
+    std::map<std::string, Parameter> params;
+    std::map<std::string, Buffer<>> buffers;
+    std::map<std::string, ReductionDomain> rdoms;
+
+    // A copy that refers to none of the pipeline's Functions,
+    // Parameters, Buffers or reduction domains, so that the cache
+    // doesn't keep them alive. The Functions and Parameters are
+    // replaced by empty ones with the same names.
+    PipelineDescription placeholder() const {
+        PipelineDescription p;
+        p.shape = shape;
+        p.exprs = exprs;
+        p.names = names;
+        p.originals = originals;
+        for (const Function &f : functions) {
+            p.functions.push_back(Function(f.name()));
+        }
+        for (const auto &it : params) {
+            const Parameter &param = it.second;
+            p.params[it.first] = Parameter(param.type(), param.is_buffer(), param.dimensions(),
+                                           param.name(), param.is_explicit_name());
+        }
+        return p;
+    }
+
+    bool matches(const PipelineDescription &other) const {
+        if (shape != other.shape || exprs.size() != other.exprs.size()) {
+            return false;
+        }
+        for (size_t i = 0; i < exprs.size(); i++) {
+            if (!graph_equal(exprs[i], other.exprs[i])) {
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+class DescribePipeline : public IRGraphMutator2 {
+    using IRGraphMutator2::visit;
+
+    PipelineDescription &desc;
+    std::ostringstream shape;
+    std::map<std::string, int> function_indices;
+    std::set<ReductionDomain, ReductionDomain::Compare> seen_rdoms;
+
+    const std::string &canonical_name(const std::string &name, const char *prefix) {
+        auto it = desc.names.find(name);
+        if (it == desc.names.end()) {
+            std::string c = prefix + std::to_string(desc.names.size());
+            it = desc.names.emplace(name, c).first;
+            desc.originals[c] = name;
+        }
+        return it->second;
+    }
+
+    int add_function(const Function &f) {
+        auto it = function_indices.find(f.name());
+        if (it != function_indices.end()) {
+            return it->second;
+        }
+        int idx = (int)desc.functions.size();
+        function_indices[f.name()] = idx;
+        desc.functions.push_back(f);
+        return idx;
+    }
+
+    void add_rdom(const ReductionDomain &rdom) {
+        if (!seen_rdoms.insert(rdom).second) {
+            return;
+        }
+        shape << " rdom " << rdom.domain().size();
+        for (const ReductionVariable &r : rdom.domain()) {
+            desc.rdoms[canonical_name(r.var, "$r")] = rdom;
+        }
+        for (const ReductionVariable &r : rdom.domain()) {
+            desc.exprs.push_back(mutate(r.min));
+            desc.exprs.push_back(mutate(r.extent));
+        }
+        if (rdom.predicate().defined()) {
+            shape << " where";
+            desc.exprs.push_back(mutate(rdom.predicate()));
+        }
+    }
+
+    void add_definition(const Definition &def) {
+        shape << " def " << def.args().size() << " " << def.values().size();
+        for (const Expr &e : def.args()) {
+            desc.exprs.push_back(mutate(e));
+        }
+        for (const Expr &e : def.values()) {
+            desc.exprs.push_back(mutate(e));
+        }
+        if (def.predicate().defined()) {
+            shape << " where";
+            desc.exprs.push_back(mutate(def.predicate()));
+        }
+    }
+
+    Expr visit(const Variable *op) override {
+        if (op->param.defined()) {
+            const std::string &p = canonical_name(op->param.name(), "$p");
+            desc.params[p] = op->param;
+            if (starts_with(op->name, op->param.name())) {
+                return Variable::make(op->type, p + op->name.substr(op->param.name().size()));
+            }
+            return Variable::make(op->type, canonical_name(op->name, "$p"));
+        } else if (op->reduction_domain.defined()) {
+            add_rdom(op->reduction_domain);
+            return Variable::make(op->type, canonical_name(op->name, "$r"));
+        } else if (op->image.defined()) {
+            const std::string &b = canonical_name(op->image.name(), "$b");
+            desc.buffers[b] = op->image;
+            if (starts_with(op->name, op->image.name())) {
+                return Variable::make(op->type, b + op->name.substr(op->image.name().size()));
+            }
+            return Variable::make(op->type, canonical_name(op->name, "$b"));
+        }
+        auto it = desc.names.find(op->name);
+        if (it != desc.names.end()) {
+            return Variable::make(op->type, it->second);
+        }
+        return op;
+    }
+
+    Expr visit(const Let *op) override {
+        std::string name = canonical_name(op->name, "$t");
+        Expr value = mutate(op->value);
+        return Let::make(name, value, mutate(op->body));
+    }
+
+    Expr visit(const Call *op) override {
+        std::string name;
+        if (op->call_type == Call::Halide && op->func.defined()) {
+            int idx = add_function(Function(op->func));
+            name = "$f" + std::to_string(idx) + "." + std::to_string(op->value_index);
+        } else if (op->call_type == Call::Image) {
+            name = canonical_name(op->name, "$b");
+            if (op->image.defined()) {
+                desc.buffers[name] = op->image;
+            }
+            if (op->param.defined()) {
+                desc.params[name] = op->param;
+            }
+        } else {
+            return IRGraphMutator2::visit(op);
+        }
+        std::vector<Expr> args;
+        for (const Expr &e : op->args) {
+            args.push_back(mutate(e));
+        }
+        return Call::make(op->type, name, args, Call::PureExtern);
+    }
+
+public:
+    DescribePipeline(PipelineDescription &d) : desc(d) {}
+
+    // Returns false if the pipeline can't be described.
+    bool describe(const Func &output, const Func &adjoint,
+                  const std::vector<std::pair<Expr, Expr>> &output_bounds) {
+        add_function(output.function());
+        add_function(adjoint.function());
+        for (size_t i = 0; i < desc.functions.size(); i++) {
+            Function f = desc.functions[i];
+            if (f.has_extern_definition()) {
+                return false;
+            }
+            shape << "\nfunc " << i << " (";
+            for (const std::string &arg : f.args()) {
+                shape << " " << arg;
+            }
+            shape << " ) ->";
+            for (const Type &t : f.output_types()) {
+                shape << " " << t;
+            }
+            if (f.has_pure_definition()) {
+                add_definition(f.definition());
+            }
+            for (const Definition &def : f.updates()) {
+                add_definition(def);
+            }
+        }
+        shape << "\nbounds " << output_bounds.size();
+        for (const auto &b : output_bounds) {
+            desc.exprs.push_back(mutate(b.first));
+            desc.exprs.push_back(mutate(b.second));
+        }
+        desc.shape = shape.str();
+        return true;
+    }
+};
+
+// Points references to one described pipeline at the corresponding
+// parts of another.
+class RemapPipeline : public IRGraphMutator2 {
+    using IRGraphMutator2::visit;
+
+    const PipelineDescription &from, &to;
+    std::map<ReductionDomain, ReductionDomain, ReductionDomain::Compare> rdom_copies;
+
+    const std::string *canonical_name(const std::string &name) const {
+        auto it = from.names.find(name);
+        return it == from.names.end() ? nullptr : &it->second;
+    }
+
+    // Reduction domains the derivative made itself are copied, so
+    // that their bounds can refer to the new parameters.
+    ReductionDomain copy_rdom(const ReductionDomain &rdom) {
+        auto it = rdom_copies.find(rdom);
+        if (it != rdom_copies.end()) {
+            return it->second;
+        }
+        ReductionDomain copy = rdom.deep_copy();
+        rdom_copies[rdom] = copy;
+        copy.mutate(this);
+        return copy;
+    }
+
+    Expr visit(const Variable *op) override {
+        if (op->param.defined()) {
+            const std::string *c = canonical_name(op->param.name());
+            if (!c || !to.params.count(*c)) {
+                return op;
+            }
+            Parameter param = to.params.at(*c);
+            std::string name = op->name;
+            if (starts_with(name, op->param.name())) {
+                name = param.name() + name.substr(op->param.name().size());
+            }
+            return Variable::make(op->type, name, param);
+        } else if (op->reduction_domain.defined()) {
+            const std::string *c = canonical_name(op->name);
+            auto r = c ? to.rdoms.find(*c) : to.rdoms.end();
+            if (r != to.rdoms.end()) {
+                return Variable::make(op->type, rename(op->name), r->second);
+            }
+            return Variable::make(op->type, op->name, copy_rdom(op->reduction_domain));
+        } else if (op->image.defined()) {
+            const std::string *c = canonical_name(op->image.name());
+            if (!c) {
+                return op;
+            }
+            auto b = to.buffers.find(*c);
+            std::string name = op->name;
+            if (starts_with(name, op->image.name())) {
+                name = to.originals.at(*c) + name.substr(op->image.name().size());
+            }
+            return Variable::make(op->type, name, b == to.buffers.end() ? Buffer<>() : b->second);
+        }
+        return op;
+    }
+
+    Expr visit(const Call *op) override {
+        if (op->call_type != Call::Image) {
+            return IRGraphMutator2::visit(op);
+        }
+        const std::string *c = canonical_name(op->name);
+        if (!c) {
+            return IRGraphMutator2::visit(op);
+        }
+        std::vector<Expr> args;
+        for (const Expr &e : op->args) {
+            args.push_back(mutate(e));
+        }
+        auto b = to.buffers.find(*c);
+        auto p = to.params.find(*c);
+        return Call::make(op->type, rename(op->name), args, Call::Image, FunctionPtr(), op->value_index,
+                          b == to.buffers.end() ? Buffer<>() : b->second,
+                          p == to.params.end() ? Parameter() : p->second);
+    }
+
+public:
+    RemapPipeline(const PipelineDescription &f, const PipelineDescription &t) : from(f), to(t) {}
+
+    std::string rename(const std::string &name) const {
+        const std::string *c = canonical_name(name);
+        return c ? to.originals.at(*c) : name;
+    }
+
+    // The key of an adjoint in a Derivative for the other pipeline.
+    std::string rename_key(const std::string &name) const {
+        for (size_t i = 0; i < from.functions.size(); i++) {
+            if (name == from.functions[i].name()) {
+                return to.functions[i].name();
+            } else if (name == from.functions[i].name() + "_unbounded") {
+                return to.functions[i].name() + "_unbounded";
+            }
+        }
+        return rename(name);
+    }
+
+    void remap(Function f) {
+        f.mutate(this);
+        auto rename_stage = [&](Definition &def) {
+            for (ReductionVariable &r : def.schedule().rvars()) {
+                r.var = rename(r.var);
+            }
+            for (Dim &d : def.schedule().dims()) {
+                d.var = rename(d.var);
+            }
+        };
+        if (f.has_pure_definition()) {
+            rename_stage(f.definition());
+        }
+        for (size_t i = 0; i < f.updates().size(); i++) {
+            rename_stage(f.update((int)i));
+        }
+    }
+};
+
+// Copy the Functions a Derivative synthesized, so that the copies
+// call new_functions instead of old_functions and refer to the
+// pipeline the remapping leads to.
+Derivative copy_derivative(const Derivative &d,
+                           const std::vector<Function> &old_functions,
+                           const std::vector<Function> &new_functions,
+                           RemapPipeline &remap, bool fresh_names) {
+    std::map<FunctionPtr, FunctionPtr> copied;
+    for (size_t i = 0; i < old_functions.size(); i++) {
+        copied[old_functions[i].get_contents()] = new_functions[i].get_contents();
+    }
+
+    std::map<std::string, Function> synthesized;
+    for (const auto &it : d.adjoints) {
+        for (const auto &c : find_transitive_calls(it.second.function())) {
+            if (!copied.count(c.second.get_contents())) {
+                synthesized.insert(c);
+            }
+        }
+    }
+
+    std::vector<Function> copies;
+    for (const auto &it : synthesized) {
+        Function copy(fresh_names ? unique_name(it.first) : it.first);
+        copied[it.second.get_contents()] = copy.get_contents();
+        copies.push_back(copy);
+    }
+    size_t i = 0;
+    for (const auto &it : synthesized) {
+        it.second.deep_copy(copies[i].name(), copies[i].get_contents(), copied);
+        i++;
+    }
+    for (Function &copy : copies) {
+        copy.substitute_calls(copied);
+        remap.remap(copy);
+    }
+
+    Derivative result;
+    for (const auto &it : d.adjoints) {
+        FuncKey key{remap.rename_key(it.first.first), it.first.second};
+        result.adjoints[key] = Func(Function(copied[it.second.function().get_contents()]));
+    }
+    return result;
+}
+
+bool derivative_cache_enabled() {
+    static bool enabled = get_env_variable("HL_DERIVATIVE_CACHE") != "0";
+    return enabled;
+}
+
+// Derivatives of recently seen pipelines. Each holds its own copy of
+// the Functions it synthesized, so scheduling the Funcs handed out
+// doesn't change what later copies start with. The copies refer to
+// placeholders rather than to the pipeline they were made for.
+struct CachedDerivative {
+    PipelineDescription pipeline;
+    Derivative derivative;
+};
+
+std::mutex derivative_cache_lock;
+std::vector<CachedDerivative> derivative_cache;
+const size_t max_cached_derivatives = 16;
+int derivative_cache_hit_count = 0;
+
+bool find_cached_derivative(const PipelineDescription &pipeline, Derivative &result) {
+    std::lock_guard<std::mutex> lock(derivative_cache_lock);
+    for (const CachedDerivative &c : derivative_cache) {
+        if (c.pipeline.matches(pipeline)) {
+            RemapPipeline remap(c.pipeline, pipeline);
+            result = copy_derivative(c.derivative, c.pipeline.functions, pipeline.functions, remap, true);
+            derivative_cache_hit_count++;
+            debug(1) << "Reusing a cached derivative\n";
+            return true;
+        }
+    }
+    return false;
+}
+
+void cache_derivative(const PipelineDescription &pipeline, const Derivative &d) {
+    PipelineDescription key = pipeline.placeholder();
+    RemapPipeline remap(pipeline, key);
+    CachedDerivative c{key, copy_derivative(d, pipeline.functions, key.functions, remap, false)};
+    std::lock_guard<std::mutex> lock(derivative_cache_lock);
+    if (derivative_cache.size() >= max_cached_derivatives) {
+        derivative_cache.erase(derivative_cache.begin());
+    }
+    derivative_cache.push_back(std::move(c));
+}
+
+}  // namespace
+
+int derivative_cache_hits() {
+    std::lock_guard<std::mutex> lock(derivative_cache_lock);
+    return derivative_cache_hit_count;
+}
+
 }  // namespace Internal
 
+void clear_derivative_cache() {
+    std::lock_guard<std::mutex> lock(Internal::derivative_cache_lock);
+    Internal::derivative_cache.clear();
+}
+
 Derivative propagate_adjoints(const Func &output,
                               const Func &adjoint,
                               const std::vector<std::pair<Expr, Expr>> &output_bounds) {
@@ -1746,9 +2178,23 @@ Derivative propagate_adjoints(const Func &output,
     user_assert((int) output_bounds.size() == adjoint.dimensions())
         << "output_bounds and adjoint dimensions must match\n";
 
+    // Reuse the derivative of a structurally identical pipeline if
+    // we've seen one.
+    Internal::PipelineDescription pipeline;
+    bool cacheable = Internal::derivative_cache_enabled() &&
+                     Internal::DescribePipeline(pipeline).describe(output, adjoint, output_bounds);
+    Derivative result;
+    if (cacheable && Internal::find_cached_derivative(pipeline, result)) {
+        return result;
+    }
+
     Internal::ReverseAccumulationVisitor visitor;
     visitor.propagate_adjoints(output, adjoint, output_bounds);
-    return Derivative{ visitor.get_adjoint_funcs() };
+    result = Derivative{ visitor.get_adjoint_funcs() };
+    if (cacheable) {
+        Internal::cache_derivative(pipeline, result);
+    }
+    return result;
 }
 
 Derivative propagate_adjoints(const Func &output,
@@ -67,10 +67,23 @@ struct Derivative {
  *  Given a Func and a corresponding adjoint, (back)propagate the
  *  adjoint to all dependent Funcs, buffers, and parameters.
  *  The bounds of output and adjoint needs to be specified with pair {min, max}
+ *  Results are cached: if the pipeline differs from a recently
+ *  differentiated one only in the names of its Funcs, parameters,
+ *  buffers and reduction variables, the cached adjoints are copied
+ *  (with fresh names) instead of being derived again. Pure Vars must
+ *  have the same names for this to happen. The cache holds no
+ *  references to the Funcs, parameters or buffers of the pipelines it
+ *  has seen. Set the environment variable HL_DERIVATIVE_CACHE=0 to
+ *  turn this off, or call clear_derivative_cache to empty it.
  */
 Derivative propagate_adjoints(const Func &output,
                               const Func &adjoint,
                               const std::vector<std::pair<Expr, Expr>> &output_bounds);
+/**
+ *  Forget the derivatives cached by propagate_adjoints.
+ */
+void clear_derivative_cache();
+
 /**
  *  Given a Func and a corresponding adjoint buffer, (back)propagate the
  *  adjoint to all dependent Funcs, buffers, and parameters.
@@ -99,6 +112,10 @@ void print_func(const Func &func, const PrintFuncOptions &options = PrintFuncOpt
 
 namespace Internal {
 
+/** The number of times propagate_adjoints has reused a cached
+ * derivative instead of deriving it again. For testing. */
+int derivative_cache_hits();
+
 void derivative_test();
 }
 
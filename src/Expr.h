@@ -345,7 +345,10 @@ const DeviceAPI all_device_apis[] = {DeviceAPI::None,
 
 /** An enum describing different address spaces to be used with Func::store_in. */
 enum class MemoryType {
-    /** Let Halide select a storage type automatically */
+    /** Let Halide select a storage type automatically. Small
+     * allocations of bounded size go on the stack, including per-tile
+     * scratch inside parallel loops. Everything else goes on the
+     * heap. */
     Auto,
 
     /** Heap/global memory. Allocated using halide_malloc, or
@@ -359,9 +362,12 @@ enum class MemoryType {
     Stack,
 
     /** Register memory. The allocation should be promoted into the
-     * register file. All stores must be at constant coordinates. May
-     * be spilled to the stack at the discretion of the register
-     * allocator. */
+     * register file. All loads and stores must be at constant
+     * coordinates, which typically means unrolling the loops over
+     * the Func's dimensions. On the CPU each element becomes a
+     * separate scalar, and it is an error to access one at a
+     * non-constant coordinate. May be spilled to the stack at the
+     * discretion of the register allocator. */
     Register,
 
     /** Allocation is stored in GPU shared memory. Also known as
@@ -2472,6 +2472,12 @@ Func &Func::trace_realizations() {
     return *this;
 }
 
+Func &Func::trace_summary() {
+    invalidate_cache();
+    func.trace_summary();
+    return *this;
+}
+
 Func &Func::add_trace_tag(const std::string &trace_tag) {
     invalidate_cache();
     func.add_trace_tag(trace_tag);
@@ -3092,6 +3098,10 @@ void *Func::compile_jit(const Target &target) {
     return pipeline().compile_jit(target);
 }
 
+Callable Func::compile_to_callable(const vector<Argument> &args, const Target &target) {
+    return pipeline().compile_to_callable(args, target);
+}
+
 Var _("_");
 Var _0("_0"), _1("_1"), _2("_2"), _3("_3"), _4("_4"),
            _5("_5"), _6("_6"), _7("_7"), _8("_8"), _9("_9");
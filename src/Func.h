@@ -923,6 +923,12 @@ public:
      */
     void *compile_jit(const Target &target = get_jit_target_from_environment());
 
+    /** JIT compile the function, and return a Callable that runs it
+     * with the given arguments at low overhead. See
+     * Pipeline::compile_to_callable. */
+    Callable compile_to_callable(const std::vector<Argument> &args,
+                                 const Target &target = get_jit_target_from_environment());
+
     /** Set the error handler function that be called in the case of
      * runtime errors during halide pipelines. If you are compiling
      * statically, you can also just define your own function with
@@ -2253,6 +2259,16 @@ public:
      * halide_trace. */
     Func &trace_realizations();
 
+    /** Instead of sending every store to halide_trace, aggregate the
+     * stores to each realization of this Func in the runtime, along
+     * with the loads from it, and print one summary line when the
+     * realization ends. The summary gives the region realized, the
+     * bounding box of the stores and loads, how many times each
+     * element was computed, and the range of values stored. This is
+     * much cheaper than tracing every store, so it can be left on for
+     * large inputs. Independent of the other tracing calls. */
+    Func &trace_summary();
+
     /** Add a string of arbitrary text that will be passed thru to trace
      * inspection code if the Func is realized in trace mode. (Funcs that are
      * inlined won't have their tags emitted.) Ignored entirely if
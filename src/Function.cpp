@@ -87,7 +87,7 @@ struct FunctionContents {
     bool extern_uses_old_buffer_t = false;
     Expr extern_proxy_expr;
 
-    bool trace_loads = false, trace_stores = false, trace_realizations = false;
+    bool trace_loads = false, trace_stores = false, trace_realizations = false, trace_summary = false;
     std::vector<string> trace_tags;
 
     bool frozen = false;
@@ -341,6 +341,7 @@ void Function::deep_copy(FunctionPtr copy, DeepCopyMap &copied_map) const {
     copy->trace_loads = contents->trace_loads;
     copy->trace_stores = contents->trace_stores;
     copy->trace_realizations = contents->trace_realizations;
+    copy->trace_summary = contents->trace_summary;
     copy->trace_tags = contents->trace_tags;
     copy->frozen = contents->frozen;
     copy->output_buffers = contents->output_buffers;
@@ -887,6 +888,9 @@ void Function::trace_stores() {
 void Function::trace_realizations() {
     contents->trace_realizations = true;
 }
+void Function::trace_summary() {
+    contents->trace_summary = true;
+}
 void Function::add_trace_tag(const std::string &trace_tag) {
     contents->trace_tags.push_back(trace_tag);
 }
@@ -900,6 +904,9 @@ bool Function::is_tracing_stores() const {
 bool Function::is_tracing_realizations() const {
     return contents->trace_realizations;
 }
+bool Function::is_tracing_summary() const {
+    return contents->trace_summary;
+}
 const std::vector<std::string> &Function::get_trace_tags() const {
     return contents->trace_tags;
 }
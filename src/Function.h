@@ -278,10 +278,12 @@ public:
     void trace_loads();
     void trace_stores();
     void trace_realizations();
+    void trace_summary();
     void add_trace_tag(const std::string &trace_tag);
     bool is_tracing_loads() const;
     bool is_tracing_stores() const;
     bool is_tracing_realizations() const;
+    bool is_tracing_summary() const;
     const std::vector<std::string> &get_trace_tags() const;
     // @}
 
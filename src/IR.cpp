@@ -900,6 +900,7 @@ Call::ConstString Call::buffer_init_from_buffer = "_halide_buffer_init_from_buff
 Call::ConstString Call::buffer_crop = "_halide_buffer_crop";
 Call::ConstString Call::buffer_set_bounds = "_halide_buffer_set_bounds";
 Call::ConstString Call::trace = "halide_trace_helper";
+Call::ConstString Call::trace_summary = "halide_trace_summary_helper";
 
 }  // namespace Internal
 }  // namespace Halide
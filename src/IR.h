@@ -545,7 +545,8 @@ struct Call : public ExprNode<Call> {
         buffer_init_from_buffer,
         buffer_crop,
         buffer_set_bounds,
-        trace;
+        trace,
+        trace_summary;
 
     // If it's a call to another halide function, this call node holds
     // a possibly-weak reference to that function.
@@ -1,20 +1,30 @@
+#include <algorithm>
+#include <sstream>
 #include <string>
 #include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include <mutex>
 #include <set>
+#include <cstring>
 
 #ifndef _WIN32
 #include <sys/mman.h>
 #endif
 
 #include "CodeGen_Internal.h"
+#include "CompilerProfiling.h"
 #include "JITModule.h"
 #include "LLVM_Headers.h"
 #include "LLVM_Runtime_Linker.h"
 #include "Debug.h"
+#include "IRMutator.h"
+#include "IRPrinter.h"
+#include "IRVisitor.h"
 #include "LLVM_Output.h"
 #include "CodeGen_LLVM.h"
 #include "Pipeline.h"
+#include "Scope.h"
 
 
 #if defined(_MSC_VER) && !defined(NOMINMAX)
@@ -136,6 +146,8 @@ public:
     std::map<std::string, JITModule::Symbol> exports;
     llvm::LLVMContext context;
     ExecutionEngine *execution_engine;
+    // Must outlive the execution engine.
+    std::unique_ptr<llvm::ObjectCache> object_cache;
     std::vector<JITModule> dependencies;
     JITModule::Symbol entrypoint;
     JITModule::Symbol argv_entrypoint;
@@ -151,10 +163,14 @@ void destroy<JITModuleContents>(const JITModuleContents *f) { delete f; }
 
 namespace {
 
-// Retrieve a function pointer from an llvm module, possibly by compiling it.
-JITModule::Symbol compile_and_get_function(ExecutionEngine &ee, const string &name) {
+// Retrieve a function pointer from an llvm module, possibly by
+// compiling it. If the code was compiled ahead of time and added to
+// the execution engine as object files, the type of the function
+// comes from the module it was compiled from.
+JITModule::Symbol compile_and_get_function(ExecutionEngine &ee, const string &name,
+                                           const llvm::Module *compiled_module = nullptr) {
     debug(2) << "JIT Compiling " << name << "\n";
-    llvm::Function *fn = ee.FindFunctionNamed(name.c_str());
+    llvm::Function *fn = compiled_module ? compiled_module->getFunction(name) : ee.FindFunctionNamed(name.c_str());
     void *f = (void *)ee.getFunctionAddress(name);
     if (!f) {
         internal_error << "Compiling " << name << " returned nullptr\n";
@@ -233,6 +249,383 @@ public:
     }
 };
 
+// Records the alignment that codegen will assume for each buffer
+// loaded from. This depends on the actual host pointer of buffers
+// embedded in a JIT-compiled pipeline, so it must be part of the key
+// of anything cached.
+class RecordAlignments : public IRGraphVisitor {
+    using IRGraphVisitor::visit;
+
+    void visit(const Load *op) override {
+        IRGraphVisitor::visit(op);
+        if (op->param.defined()) {
+            out << op->name << " param alignment " << op->param.host_alignment() << "\n";
+        } else if (op->image.defined()) {
+            uintptr_t ptr = (uintptr_t)op->image.data();
+            int alignment = 1;
+            while (alignment < (1 << 30) && !(ptr & alignment)) {
+                alignment *= 2;
+            }
+            out << op->name << " image alignment " << alignment << "\n";
+        }
+    }
+
+public:
+    std::ostream &out;
+    RecordAlignments(std::ostream &out) : out(out) {}
+};
+
+// Renames the variables, loops and allocations a Stmt binds, in the
+// order they are bound, so that two lowerings of the same pipeline
+// print the same even though their temporaries were named from
+// process-wide counters (see unique_name). Free names, such as the
+// arguments, and string constants are left alone, as they end up in
+// the compiled code.
+class CanonicalizeLocalNames : public IRMutator2 {
+    using IRMutator2::visit;
+
+    Scope<string> renamed;
+    int count = 0;
+
+    string rename(const string &name) {
+        return renamed.contains(name) ? renamed.get(name) : name;
+    }
+
+    string bind_next() {
+        return "$l" + std::to_string(count++);
+    }
+
+    Expr visit(const Variable *op) override {
+        if (renamed.contains(op->name)) {
+            return Variable::make(op->type, renamed.get(op->name));
+        }
+        return op;
+    }
+
+    Expr visit(const Let *op) override {
+        Expr value = mutate(op->value);
+        string name = bind_next();
+        ScopedBinding<string> bind(renamed, op->name, name);
+        return Let::make(name, value, mutate(op->body));
+    }
+
+    Stmt visit(const LetStmt *op) override {
+        Expr value = mutate(op->value);
+        string name = bind_next();
+        ScopedBinding<string> bind(renamed, op->name, name);
+        return LetStmt::make(name, value, mutate(op->body));
+    }
+
+    Stmt visit(const For *op) override {
+        Expr min = mutate(op->min);
+        Expr extent = mutate(op->extent);
+        string name = bind_next();
+        ScopedBinding<string> bind(renamed, op->name, name);
+        return For::make(name, min, extent, op->for_type, op->device_api, mutate(op->body));
+    }
+
+    Stmt visit(const Allocate *op) override {
+        std::vector<Expr> extents;
+        for (const Expr &e : op->extents) {
+            extents.push_back(mutate(e));
+        }
+        Expr condition = mutate(op->condition);
+        Expr new_expr;
+        if (op->new_expr.defined()) {
+            new_expr = mutate(op->new_expr);
+        }
+        string name = bind_next();
+        ScopedBinding<string> bind(renamed, op->name, name);
+        return Allocate::make(name, op->type, op->memory_type, extents, condition,
+                              mutate(op->body), new_expr, op->free_function);
+    }
+
+    Stmt visit(const Free *op) override {
+        return Free::make(rename(op->name));
+    }
+
+    Expr visit(const Load *op) override {
+        return Load::make(op->type, rename(op->name), mutate(op->index),
+                          op->image, op->param, mutate(op->predicate));
+    }
+
+    Stmt visit(const Store *op) override {
+        return Store::make(rename(op->name), mutate(op->value), mutate(op->index),
+                           op->param, mutate(op->predicate));
+    }
+};
+
+// Print a module for the key of the JIT cache, with the local names
+// of each function canonicalized.
+void print_canonical_module(std::ostream &out, const Module &m) {
+    for (const Module &s : m.submodules()) {
+        print_canonical_module(out, s);
+    }
+    out << "module name=" << m.name() << ", target=" << m.target().to_string() << "\n";
+    for (const Buffer<> &b : m.buffers()) {
+        out << "buffer " << b.name() << " = {...}\n";
+    }
+    for (const LoweredFunc &f : m.functions()) {
+        out << f.linkage << " func " << f.name << " (";
+        for (const LoweredArgument &arg : f.args) {
+            out << arg.name << ":" << (int)arg.kind << ":" << arg.type << ":" << (int)arg.dimensions << " ";
+        }
+        out << ") {\n"
+            << CanonicalizeLocalNames().mutate(f.body)
+            << "}\n";
+    }
+}
+
+// Identifies the build of Halide doing the compiling, by the size and
+// modification time of the library or executable this code is in,
+// so that rebuilding any part of Halide, including the runtime it
+// embeds, invalidates the cache. Empty if it can't be found.
+std::string halide_build_stamp() {
+    std::string path;
+#ifdef _WIN32
+    HMODULE module = NULL;
+    char buf[MAX_PATH];
+    if (GetModuleHandleExA(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS |
+                           GET_MODULE_HANDLE_EX_FLAG_UNCHANGED_REFCOUNT,
+                           (LPCSTR)&halide_build_stamp, &module) &&
+        GetModuleFileNameA(module, buf, sizeof(buf)) != 0) {
+        path = buf;
+    }
+#else
+    Dl_info info;
+    if (dladdr((void *)&halide_build_stamp, &info) && info.dli_fname) {
+        path = info.dli_fname;
+    }
+#endif
+    llvm::sys::fs::file_status status;
+    if (path.empty() || llvm::sys::fs::status(path, status)) {
+        // dladdr may give a path relative to where the program was
+        // started from.
+        path = llvm::sys::fs::getMainExecutable(nullptr, (void *)&halide_build_stamp);
+        if (path.empty() || llvm::sys::fs::status(path, status)) {
+            return "";
+        }
+    }
+    std::ostringstream stamp;
+    stamp << status.getSize() << " " << status.getLastModificationTime().time_since_epoch().count();
+    return stamp.str();
+}
+
+// A cache of JIT-compiled pipelines on disk, shared between
+// processes. See the documentation of the JITModule constructor.
+class JITDiskCache : public llvm::ObjectCache {
+    std::string dir, key;
+    // The bitcode of the module being compiled, written along with
+    // the object file once it has been compiled.
+    std::string bitcode;
+
+    std::string path(const char *extension) const {
+        return dir + "/halide_jit_" + key + extension;
+    }
+
+    // Write a file so that other processes never see it partially
+    // written.
+    static bool write_file(const std::string &path, llvm::StringRef data) {
+        int fd;
+        llvm::SmallString<128> tmp_path;
+        if (llvm::sys::fs::createUniqueFile(path + ".%%%%%%.tmp", fd, tmp_path)) {
+            return false;
+        }
+        bool ok;
+        {
+            llvm::raw_fd_ostream out(fd, /* shouldClose */ true);
+            out << data;
+            out.close();
+            ok = !out.has_error();
+            out.clear_error();
+        }
+        if (!ok || llvm::sys::fs::rename(tmp_path, path)) {
+            llvm::sys::fs::remove(tmp_path);
+            return false;
+        }
+        return true;
+    }
+
+    // Delete the oldest entries until the cache is below its size limit.
+    void evict() {
+        uint64_t max_size = 1024;
+        std::string max_size_str = get_env_variable("HL_JIT_CACHE_MAX_SIZE");
+        if (!max_size_str.empty()) {
+            max_size = strtoull(max_size_str.c_str(), nullptr, 10);
+        }
+        max_size *= 1024 * 1024;
+
+        typedef decltype(llvm::sys::fs::file_status().getLastModificationTime()) Time;
+        struct Entry {
+            Time time;
+            uint64_t size = 0;
+            std::vector<std::string> files;
+        };
+        std::map<std::string, Entry> entries;
+        uint64_t total_size = 0;
+        std::error_code ec;
+        for (llvm::sys::fs::directory_iterator it(dir, ec), end; it != end && !ec; it.increment(ec)) {
+            std::string file = it->path();
+            std::string name = llvm::sys::path::filename(file);
+            std::string extension = llvm::sys::path::extension(file);
+            if (!starts_with(name, "halide_jit_") || (extension != ".o" && extension != ".bc")) {
+                continue;
+            }
+            llvm::sys::fs::file_status status;
+            if (llvm::sys::fs::status(file, status)) {
+                continue;
+            }
+            Entry &e = entries[name.substr(0, name.size() - extension.size())];
+            // The bitcode is written last, so its time is the time
+            // the entry was added.
+            if (e.files.empty() || extension == ".bc") {
+                e.time = status.getLastModificationTime();
+            }
+            e.size += status.getSize();
+            e.files.push_back(file);
+            total_size += status.getSize();
+        }
+        if (total_size <= max_size) {
+            return;
+        }
+        std::vector<Entry *> oldest_first;
+        for (auto &e : entries) {
+            oldest_first.push_back(&e.second);
+        }
+        std::sort(oldest_first.begin(), oldest_first.end(),
+                  [](const Entry *a, const Entry *b) { return a->time < b->time; });
+        for (const Entry *e : oldest_first) {
+            if (total_size <= max_size) {
+                break;
+            }
+            for (const std::string &file : e->files) {
+                llvm::sys::fs::remove(file);
+            }
+            total_size -= e->size;
+        }
+    }
+
+public:
+    JITDiskCache(const std::string &dir, const std::string &key)
+        : dir(dir), key(key) {
+        llvm::sys::fs::create_directories(dir);
+    }
+
+    // Load the module if it is in the cache, along with its object
+    // file. Returns nullptr if it is not.
+    std::unique_ptr<llvm::Module> load_module(llvm::LLVMContext &context) {
+        if (!llvm::sys::fs::exists(path(".o"))) {
+            return nullptr;
+        }
+        auto buffer = llvm::MemoryBuffer::getFile(path(".bc"));
+        if (!buffer) {
+            return nullptr;
+        }
+        auto module = llvm::expectedToErrorOr(llvm::parseBitcodeFile((*buffer)->getMemBufferRef(), context));
+        if (!module) {
+            debug(1) << "Ignoring corrupt JIT cache entry " << path(".bc") << "\n";
+            return nullptr;
+        }
+        debug(1) << "Loaded " << path(".bc") << " from the JIT cache\n";
+        return std::move(*module);
+    }
+
+    // Remember the module, to write it to the cache once it has been
+    // compiled.
+    void save_module(const llvm::Module &module) {
+        llvm::SmallVector<char, 0> buffer;
+        llvm::raw_svector_ostream out(buffer);
+#if LLVM_VERSION >= 70
+        WriteBitcodeToFile(module, out);
+#else
+        WriteBitcodeToFile(&module, out);
+#endif
+        bitcode.assign(buffer.begin(), buffer.end());
+    }
+
+    void notifyObjectCompiled(const llvm::Module *, llvm::MemoryBufferRef object) override {
+        if (bitcode.empty()) {
+            // The module came from the cache.
+            return;
+        }
+        // The module must be written after the object, because the
+        // presence of the module means the entry is complete.
+        if (write_file(path(".o"), object.getBuffer()) &&
+            write_file(path(".bc"), bitcode)) {
+            debug(1) << "Wrote " << path(".o") << " to the JIT cache\n";
+            evict();
+        } else {
+            debug(1) << "Failed to write " << path(".o") << " to the JIT cache\n";
+        }
+        bitcode.clear();
+    }
+
+    std::unique_ptr<llvm::MemoryBuffer> getObject(const llvm::Module *) override {
+        if (!bitcode.empty()) {
+            // The module was just compiled.
+            return nullptr;
+        }
+        auto buffer = llvm::MemoryBuffer::getFile(path(".o"));
+        if (!buffer) {
+            return nullptr;
+        }
+        return std::move(*buffer);
+    }
+
+    // The directory to cache JIT-compiled pipelines in, or the empty
+    // string if caching is disabled.
+    static std::string directory() {
+        static std::string cached_dir = get_env_variable("HL_JIT_CACHE_DIR");
+        if (!cached_dir.empty() && build_stamp().empty()) {
+            debug(1) << "Not using the JIT cache, as the build of Halide can't be identified\n";
+            cached_dir.clear();
+        }
+        return cached_dir;
+    }
+
+    static const std::string &build_stamp() {
+        static std::string stamp = halide_build_stamp();
+        return stamp;
+    }
+
+    // Compute a key that identifies everything that determines the
+    // compiled code for a module.
+    static std::string compute_key(const Module &m) {
+        std::ostringstream key;
+        key << "halide jit cache 2\n"
+            << "llvm " << LLVM_VERSION << "\n"
+            << "halide build " << build_stamp() << "\n"
+            << "host cpu " << llvm::sys::getHostCPUName().str() << "\n"
+            << "strict float " << m.any_strict_float() << "\n";
+        print_canonical_module(key, m);
+        // Embedded buffers and external code are only printed by name.
+        for (const Buffer<> &b : m.buffers()) {
+            const halide_buffer_t *buf = b.raw_buffer();
+            if (buf->host) {
+                key.write((const char *)buf->begin(), buf->size_in_bytes());
+            }
+        }
+        for (const ExternalCode &code : m.external_code()) {
+            key.write((const char *)code.contents().data(), code.contents().size());
+        }
+        RecordAlignments alignments(key);
+        for (const LoweredFunc &f : m.functions()) {
+            f.body.accept(&alignments);
+        }
+
+        // Two independent 64-bit FNV-1a hashes of the key.
+        std::string str = key.str();
+        uint64_t h1 = 14695981039346656037ULL, h2 = 0x9e3779b97f4a7c15ULL;
+        for (char c : str) {
+            h1 = (h1 ^ (uint8_t)c) * 1099511628211ULL;
+            h2 = (h2 ^ (uint8_t)c) * 1099511628211ULL;
+        }
+        char result[33];
+        snprintf(result, sizeof(result), "%016llx%016llx", (unsigned long long)h1, (unsigned long long)h2);
+        return result;
+    }
+};
+
 }
 
 JITModule::JITModule() {
@@ -242,7 +635,19 @@ JITModule::JITModule() {
 JITModule::JITModule(const Module &m, const LoweredFunc &fn,
                      const std::vector<JITModule> &dependencies) {
     jit_module = new JITModuleContents();
-    std::unique_ptr<llvm::Module> llvm_module(compile_module_to_llvm_module(m, jit_module->context));
+    std::unique_ptr<llvm::Module> llvm_module;
+    std::string cache_dir = JITDiskCache::directory();
+    if (!cache_dir.empty()) {
+        JITDiskCache *cache = new JITDiskCache(cache_dir, JITDiskCache::compute_key(m));
+        jit_module->object_cache.reset(cache);
+        llvm_module = cache->load_module(jit_module->context);
+        if (!llvm_module) {
+            llvm_module = compile_module_to_llvm_module(m, jit_module->context);
+            cache->save_module(*llvm_module);
+        }
+    } else {
+        llvm_module = compile_module_to_llvm_module(m, jit_module->context);
+    }
     std::vector<JITModule> deps_with_runtime = dependencies;
     std::vector<JITModule> shared_runtime = JITSharedRuntime::get(llvm_module.get(), m.target());
     deps_with_runtime.insert(deps_with_runtime.end(), shared_runtime.begin(), shared_runtime.end());
@@ -269,6 +674,27 @@ void JITModule::compile_module(std::unique_ptr<llvm::Module> m, const string &fu
     DataLayout initial_module_data_layout = m->getDataLayout();
     string module_name = m->getModuleIdentifier();
 
+    CompileProfiler profiler(module_name);
+
+    // If asked to, compile a pipeline to objects on several threads,
+    // and give the execution engine an empty module instead. This
+    // doesn't work with an object cache, which MCJIT consults per
+    // module it compiles, or with static constructors, which the
+    // execution engine finds in its modules. Runtime modules are left
+    // alone for the same reason.
+    std::vector<std::string> objects;
+    std::unique_ptr<llvm::Module> compiled_module;
+    if (llvm_codegen_threads() > 1 &&
+        !function_name.empty() &&
+        !jit_module->object_cache &&
+        !m->getNamedGlobal("llvm.global_ctors")) {
+        objects = compile_llvm_module_to_objects(*m, llvm_codegen_threads(), /* export_internal_symbols */ true);
+        compiled_module = std::move(m);
+        m.reset(new llvm::Module(module_name, compiled_module->getContext()));
+        m->setTargetTriple(compiled_module->getTargetTriple());
+        m->setDataLayout(compiled_module->getDataLayout());
+    }
+
     llvm::EngineBuilder engine_builder((std::move(m)));
     engine_builder.setTargetOptions(options);
     engine_builder.setErrorStr(&error_string);
@@ -297,6 +723,17 @@ void JITModule::compile_module(std::unique_ptr<llvm::Module> m, const string &fu
     if (!ee) std::cerr << error_string << "\n";
     internal_assert(ee) << "Couldn't create execution engine\n";
 
+    if (jit_module->object_cache) {
+        ee->setObjectCache(jit_module->object_cache.get());
+    }
+
+    for (const std::string &object : objects) {
+        std::unique_ptr<llvm::MemoryBuffer> buffer = llvm::MemoryBuffer::getMemBufferCopy(object, module_name);
+        auto object_file = llvm::expectedToErrorOr(llvm::object::ObjectFile::createObjectFile(buffer->getMemBufferRef()));
+        internal_assert(object_file) << "Could not load an object compiled for " << module_name << "\n";
+        ee->addObjectFile(llvm::object::OwningBinary<llvm::object::ObjectFile>(std::move(*object_file), std::move(buffer)));
+    }
+
     // Do any target-specific initialization
     std::vector<llvm::JITEventListener *> listeners;
 
@@ -319,19 +756,20 @@ void JITModule::compile_module(std::unique_ptr<llvm::Module> m, const string &fu
     Symbol entrypoint;
     Symbol argv_entrypoint;
     if (!function_name.empty()) {
-        entrypoint = compile_and_get_function(*ee, function_name);
+        entrypoint = compile_and_get_function(*ee, function_name, compiled_module.get());
         exports[function_name] = entrypoint;
-        argv_entrypoint = compile_and_get_function(*ee, function_name + "_argv");
+        argv_entrypoint = compile_and_get_function(*ee, function_name + "_argv", compiled_module.get());
         exports[function_name + "_argv"] = argv_entrypoint;
     }
 
     for (size_t i = 0; i < requested_exports.size(); i++) {
-        exports[requested_exports[i]] = compile_and_get_function(*ee, requested_exports[i]);
+        exports[requested_exports[i]] = compile_and_get_function(*ee, requested_exports[i], compiled_module.get());
     }
 
     debug(2) << "Finalizing object\n";
     ee->finalizeObject();
     memory_manager->work_around_llvm_bugs();
+    profiler.phase("jit compilation");
 
     // Do any target-specific post-compilation module meddling
     for (size_t i = 0; i < listeners.size(); i++) {
@@ -454,6 +892,40 @@ void JITModule::memoization_cache_set_size(int64_t size) const {
     }
 }
 
+void JITModule::memoization_cache_set_eviction_policy(int policy) const {
+    std::map<std::string, Symbol>::const_iterator f =
+        exports().find("halide_memoization_cache_set_eviction_policy");
+    if (f != exports().end()) {
+        (reinterpret_bits<int (*)(void *, int)>(f->second.address))(nullptr, policy);
+    }
+}
+
+int JITModule::memoization_cache_set_persistent_file(const char *path, uint64_t fingerprint, int64_t size) const {
+    std::map<std::string, Symbol>::const_iterator f =
+        exports().find("halide_memoization_cache_set_persistent_file");
+    if (f != exports().end()) {
+        typedef int (*set_persistent_file_fn)(void *, const char *, uint64_t, int64_t);
+        return (reinterpret_bits<set_persistent_file_fn>(f->second.address))(nullptr, path, fingerprint, size);
+    }
+    return 0;
+}
+
+int JITModule::memoization_cache_get_stats(halide_memoization_cache_stats *stats,
+                                           halide_memoization_cache_func_stats *per_func,
+                                           int max_funcs) const {
+    std::map<std::string, Symbol>::const_iterator f =
+        exports().find("halide_memoization_cache_get_stats");
+    if (f != exports().end()) {
+        typedef int (*get_stats_fn)(void *, halide_memoization_cache_stats *,
+                                    halide_memoization_cache_func_stats *, int);
+        return (reinterpret_bits<get_stats_fn>(f->second.address))(nullptr, stats, per_func, max_funcs);
+    }
+    if (stats) {
+        memset(stats, 0, sizeof(*stats));
+    }
+    return 0;
+}
+
 bool JITModule::compiled() const {
   return jit_module->execution_engine != nullptr;
 }
@@ -464,6 +936,10 @@ JITHandlers runtime_internal_handlers;
 JITHandlers default_handlers;
 JITHandlers active_handlers;
 int64_t default_cache_size;
+int default_cache_eviction_policy;
+std::string default_cache_file;
+uint64_t default_cache_file_fingerprint;
+int64_t default_cache_file_size;
 
 void merge_handlers(JITHandlers &base, const JITHandlers &addins) {
     if (addins.custom_print) {
@@ -750,6 +1226,14 @@ JITModule &make_module(llvm::Module *for_module, Target target,
             if (default_cache_size != 0) {
                 runtime.memoization_cache_set_size(default_cache_size);
             }
+            if (default_cache_eviction_policy != 0) {
+                runtime.memoization_cache_set_eviction_policy(default_cache_eviction_policy);
+            }
+            if (!default_cache_file.empty()) {
+                runtime.memoization_cache_set_persistent_file(default_cache_file.c_str(),
+                                                              default_cache_file_fingerprint,
+                                                              default_cache_file_size);
+            }
 
             runtime.jit_module->name = "MainShared";
         } else {
@@ -874,5 +1358,32 @@ void JITSharedRuntime::memoization_cache_set_size(int64_t size) {
     }
 }
 
+int JITSharedRuntime::memoization_cache_get_stats(halide_memoization_cache_stats *stats,
+                                                  halide_memoization_cache_func_stats *per_func,
+                                                  int max_funcs) {
+    std::lock_guard<std::mutex> lock(shared_runtimes_mutex);
+    return shared_runtimes(MainShared).memoization_cache_get_stats(stats, per_func, max_funcs);
+}
+
+void JITSharedRuntime::memoization_cache_set_eviction_policy(int policy) {
+    std::lock_guard<std::mutex> lock(shared_runtimes_mutex);
+
+    if (policy != default_cache_eviction_policy) {
+        default_cache_eviction_policy = policy;
+        shared_runtimes(MainShared).memoization_cache_set_eviction_policy(policy);
+    }
+}
+
+int JITSharedRuntime::memoization_cache_set_persistent_file(const std::string &path,
+                                                            uint64_t fingerprint, int64_t size) {
+    std::lock_guard<std::mutex> lock(shared_runtimes_mutex);
+
+    default_cache_file = path;
+    default_cache_file_fingerprint = fingerprint;
+    default_cache_file_size = size;
+    return shared_runtimes(MainShared).memoization_cache_set_persistent_file(path.empty() ? nullptr : path.c_str(),
+                                                                             fingerprint, size);
+}
+
 }  // namespace Internal
 }  // namespace Halide
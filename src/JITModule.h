@@ -41,6 +41,17 @@ struct JITModule {
     };
 
     JITModule();
+
+    /** Compile a Module. If the environment variable HL_JIT_CACHE_DIR
+     * is set, the compiled code is cached in that directory, keyed by
+     * a hash of the Module (ignoring the names of its temporaries), its
+     * Target, the host CPU, and the build of Halide and LLVM. The
+     * build of Halide is identified by the size and modification time
+     * of the library it was loaded from; if that can't be found,
+     * nothing is cached. Later compilations of the same Module, in
+     * this process or any other, load the cached code instead of
+     * running LLVM. The least recently added entries are deleted once the
+     * cache exceeds HL_JIT_CACHE_MAX_SIZE megabytes (default 1024). */
     JITModule(const Module &m, const LoweredFunc &fn,
                      const std::vector<JITModule> &dependencies = std::vector<JITModule>());
     /** The exports map of a JITModule contains all symbols which are
@@ -115,6 +126,11 @@ struct JITModule {
 
     /** Encapsulate device (GPU) and buffer interactions. */
     void memoization_cache_set_size(int64_t size) const;
+    void memoization_cache_set_eviction_policy(int policy) const;
+    int memoization_cache_set_persistent_file(const char *path, uint64_t fingerprint, int64_t size) const;
+    int memoization_cache_get_stats(halide_memoization_cache_stats *stats,
+                                    halide_memoization_cache_func_stats *per_func,
+                                    int max_funcs) const;
 
     /** Return true if compile_module has been called on this module. */
     bool compiled() const;
@@ -153,6 +169,33 @@ public:
      */
     static void memoization_cache_set_size(int64_t size);
 
+    /** Set the eviction policy used by memoization caching, one of
+     * the halide_memoization_cache_eviction_policy_t values. If you
+     * are compiling statically, call
+     * halide_memoization_cache_set_eviction_policy() instead.
+     */
+    static void memoization_cache_set_eviction_policy(int policy);
+
+    /** Back memoization caching with a memory-mapped file that
+     * persists across runs, as for
+     * halide_memoization_cache_set_persistent_file(). An empty path
+     * detaches the file. The file stays attached if the shared runtime
+     * is released and recreated. If you are compiling statically,
+     * call halide_memoization_cache_set_persistent_file() instead.
+     */
+    static int memoization_cache_set_persistent_file(const std::string &path,
+                                                     uint64_t fingerprint, int64_t size = 0);
+
+    /** Get the counters kept by memoization caching, as for
+     * halide_memoization_cache_get_stats(). Returns the number of
+     * memoized Funcs with counters, or zero if nothing has been
+     * JIT-compiled yet. If you are compiling statically, call
+     * halide_memoization_cache_get_stats() instead.
+     */
+    static int memoization_cache_get_stats(halide_memoization_cache_stats *stats,
+                                           halide_memoization_cache_func_stats *per_func = nullptr,
+                                           int max_funcs = 0);
+
     static void release_all();
 };
 
@@ -2,10 +2,14 @@
 #include "CodeGen_C.h"
 #include "CodeGen_Internal.h"
 #include "CodeGen_LLVM.h"
+#include "CompilerProfiling.h"
 #include "LLVM_Headers.h"
 #include "LLVM_Runtime_Linker.h"
+#include "ThreadPool.h"
 
+#include <algorithm>
 #include <fstream>
+#include <future>
 #include <iostream>
 
 #ifdef _WIN32
@@ -343,6 +347,8 @@ void emit_file(const llvm::Module &module_in, Internal::LLVMOStream& out, llvm::
     Internal::debug(1) << "emit_file.Compiling to native code...\n";
     Internal::debug(2) << "Target triple: " << module_in.getTargetTriple() << "\n";
 
+    Internal::CompileProfiler profiler(module_in.getModuleIdentifier());
+
     // Work on a copy of the module to avoid modifying the original.
     std::unique_ptr<llvm::Module> module = clone_module(module_in);
 
@@ -385,6 +391,9 @@ void emit_file(const llvm::Module &module_in, Internal::LLVMOStream& out, llvm::
 #endif
 
     pass_manager.run(*module);
+
+    profiler.phase(file_type == llvm::TargetMachine::CGFT_ObjectFile ?
+                   "llvm object code emission" : "llvm assembly emission");
 }
 
 std::unique_ptr<llvm::Module> compile_module_to_llvm_module(const Module &module, llvm::LLVMContext &context) {
@@ -399,6 +408,83 @@ void compile_llvm_module_to_assembly(llvm::Module &module, Internal::LLVMOStream
     emit_file(module, out, llvm::TargetMachine::CGFT_AssemblyFile);
 }
 
+int llvm_codegen_threads() {
+    static int cached_threads = ([]() -> int {
+        std::string threads = Internal::get_env_variable("HL_LLVM_CODEGEN_THREADS");
+        return std::max(threads.empty() ? 1 : atoi(threads.c_str()), 1);
+    })();
+    return cached_threads;
+}
+
+std::vector<std::string> compile_llvm_module_to_objects(const llvm::Module &module_in, int num_partitions,
+                                                        bool export_internal_symbols) {
+    Internal::CompileProfiler profiler(module_in.getModuleIdentifier());
+
+    // LLVMContexts can't be shared between threads, so each piece is
+    // passed to the thread that compiles it as bitcode, and parsed
+    // into a fresh context there.
+    std::vector<std::string> bitcode;
+    std::unique_ptr<llvm::Module> module = clone_module(module_in);
+
+    // SplitModule turns local symbols used by more than one piece
+    // into hidden externals, keeping their names (e.g. "str" for
+    // string constants). Prefix them with the name of the module
+    // first, so that two libraries compiled this way can be linked
+    // into the same binary.
+    const std::string prefix = module->getModuleIdentifier() + ".";
+    for (llvm::GlobalValue &v : module->global_values()) {
+        if (v.hasLocalLinkage() && !v.getName().startswith("llvm.")) {
+            v.setName(prefix + (v.hasName() ? v.getName().str() : std::string("unnamed")));
+        }
+    }
+
+    llvm::SplitModule(std::move(module), num_partitions, [&](std::unique_ptr<llvm::Module> part) {
+        if (export_internal_symbols) {
+            for (llvm::GlobalValue &v : part->global_values()) {
+                if (!v.isDeclaration() && v.hasHiddenVisibility()) {
+                    v.setVisibility(llvm::GlobalValue::DefaultVisibility);
+                }
+            }
+        }
+        std::string buffer;
+        llvm::raw_string_ostream out(buffer);
+#if LLVM_VERSION >= 70
+        WriteBitcodeToFile(*part, out);
+#else
+        WriteBitcodeToFile(part.get(), out);
+#endif
+        out.flush();
+        bitcode.push_back(std::move(buffer));
+    });
+    profiler.phase("splitting llvm module");
+
+    Internal::debug(1) << "Compiling " << bitcode.size() << " pieces of " << module_in.getModuleIdentifier()
+                       << " on " << num_partitions << " threads\n";
+    // The pool stops taking jobs when it is destroyed, so wait for
+    // all the results before it goes out of scope.
+    Internal::ThreadPool<std::string> pool(std::min((size_t)num_partitions, bitcode.size()));
+    std::vector<std::future<std::string>> futures;
+    for (const std::string &b : bitcode) {
+        futures.push_back(pool.async([&b]() {
+            llvm::LLVMContext context;
+            llvm::MemoryBufferRef buffer_ref(b, "partition");
+            auto part = llvm::expectedToErrorOr(llvm::parseBitcodeFile(buffer_ref, context));
+            internal_assert(part) << "Could not parse a partition of an llvm module\n";
+
+            llvm::SmallVector<char, 0> object;
+            llvm::raw_svector_ostream out(object);
+            emit_file(**part, out, llvm::TargetMachine::CGFT_ObjectFile);
+            return std::string(object.begin(), object.end());
+        }));
+    }
+
+    std::vector<std::string> objects;
+    for (auto &f : futures) {
+        objects.push_back(f.get());
+    }
+    return objects;
+}
+
 void compile_llvm_module_to_llvm_bitcode(llvm::Module &module, Internal::LLVMOStream& out) {
 #if LLVM_VERSION >= 70
     WriteBitcodeToFile(module, out);
@@ -39,6 +39,21 @@ void compile_llvm_module_to_object(llvm::Module &module, Internal::LLVMOStream&
 void compile_llvm_module_to_assembly(llvm::Module &module, Internal::LLVMOStream& out);
 // @}
 
+/** The number of threads to use when compiling LLVM modules to
+ * native code, from the environment variable
+ * HL_LLVM_CODEGEN_THREADS. Returns 1 if it is not set. */
+int llvm_codegen_threads();
+
+/** Split an LLVM module into up to num_partitions pieces, and compile
+ * the pieces to object code concurrently. Returns the object code of
+ * each piece. Functions and globals that were internal to the module
+ * are made external so that the pieces can reference each other; if
+ * export_internal_symbols is false they get hidden visibility, which
+ * suits static libraries, and otherwise default visibility, which
+ * suits loading the pieces into a JIT. */
+std::vector<std::string> compile_llvm_module_to_objects(const llvm::Module &module, int num_partitions,
+                                                         bool export_internal_symbols = false);
+
 /** Compile an LLVM module to LLVM targets (bitcode, LLVM assembly). */
 // @{
 void compile_llvm_module_to_llvm_bitcode(llvm::Module &module, Internal::LLVMOStream& out);
@@ -13,6 +13,7 @@
 #include "BoundsInference.h"
 #include "CSE.h"
 #include "CanonicalizeGPUVars.h"
+#include "CompilerProfiling.h"
 #include "Debug.h"
 #include "DebugArguments.h"
 #include "DebugToFile.h"
@@ -33,11 +34,14 @@
 #include "Inline.h"
 #include "LICM.h"
 #include "LoopCarry.h"
+#include "LowerParallel.h"
 #include "LowerWarpShuffles.h"
 #include "Memoization.h"
 #include "PartitionLoops.h"
+#include "PlanMemory.h"
 #include "Prefetch.h"
 #include "Profiling.h"
+#include "PromoteRegisters.h"
 #include "Qualify.h"
 #include "RealizationOrder.h"
 #include "RemoveDeadAllocations.h"
@@ -81,6 +85,13 @@ Module lower(const vector<Function> &output_funcs, const string &pipeline_name,
     std::vector<std::string> namespaces;
     std::string simple_pipeline_name = extract_namespaces(pipeline_name, namespaces);
 
+    CompileProfiler profiler(simple_pipeline_name);
+
+    // Lots of passes simplify and take the bounds of the same
+    // expressions over and over. Only do each once.
+    SimplifyMemoScope simplify_memo;
+    BoundsMemoScope bounds_memo;
+
     Module result_module(simple_pipeline_name, t);
 
     // Compute an environment
@@ -123,15 +134,18 @@ Module lower(const vector<Function> &output_funcs, const string &pipeline_name,
     bool any_memoized = false;
     Stmt s = schedule_functions(outputs, fused_groups, env, t, any_memoized);
     debug(2) << "Lowering after creating initial loop nests:\n" << s << '\n';
+    profiler.phase("creating initial loop nests", s);
 
     debug(1) << "Canonicalizing GPU var names...\n";
     s = canonicalize_gpu_vars(s);
     debug(2) << "Lowering after canonicalizing GPU var names:\n" << s << '\n';
+    profiler.phase("canonicalizing GPU var names", s);
 
     if (any_memoized) {
         debug(1) << "Injecting memoization...\n";
         s = inject_memoization(s, env, pipeline_name, outputs);
         debug(2) << "Lowering after injecting memoization:\n" << s << '\n';
+        profiler.phase("injecting memoization", s);
     } else {
         debug(1) << "Skipping injecting memoization...\n";
     }
@@ -139,21 +153,25 @@ Module lower(const vector<Function> &output_funcs, const string &pipeline_name,
     debug(1) << "Injecting tracing...\n";
     s = inject_tracing(s, pipeline_name, env, outputs, t);
     debug(2) << "Lowering after injecting tracing:\n" << s << '\n';
+    profiler.phase("injecting tracing", s);
 
     debug(1) << "Adding checks for parameters\n";
     s = add_parameter_checks(s, t);
     debug(2) << "Lowering after injecting parameter checks:\n" << s << '\n';
+    profiler.phase("injecting parameter checks", s);
 
     // Compute the maximum and minimum possible value of each
     // function. Used in later bounds inference passes.
     debug(1) << "Computing bounds of each function's value\n";
     FuncValueBounds func_bounds = compute_function_value_bounds(order, env);
+    profiler.phase("computing function value bounds");
 
     // The checks will be in terms of the symbols defined by bounds
     // inference.
     debug(1) << "Adding checks for images\n";
     s = add_image_checks(s, outputs, t, order, env, func_bounds);
     debug(2) << "Lowering after injecting image checks:\n" << s << '\n';
+    profiler.phase("injecting image checks", s);
 
     // This pass injects nested definitions of variable names, so we
     // can't simplify statements from here until we fix them up. (We
@@ -161,18 +179,22 @@ Module lower(const vector<Function> &output_funcs, const string &pipeline_name,
     debug(1) << "Performing computation bounds inference...\n";
     s = bounds_inference(s, outputs, order, fused_groups, env, func_bounds, t);
     debug(2) << "Lowering after computation bounds inference:\n" << s << '\n';
+    profiler.phase("computation bounds inference", s);
 
     debug(1) << "Performing sliding window optimization...\n";
     s = sliding_window(s, env);
     debug(2) << "Lowering after sliding window:\n" << s << '\n';
+    profiler.phase("sliding window", s);
 
     debug(1) << "Performing allocation bounds inference...\n";
     s = allocation_bounds_inference(s, env, func_bounds);
     debug(2) << "Lowering after allocation bounds inference:\n" << s << '\n';
+    profiler.phase("allocation bounds inference", s);
 
     debug(1) << "Removing code that depends on undef values...\n";
     s = remove_undef(s);
     debug(2) << "Lowering after removing code that depends on undef values:\n" << s << "\n\n";
+    profiler.phase("removing code that depends on undef values", s);
 
     // This uniquifies the variable names, so we're good to simplify
     // after this point. This lets later passes assume syntactic
@@ -180,34 +202,42 @@ Module lower(const vector<Function> &output_funcs, const string &pipeline_name,
     debug(1) << "Uniquifying variable names...\n";
     s = uniquify_variable_names(s);
     debug(2) << "Lowering after uniquifying variable names:\n" << s << "\n\n";
+    profiler.phase("uniquifying variable names", s);
 
     debug(1) << "Simplifying...\n";
     s = simplify(s, false); // Keep dead lets. Storage flattening needs them.
     debug(2) << "Lowering after first simplification:\n" << s << "\n\n";
+    profiler.phase("first simplification", s);
 
     debug(1) << "Performing storage folding optimization...\n";
     s = storage_folding(s, env);
     debug(2) << "Lowering after storage folding:\n" << s << '\n';
+    profiler.phase("storage folding", s);
 
     debug(1) << "Injecting debug_to_file calls...\n";
     s = debug_to_file(s, outputs, env);
     debug(2) << "Lowering after injecting debug_to_file calls:\n" << s << '\n';
+    profiler.phase("injecting debug_to_file calls", s);
 
     debug(1) << "Injecting prefetches...\n";
     s = inject_prefetch(s, env);
     debug(2) << "Lowering after injecting prefetches:\n" << s << "\n\n";
+    profiler.phase("injecting prefetches", s);
 
     debug(1) << "Dynamically skipping stages...\n";
     s = skip_stages(s, order);
     debug(2) << "Lowering after dynamically skipping stages:\n" << s << "\n\n";
+    profiler.phase("dynamically skipping stages", s);
 
     debug(1) << "Destructuring tuple-valued realizations...\n";
     s = split_tuples(s, env);
     debug(2) << "Lowering after destructuring tuple-valued realizations:\n" << s << "\n\n";
+    profiler.phase("destructuring tuple-valued realizations", s);
 
     debug(1) << "Performing storage flattening...\n";
     s = storage_flattening(s, outputs, env, t);
     debug(2) << "Lowering after storage flattening:\n" << s << "\n\n";
+    profiler.phase("storage flattening", s);
 
     debug(1) << "Unpacking buffer arguments...\n";
     s = unpack_buffers(s);
@@ -217,6 +247,7 @@ Module lower(const vector<Function> &output_funcs, const string &pipeline_name,
         debug(1) << "Rewriting memoized allocations...\n";
         s = rewrite_memoized_allocations(s, env);
         debug(2) << "Lowering after rewriting memoized allocations:\n" << s << "\n\n";
+        profiler.phase("rewriting memoized allocations", s);
     } else {
         debug(1) << "Skipping rewriting memoized allocations...\n";
     }
@@ -228,20 +259,24 @@ Module lower(const vector<Function> &output_funcs, const string &pipeline_name,
         debug(1) << "Selecting a GPU API for GPU loops...\n";
         s = select_gpu_api(s, t);
         debug(2) << "Lowering after selecting a GPU API:\n" << s << "\n\n";
+        profiler.phase("selecting a GPU API", s);
 
         debug(1) << "Injecting host <-> dev buffer copies...\n";
         s = inject_host_dev_buffer_copies(s, t);
         debug(2) << "Lowering after injecting host <-> dev buffer copies:\n" << s << "\n\n";
+        profiler.phase("injecting host <-> dev buffer copies", s);
 
         debug(1) << "Selecting a GPU API for extern stages...\n";
         s = select_gpu_api(s, t);
         debug(2) << "Lowering after selecting a GPU API for extern stages:\n" << s << "\n\n";
+        profiler.phase("selecting a GPU API for extern stages", s);
     }
 
     if (t.has_feature(Target::OpenGL)) {
         debug(1) << "Injecting OpenGL texture intrinsics...\n";
         s = inject_opengl_intrinsics(s);
         debug(2) << "Lowering after OpenGL intrinsics:\n" << s << "\n\n";
+        profiler.phase("OpenGL intrinsics", s);
     }
 
     if (t.has_gpu_feature() ||
@@ -249,6 +284,7 @@ Module lower(const vector<Function> &output_funcs, const string &pipeline_name,
         debug(1) << "Injecting per-block gpu synchronization...\n";
         s = fuse_gpu_thread_loops(s);
         debug(2) << "Lowering after injecting per-block gpu synchronization:\n" << s << "\n\n";
+        profiler.phase("injecting per-block gpu synchronization", s);
     }
 
     debug(1) << "Simplifying...\n";
@@ -256,88 +292,124 @@ Module lower(const vector<Function> &output_funcs, const string &pipeline_name,
     s = unify_duplicate_lets(s);
     s = remove_trivial_for_loops(s);
     debug(2) << "Lowering after second simplifcation:\n" << s << "\n\n";
+    profiler.phase("second simplification", s);
 
     debug(1) << "Reduce prefetch dimension...\n";
     s = reduce_prefetch_dimension(s, t);
     debug(2) << "Lowering after reduce prefetch dimension:\n" << s << "\n";
+    profiler.phase("reduce prefetch dimension", s);
 
     debug(1) << "Unrolling...\n";
-    s = unroll_loops(s);
-    s = simplify(s);
+    s = mutate_independent_subtrees(s, [&](const Stmt &stmt) {
+        return simplify(unroll_loops(stmt));
+    });
     debug(2) << "Lowering after unrolling:\n" << s << "\n\n";
+    profiler.phase("unrolling", s);
 
     debug(1) << "Vectorizing...\n";
-    s = vectorize_loops(s, t);
-    s = simplify(s);
+    s = mutate_independent_subtrees(s, [&](const Stmt &stmt) {
+        return simplify(vectorize_loops(stmt, t));
+    });
     debug(2) << "Lowering after vectorizing:\n" << s << "\n\n";
+    profiler.phase("vectorizing", s);
 
     debug(1) << "Detecting vector interleavings...\n";
-    s = rewrite_interleavings(s);
-    s = simplify(s);
+    s = mutate_independent_subtrees(s, [&](const Stmt &stmt) {
+        return simplify(rewrite_interleavings(stmt));
+    });
     debug(2) << "Lowering after rewriting vector interleavings:\n" << s << "\n\n";
+    profiler.phase("rewriting vector interleavings", s);
 
     debug(1) << "Partitioning loops to simplify boundary conditions...\n";
-    s = partition_loops(s);
-    s = simplify(s);
+    s = mutate_independent_subtrees(s, [&](const Stmt &stmt) {
+        return simplify(partition_loops(stmt));
+    });
     debug(2) << "Lowering after partitioning loops:\n" << s << "\n\n";
+    profiler.phase("partitioning loops", s);
 
     debug(1) << "Trimming loops to the region over which they do something...\n";
     s = trim_no_ops(s);
     debug(2) << "Lowering after loop trimming:\n" << s << "\n\n";
+    profiler.phase("loop trimming", s);
 
     debug(1) << "Injecting early frees...\n";
     s = inject_early_frees(s);
     debug(2) << "Lowering after injecting early frees:\n" << s << "\n\n";
+    profiler.phase("injecting early frees", s);
+
+    // Before profiling, so that the profiler reports the arena rather
+    // than the heap allocations folded into it.
+    if (t.has_feature(Target::PlanMemory)) {
+        debug(1) << "Planning memory...\n";
+        s = plan_memory(s, t);
+        debug(2) << "Lowering after planning memory:\n" << s << "\n\n";
+        profiler.phase("planning memory", s);
+    }
 
     if (t.has_feature(Target::Profile)) {
         debug(1) << "Injecting profiling...\n";
         s = inject_profiling(s, pipeline_name);
         debug(2) << "Lowering after injecting profiling:\n" << s << "\n\n";
+        profiler.phase("injecting profiling", s);
     }
 
     if (t.has_feature(Target::FuzzFloatStores)) {
         debug(1) << "Fuzzing floating point stores...\n";
         s = fuzz_float_stores(s);
         debug(2) << "Lowering after fuzzing floating point stores:\n" << s << "\n\n";
+        profiler.phase("fuzzing floating point stores", s);
     }
 
     debug(1) << "Bounding small allocations...\n";
     s = bound_small_allocations(s);
     debug(2) << "Lowering after bounding small allocations:\n" << s << "\n\n";
+    profiler.phase("bounding small allocations", s);
+
+    debug(1) << "Promoting register allocations...\n";
+    s = promote_registers(s);
+    debug(2) << "Lowering after promoting register allocations:\n" << s << "\n\n";
+    profiler.phase("promoting register allocations", s);
 
     if (t.has_feature(Target::CUDA)) {
         debug(1) << "Injecting warp shuffles...\n";
         s = lower_warp_shuffles(s);
         debug(2) << "Lowering after injecting warp shuffles:\n" << s << "\n\n";
+        profiler.phase("injecting warp shuffles", s);
     }
 
     debug(1) << "Simplifying...\n";
-    s = common_subexpression_elimination(s);
+    s = common_subexpression_elimination_across_stmts(s);
+    profiler.phase("common subexpression elimination", s);
 
     if (t.has_feature(Target::OpenGL)) {
         debug(1) << "Detecting varying attributes...\n";
         s = find_linear_expressions(s);
         debug(2) << "Lowering after detecting varying attributes:\n" << s << "\n\n";
+        profiler.phase("detecting varying attributes", s);
 
         debug(1) << "Moving varying attribute expressions out of the shader...\n";
         s = setup_gpu_vertex_buffer(s);
         debug(2) << "Lowering after removing varying attributes:\n" << s << "\n\n";
+        profiler.phase("removing varying attributes", s);
     }
 
     debug(1) << "Lowering unsafe promises...\n";
     s = lower_unsafe_promises(s, t);
     debug(2) << "Lowering after lowering unsafe promises:\n" << s << "\n\n";
+    profiler.phase("lowering unsafe promises", s);
 
     s = remove_dead_allocations(s);
-    s = remove_trivial_for_loops(s);
-    s = simplify(s);
-    s = loop_invariant_code_motion(s);
+    s = mutate_independent_subtrees(s, [&](const Stmt &stmt) {
+        return loop_invariant_code_motion(simplify(remove_trivial_for_loops(stmt)));
+    });
     debug(1) << "Lowering after final simplification:\n" << s << "\n\n";
+    profiler.phase("final simplification", s);
 
     if (t.arch != Target::Hexagon && (t.features_any_of({Target::HVX_64, Target::HVX_128}))) {
         debug(1) << "Splitting off Hexagon offload...\n";
         s = inject_hexagon_rpc(s, t, result_module);
         debug(2) << "Lowering after splitting off Hexagon offload:\n" << s << '\n';
+        profiler.phase("splitting off Hexagon offload", s);
     } else {
         debug(1) << "Skipping Hexagon offload...\n";
     }
@@ -347,6 +419,7 @@ Module lower(const vector<Function> &output_funcs, const string &pipeline_name,
             debug(1) << "Running custom lowering pass " << i << "...\n";
             s = custom_passes[i]->mutate(s);
             debug(1) << "Lowering after custom pass " << i << ":\n" << s << "\n\n";
+            profiler.phase("custom pass " + std::to_string(i), s);
         }
     }
 
@@ -442,6 +515,7 @@ Module lower(const vector<Function> &output_funcs, const string &pipeline_name,
 
     // Also append any wrappers for extern stages that expect the old buffer_t
     wrap_legacy_extern_stages(result_module);
+    profiler.phase("inferring arguments and adding wrappers");
 
     return result_module;
 }
@@ -0,0 +1,286 @@
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <future>
+#include <set>
+
+#include "LowerParallel.h"
+#include "Bounds.h"
+#include "Debug.h"
+#include "ExprUsesVar.h"
+#include "IROperator.h"
+#include "IRVisitor.h"
+#include "Simplify.h"
+#include "ThreadPool.h"
+#include "Util.h"
+
+namespace Halide {
+namespace Internal {
+
+using std::string;
+using std::vector;
+
+int lowering_threads() {
+    static int cached_threads = ([]() -> int {
+        string threads = get_env_variable("HL_LOWERING_THREADS");
+        return std::max(threads.empty() ? 1 : atoi(threads.c_str()), 1);
+    })();
+    return cached_threads;
+}
+
+namespace {
+
+std::atomic<int> parallel_runs(0), serial_fallbacks(0);
+
+// Marks the end of a subtree, so that it can be found again in the
+// output of the pass.
+const char *const end_marker_name = "halide_lowering_subtree_end";
+
+Stmt end_marker() {
+    return Evaluate::make(Call::make(Int(32), end_marker_name, {}, Call::Extern));
+}
+
+bool is_end_marker(const Stmt &s) {
+    const Evaluate *e = s.as<Evaluate>();
+    const Call *c = e ? e->value.as<Call>() : nullptr;
+    return c && c->name == end_marker_name;
+}
+
+class ContainsLoop : public IRVisitor {
+    using IRVisitor::visit;
+
+    void visit(const For *) override {
+        result = true;
+    }
+
+public:
+    bool result = false;
+};
+
+bool contains_loop(const Stmt &s) {
+    ContainsLoop c;
+    s.accept(&c);
+    return c.result;
+}
+
+// An enclosing LetStmt, or an enclosing condition if the name is empty.
+struct Context {
+    string name;
+    Expr value;
+};
+
+struct Subtree {
+    Stmt stmt;
+    vector<Context> context;
+    Stmt result;
+};
+
+// Collect the subtrees below the structural nodes at the top of a
+// Stmt, in order.
+void find_subtrees(const Stmt &s, vector<Context> &context, vector<Subtree> &subtrees) {
+    if (const LetStmt *op = s.as<LetStmt>()) {
+        context.push_back({op->name, op->value});
+        find_subtrees(op->body, context, subtrees);
+        context.pop_back();
+    } else if (const Block *op = s.as<Block>()) {
+        find_subtrees(op->first, context, subtrees);
+        find_subtrees(op->rest, context, subtrees);
+    } else if (const IfThenElse *op = s.as<IfThenElse>()) {
+        context.push_back({"", op->condition});
+        find_subtrees(op->then_case, context, subtrees);
+        if (op->else_case.defined()) {
+            context.back().value = !op->condition;
+            find_subtrees(op->else_case, context, subtrees);
+        }
+        context.pop_back();
+    } else if (const ProducerConsumer *op = s.as<ProducerConsumer>()) {
+        find_subtrees(op->body, context, subtrees);
+    } else if (const Allocate *op = s.as<Allocate>()) {
+        find_subtrees(op->body, context, subtrees);
+    } else {
+        subtrees.push_back({s, context, Stmt()});
+    }
+}
+
+// Put a subtree inside its context, followed by the end marker.
+Stmt wrap(const Subtree &t) {
+    Stmt s = Block::make(t.stmt, end_marker());
+    for (size_t i = t.context.size(); i > 0; i--) {
+        const Context &c = t.context[i - 1];
+        if (c.name.empty()) {
+            s = IfThenElse::make(c.value, s);
+        } else {
+            s = LetStmt::make(c.name, c.value, s);
+        }
+    }
+    return s;
+}
+
+// Find what became of a subtree in the output of the pass. Lets the
+// pass introduced into the context (e.g. when the simplifier splits
+// the constant part off a let) are moved down onto the subtree.
+// Returns false if the end marker can't be found.
+bool unwrap(const Stmt &s, const std::set<string> &context_lets,
+            vector<std::pair<string, Expr>> &new_lets, Stmt &result) {
+    if (const LetStmt *op = s.as<LetStmt>()) {
+        if (!context_lets.count(op->name)) {
+            new_lets.emplace_back(op->name, op->value);
+        }
+        return unwrap(op->body, context_lets, new_lets, result);
+    } else if (const IfThenElse *op = s.as<IfThenElse>()) {
+        if (op->else_case.defined()) {
+            return false;
+        }
+        return unwrap(op->then_case, context_lets, new_lets, result);
+    }
+
+    vector<Stmt> stmts;
+    Stmt rest = s;
+    while (const Block *op = rest.as<Block>()) {
+        stmts.push_back(op->first);
+        rest = op->rest;
+    }
+    if (!is_end_marker(rest)) {
+        return false;
+    }
+    if (stmts.empty()) {
+        // The subtree did nothing.
+        result = Evaluate::make(0);
+        return true;
+    }
+    result = Block::make(stmts);
+    for (size_t i = new_lets.size(); i > 0; i--) {
+        const auto &l = new_lets[i - 1];
+        if (stmt_uses_var(result, l.first)) {
+            result = LetStmt::make(l.first, l.second, result);
+        }
+    }
+    return true;
+}
+
+// Rebuild a Stmt with the results of the pass in place of the
+// subtrees, taking them in the order find_subtrees found them.
+Stmt rebuild(const Stmt &s, vector<Subtree>::const_iterator &next) {
+    if (const LetStmt *op = s.as<LetStmt>()) {
+        Stmt body = rebuild(op->body, next);
+        if (!stmt_uses_var(body, op->name)) {
+            return body;
+        }
+        return LetStmt::make(op->name, op->value, body);
+    } else if (const Block *op = s.as<Block>()) {
+        Stmt first = rebuild(op->first, next);
+        Stmt rest = rebuild(op->rest, next);
+        if (is_no_op(first)) {
+            return rest;
+        } else if (is_no_op(rest)) {
+            return first;
+        }
+        return Block::make(first, rest);
+    } else if (const IfThenElse *op = s.as<IfThenElse>()) {
+        Stmt then_case = rebuild(op->then_case, next);
+        Stmt else_case;
+        if (op->else_case.defined()) {
+            else_case = rebuild(op->else_case, next);
+            if (is_no_op(else_case)) {
+                else_case = Stmt();
+            }
+        }
+        if (is_no_op(then_case) && !else_case.defined()) {
+            return then_case;
+        }
+        return IfThenElse::make(op->condition, then_case, else_case);
+    } else if (const ProducerConsumer *op = s.as<ProducerConsumer>()) {
+        return ProducerConsumer::make(op->name, op->is_producer, rebuild(op->body, next));
+    } else if (const Allocate *op = s.as<Allocate>()) {
+        return Allocate::make(op->name, op->type, op->memory_type, op->extents, op->condition,
+                              rebuild(op->body, next), op->new_expr, op->free_function);
+    } else {
+        return (next++)->result;
+    }
+}
+
+}  // namespace
+
+Stmt mutate_independent_subtrees(const Stmt &s, const std::function<Stmt(const Stmt &)> &pass) {
+    int threads = lowering_threads();
+    if (threads <= 1 || !s.defined()) {
+        return pass(s);
+    }
+
+    vector<Context> context;
+    vector<Subtree> subtrees;
+    find_subtrees(s, context, subtrees);
+    if (std::count_if(subtrees.begin(), subtrees.end(),
+                      [](const Subtree &t) { return contains_loop(t.stmt); }) < 2) {
+        return pass(s);
+    }
+
+    parallel_runs++;
+
+    // Get the tags in order on this thread, so that the names each
+    // subtree generates are the same from one run to the next.
+    vector<string> tags;
+    for (size_t i = 0; i < subtrees.size(); i++) {
+        tags.push_back(unique_name('l'));
+    }
+
+    static ThreadPool<void> pool(threads);
+    vector<std::future<void>> jobs;
+    vector<char> found(subtrees.size(), false);
+#ifdef WITH_EXCEPTIONS
+    vector<std::exception_ptr> errors(subtrees.size());
+#endif
+    for (size_t i = 0; i < subtrees.size(); i++) {
+        jobs.push_back(pool.async([&, i]() {
+#ifdef WITH_EXCEPTIONS
+            try {
+#endif
+                UniqueNameTag tag(tags[i]);
+                SimplifyMemoScope simplify_memo;
+                BoundsMemoScope bounds_memo;
+                Subtree &t = subtrees[i];
+                std::set<string> context_lets;
+                for (const Context &c : t.context) {
+                    context_lets.insert(c.name);
+                }
+                vector<std::pair<string, Expr>> new_lets;
+                found[i] = unwrap(pass(wrap(t)), context_lets, new_lets, t.result);
+#ifdef WITH_EXCEPTIONS
+            } catch (...) {
+                errors[i] = std::current_exception();
+            }
+#endif
+        }));
+    }
+    for (auto &job : jobs) {
+        job.wait();
+    }
+
+#ifdef WITH_EXCEPTIONS
+    for (const auto &e : errors) {
+        if (e) {
+            std::rethrow_exception(e);
+        }
+    }
+#endif
+
+    if (std::find(found.begin(), found.end(), false) != found.end()) {
+        debug(1) << "Lost track of a subtree while lowering in parallel. Redoing it serially.\n";
+        serial_fallbacks++;
+        return pass(s);
+    }
+
+    auto next = subtrees.cbegin();
+    return rebuild(s, next);
+}
+
+int lowering_parallel_runs() {
+    return parallel_runs;
+}
+
+int lowering_serial_fallbacks() {
+    return serial_fallbacks;
+}
+
+}  // namespace Internal
+}  // namespace Halide
@@ -0,0 +1,46 @@
+#ifndef HALIDE_LOWER_PARALLEL_H
+#define HALIDE_LOWER_PARALLEL_H
+
+/** \file
+ * Defines a helper for running lowering passes over the independent
+ * parts of a Stmt on several threads.
+ */
+
+#include <functional>
+
+#include "IR.h"
+
+namespace Halide {
+namespace Internal {
+
+/** The number of threads to use for lowering passes run through
+ * mutate_independent_subtrees. Set by the environment variable
+ * HL_LOWERING_THREADS. Defaults to one. */
+int lowering_threads();
+
+/** Apply a lowering pass to the independent pieces of a Stmt in
+ * parallel. The Stmt is split below any LetStmts, Blocks,
+ * IfThenElses, ProducerConsumers and Allocates at its top, and the
+ * pass is applied to each remaining subtree inside the LetStmts and
+ * conditions that enclose it, so that simplification still sees
+ * them. The enclosing nodes themselves are kept as they were, apart
+ * from dropping lets and branches that are no longer needed. Names
+ * generated while running the pass are tagged per subtree (see
+ * UniqueNameTag), so the result doesn't depend on scheduling. If
+ * parallel lowering is off, or there aren't at least two loops to
+ * work on, this just applies the pass to the whole Stmt. */
+Stmt mutate_independent_subtrees(const Stmt &s, const std::function<Stmt(const Stmt &)> &pass);
+
+/** The number of times mutate_independent_subtrees has run a pass on
+ * several subtrees in parallel, and the number of those times it
+ * lost track of a subtree in the output and had to redo the pass
+ * serially. Counted across all threads, for testing. */
+// @{
+int lowering_parallel_runs();
+int lowering_serial_fallbacks();
+// @}
+
+}  // namespace Internal
+}  // namespace Halide
+
+#endif
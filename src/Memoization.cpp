@@ -217,6 +217,11 @@ public:
         // values of the scalar parameters. Omits the pipeline name
         // and the unique counter so that we can reuse memoized Funcs
         // across forward and backwards pipelines.
+        //
+        // The default cache in src/runtime/cache.cpp relies on the
+        // key starting with the length of the function name followed
+        // by the name packed into 32-bit words, to attribute its
+        // per-Func counters.
 
         (void)top_level_name;
         (void)memoize_instance;
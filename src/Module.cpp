@@ -382,7 +382,19 @@ void Module::compile(const Outputs &output_files_arg) const {
             // at the same time, so there is no meaningful performance advantage
             // to be had.
             TemporaryObjectFileDir temp_dir;
-            {
+            if (llvm_codegen_threads() > 1) {
+                // A static library can hold many objects, so compile
+                // pieces of the module concurrently.
+                std::vector<std::string> objects = compile_llvm_module_to_objects(*llvm_module, llvm_codegen_threads());
+                for (size_t i = 0; i < objects.size(); i++) {
+                    std::string object_name = temp_dir.add_temp_object_file(output_files.static_library_name,
+                                                                            "_" + std::to_string(i), target());
+                    debug(1) << "Module.compile(): temporary object_name " << object_name << "\n";
+                    auto out = make_raw_fd_ostream(object_name);
+                    *out << objects[i];
+                    out->flush();
+                }
+            } else {
                 std::string object_name = temp_dir.add_temp_object_file(output_files.static_library_name, "", target());
                 debug(1) << "Module.compile(): temporary object_name " << object_name << "\n";
                 auto out = make_raw_fd_ostream(object_name);
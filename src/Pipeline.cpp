@@ -1,4 +1,6 @@
 #include <algorithm>
+#include <chrono>
+#include <future>
 
 #include "Argument.h"
 #include "FindCalls.h"
@@ -13,6 +15,7 @@
 #include "Pipeline.h"
 #include "PrintLoopNest.h"
 #include "RealizationOrder.h"
+#include "ThreadPool.h"
 
 using namespace Halide::Internal;
 
@@ -42,6 +45,19 @@ Outputs static_library_outputs(const string &filename_prefix, const Target &targ
     return outputs;
 }
 
+// The target a pipeline actually gets jit-compiled for.
+Target jit_target_for(Target target) {
+    target.set_feature(Target::JIT);
+    target.set_feature(Target::UserContext);
+    return target;
+}
+
+// Background jit compilations for all pipelines share a pool of threads.
+ThreadPool<void> &async_jit_thread_pool() {
+    static ThreadPool<void> pool;
+    return pool;
+}
+
 }  // namespace
 
 struct PipelineContents {
@@ -57,12 +73,67 @@ struct PipelineContents {
     JITModule jit_module;
     Target jit_target;
 
+    /** Jit-compiled variants of the pipeline with the extents and
+     * strides of the input and output buffers baked in, keyed on the
+     * shape signature they were compiled for. See
+     * Pipeline::specialize_jit_on_shapes. */
+    int max_shape_variants = 0;
+    vector<std::pair<vector<int64_t>, JITModule>> shape_variants;
+
+    /** How many times each shape signature without a variant has
+     * been seen. */
+    std::map<vector<int64_t>, int> shape_counts;
+
+    /** Jit compilations started by Pipeline::compile_jit_async that
+     * haven't been used yet, in the order they were started, with
+     * the jit target each is for. */
+    vector<std::pair<Target, std::shared_future<JITModule>>> async_jit;
+
+    /** A pipeline to realize instead while the background
+     * compilation for the target being realized is still running. */
+    Pipeline jit_fallback;
+
+    std::shared_future<JITModule> *find_async_jit(const Target &target) {
+        for (auto &j : async_jit) {
+            if (j.first == target) {
+                return &j.second;
+            }
+        }
+        return nullptr;
+    }
+
+    /** Remove and return the background compilation for a jit
+     * target. Invalid if there is none. */
+    std::shared_future<JITModule> take_async_jit(const Target &target) {
+        std::shared_future<JITModule> result;
+        for (auto it = async_jit.begin(); it != async_jit.end(); it++) {
+            if (it->first == target) {
+                result = it->second;
+                async_jit.erase(it);
+                break;
+            }
+        }
+        return result;
+    }
+
+    /** Background compilations read the cached state below, so
+     * they have to finish before it changes. */
+    void wait_for_async_jit() {
+        for (auto &j : async_jit) {
+            j.second.wait();
+        }
+    }
+
     /** Clear all cached state */
     void invalidate_cache() {
+        wait_for_async_jit();
+        async_jit.clear();
         module = Module("", Target());
         jit_module = JITModule();
         jit_target = Target();
         inferred_args.clear();
+        shape_variants.clear();
+        shape_counts.clear();
     }
 
     // The outputs
@@ -324,6 +395,8 @@ vector<Argument> Pipeline::infer_arguments(Stmt body) {
 }
 
 vector<Argument> Pipeline::infer_arguments() {
+    user_assert(defined()) << "Pipeline is undefined\n";
+    contents->wait_for_async_jit();
     return infer_arguments(Stmt());
 }
 
@@ -332,6 +405,16 @@ Module Pipeline::compile_to_module(const vector<Argument> &args,
                                    const Target &target,
                                    const LinkageType linkage_type) {
     user_assert(defined()) << "Can't compile undefined Pipeline.\n";
+    // Background compilations use the cached module, so let them
+    // finish before replacing it.
+    contents->wait_for_async_jit();
+    return lower_to_module(args, fn_name, target, linkage_type);
+}
+
+Module Pipeline::lower_to_module(const vector<Argument> &args,
+                                 const string &fn_name,
+                                 const Target &target,
+                                 const LinkageType linkage_type) {
 
     for (Function f : contents->outputs) {
         user_assert(f.has_pure_definition() || f.has_extern_definition())
@@ -412,9 +495,7 @@ std::string Pipeline::generate_function_name() const {
 void *Pipeline::compile_jit(const Target &target_arg) {
     user_assert(defined()) << "Pipeline is undefined\n";
 
-    Target target(target_arg);
-    target.set_feature(Target::JIT);
-    target.set_feature(Target::UserContext);
+    Target target = jit_target_for(target_arg);
 
     debug(2) << "jit-compiling for: " << target_arg << "\n";
 
@@ -425,14 +506,101 @@ void *Pipeline::compile_jit(const Target &target_arg) {
         debug(2) << "Reusing old jit module compiled for :\n" << contents->jit_target << "\n";
         return contents->jit_module.main_function();
     }
-    // Clear all cached info in case there is an error.
+
+    // If compile_jit_async was called for this target, use its
+    // result. The inferred arguments it was compiled against are
+    // still current.
+    std::shared_future<JITModule> async_result = contents->take_async_jit(target);
+    if (async_result.valid()) {
+        debug(2) << "Waiting for background jit compilation for: " << target << "\n";
+        // Rethrows any error from the compilation.
+        contents->jit_module = async_result.get();
+        contents->jit_target = target;
+        contents->shape_variants.clear();
+        contents->shape_counts.clear();
+        return contents->jit_module.main_function();
+    }
+
+    // Clear all cached info in case there is an error. Background
+    // compilations for other targets stay valid, so keep them.
+    vector<std::pair<Target, std::shared_future<JITModule>>> async_jit;
+    contents->wait_for_async_jit();
+    async_jit.swap(contents->async_jit);
     contents->invalidate_cache();
+    async_jit.swap(contents->async_jit);
 
     contents->jit_target = target;
 
     // Infer an arguments vector
     infer_arguments();
 
+    contents->jit_module = compile_jit_module(target, target_arg);
+
+    return contents->jit_module.main_function();
+}
+
+void Pipeline::compile_jit_async(const Target &target_arg) {
+    user_assert(defined()) << "Pipeline is undefined\n";
+
+    Target target = jit_target_for(target_arg);
+
+    if ((contents->jit_target == target && contents->jit_module.compiled()) ||
+        contents->find_async_jit(target)) {
+        return;
+    }
+
+    if (contents->inferred_args.empty()) {
+        infer_arguments();
+    }
+
+    // Compilations of the same pipeline share its cached state, so
+    // each one waits for the one started before it.
+    std::shared_future<JITModule> previous;
+    if (!contents->async_jit.empty()) {
+        previous = contents->async_jit.back().second;
+    }
+
+    debug(1) << "Starting background jit compilation for: " << target << "\n";
+
+    auto result = std::make_shared<std::promise<JITModule>>();
+    contents->async_jit.emplace_back(target, result->get_future().share());
+
+    Pipeline pipeline = *this;
+    async_jit_thread_pool().async([=]() mutable {
+        if (previous.valid()) {
+            previous.wait();
+        }
+#ifdef WITH_EXCEPTIONS
+        try {
+            result->set_value(pipeline.compile_jit_module(target, target_arg));
+        } catch (...) {
+            result->set_exception(std::current_exception());
+        }
+#else
+        result->set_value(pipeline.compile_jit_module(target, target_arg));
+#endif
+    });
+}
+
+bool Pipeline::async_jit_ready(const Target &target) {
+    user_assert(defined()) << "Pipeline is undefined\n";
+    std::shared_future<JITModule> *pending = contents->find_async_jit(jit_target_for(target));
+    return !pending || pending->wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+}
+
+void Pipeline::wait_for_async_jit() {
+    user_assert(defined()) << "Pipeline is undefined\n";
+    contents->wait_for_async_jit();
+}
+
+void Pipeline::set_jit_fallback(const Pipeline &fallback) {
+    user_assert(defined()) << "Pipeline is undefined\n";
+    user_assert(!fallback.defined() || fallback.contents.get() != contents.get())
+        << "A Pipeline can't be its own jit fallback\n";
+    contents->jit_fallback = fallback;
+}
+
+JITModule Pipeline::compile_jit_module(const Target &target, const Target &externs_target) {
     // Don't actually use the return value - it embeds all constant
     // images and we don't want to do that when jitting. Instead
     // use the vector of parameters found to make a more complete
@@ -446,13 +614,13 @@ void *Pipeline::compile_jit(const Target &target_arg) {
     string name = generate_function_name();
 
     // Compile to a module and also compile any submodules.
-    Module module = compile_to_module(args, name, target).resolve_submodules();
+    Module module = lower_to_module(args, name, target, LinkageType::ExternalPlusMetadata).resolve_submodules();
     auto f = module.get_function_by_name(name);
 
     std::map<std::string, JITExtern> lowered_externs = contents->jit_externs;
 
     // Compile to jit module
-    JITModule jit_module(module, f, make_externs_jit_module(target_arg, lowered_externs));
+    JITModule jit_module(module, f, make_externs_jit_module(externs_target, lowered_externs));
 
     // Dump bitcode to a file if the environment variable
     // HL_GENBITCODE is defined to a nonzero value.
@@ -466,9 +634,7 @@ void *Pipeline::compile_jit(const Target &target_arg) {
         module.compile(Outputs().bitcode(file_name));
     }
 
-    contents->jit_module = jit_module;
-
-    return jit_module.main_function();
+    return jit_module;
 }
 
 
@@ -506,8 +672,10 @@ void Pipeline::set_custom_print(void (*cust_print)(void *, const char *)) {
 
 void Pipeline::set_jit_externs(const std::map<std::string, JITExtern> &externs) {
     user_assert(defined()) << "Pipeline is undefined\n";
-    contents->jit_externs = externs;
+    // Background compilations read the externs, so they must finish
+    // before the externs change.
     invalidate_cache();
+    contents->jit_externs = externs;
 }
 
 const std::map<std::string, JITExtern> &Pipeline::get_jit_externs() {
@@ -515,6 +683,14 @@ const std::map<std::string, JITExtern> &Pipeline::get_jit_externs() {
     return contents->jit_externs;
 }
 
+void Pipeline::specialize_jit_on_shapes(int max_variants) {
+    user_assert(defined()) << "Pipeline is undefined\n";
+    user_assert(max_variants >= 0) << "The number of shape-specialized variants can't be negative\n";
+    contents->max_shape_variants = max_variants;
+    contents->shape_variants.clear();
+    contents->shape_counts.clear();
+}
+
 void Pipeline::add_custom_lowering_pass(IRMutator2 *pass, std::function<void()> deleter) {
     user_assert(defined()) << "Pipeline is undefined\n";
     contents->invalidate_cache();
@@ -778,6 +954,152 @@ void Pipeline::prepare_jit_call_arguments(RealizationArg &outputs, const Target
 
 }
 
+namespace {
+
+// Temporarily constrains the buffer parameters of a pipeline to the
+// shapes seen at a call, and puts the old constraints back when it
+// goes out of scope.
+class ShapeConstraints {
+    struct Saved {
+        Parameter param;
+        vector<Expr> extents, strides;
+        int host_alignment;
+    };
+    vector<Saved> saved;
+
+public:
+    void constrain(Parameter p, const halide_buffer_t *buf, int host_alignment, bool constrain_extents) {
+        Saved s;
+        s.param = p;
+        s.host_alignment = p.host_alignment();
+        for (int d = 0; d < buf->dimensions; d++) {
+            s.extents.push_back(p.extent_constraint(d));
+            s.strides.push_back(p.stride_constraint(d));
+            // Leave alone anything the user constrained themselves.
+            if (constrain_extents && !s.extents.back().defined()) {
+                p.set_extent_constraint(d, buf->dim[d].extent);
+            }
+            if (!s.strides.back().defined()) {
+                p.set_stride_constraint(d, buf->dim[d].stride);
+            }
+        }
+        if (host_alignment > s.host_alignment) {
+            p.set_host_alignment(host_alignment);
+        }
+        saved.push_back(s);
+    }
+
+    ~ShapeConstraints() {
+        for (Saved &s : saved) {
+            for (size_t d = 0; d < s.extents.size(); d++) {
+                s.param.set_extent_constraint(d, s.extents[d]);
+                s.param.set_stride_constraint(d, s.strides[d]);
+            }
+            s.param.set_host_alignment(s.host_alignment);
+        }
+    }
+};
+
+}  // namespace
+
+JITModule Pipeline::shape_specialized_jit_module(const Target &target, const JITCallArgs &args) {
+    // Find the buffer parameters and the buffers bound to them, in
+    // argument order. Buffers embedded in the pipeline have a fixed
+    // shape already.
+    vector<Parameter> params;
+    vector<const halide_buffer_t *> bufs;
+    vector<bool> is_secondary_output;
+    size_t arg_index = 0;
+    for (const InferredArgument &arg : contents->inferred_args) {
+        const void *ptr = args.store[arg_index++];
+        if (arg.param.defined() && arg.param.is_buffer()) {
+            params.push_back(arg.param);
+            bufs.push_back((const halide_buffer_t *)ptr);
+            is_secondary_output.push_back(false);
+        }
+    }
+    for (Function out : contents->outputs) {
+        for (size_t i = 0; i < out.output_buffers().size(); i++) {
+            params.push_back(out.output_buffers()[i]);
+            bufs.push_back((const halide_buffer_t *)args.store[arg_index++]);
+            // The extents of the outputs of a Tuple beyond the first
+            // are implicitly those of the first.
+            is_secondary_output.push_back(i > 0);
+        }
+    }
+    internal_assert(arg_index == args.size);
+
+    // The signature is the dimensionality, extents and strides of
+    // each buffer, and the alignment of its host pointer up to a
+    // cache line.
+    vector<int64_t> signature;
+    vector<int> alignments;
+    for (size_t i = 0; i < bufs.size(); i++) {
+        const halide_buffer_t *buf = bufs[i];
+        if (!buf || !buf->host || buf->dimensions != params[i].dimensions()) {
+            // Let the generic code deal with it.
+            return contents->jit_module;
+        }
+        signature.push_back(buf->dimensions);
+        for (int d = 0; d < buf->dimensions; d++) {
+            signature.push_back(buf->dim[d].extent);
+            signature.push_back(buf->dim[d].stride);
+        }
+        int alignment = 1;
+        while (alignment < 64 && ((uintptr_t)buf->host % (alignment * 2)) == 0) {
+            alignment *= 2;
+        }
+        signature.push_back(alignment);
+        alignments.push_back(alignment);
+    }
+
+    for (const auto &variant : contents->shape_variants) {
+        if (variant.first == signature) {
+            return variant.second;
+        }
+    }
+
+    if ((int)contents->shape_variants.size() >= contents->max_shape_variants) {
+        return contents->jit_module;
+    }
+
+    // Only compile a variant for a shape that recurs. Don't let the
+    // counts grow without bound if every call is a new shape.
+    if (contents->shape_counts.size() >= 64) {
+        contents->shape_counts.clear();
+    }
+    if (++contents->shape_counts[signature] < 2) {
+        return contents->jit_module;
+    }
+    contents->shape_counts.erase(signature);
+
+    debug(1) << "Compiling a variant of " << generate_function_name()
+             << " specialized on the shapes of its buffers\n";
+
+    // Background compilations for other targets may still be lowering
+    // the pipeline, against the same Parameters and cached module
+    // that compiling the variant changes for a while.
+    contents->wait_for_async_jit();
+
+    JITModule variant;
+    {
+        ShapeConstraints constraints;
+        for (size_t i = 0; i < bufs.size(); i++) {
+            constraints.constrain(params[i], bufs[i], alignments[i], !is_secondary_output[i]);
+        }
+
+        // Lower from scratch rather than reusing the cached generic
+        // module, and put the generic module back afterwards.
+        Module generic_module = contents->module;
+        contents->module = Module("", Target());
+        variant = compile_jit_module(contents->jit_target, target);
+        contents->module = generic_module;
+    }
+
+    contents->shape_variants.emplace_back(signature, variant);
+    return variant;
+}
+
 std::vector<JITModule>
 Pipeline::make_externs_jit_module(const Target &target,
                                   std::map<std::string, JITExtern> &externs_in_out) {
@@ -827,10 +1149,158 @@ Pipeline::make_externs_jit_module(const Target &target,
     return result;
 }
 
+namespace Internal {
+
+struct CallableContents {
+    mutable RefCount ref_count;
+
+    // Keeps the compiled code alive.
+    JITModule jit_module;
+    JITModule::argv_wrapper argv_function;
+    JITHandlers handlers;
+
+    // The arguments of the Callable, including the outputs, and the
+    // slot of the argv array each one goes in (or -1 if the pipeline
+    // doesn't use it).
+    vector<Argument> args;
+    vector<int> slots;
+
+    // The argv array, with the arguments that are the same for every
+    // call (i.e. embedded buffers) filled in.
+    vector<const void *> argv_template;
+    vector<Buffer<>> embedded_buffers;
+    int user_context_slot = -1;
+};
+
+template<>
+RefCount &ref_count<CallableContents>(const CallableContents *p) {
+    return p->ref_count;
+}
+
+template<>
+void destroy<CallableContents>(const CallableContents *p) {
+    delete p;
+}
+
+}  // namespace Internal
+
+Callable Pipeline::compile_to_callable(const vector<Argument> &args, const Target &target) {
+    user_assert(defined()) << "Can't compile an undefined Pipeline\n";
+
+    compile_jit(target);
+
+    CallableContents *c = new CallableContents;
+    Callable callable(c);
+    c->jit_module = contents->jit_module;
+    c->argv_function = contents->jit_module.argv_function();
+    c->handlers = jit_handlers();
+    c->args = args;
+    c->slots.resize(args.size(), -1);
+    c->argv_template.resize(contents->inferred_args.size(), nullptr);
+
+    for (size_t i = 0; i < contents->inferred_args.size(); i++) {
+        const InferredArgument &arg = contents->inferred_args[i];
+        if (arg.param.defined() && arg.param.same_as(contents->user_context_arg.param)) {
+            c->user_context_slot = (int)i;
+            continue;
+        }
+        bool found = false;
+        for (size_t j = 0; j < args.size(); j++) {
+            if (args[j].name == arg.arg.name) {
+                user_assert(args[j].is_buffer() == arg.arg.is_buffer())
+                    << "Argument " << args[j].name << " of compile_to_callable is a "
+                    << (args[j].is_buffer() ? "buffer" : "scalar") << ", but the pipeline uses it as a "
+                    << (arg.arg.is_buffer() ? "buffer" : "scalar") << "\n";
+                user_assert(args[j].is_buffer() || args[j].type == arg.arg.type)
+                    << "Argument " << args[j].name << " of compile_to_callable has type " << args[j].type
+                    << ", but the pipeline uses it with type " << arg.arg.type << "\n";
+                c->slots[j] = (int)i;
+                found = true;
+            }
+        }
+        if (found) {
+            continue;
+        }
+        user_assert(!arg.param.defined())
+            << "The pipeline uses " << arg.arg.name
+            << ", which is not in the argument list passed to compile_to_callable\n";
+        // An embedded buffer.
+        internal_assert(arg.buffer.defined());
+        c->embedded_buffers.push_back(arg.buffer);
+        c->argv_template[i] = arg.buffer.raw_buffer();
+    }
+
+    for (Function out : contents->outputs) {
+        for (Parameter buf : out.output_buffers()) {
+            c->slots.push_back((int)c->argv_template.size());
+            c->argv_template.push_back(nullptr);
+            c->args.push_back(Argument(buf.name(), Argument::OutputBuffer, buf.type(), buf.dimensions()));
+        }
+    }
+
+    return callable;
+}
+
+Callable::Callable() {
+}
+
+Callable::Callable(CallableContents *contents) : contents(contents) {
+}
+
+bool Callable::defined() const {
+    return contents.defined();
+}
+
+int Callable::call(size_t argc, const CallableArg *argv) const {
+    user_assert(defined()) << "Can't call an undefined Callable\n";
+    const CallableContents *c = contents.get();
+
+    user_assert(argc == c->args.size())
+        << "Callable expects " << c->args.size() << " arguments (including outputs), but was passed " << argc << "\n";
+    for (size_t i = 0; i < argc; i++) {
+        const Argument &a = c->args[i];
+        user_assert(argv[i].is_buffer == a.is_buffer())
+            << "Argument " << i << " of Callable (" << a.name << ") should be a "
+            << (a.is_buffer() ? "buffer" : "scalar") << "\n";
+        user_assert(argv[i].is_buffer || argv[i].type == (halide_type_t)a.type)
+            << "Argument " << i << " of Callable (" << a.name << ") should have type " << a.type
+            << ", but has type " << Type(argv[i].type) << "\n";
+    }
+
+    const void *fixed_store[64];
+    vector<const void *> heap_store;
+    const void **store = fixed_store;
+    if (c->argv_template.size() > sizeof(fixed_store) / sizeof(fixed_store[0])) {
+        heap_store.resize(c->argv_template.size());
+        store = heap_store.data();
+    }
+    std::copy(c->argv_template.begin(), c->argv_template.end(), store);
+    for (size_t i = 0; i < argc; i++) {
+        if (c->slots[i] >= 0) {
+            store[c->slots[i]] = argv[i].value;
+        }
+    }
+
+    JITFuncCallContext jit_context(c->handlers);
+    void *user_context_storage = &jit_context.jit_context;
+    if (c->user_context_slot >= 0) {
+        store[c->user_context_slot] = &user_context_storage;
+    }
+
+    int exit_status = c->argv_function(store);
+    jit_context.finalize(exit_status);
+    return exit_status;
+}
+
 void Pipeline::realize(RealizationArg outputs, const Target &t,
                        const ParamMap &param_map) {
-    Target target = t;
     user_assert(defined()) << "Can't realize an undefined Pipeline\n";
+    realize_with_handlers(std::move(outputs), t, param_map, jit_handlers());
+}
+
+void Pipeline::realize_with_handlers(RealizationArg outputs, const Target &t,
+                                     const ParamMap &param_map, const Internal::JITHandlers &handlers) {
+    Target target = t;
 
     debug(2) << "Realizing Pipeline for " << target << "\n";
 
@@ -857,12 +1327,22 @@ void Pipeline::realize(RealizationArg outputs, const Target &t,
         // If we've already jit-compiled for a specific target, use that.
         if (contents->jit_module.compiled()) {
             target = contents->jit_target;
+        } else if (!contents->async_jit.empty()) {
+            // Or the one we started compiling for in the background.
+            target = contents->async_jit.front().first;
         } else {
             // Otherwise get the target from the environment
             target = get_jit_target_from_environment();
         }
     }
 
+    // Don't wait for a background compilation if there's a fallback.
+    if (contents->jit_fallback.defined() && !async_jit_ready(target)) {
+        debug(2) << "Realizing jit fallback while compilation is in progress\n";
+        contents->jit_fallback.realize_with_handlers(std::move(outputs), target, param_map, handlers);
+        return;
+    }
+
     // We need to make a context for calling the jitted function to
     // carry the the set of custom handlers. Here's how handlers get
     // called when running jitted code:
@@ -889,13 +1369,17 @@ void Pipeline::realize(RealizationArg outputs, const Target &t,
     compile_jit(target);
 
     // This has to happen after a runtime has been compiled in compile_jit.
-    JITFuncCallContext jit_context(jit_handlers());
+    JITFuncCallContext jit_context(handlers);
     void *user_context_storage = &jit_context.jit_context;
 
     JITCallArgs args(contents->inferred_args.size() + outputs.size());
     prepare_jit_call_arguments(outputs, target, param_map,
                                &user_context_storage, false, args);
 
+    JITModule jit_module = contents->jit_module;
+    if (contents->max_shape_variants > 0) {
+        jit_module = shape_specialized_jit_module(target, args);
+    }
 
     // The handlers in the jit_context default to the default handlers
     // in the runtime of the shared module (e.g. halide_print_impl,
@@ -935,15 +1419,15 @@ void Pipeline::realize(RealizationArg outputs, const Target &t,
     // exception.
 
     debug(2) << "Calling jitted function\n";
-    int exit_status = contents->jit_module.argv_function()(args.store);
+    int exit_status = jit_module.argv_function()(args.store);
     debug(2) << "Back from jitted function. Exit status was " << exit_status << "\n";
 
     // If we're profiling, report runtimes and reset profiler stats.
     if (target.has_feature(Target::Profile)) {
         JITModule::Symbol report_sym =
-            contents->jit_module.find_symbol_by_name("halide_profiler_report");
+            jit_module.find_symbol_by_name("halide_profiler_report");
         JITModule::Symbol reset_sym =
-            contents->jit_module.find_symbol_by_name("halide_profiler_reset");
+            jit_module.find_symbol_by_name("halide_profiler_reset");
         if (report_sym.address && reset_sym.address) {
             void *uc = &jit_context.jit_context;
             void (*report_fn_ptr)(void *) = (void (*)(void *))(report_sym.address);
@@ -21,6 +21,7 @@
 namespace Halide {
 
 struct Argument;
+class Callable;
 class Func;
 struct Outputs;
 struct PipelineContents;
@@ -101,6 +102,25 @@ public:
     static std::vector<Internal::JITModule> make_externs_jit_module(const Target &target,
                                                                     std::map<std::string, JITExtern> &externs_in_out);
 
+    Internal::JITModule compile_jit_module(const Target &target, const Target &externs_target);
+
+    // compile_to_module, without waiting for background compilations.
+    // Used by the background compilations themselves.
+    Module lower_to_module(const std::vector<Argument> &args,
+                           const std::string &fn_name,
+                           const Target &target,
+                           const LinkageType linkage_type);
+
+    // Find or compile a variant of the jitted pipeline specialized
+    // on the shapes of the buffers in the prepared arguments.
+    Internal::JITModule shape_specialized_jit_module(const Target &target, const JITCallArgs &args);
+
+    // realize, calling the given handlers rather than this pipeline's
+    // own. Used to run the jit fallback with the handlers of the
+    // pipeline it stands in for.
+    void realize_with_handlers(RealizationArg outputs, const Target &target,
+                               const ParamMap &param_map, const Internal::JITHandlers &handlers);
+
 public:
     /** Make an undefined Pipeline object. */
     Pipeline();
@@ -254,6 +274,18 @@ public:
      */
      void *compile_jit(const Target &target = get_jit_target_from_environment());
 
+    /** JIT compile the pipeline, and return a Callable that runs it
+     * with the given arguments. The argument layout is resolved once
+     * here, so calling the Callable costs little more than calling
+     * the compiled code directly, unlike realize, which looks up
+     * every Param and ImageParam on each call. The values currently
+     * bound to Params and ImageParams are ignored. Every Param and
+     * ImageParam the pipeline uses must be in the argument list. The
+     * handlers set on this Pipeline (e.g. by set_error_handler) are
+     * captured now; later changes don't affect the Callable. */
+    Callable compile_to_callable(const std::vector<Argument> &args,
+                                 const Target &target = get_jit_target_from_environment());
+
     /** Set the error handler function that be called in the case of
      * runtime errors during halide pipelines. If you are compiling
      * statically, you can also just define your own function with
@@ -360,6 +392,52 @@ public:
      * map unless set otherwise. */
     const std::map<std::string, JITExtern> &get_jit_externs();
 
+    /** Start jit-compiling this pipeline for the given target on a
+     * background thread, and return without waiting for it. The next
+     * realize, infer_input_bounds, or compile_jit for that target
+     * uses the result, waiting for it if it isn't ready yet, or
+     * realizing the fallback pipeline instead if there is one (see
+     * set_jit_fallback). Call this once per target to prepare several
+     * at once; compilations of the same pipeline run one after
+     * another, and those of different pipelines run in parallel.
+     * Don't change the Funcs in the pipeline or call its other
+     * compile_to methods until the compilation is done. Any errors
+     * are reported by the call that uses the result. */
+    void compile_jit_async(const Target &target = get_jit_target_from_environment());
+
+    /** Check whether the compilation started by compile_jit_async
+     * for the given target has finished. True if there is none. */
+    bool async_jit_ready(const Target &target = get_jit_target_from_environment());
+
+    /** Wait for all compilations started by compile_jit_async to
+     * finish. */
+    void wait_for_async_jit();
+
+    /** Realize the given pipeline instead of this one while
+     * the background compilation for the target being realized is
+     * still running. It should compute the same outputs from the same
+     * parameters, e.g. the same algorithm with a cheaper schedule,
+     * and should be jit-compiled ahead of time so that it doesn't
+     * block the first realize itself. The fallback is run with this
+     * pipeline's handlers (set_error_handler, set_custom_trace,
+     * set_custom_print, set_custom_allocator, etc.), not its own. Pass
+     * an undefined Pipeline to always wait instead. */
+    void set_jit_fallback(const Pipeline &fallback);
+
+    /** Have realize compile variants of this pipeline specialized
+     * to the shapes of the buffers it is called with. Once the same
+     * combination of extents, strides, and host alignments of the
+     * input ImageParams and output buffers has been seen twice, a
+     * variant with those values baked in as buffer constraints is
+     * jit-compiled and used for every later call with that
+     * combination. This lets the simplifier fold away bounds
+     * arithmetic and pick aligned vector loads and stores. The mins
+     * are not specialized on. At most max_variants are kept; other
+     * shapes use the generic code. Zero (the default) disables
+     * this. Dimensions the user has already constrained are left
+     * alone. */
+    void specialize_jit_on_shapes(int max_variants = 4);
+
     /** Get a struct containing the currently set custom functions
      * used by JIT. */
     const Internal::JITHandlers &jit_handlers();
@@ -527,6 +605,72 @@ public:
     const ExternCFunction &extern_c_function() const { return extern_c_function_; }
 };
 
+namespace Internal {
+struct CallableContents;
+
+/** An argument to a Callable, type-erased. */
+struct CallableArg {
+    const void *value;
+    bool is_buffer;
+    halide_type_t type;
+};
+
+inline CallableArg make_callable_arg(halide_buffer_t *buf) {
+    return {buf, true, halide_type_t()};
+}
+
+inline CallableArg make_callable_arg(const halide_buffer_t *buf) {
+    return {buf, true, halide_type_t()};
+}
+
+template<typename T>
+CallableArg make_callable_arg(const Buffer<T> &buf) {
+    return {buf.raw_buffer(), true, halide_type_t()};
+}
+
+template<typename T, int D>
+CallableArg make_callable_arg(const Runtime::Buffer<T, D> &buf) {
+    return {buf.raw_buffer(), true, halide_type_t()};
+}
+
+// Scalars are passed to the compiled code by address.
+template<typename T>
+CallableArg make_callable_arg(const T &scalar) {
+    return {&scalar, false, halide_type_of<T>()};
+}
+}  // namespace Internal
+
+/** A JIT-compiled Pipeline bound to a fixed argument list, made by
+ * Pipeline::compile_to_callable. Call it with the inputs in the order
+ * of that argument list, followed by one buffer per output of the
+ * pipeline (one per Tuple element for Tuple-valued outputs). Buffers
+ * may be passed as halide_buffer_t pointers, Halide::Buffers, or
+ * Halide::Runtime::Buffers. Scalars are passed by value, and must
+ * have exactly the type of their Param. Returns the exit status of
+ * the pipeline; errors are reported as for realize. A Callable keeps
+ * its compiled code alive, so it stays valid if the Pipeline is
+ * recompiled or destroyed. */
+class Callable {
+    Internal::IntrusivePtr<Internal::CallableContents> contents;
+
+    friend class Pipeline;
+    explicit Callable(Internal::CallableContents *contents);
+
+    int call(size_t argc, const Internal::CallableArg *argv) const;
+
+public:
+    Callable();
+
+    bool defined() const;
+
+    template<typename... Args>
+    int operator()(const Args &... args) const {
+        // One extra element so the array is never empty.
+        const Internal::CallableArg argv[] = {Internal::make_callable_arg(args)..., Internal::CallableArg()};
+        return call(sizeof...(Args), argv);
+    }
+};
+
 }  // namespace Halide
 
 #endif
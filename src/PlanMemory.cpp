@@ -0,0 +1,348 @@
+#include <algorithm>
+#include <limits>
+#include <map>
+
+#include "PlanMemory.h"
+#include "CodeGen_Internal.h"
+#include "IRMutator.h"
+#include "IROperator.h"
+#include "Scope.h"
+#include "Util.h"
+
+namespace Halide {
+namespace Internal {
+
+using std::map;
+using std::pair;
+using std::string;
+using std::vector;
+
+namespace {
+
+// Offsets into the arena are rounded up to a multiple of this, which
+// is at least the alignment halide_malloc provides on any target.
+const int64_t arena_alignment = 128;
+
+// Arenas are named by unique_name(arena_prefix).
+const char *const arena_prefix = "memory_arena";
+
+// The free function of the views into an arena.
+const char *const arena_view_free_function = "halide_device_host_nop_free";
+
+struct PlannedAllocation {
+    const Allocate *op;
+    // Including the padding codegen adds to heap allocations.
+    int64_t size;
+    // The allocation is live from its Allocate node until its Free
+    // marker, measured in allocation events reached in program order.
+    int start, end;
+    // The loop and if nesting depth of the Allocate node.
+    int depth;
+    int64_t offset;
+    // Set if the allocation turned out to be unsafe to plan.
+    bool rejected;
+};
+
+// Find the heap allocations of constant size made outside of any
+// loop, and the interval over which each one is live.
+class FindPlannableAllocations : public IRVisitor {
+    using IRVisitor::visit;
+
+    int loop_depth = 0, depth = 0;
+    int clock = 0;
+    // The index into allocations of each allocation in scope, or -1
+    // if it's not being planned.
+    Scope<int> live;
+
+    void visit(const For *op) override {
+        op->min.accept(this);
+        op->extent.accept(this);
+        ScopedValue<int> old_loop_depth(loop_depth, loop_depth + 1);
+        ScopedValue<int> old_depth(depth, depth + 1);
+        op->body.accept(this);
+    }
+
+    void visit(const IfThenElse *op) override {
+        op->condition.accept(this);
+        ScopedValue<int> old_depth(depth, depth + 1);
+        op->then_case.accept(this);
+        if (op->else_case.defined()) {
+            op->else_case.accept(this);
+        }
+    }
+
+    bool plannable(const Allocate *op) {
+        if (loop_depth > 0 ||
+            op->new_expr.defined() ||
+            !op->free_function.empty() ||
+            !is_one(op->condition) ||
+            (op->memory_type != MemoryType::Heap &&
+             op->memory_type != MemoryType::Auto)) {
+            return false;
+        }
+        int32_t constant_size = Allocate::constant_allocation_size(op->extents, op->name);
+        if (constant_size <= 0) {
+            return false;
+        }
+        // Auto allocations small enough to go on the stack will
+        // go on the stack.
+        int64_t bytes = (int64_t)constant_size * op->type.bytes();
+        return (op->memory_type == MemoryType::Heap ||
+                !can_allocation_fit_on_stack(bytes));
+    }
+
+    void visit(const Allocate *op) override {
+        int idx = -1;
+        if (plannable(op)) {
+            map<const Allocate *, int>::iterator iter = index_of.find(op);
+            if (iter != index_of.end()) {
+                // The same node is reached more than once (e.g. it
+                // is shared by two branches), so it doesn't have a
+                // single lifetime.
+                allocations[iter->second].rejected = true;
+            } else {
+                int32_t constant_size = Allocate::constant_allocation_size(op->extents, op->name);
+                PlannedAllocation a;
+                a.op = op;
+                a.size = (int64_t)constant_size * op->type.bytes() + op->type.bytes();
+                a.start = clock++;
+                a.end = -1;
+                a.depth = depth;
+                a.offset = 0;
+                a.rejected = false;
+                idx = (int)allocations.size();
+                index_of[op] = idx;
+                allocations.push_back(a);
+            }
+        }
+
+        for (const Expr &e : op->extents) {
+            e.accept(this);
+        }
+        op->condition.accept(this);
+        {
+            ScopedBinding<int> bind(live, op->name, idx);
+            op->body.accept(this);
+        }
+
+        if (idx >= 0 && allocations[idx].end < 0) {
+            // There was no early free.
+            allocations[idx].end = clock++;
+        }
+    }
+
+    void visit(const Free *op) override {
+        if (!live.contains(op->name)) {
+            return;
+        }
+        int idx = live.get(op->name);
+        if (idx < 0) {
+            return;
+        }
+        PlannedAllocation &a = allocations[idx];
+        if (depth != a.depth) {
+            // A free inside a loop or a branch doesn't end the
+            // lifetime unconditionally.
+            a.rejected = true;
+        }
+        a.end = clock++;
+    }
+
+public:
+    vector<PlannedAllocation> allocations;
+    map<const Allocate *, int> index_of;
+};
+
+int64_t align_up(int64_t x) {
+    return (x + arena_alignment - 1) / arena_alignment * arena_alignment;
+}
+
+bool lifetimes_overlap(const PlannedAllocation *a, const PlannedAllocation *b) {
+    return a->start < b->end && b->start < a->end;
+}
+
+// Greedily assign offsets, largest allocation first, placing each
+// one at the lowest offset that doesn't overlap an allocation already
+// placed with an overlapping lifetime. Returns the size of the arena.
+int64_t assign_offsets(vector<PlannedAllocation *> &allocs) {
+    std::sort(allocs.begin(), allocs.end(),
+              [](const PlannedAllocation *a, const PlannedAllocation *b) {
+                  return a->size > b->size || (a->size == b->size && a->start < b->start);
+              });
+
+    vector<PlannedAllocation *> placed;
+    int64_t arena_size = 0;
+    for (PlannedAllocation *a : allocs) {
+        vector<pair<int64_t, int64_t>> busy;
+        for (const PlannedAllocation *p : placed) {
+            if (lifetimes_overlap(a, p)) {
+                busy.push_back({p->offset, p->offset + p->size});
+            }
+        }
+        std::sort(busy.begin(), busy.end());
+        int64_t offset = 0;
+        for (const pair<int64_t, int64_t> &range : busy) {
+            if (offset + a->size <= range.first) {
+                break;
+            }
+            offset = std::max(offset, align_up(range.second));
+        }
+        a->offset = offset;
+        arena_size = std::max(arena_size, offset + a->size);
+        placed.push_back(a);
+    }
+    return arena_size;
+}
+
+class CountPlannedAllocations : public IRVisitor {
+    using IRVisitor::visit;
+
+    const map<const Allocate *, int64_t> &offsets;
+
+    void visit(const Allocate *op) override {
+        if (offsets.count(op)) {
+            count++;
+        }
+        IRVisitor::visit(op);
+    }
+
+public:
+    int count = 0;
+    CountPlannedAllocations(const map<const Allocate *, int64_t> &offsets) : offsets(offsets) {}
+};
+
+// Turn each planned allocation into a view of the arena.
+class UseArena : public IRMutator2 {
+    using IRMutator2::visit;
+
+    const map<const Allocate *, int64_t> &offsets;
+    const string &arena_name;
+
+    Stmt visit(const Allocate *op) override {
+        map<const Allocate *, int64_t>::const_iterator iter = offsets.find(op);
+        if (iter == offsets.end()) {
+            return IRMutator2::visit(op);
+        }
+        Expr arena = Variable::make(Handle(), arena_name);
+        Expr address = reinterpret(UInt(64), arena) + make_const(UInt(64), iter->second);
+        return Allocate::make(op->name, op->type, MemoryType::Heap, op->extents, op->condition,
+                              mutate(op->body), reinterpret(Handle(), address),
+                              arena_view_free_function);
+    }
+
+public:
+    UseArena(const map<const Allocate *, int64_t> &offsets, const string &arena_name)
+        : offsets(offsets), arena_name(arena_name) {}
+};
+
+// Allocate the arena around the smallest statement that contains all
+// of the planned allocations, so that e.g. bounds queries don't
+// allocate it.
+class InjectArena {
+    const map<const Allocate *, int64_t> &offsets;
+    string arena_name;
+    int64_t arena_size;
+
+    bool contains_all(const Stmt &s) {
+        if (!s.defined()) {
+            return false;
+        }
+        CountPlannedAllocations counter(offsets);
+        s.accept(&counter);
+        return counter.count == (int)offsets.size();
+    }
+
+public:
+    InjectArena(const map<const Allocate *, int64_t> &offsets, int64_t arena_size)
+        : offsets(offsets), arena_name(unique_name(arena_prefix)), arena_size(arena_size) {}
+
+    Stmt inject(const Stmt &s) {
+        if (const LetStmt *op = s.as<LetStmt>()) {
+            return LetStmt::make(op->name, op->value, inject(op->body));
+        } else if (const ProducerConsumer *op = s.as<ProducerConsumer>()) {
+            return ProducerConsumer::make(op->name, op->is_producer, inject(op->body));
+        } else if (const IfThenElse *op = s.as<IfThenElse>()) {
+            if (contains_all(op->then_case)) {
+                return IfThenElse::make(op->condition, inject(op->then_case), op->else_case);
+            } else if (contains_all(op->else_case)) {
+                return IfThenElse::make(op->condition, op->then_case, inject(op->else_case));
+            }
+        } else if (const Block *op = s.as<Block>()) {
+            if (contains_all(op->first)) {
+                return Block::make(inject(op->first), op->rest);
+            } else if (contains_all(op->rest)) {
+                return Block::make(op->first, inject(op->rest));
+            }
+        }
+        Stmt body = UseArena(offsets, arena_name).mutate(s);
+        return Allocate::make(arena_name, UInt(8), MemoryType::Heap,
+                              {make_const(Int(32), arena_size)}, const_true(), body);
+    }
+};
+
+class UsesArena : public IRVisitor {
+    using IRVisitor::visit;
+
+    void visit(const Variable *op) override {
+        result = result || starts_with(op->name, arena_prefix + string("$"));
+    }
+
+public:
+    bool result = false;
+};
+
+}  // namespace
+
+bool is_arena_view(const Allocate *op) {
+    if (!op->new_expr.defined() || op->free_function != arena_view_free_function) {
+        return false;
+    }
+    UsesArena uses;
+    op->new_expr.accept(&uses);
+    return uses.result;
+}
+
+Stmt plan_memory(Stmt s, const Target &t) {
+    // Device buffers and Hexagon offloading manage host allocations
+    // of their own.
+    if (t.has_gpu_feature() ||
+        t.features_any_of({Target::HVX_64, Target::HVX_128})) {
+        return s;
+    }
+
+    FindPlannableAllocations finder;
+    s.accept(&finder);
+
+    vector<PlannedAllocation *> allocs;
+    int64_t total_size = 0;
+    for (PlannedAllocation &a : finder.allocations) {
+        if (!a.rejected) {
+            allocs.push_back(&a);
+            total_size += a.size;
+        }
+    }
+    if (allocs.size() < 2) {
+        return s;
+    }
+
+    int64_t arena_size = assign_offsets(allocs);
+    if (arena_size > std::numeric_limits<int32_t>::max() ||
+        arena_size > t.maximum_buffer_size()) {
+        debug(1) << "Not planning memory, as the arena would be " << arena_size << " bytes\n";
+        return s;
+    }
+
+    map<const Allocate *, int64_t> offsets;
+    for (const PlannedAllocation *a : allocs) {
+        debug(2) << "  " << a->op->name << ": " << a->size << " bytes at offset " << a->offset
+                 << ", live from " << a->start << " to " << a->end << "\n";
+        offsets[a->op] = a->offset;
+    }
+    debug(1) << "Planned " << allocs.size() << " allocations totalling " << total_size
+             << " bytes into an arena of " << arena_size << " bytes\n";
+
+    return InjectArena(offsets, arena_size).inject(s);
+}
+
+}  // namespace Internal
+}  // namespace Halide
@@ -0,0 +1,31 @@
+#ifndef HALIDE_PLAN_MEMORY_H
+#define HALIDE_PLAN_MEMORY_H
+
+/** \file
+ * Defines the lowering pass that packs heap allocations with disjoint
+ * lifetimes into a single arena.
+ */
+
+#include "IR.h"
+#include "Target.h"
+
+namespace Halide {
+namespace Internal {
+
+/** Find the heap allocations of constant size that are made once per
+ * call to the pipeline (i.e. outside of any loop), compute the
+ * interval over which each one is live using the markers injected by
+ * inject_early_frees, and assign each an offset into one shared arena
+ * so that allocations that are never live at the same time share
+ * memory. The arena is allocated once, and the original allocations
+ * become views into it. */
+Stmt plan_memory(Stmt s, const Target &t);
+
+/** Check if an Allocate node is one of the views into the arena
+ * made by plan_memory, rather than memory of its own. */
+bool is_arena_view(const Allocate *op);
+
+}  // namespace Internal
+}  // namespace Halide
+
+#endif
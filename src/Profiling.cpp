@@ -6,6 +6,7 @@
 #include "CodeGen_Internal.h"
 #include "IRMutator.h"
 #include "IROperator.h"
+#include "PlanMemory.h"
 #include "Profiling.h"
 #include "Scope.h"
 #include "Simplify.h"
@@ -27,7 +28,8 @@ public:
 
     string pipeline_name;
 
-    InjectProfiling(const string &pipeline_name) : pipeline_name(pipeline_name) {
+    InjectProfiling(const string &pipeline_name)
+        : pipeline_name(pipeline_name), local_slot(Variable::make(Handle(), "profiler_local_slot")) {
         indices["overhead"] = 0;
         stack.push_back(0);
     }
@@ -47,6 +49,13 @@ private:
 
     bool profiling_memory = true;
 
+    // The profiler slot of the thread running the current statement.
+    // Each thread that runs a task of a parallel loop claims a slot of
+    // its own.
+    Expr local_slot;
+
+    bool in_hexagon = false;
+
     // Strip down the tuple name, e.g. f.0 into f
     string normalize_name(const string &name) {
         vector<string> v = split_string(name, ".");
@@ -111,8 +120,15 @@ private:
         }
         Expr condition = mutate(op->condition);
 
-        bool on_stack;
-        Expr size = compute_allocation_size(new_extents, condition, op->type, op->name, on_stack);
+        bool on_stack = false;
+        Expr size;
+        if (is_arena_view(op)) {
+            // The memory belongs to an arena made by plan_memory,
+            // which is reported in its own right.
+            size = make_zero(UInt(64));
+        } else {
+            size = compute_allocation_size(new_extents, condition, op->type, op->name, on_stack);
+        }
         internal_assert(size.type() == UInt(64));
         func_alloc_sizes.push(op->name, {on_stack, size});
 
@@ -200,29 +216,60 @@ private:
             idx = stack.back();
         }
 
-        Expr profiler_token = Variable::make(Int(32), "profiler_token");
-        Expr profiler_state = Variable::make(Handle(), "profiler_state");
-
-        // This call gets inlined and becomes a single store instruction.
-        Expr set_task = Call::make(Int(32), "halide_profiler_set_current_func",
-                                   {profiler_state, profiler_token, idx}, Call::Extern);
-
-        body = Block::make(Evaluate::make(set_task), body);
+        body = Block::make(set_current_func(idx), body);
 
         return ProducerConsumer::make(op->name, op->is_producer, body);
     }
 
+    Stmt set_current_func(int idx) {
+        Expr profiler_token = Variable::make(Int(32), "profiler_token");
+        // This call gets inlined and becomes a single store instruction.
+        return Evaluate::make(Call::make(Int(32), "halide_profiler_set_current_func",
+                                         {local_slot, profiler_token, idx}, Call::Extern));
+    }
+
     Stmt visit(const For *op) override {
         Stmt body = op->body;
 
-        // The for loop indicates a device transition or a
-        // parallel job launch. Decrement the number of active
+        bool on_host = (op->device_api == DeviceAPI::None ||
+                        op->device_api == DeviceAPI::Host);
+
+        Expr state = Variable::make(Handle(), "profiler_state");
+
+        if (on_host && op->is_parallel() && !in_hexagon) {
+            // Each task runs on some thread, which claims a slot of
+            // its own while it runs the task. Meanwhile the thread
+            // that launched the loop isn't running this Func, even
+            // if it helps out with the tasks.
+            string slot_name = unique_name("profiler_local_slot");
+            Expr slot = Variable::make(Handle(), slot_name);
+            {
+                ScopedValue<Expr> old_local_slot(local_slot, slot);
+                body = mutate(body);
+            }
+            Expr profiler_token = Variable::make(Int(32), "profiler_token");
+            Expr acquire = Call::make(Handle(), "halide_profiler_acquire_slot",
+                                      {state, profiler_token + stack.back()}, Call::Extern);
+            // Released as a destructor, so that the slot is freed
+            // even if the task exits early with an error.
+            Stmt release = Evaluate::make(
+                Call::make(Int(32), Call::register_destructor,
+                           {Expr("halide_profiler_release_slot_as_destructor"), slot}, Call::Intrinsic));
+            body = LetStmt::make(slot_name, acquire, Block::make(release, body));
+
+            Stmt stmt = For::make(op->name, op->min, op->extent, op->for_type, op->device_api, body);
+            Stmt wait = Evaluate::make(Call::make(Int(32), "halide_profiler_set_current_func",
+                                                  {local_slot, halide_profiler_waiting, 0}, Call::Extern));
+            return Block::make({wait, stmt, set_current_func(stack.back())});
+        }
+
+        // The for loop indicates a device transition or a parallel
+        // job launch on the device. Decrement the number of active
         // threads outside the loop, and increment it inside the
         // body.
         bool update_active_threads = (op->device_api == DeviceAPI::Hexagon ||
-                                      op->is_parallel());
+                                      (in_hexagon && op->is_parallel()));
 
-        Expr state = Variable::make(Handle(), "profiler_state");
         Stmt incr_active_threads =
             Evaluate::make(Call::make(Int(32), "halide_profiler_incr_active_threads",
                                       {state}, Call::Extern));
@@ -242,17 +289,25 @@ private:
             // which means we can't do memory accounting.
             bool old_profiling_memory = profiling_memory;
             profiling_memory = false;
-            body = mutate(body);
+            {
+                // The DSP has no per-thread slots. Everything there
+                // shares its state's current_func.
+                ScopedValue<Expr> old_local_slot(local_slot, Variable::make(Handle(), "hvx_profiler_slot"));
+                ScopedValue<bool> old_in_hexagon(in_hexagon, true);
+                body = mutate(body);
+            }
             profiling_memory = old_profiling_memory;
 
             // Get the profiler state pointer from scratch inside the
             // kernel. There will be a separate copy of the state on
             // the DSP that the host side will periodically query.
             Expr get_state = Call::make(Handle(), "halide_profiler_get_state", {}, Call::Extern);
+            Expr get_slot = Call::make(Handle(), "halide_profiler_shared_slot",
+                                       {Variable::make(Handle(), "hvx_profiler_state")}, Call::Extern);
             body = substitute("profiler_state", Variable::make(Handle(), "hvx_profiler_state"), body);
+            body = LetStmt::make("hvx_profiler_slot", get_slot, body);
             body = LetStmt::make("hvx_profiler_state", get_state, body);
-        } else if (op->device_api == DeviceAPI::None ||
-                   op->device_api == DeviceAPI::Host) {
+        } else if (on_host) {
             body = mutate(body);
         } else {
             body = op->body;
@@ -297,14 +352,17 @@ Stmt inject_profiling(Stmt s, string pipeline_name) {
         s = Block::make(update_stack, s);
     }
 
+    // The calling thread claims a profiler slot for the duration of
+    // the pipeline, starting in the overhead slot.
     Expr profiler_state = Variable::make(Handle(), "profiler_state");
-    Stmt incr_active_threads =
-        Evaluate::make(Call::make(Int(32), "halide_profiler_incr_active_threads",
-                                  {profiler_state}, Call::Extern));
-    Stmt decr_active_threads =
-        Evaluate::make(Call::make(Int(32), "halide_profiler_decr_active_threads",
-                                  {profiler_state}, Call::Extern));
-    s = Block::make({incr_active_threads, s, decr_active_threads});
+    Expr local_slot = Variable::make(Handle(), "profiler_local_slot");
+    Expr acquire_slot = Call::make(Handle(), "halide_profiler_acquire_slot",
+                                   {profiler_state, profiler_token}, Call::Extern);
+    Stmt release_slot = Evaluate::make(
+        Call::make(Int(32), Call::register_destructor,
+                   {Expr("halide_profiler_release_slot_as_destructor"), local_slot}, Call::Intrinsic));
+    s = Block::make(release_slot, s);
+    s = LetStmt::make("profiler_local_slot", acquire_slot, s);
 
     s = LetStmt::make("profiler_pipeline_state", get_pipeline_state, s);
     s = LetStmt::make("profiler_state", get_state, s);
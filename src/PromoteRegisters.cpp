@@ -0,0 +1,200 @@
+#include <map>
+
+#include "PromoteRegisters.h"
+#include "ExprUsesVar.h"
+#include "IRMutator.h"
+#include "IROperator.h"
+#include "Simplify.h"
+#include "Substitute.h"
+
+namespace Halide {
+namespace Internal {
+
+using std::map;
+using std::pair;
+using std::string;
+using std::vector;
+
+namespace {
+
+class PromoteRegisters : public IRMutator2 {
+    using IRMutator2::visit;
+
+    // The number of elements of each allocation being promoted.
+    map<string, int> registers;
+
+    // The enclosing lets, innermost last, used to reduce the index of
+    // an access to a constant.
+    vector<pair<string, Expr>> lets;
+
+    bool in_gpu_loop = false;
+
+    static string element_name(const string &name, int i) {
+        return name + ".reg" + std::to_string(i);
+    }
+
+    Stmt visit(const LetStmt *op) override {
+        Expr value = mutate(op->value);
+        lets.push_back({op->name, value});
+        Stmt body = mutate(op->body);
+        lets.pop_back();
+        return LetStmt::make(op->name, value, body);
+    }
+
+    Expr visit(const Let *op) override {
+        Expr value = mutate(op->value);
+        lets.push_back({op->name, value});
+        Expr body = mutate(op->body);
+        lets.pop_back();
+        return Let::make(op->name, value, body);
+    }
+
+    Stmt visit(const For *op) override {
+        ScopedValue<bool> old_in_gpu_loop(in_gpu_loop, in_gpu_loop ||
+                                          op->for_type == ForType::GPUBlock ||
+                                          op->for_type == ForType::GPUThread);
+        return IRMutator2::visit(op);
+    }
+
+    // Reduce an index to a constant, substituting in enclosing lets
+    // if necessary.
+    Expr resolve_index(const string &name, Expr index) {
+        index = simplify(index);
+        for (size_t i = lets.size(); i > 0 && !is_const(index); i--) {
+            const pair<string, Expr> &let = lets[i - 1];
+            if (expr_uses_var(index, let.first)) {
+                index = simplify(substitute(let.first, let.second, index));
+            }
+        }
+        return index;
+    }
+
+    // The element indices accessed by each lane of an access.
+    vector<int> lane_indices(const string &name, Expr index) {
+        Expr original = index;
+        index = resolve_index(name, index);
+
+        int lanes = index.type().lanes();
+        vector<int> result(lanes);
+        static const int64_t zero = 0;
+        const int64_t *base = nullptr, *stride = &zero;
+        if (const Ramp *r = index.as<Ramp>()) {
+            base = as_const_int(r->base);
+            stride = as_const_int(r->stride);
+        } else if (const Broadcast *b = index.as<Broadcast>()) {
+            base = as_const_int(b->value);
+        } else {
+            base = as_const_int(index);
+        }
+        user_assert(base && stride)
+            << "Func " << name << " is stored in registers, but is accessed at the non-constant index "
+            << original << ". All accesses to Funcs stored in registers must be at constant coordinates. "
+            << "Try unrolling the loops over its dimensions, or storing it on the stack instead.\n";
+
+        int size = registers[name];
+        for (int i = 0; i < lanes; i++) {
+            int64_t idx = *base + *stride * i;
+            user_assert(idx >= 0 && idx < size)
+                << "Func " << name << " is stored in registers, but is accessed at index "
+                << idx << ", outside of its allocation of " << size << " elements.\n";
+            result[i] = (int)idx;
+        }
+        return result;
+    }
+
+    Stmt visit(const Allocate *op) override {
+        if (op->memory_type != MemoryType::Register ||
+            in_gpu_loop ||
+            op->new_expr.defined()) {
+            return IRMutator2::visit(op);
+        }
+
+        // BoundSmallAllocations has already made the size constant.
+        int size = op->constant_allocation_size();
+        internal_assert(size > 0) << "Register allocation " << op->name << " with non-constant size\n";
+
+        ScopedValue<map<string, int>> old_registers(registers, registers);
+        registers[op->name] = size;
+        Stmt body = mutate(op->body);
+
+        for (int i = size - 1; i >= 0; i--) {
+            body = Allocate::make(element_name(op->name, i), op->type, MemoryType::Stack,
+                                  {}, op->condition, body);
+        }
+        return body;
+    }
+
+    Stmt visit(const Free *op) override {
+        map<string, int>::const_iterator iter = registers.find(op->name);
+        if (iter == registers.end()) {
+            return op;
+        }
+        vector<Stmt> frees;
+        for (int i = 0; i < iter->second; i++) {
+            frees.push_back(Free::make(element_name(op->name, i)));
+        }
+        return Block::make(frees);
+    }
+
+    Expr visit(const Load *op) override {
+        if (!registers.count(op->name)) {
+            return IRMutator2::visit(op);
+        }
+        user_assert(is_one(op->predicate))
+            << "Func " << op->name << " is stored in registers, but has a predicated load.\n";
+
+        vector<int> indices = lane_indices(op->name, op->index);
+        vector<Expr> lanes;
+        for (int idx : indices) {
+            lanes.push_back(Load::make(op->type.element_of(), element_name(op->name, idx),
+                                       0, Buffer<>(), Parameter(), const_true()));
+        }
+        if (lanes.size() == 1) {
+            return lanes[0];
+        }
+        return Shuffle::make_concat(lanes);
+    }
+
+    Stmt visit(const Store *op) override {
+        if (!registers.count(op->name)) {
+            return IRMutator2::visit(op);
+        }
+        user_assert(is_one(op->predicate))
+            << "Func " << op->name << " is stored in registers, but has a predicated store.\n";
+
+        Expr value = mutate(op->value);
+        vector<int> indices = lane_indices(op->name, op->index);
+        if (indices.size() == 1) {
+            return Store::make(element_name(op->name, indices[0]), value, 0, Parameter(), const_true());
+        }
+
+        // Later lanes win if two lanes store to the same element.
+        string value_name = unique_name('t');
+        Expr value_var = Variable::make(value.type(), value_name);
+        vector<Stmt> stores;
+        for (size_t i = 0; i < indices.size(); i++) {
+            stores.push_back(Store::make(element_name(op->name, indices[i]),
+                                         Shuffle::make_extract_element(value_var, (int)i),
+                                         0, Parameter(), const_true()));
+        }
+        return LetStmt::make(value_name, value, Block::make(stores));
+    }
+
+    Expr visit(const Variable *op) override {
+        user_assert(!registers.count(op->name) &&
+                    !(ends_with(op->name, ".buffer") &&
+                      registers.count(op->name.substr(0, op->name.size() - 7))))
+            << "Func " << op->name << " is stored in registers, but its address is used. "
+            << "Funcs stored in registers may only be accessed with loads and stores at constant coordinates.\n";
+        return op;
+    }
+};
+
+}  // namespace
+
+Stmt promote_registers(const Stmt &s) {
+    return PromoteRegisters().mutate(s);
+}
+
+}  // namespace Internal
+}  // namespace Halide
@@ -0,0 +1,25 @@
+#ifndef HALIDE_PROMOTE_REGISTERS_H
+#define HALIDE_PROMOTE_REGISTERS_H
+
+/** \file
+ * Defines the lowering pass that splits allocations stored in
+ * registers into one scalar per element.
+ */
+
+#include "IR.h"
+
+namespace Halide {
+namespace Internal {
+
+/** Replace each allocation with MemoryType::Register made outside of
+ * a GPU kernel with one single-element allocation per element, and
+ * rewrite its loads and stores to use them. Every access must be at
+ * a constant index (e.g. because the loops over the dimensions of
+ * the Func have been unrolled), which is checked, so that each
+ * element is a scalar that LLVM will promote to a register. */
+Stmt promote_registers(const Stmt &s);
+
+}  // namespace Internal
+}  // namespace Halide
+
+#endif
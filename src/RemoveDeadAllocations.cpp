@@ -51,6 +51,11 @@ class RemoveDeadAllocations : public IRMutator2 {
     }
 
     Stmt visit(const Allocate *op) override {
+        // The new_expr may refer to another allocation (e.g. an
+        // arena the allocation is a view of).
+        if (op->new_expr.defined()) {
+            mutate(op->new_expr);
+        }
         allocs.push(op->name, 1);
         Stmt body = mutate(op->body);
 
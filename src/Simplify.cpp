@@ -6002,9 +6002,128 @@ private:
     }
 };
 
+namespace {
+
+// Loads carry alignment information that IR equality ignores, so
+// Exprs containing them are never shared between call sites.
+class ContainsLoad : public IRGraphVisitor {
+    using IRGraphVisitor::visit;
+    void visit(const Load *op) override {
+        result = true;
+    }
+
+public:
+    bool result = false;
+};
+
+// The results remembered while a SimplifyMemoScope exists. There's
+// one of these per thread.
+struct SimplifyMemo {
+    int depth = 0;
+    IRCompareCache cache;
+    // Indexed by remove_dead_lets. The first maps are a fast path for
+    // Exprs we've seen before by pointer.
+    map<Expr, Expr, ExprCompare> seen[2];
+    map<ExprWithCompareCache, Expr> results[2];
+    int64_t hits = 0, misses = 0;
+
+    // Bound the memory the table can hold on to.
+    static const size_t max_entries = 1 << 16;
+
+    SimplifyMemo() : cache(8) {}
+
+    static Expr simplify_uncached(const Expr &e, bool remove_dead_lets) {
+        return Simplify(remove_dead_lets,
+                        &Scope<Interval>::empty_scope(),
+                        &Scope<ModulusRemainder>::empty_scope()).mutate(e);
+    }
+
+    void clear() {
+        for (int i = 0; i < 2; i++) {
+            seen[i].clear();
+            results[i].clear();
+        }
+        cache.clear();
+    }
+
+    Expr simplify(const Expr &e, bool remove_dead_lets) {
+        const int i = remove_dead_lets ? 1 : 0;
+        auto s = seen[i].find(e);
+        if (s != seen[i].end()) {
+            hits++;
+            return s->second;
+        }
+
+        ContainsLoad loads;
+        e.accept(&loads);
+        if (loads.result) {
+            return simplify_uncached(e, remove_dead_lets);
+        }
+
+        // Simplifying may recurse back in here, so don't hold on to
+        // any iterators across the call.
+        ExprWithCompareCache key(e, &cache);
+        Expr result;
+        auto r = results[i].find(key);
+        if (r != results[i].end()) {
+            hits++;
+            result = r->second;
+        } else {
+            misses++;
+            result = simplify_uncached(e, remove_dead_lets);
+            if (seen[i].size() + results[i].size() >= max_entries) {
+                clear();
+            }
+            results[i].emplace(key, result);
+        }
+        seen[i].emplace(e, result);
+        return result;
+    }
+};
+
+SimplifyMemo &simplify_memo() {
+    thread_local SimplifyMemo memo;
+    return memo;
+}
+
+// Checked per scope rather than once, so that it can be toggled
+// between pipelines (e.g. to benchmark with and without the memo).
+bool simplify_memo_enabled() {
+    return get_env_variable("HL_SIMPLIFY_MEMO") != "0";
+}
+
+}  // namespace
+
+SimplifyMemoScope::SimplifyMemoScope() : enabled(simplify_memo_enabled()) {
+    if (enabled) {
+        simplify_memo().depth++;
+    }
+}
+
+SimplifyMemoScope::~SimplifyMemoScope() {
+    if (!enabled) {
+        return;
+    }
+    SimplifyMemo &memo = simplify_memo();
+    if (--memo.depth == 0) {
+        debug(2) << "Simplifier memo: " << memo.hits << " hits, " << memo.misses << " misses\n";
+        memo.clear();
+        memo.hits = memo.misses = 0;
+    }
+}
+
 Expr simplify(Expr e, bool remove_dead_lets,
               const Scope<Interval> &bounds,
               const Scope<ModulusRemainder> &alignment) {
+    // With no facts about the free variables, the result only
+    // depends on the Expr itself.
+    SimplifyMemo &memo = simplify_memo();
+    if (memo.depth > 0 &&
+        &bounds == &Scope<Interval>::empty_scope() &&
+        &alignment == &Scope<ModulusRemainder>::empty_scope() &&
+        e.defined() && !is_const(e) && !e.as<Variable>()) {
+        return memo.simplify(e, remove_dead_lets);
+    }
     return Simplify(remove_dead_lets, &bounds, &alignment).mutate(e);
 }
 
@@ -29,6 +29,26 @@ Expr simplify(Expr, bool remove_dead_lets = true,
               const Scope<ModulusRemainder> &alignment = Scope<ModulusRemainder>::empty_scope());
 // @}
 
+/** While an object of this type exists, calls to simplify(Expr) on
+ * the current thread that pass no bounds or alignment facts remember
+ * their results, so that structurally equal Exprs are only simplified
+ * once. This pays off for IR with lots of repeated subexpressions,
+ * like that produced by the derivative code or by unrolling. Names
+ * must refer to the same Funcs and Parameters for the lifetime of the
+ * scope, which holds within the lowering of a single pipeline. Scopes
+ * nest; the results are dropped when the outermost one ends. Setting
+ * HL_SIMPLIFY_MEMO=0 in the environment turns this off. */
+class SimplifyMemoScope {
+    bool enabled;
+
+public:
+    SimplifyMemoScope();
+    ~SimplifyMemoScope();
+
+    SimplifyMemoScope(const SimplifyMemoScope &) = delete;
+    SimplifyMemoScope &operator=(const SimplifyMemoScope &) = delete;
+};
+
 /** A common use of the simplifier is to prove boolean expressions are
  * true at compile time. Equivalent to is_one(simplify(e)) */
 bool can_prove(Expr e);
@@ -22,6 +22,9 @@ struct TraceEventBuilder {
     Type type;
     enum halide_trace_event_code_t event;
     Expr parent_id, value_index;
+    // Whether to aggregate the event in the runtime rather than pass
+    // it to halide_trace.
+    bool summary = false;
 
     Expr build() {
         Expr values = Call::make(type_of<void *>(), Call::make_struct,
@@ -42,7 +45,7 @@ struct TraceEventBuilder {
                              (int)event,
                              parent_id, idx, (int)coordinates.size(),
                              trace_tag_expr};
-        return Call::make(Int(32), Call::trace, args, Call::Extern);
+        return Call::make(Int(32), summary ? Call::trace_summary : Call::trace, args, Call::Extern);
     }
 };
 
@@ -56,6 +59,9 @@ public:
     // The funcs that will have any tracing info emitted (not just trace tags),
     // and the Type(s) of their elements.
     map<string, vector<Type>> funcs_touched;
+    // Whether any events are passed to halide_trace, as opposed to
+    // only being summarized.
+    bool traced_events = false;
 
     InjectTracing(const map<string, Function> &e, const Target &t)
         : env(e),
@@ -67,6 +73,29 @@ public:
     }
 
 private:
+    // Wrap a value in a call that summarizes it as a load or store
+    // of the given Func.
+    Expr summarize_value(Expr value, const string &func, const vector<Expr> &coordinates,
+                         enum halide_trace_event_code_t event, int value_index) {
+        string value_var_name = unique_name('t');
+        Expr value_var = Variable::make(value.type(), value_var_name);
+
+        TraceEventBuilder builder;
+        builder.func = func;
+        builder.value = {value_var};
+        builder.coordinates = coordinates;
+        builder.type = value.type();
+        builder.event = event;
+        builder.parent_id = Variable::make(Int(32), func + ".trace_summary_id");
+        builder.value_index = value_index;
+        builder.summary = true;
+        Expr trace = builder.build();
+
+        return Let::make(value_var_name, value,
+                         Call::make(value.type(), Call::return_second,
+                                    {trace, value_var}, Call::PureIntrinsic));
+    }
+
     void add_trace_tags(const string &name, const vector<string> &t) {
         if (!t.empty() && !trace_tags_added.count(name)) {
             trace_tags.push_back({name, t});
@@ -113,6 +142,9 @@ private:
             if (trace_it) {
                 add_trace_tags(op->name, f.get_trace_tags());
             }
+            if (f.is_tracing_summary()) {
+                expr = summarize_value(expr, op->name, op->args, halide_trace_load, op->value_index);
+            }
         } else if (op->call_type == Call::Image) {
             trace_it = trace_all_loads;
             // If there is a Function in the env named "name_im", assume that
@@ -136,6 +168,7 @@ private:
         }
 
         if (trace_it) {
+            traced_events = true;
             add_func_touched(op->name, op->value_index, op->type);
 
             string value_var_name = unique_name('t');
@@ -151,7 +184,7 @@ private:
             builder.value_index = op->value_index;
             Expr trace = builder.build();
 
-            expr = Let::make(value_var_name, op,
+            expr = Let::make(value_var_name, expr,
                              Call::make(op->type, Call::return_second,
                                         {trace, value_var}, Call::PureIntrinsic));
         }
@@ -168,7 +201,8 @@ private:
         Function f = iter->second;
         internal_assert(!f.can_be_inlined() || !f.schedule().compute_level().is_inlined());
 
-        if (f.is_tracing_stores() || trace_all_stores) {
+        bool trace_stores = f.is_tracing_stores() || trace_all_stores;
+        if (trace_stores || f.is_tracing_summary()) {
             // Wrap each expr in a tracing call
 
             const vector<Expr> &values = op->values;
@@ -180,6 +214,14 @@ private:
             builder.event = halide_trace_store;
             builder.parent_id = Variable::make(Int(32), op->name + ".trace_id");
             for (size_t i = 0; i < values.size(); i++) {
+                traces[i] = values[i];
+                if (f.is_tracing_summary()) {
+                    traces[i] = summarize_value(traces[i], f.name(), op->args, halide_trace_store, (int)i);
+                }
+                if (!trace_stores) {
+                    continue;
+                }
+                traced_events = true;
                 Type t = values[i].type();
                 add_func_touched(f.name(), (int) i, t);
                 string value_var_name = unique_name('t');
@@ -190,7 +232,7 @@ private:
                 builder.value = {value_var};
                 Expr trace = builder.build();
 
-                traces[i] = Let::make(value_var_name, values[i],
+                traces[i] = Let::make(value_var_name, traces[i],
                                       Call::make(t, Call::return_second,
                                                  {trace, value_var}, Call::PureIntrinsic));
             }
@@ -225,6 +267,7 @@ private:
         if (iter == env.end()) return stmt;
         Function f = iter->second;
         if (f.is_tracing_realizations() || trace_all_realizations) {
+            traced_events = true;
             add_trace_tags(op->name, f.get_trace_tags());
             for (size_t i = 0; i < op->types.size(); i++) {
                 add_func_touched(op->name, i, op->types[i]);
@@ -254,10 +297,37 @@ private:
             // Warning: 'op' may be invalid at this point
         } else if (f.is_tracing_stores() || f.is_tracing_loads()) {
             // We need a trace id defined to pass to the loads and stores
+            traced_events = true;
             Stmt new_body = op->body;
             new_body = LetStmt::make(op->name + ".trace_id", 0, new_body);
             stmt = Realize::make(op->name, op->types, op->memory_type, op->bounds, op->condition, new_body);
         }
+
+        if (f.is_tracing_summary()) {
+            op = stmt.as<Realize>();
+            internal_assert(op);
+
+            // Start aggregating the loads and stores of this
+            // realization, and print a summary of them at the end.
+            TraceEventBuilder builder;
+            builder.func = op->name;
+            builder.parent_id = 0;
+            builder.event = halide_trace_begin_realization;
+            builder.summary = true;
+            for (size_t i = 0; i < op->bounds.size(); i++) {
+                builder.coordinates.push_back(op->bounds[i].min);
+                builder.coordinates.push_back(op->bounds[i].extent);
+            }
+            Expr call_before = builder.build();
+
+            builder.event = halide_trace_end_realization;
+            builder.parent_id = Variable::make(Int(32), op->name + ".trace_summary_id");
+            Expr call_after = builder.build();
+
+            Stmt new_body = Block::make(op->body, Evaluate::make(call_after));
+            new_body = LetStmt::make(op->name + ".trace_summary_id", call_before, new_body);
+            stmt = Realize::make(op->name, op->types, op->memory_type, op->bounds, op->condition, new_body);
+        }
         return stmt;
     }
 
@@ -324,7 +394,6 @@ public:
 Stmt inject_tracing(Stmt s, const string &pipeline_name,
                     const map<string, Function> &env, const vector<Function> &outputs,
                     const Target &t) {
-    Stmt original = s;
     InjectTracing tracing(env, t);
 
     // Add a dummy realize block for the output buffers
@@ -347,7 +416,7 @@ Stmt inject_tracing(Stmt s, const string &pipeline_name,
     // Strip off the dummy realize blocks
     s = RemoveRealizeOverOutput(outputs).mutate(s);
 
-    if (!s.same_as(original)) {
+    if (tracing.traced_events) {
         // Add pipeline start and end events
         TraceEventBuilder builder;
         builder.func = pipeline_name;
@@ -2,6 +2,7 @@
 #include "Debug.h"
 #include "Error.h"
 #include "Introspection.h"
+#include <algorithm>
 #include <atomic>
 #include <chrono>
 #include <iomanip>
@@ -111,18 +112,47 @@ int unique_count(size_t h) {
     h = h & (num_unique_name_counters - 1);
     return unique_name_counters[h]++;
 }
+
+// The innermost UniqueNameTag on this thread, if any.
+thread_local const std::string *unique_name_tag = nullptr;
+thread_local std::map<std::string, int> *unique_name_tag_counts = nullptr;
+
+// Tagged names have two '$'s, which untagged ones never do (see
+// below), so the two can't collide.
+string tagged_unique_name(const string &sanitized) {
+    int count = (*unique_name_tag_counts)[sanitized]++;
+    return sanitized + "$" + *unique_name_tag + "$" + std::to_string(count);
+}
 }  // namespace
 
-// There are three possible families of names returned by the methods below:
+UniqueNameTag::UniqueNameTag(const std::string &t) :
+    old_tag(unique_name_tag), old_counts(unique_name_tag_counts), tag(t) {
+    std::replace(tag.begin(), tag.end(), '$', '_');
+    unique_name_tag = &tag;
+    unique_name_tag_counts = &counts;
+}
+
+UniqueNameTag::~UniqueNameTag() {
+    unique_name_tag = old_tag;
+    unique_name_tag_counts = old_counts;
+}
+
+// There are four possible families of names returned by the methods below:
 // 1) char pattern: (char that isn't '$') + number (e.g. v234)
 // 2) string pattern: (string without '$') + '$' + number (e.g. fr#nk82$42)
-// 3) a string that does not match the patterns above
+// 3) a string that does not match the patterns above, and has fewer
+//    than two '$'s
+// 4) with a UniqueNameTag: (string without '$') + '$' + tag + '$' + number
+//    (e.g. f$l12$3), where the tag has no '$' and is unique
 // There are no collisions within each family, due to the unique_count
-// done above, and there can be no collisions across families by
-// construction.
+// done above and the per-tag counts, and there can be no collisions
+// across families by construction.
 
 string unique_name(char prefix) {
     if (prefix == '$') prefix = '_';
+    if (unique_name_tag) {
+        return tagged_unique_name(string(1, prefix));
+    }
     return prefix + std::to_string(unique_count((size_t)(prefix)));
 }
 
@@ -156,6 +186,10 @@ string unique_name(const std::string &prefix) {
     matches_string_pattern &= num_dollars == 1;
     matches_char_pattern &= prefix.size() > 1;
 
+    if (unique_name_tag) {
+        return tagged_unique_name(sanitized);
+    }
+
     // Then add a suffix that's globally unique relative to the hash
     // of the sanitized name.
     int count = unique_count(std::hash<std::string>()(sanitized));
@@ -163,7 +197,7 @@ string unique_name(const std::string &prefix) {
         // We can return the name as-is if there's no risk of it
         // looking like something unique_name has ever returned in the
         // past or will ever return in the future.
-        if (!matches_char_pattern && !matches_string_pattern) {
+        if (!matches_char_pattern && !matches_string_pattern && num_dollars < 2) {
             return prefix;
         }
     }
@@ -16,6 +16,7 @@
 #include <cstdint>
 #include <cstring>
 #include <limits>
+#include <map>
 #include <string>
 #include <utility>
 #include <vector>
@@ -135,6 +136,27 @@ std::string unique_name(char prefix);
 std::string unique_name(const std::string &prefix);
 // @}
 
+/** While an object of this type exists, unique_name on the current
+ * thread makes names of the form prefix$tag$N, counting N per thread
+ * instead of using the counters shared by all threads. The names a
+ * piece of work generates then don't depend on what other threads
+ * are doing at the same time, which keeps the output of lowering
+ * done in parallel deterministic. The tag should itself come from
+ * unique_name, so that no other code generates the same names. */
+class UniqueNameTag {
+    const std::string *old_tag;
+    std::map<std::string, int> *old_counts;
+    std::string tag;
+    std::map<std::string, int> counts;
+
+public:
+    UniqueNameTag(const std::string &tag);
+    ~UniqueNameTag();
+
+    UniqueNameTag(const UniqueNameTag &) = delete;
+    UniqueNameTag &operator=(const UniqueNameTag &) = delete;
+};
+
 /** Test if the first string starts with the second string */
 bool starts_with(const std::string &str, const std::string &prefix);
 
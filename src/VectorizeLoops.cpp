@@ -481,11 +481,12 @@ class VectorSubs : public IRMutator2 {
 
         if (!changed) {
             return op;
-        } else if (op->name == Call::trace) {
+        } else if (op->name == Call::trace || op->name == Call::trace_summary) {
             const int64_t *event = as_const_int(op->args[6]);
             internal_assert(event != nullptr);
             if (*event == halide_trace_begin_realization || *event == halide_trace_end_realization) {
-                // Call::trace vectorizes uniquely for begin/end realization, because the coordinates
+                // Call::trace (and Call::trace_summary, which takes the
+                // same arguments) vectorizes uniquely for begin/end realization, because the coordinates
                 // for these are actually min/extent pairs; we need to maintain the proper dimensionality
                 // count and instead aggregate the widened values into a single pair.
                 for (size_t i = 1; i <= 2; i++) {
@@ -540,7 +541,7 @@ class VectorSubs : public IRMutator2 {
                     new_args[9] = new_args[9] * max_lanes;
                 }
             }
-            return Call::make(op->type, Call::trace, new_args, op->call_type);
+            return Call::make(op->type, op->name, new_args, op->call_type);
         } else {
             // Widen the args to have the same lanes as the max lanes found
             for (size_t i = 0; i < new_args.size(); i++) {
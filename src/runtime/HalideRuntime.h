@@ -177,6 +177,77 @@ extern void halide_join_thread(struct halide_thread *);
  */
 extern int halide_set_num_threads(int n);
 
+/** Counters accumulated by one thread of the default thread pool when
+ * thread pool instrumentation is enabled. All times are in
+ * nanoseconds. */
+struct halide_thread_pool_worker_stats {
+    /** Time spent inside tasks. */
+    uint64_t task_time;
+
+    /** Time spent waiting to acquire the work queue lock. */
+    uint64_t lock_wait_time;
+
+    /** Time spent asleep waiting for work or for a job to complete. */
+    uint64_t sleep_time;
+
+    /** The number of tasks this thread claimed from the work queue. */
+    uint64_t tasks_claimed;
+
+    /** The number of times this thread was woken from sleep. */
+    uint64_t wakeups;
+};
+
+/** Pool-wide counters accumulated by the default thread pool when
+ * thread pool instrumentation is enabled. All times are in
+ * nanoseconds. */
+struct halide_thread_pool_stats {
+    /** The number of parallel jobs (calls to halide_do_par_for) run. */
+    uint64_t jobs;
+
+    /** Sum over all jobs of the time from the job being enqueued to
+     * its last task completing. */
+    uint64_t job_time;
+
+    /** Sum over all jobs of the time spent inside their tasks. Divide
+     * by job_time to get the average parallelism achieved. */
+    uint64_t job_task_time;
+
+    /** The number of tasks run across all jobs. */
+    uint64_t tasks;
+
+    /** Sum over all jobs of the depth of the job stack at the time
+     * the job was enqueued, and the largest depth seen. Large values
+     * indicate deeply nested parallelism. */
+    uint64_t queue_depth_total;
+    uint64_t queue_depth_peak;
+
+    /** The number of worker threads with an entry in the per-worker
+     * stats. */
+    int num_workers;
+
+    /** Totals for the threads that called halide_do_par_for and
+     * worked on their own jobs while waiting for them to complete. */
+    struct halide_thread_pool_worker_stats owners;
+};
+
+/** Enable or disable thread pool instrumentation in the default
+ * thread pool. Instrumentation is off by default and may also be
+ * turned on by setting the environment variable HL_THREAD_POOL_STATS
+ * to 1 before the thread pool starts up. Returns the previous
+ * setting. */
+extern bool halide_thread_pool_enable_stats(bool enable);
+
+/** Copy out the thread pool counters accumulated since the last
+ * reset. If per_worker is non-NULL, up to max_workers per-worker
+ * entries are copied into it. Returns the number of worker entries
+ * available, which may exceed max_workers. */
+extern int halide_thread_pool_get_stats(struct halide_thread_pool_stats *stats,
+                                        struct halide_thread_pool_worker_stats *per_worker,
+                                        int max_workers);
+
+/** Zero all thread pool counters. */
+extern void halide_thread_pool_reset_stats();
+
 /** Halide calls these functions to allocate and free memory. To
  * replace in AOT code, use the halide_set_custom_malloc and
  * halide_set_custom_free, or (on platforms that support weak
@@ -205,6 +276,55 @@ extern halide_malloc_t halide_set_custom_malloc(halide_malloc_t user_malloc);
 extern halide_free_t halide_set_custom_free(halide_free_t user_free);
 //@}
 
+/** The default allocator can keep freed blocks, rounded up to one of
+ * a set of size classes, and reuse them for later allocations, so
+ * that pipelines called repeatedly don't return their scratch memory
+ * to the system between calls. Pooling is off unless a limit on the
+ * number of bytes held in free blocks is set, either with
+ * halide_malloc_pool_set_limit or the HL_MALLOC_POOL_LIMIT
+ * environment variable. Custom allocators bypass the pool. */
+struct halide_malloc_pool_stats {
+    /** The current limit on cached bytes. Zero if pooling is off. */
+    int64_t limit;
+    /** The number of bytes held in free blocks. */
+    int64_t cached_bytes;
+    /** Allocations served from, and not from, a free block. */
+    uint64_t hits, misses;
+};
+
+/** Set the most bytes that may be held in free blocks. Zero turns
+ * pooling off. If the pool holds more than the new limit, it is
+ * trimmed. */
+extern void halide_malloc_pool_set_limit(void *user_context, int64_t max_cached_bytes);
+
+/** Return all free blocks held by the pool to the system. */
+extern void halide_malloc_pool_trim(void *user_context);
+
+/** Copy out the pool's current limit and counters. */
+extern void halide_malloc_pool_get_stats(void *user_context, struct halide_malloc_pool_stats *stats);
+
+/** Where the pages of a huge page allocation are first touched, and
+ * so which NUMA node the kernel places them on. */
+typedef enum halide_huge_page_placement_t {
+    /** Pages are placed by whichever thread first writes to them. */
+    halide_huge_page_placement_first_touch = 0,
+    /** Pages are faulted in by the allocating thread when the
+     * allocation is made, so the pipeline doesn't take page faults
+     * later. */
+    halide_huge_page_placement_prefault = 1,
+} halide_huge_page_placement_t;
+
+/** Make the default allocator map allocations of at least threshold
+ * bytes directly from the kernel, aligned to and advised to use
+ * transparent huge pages. This reduces TLB misses when walking large
+ * intermediates. A threshold of zero turns this off, which is the
+ * default unless the HL_HUGE_PAGE_THRESHOLD (and optionally
+ * HL_HUGE_PAGE_PLACEMENT) environment variables are set. Huge page
+ * allocations are never pooled. Only supported on
+ * Linux; elsewhere a non-zero threshold is an error. */
+extern int halide_set_huge_page_policy(void *user_context, int64_t threshold,
+                                       halide_huge_page_placement_t placement);
+
 /** Halide calls these functions to interact with the underlying
  * system runtime functions. To replace in AOT code on platforms that
  * support weak linking, define these functions yourself, or use
@@ -383,7 +503,24 @@ struct halide_trace_event_t {
  * HL_TRACE_FILE is defined, dumps the trace to that file in a
  * sequence of trace packets. The header for a trace packet is defined
  * below. If the trace is going to be large, you may want to make the
- * file a named pipe, and then read from that pipe into gzip.
+ * file a named pipe, and then read from that pipe into gzip. If the
+ * environment variable HL_TRACE_FORMAT is also set to "chrome", it
+ * instead writes the begin and end of each pipeline, realization,
+ * production and consumption, with a timestamp and the thread it
+ * happened on, as Chrome trace-event JSON. Load in chrome://tracing or
+ * Perfetto to see a timeline of the work done by each thread. Loads
+ * and stores are not written in this format.
+ *
+ * When writing to a file, each thread buffers its loads and stores
+ * separately, and the buffers are written out when full. Other events
+ * are written out as they happen, after any loads and stores they
+ * end, so an event always comes after its parent and before its
+ * parent's end. To make tracing of loads and stores on large inputs
+ * practical, set HL_TRACE_SAMPLE to N to keep only every Nth load and
+ * store on each thread. A Func can be given its own rate with a trace
+ * tag of the form "halide_trace_sample: N" (see Func::add_trace_tag),
+ * where zero drops all of its loads and stores. Other events are
+ * always kept.
  *
  * halide_trace returns a unique ID which will be passed to future
  * events that "belong" to the earlier event as the parent id. The
@@ -420,10 +557,10 @@ typedef int32_t (*halide_trace_t)(void *user_context, const struct halide_trace_
 extern halide_trace_t halide_set_custom_trace(halide_trace_t trace);
 // @}
 
-/** The header of a packet in a binary trace. All fields are 32-bit. */
+/** The header of a packet in a binary trace. */
 struct halide_trace_packet_t {
     /** The total size of this packet in bytes. Always a multiple of
-     * four. Equivalently, the number of bytes until the next
+     * eight. Equivalently, the number of bytes until the next
      * packet. */
     uint32_t size;
 
@@ -439,6 +576,16 @@ struct halide_trace_packet_t {
     int32_t dimensions;
     // @}
 
+    /** The thread that emitted this event, numbered from zero in the
+     * order threads first emit events. Each thread's loads and stores
+     * are buffered separately, so loads and stores from different
+     * threads are not in the order they happened. */
+    int32_t thread;
+
+    /** When this event happened, in nanoseconds since the trace file
+     * was opened. */
+    uint64_t time;
+
     #ifdef __cplusplus
     // If we don't explicitly mark the default ctor as inline,
     // certain build configurations can fail (notably iOS)
@@ -706,6 +853,44 @@ extern int halide_get_gpu_device(void *user_context);
  */
 extern void halide_memoization_cache_set_size(void *user_context, int64_t size);
 
+/** Policies the default memoization cache can use to choose which
+ * entries to evict once it exceeds its size. */
+enum halide_memoization_cache_eviction_policy_t {
+    /** Evict the least recently used entry. The default. */
+    halide_memoization_cache_evict_lru = 0,
+
+    /** Weigh the measured time taken to compute each entry against
+     * the bytes it occupies, evicting cheap-to-recompute bytes first
+     * while still aging out entries that are no longer used
+     * (GreedyDual-Size). */
+    halide_memoization_cache_evict_cost_aware = 1,
+};
+
+/** Select the eviction policy used by the memoization cache. Entries
+ * already in the cache are reprioritized under the new policy. Returns
+ * zero on success, or an error code if the policy is unknown. */
+extern int halide_memoization_cache_set_eviction_policy(void *user_context, int policy);
+
+/** Back the default memoization cache with a memory-mapped file, so
+ * that memoized results survive the process exiting. Results the
+ * in-memory cache misses on are looked for in the file before being
+ * computed, and every result stored in the cache is also written to
+ * the file. The fingerprint identifies the pipelines the results
+ * came from; only records written with the same fingerprint are used,
+ * so it must be changed whenever the code of the pipelines
+ * changes. The size is the size of the file in bytes, or zero to keep
+ * the size of an existing file (or use 64MB for a new one). When the
+ * file is full, records are evicted under the cache's eviction
+ * policy. The file is locked for the exclusive use of this process
+ * while attached. Passing a NULL path detaches the current file.
+ * Records that fail their checksum when the file is attached, such
+ * as those left by a process that died while writing, discard the
+ * file's contents. Returns zero on success, or an error code. On
+ * 32-bit targets the file is limited to 2GB. Only supported on
+ * Linux, OS X and Android. */
+extern int halide_memoization_cache_set_persistent_file(void *user_context, const char *path,
+                                                        uint64_t fingerprint, int64_t size);
+
 /** Given a cache key for a memoized result, currently constructed
  *  from the Func name and top-level Func name plus the arguments of
  *  the computation, determine if the result is in the cache and
@@ -768,6 +953,55 @@ extern void halide_memoization_cache_release(void *user_context, void *host);
  */
 extern void halide_memoization_cache_cleanup(void *user_context);
 
+/** Counters kept by the default memoization cache for one memoized
+ * Func. Entries are shared by all pipelines that memoize the same Func
+ * with the same parameters, so these are not split by pipeline. */
+struct halide_memoization_cache_func_stats {
+    /** The name of the memoized Func. Owned by the cache, and valid
+     * until halide_memoization_cache_cleanup is called. */
+    const char *name;
+
+    /** Calls to halide_memoization_cache_lookup, and how many of them
+     * hit or missed. */
+    uint64_t lookups, hits, misses;
+
+    /** New entries stored, and entries evicted to stay within the
+     * cache size. */
+    uint64_t stores, evictions;
+
+    /** Bytes of results currently held in the cache, and the largest
+     * that has been since the last reset. */
+    uint64_t bytes, peak_bytes;
+};
+
+/** Counters for the default memoization cache as a whole. */
+struct halide_memoization_cache_stats {
+    uint64_t lookups, hits, misses;
+    uint64_t stores, evictions;
+    uint64_t bytes, peak_bytes;
+
+    /** The number of entries in the cache, and how many of those are
+     * pinned because a pipeline is still using them. */
+    uint64_t entries, entries_in_use;
+
+    /** The number of memoized Funcs with per-Func counters. */
+    int num_funcs;
+};
+
+/** Get the counters accumulated by the default memoization cache
+ * since the last reset. The counters are always maintained and are
+ * cheap to keep. If per_func is non-NULL, up to max_funcs per-Func
+ * entries are copied into it. Returns the number of per-Func entries
+ * available, which may exceed max_funcs. */
+extern int halide_memoization_cache_get_stats(void *user_context,
+                                              struct halide_memoization_cache_stats *stats,
+                                              struct halide_memoization_cache_func_stats *per_func,
+                                              int max_funcs);
+
+/** Zero the memoization cache counters. Byte counts are kept, and the
+ * peaks are reset to the current values. */
+extern void halide_memoization_cache_reset_stats(void *user_context);
+
 /** Create a unique file with a name of the form prefixXXXXXsuffix in an arbitrary
  * (but writable) directory; this is typically $TMP or /tmp, but the specific
  * location is not guaranteed. (Note that the exact form of the file name
@@ -1138,7 +1372,8 @@ typedef enum halide_target_feature_t {
     halide_target_feature_asan = 53, ///< Enable hooks for ASAN support.
     halide_target_feature_d3d12compute = 54, ///< Enable Direct3D 12 Compute runtime.
     halide_target_feature_check_unsafe_promises = 55, ///< Insert assertions for promises.
-    halide_target_feature_end = 56 ///< A sentinel. Every target is considered to have this feature, and setting this feature does nothing.
+    halide_target_feature_plan_memory = 56, ///< Pack heap allocations with disjoint lifetimes into a single arena.
+    halide_target_feature_end = 57 ///< A sentinel. Every target is considered to have this feature, and setting this feature does nothing.
 } halide_target_feature_t;
 
 /** This function is called internally by Halide in some situations to determine
@@ -1501,9 +1736,16 @@ struct halide_profiler_func_stats {
     /** The peak stack allocation of this Func's threads. */
     uint64_t stack_peak;
 
-    /** The average number of thread pool worker threads active while computing this Func. */
+    /** The average number of threads computing this Func, over the
+     * samples in which at least one thread was. Divide by the state's
+     * num_threads to get the Func's parallel efficiency. */
     uint64_t active_threads_numerator, active_threads_denominator;
 
+    /** Hardware counter totals for this Func: cycles, instructions,
+     * last-level cache misses and branch mispredictions. Zero unless
+     * counters are enabled with halide_profiler_enable_counters. */
+    uint64_t cycles, instructions, cache_misses, branch_misses;
+
     /** The name of this Func. A global constant string. */
     const char *name;
 
@@ -1530,6 +1772,9 @@ struct halide_profiler_pipeline_stats {
      * work while computing this pipeline. */
     uint64_t active_threads_numerator, active_threads_denominator;
 
+    /** Hardware counter totals for funcs in this pipeline. */
+    uint64_t cycles, instructions, cache_misses, branch_misses;
+
     /** The name of this pipeline. A global constant string. */
     const char *name;
 
@@ -1556,6 +1801,17 @@ struct halide_profiler_pipeline_stats {
     int num_allocs;
 };
 
+/** The most threads the sampling profiler tracks separately. Any
+ * further threads share the current_func field below. */
+enum { halide_profiler_max_threads = 256 };
+
+/** A per-thread profiler slot. Each is padded out to a cache line of
+ * its own, so that threads switching Funcs don't contend for one. */
+struct halide_profiler_thread_slot {
+    int func;
+    int padding[15];
+};
+
 /** The global state of the profiler. */
 
 struct halide_profiler_state {
@@ -1571,11 +1827,13 @@ struct halide_profiler_state {
     /** An internal id used for bookkeeping. */
     int first_free_id;
 
-    /** The id of the current running Func. Set by the pipeline, read
-     * periodically by the profiler thread. */
+    /** The id of the current running Func on threads that could not
+     * claim one of the per-thread slots below. Set by the pipeline,
+     * read periodically by the profiler thread. */
     int current_func;
 
-    /** The number of threads currently doing work. */
+    /** The number of threads currently doing work on a remote
+     * target. On the host this is counted from the slots below. */
     int active_threads;
 
     /** A linked list of stats gathered for each pipeline. */
@@ -1588,6 +1846,21 @@ struct halide_profiler_state {
 
     /** Sampling thread reference to be joined at shutdown. */
     struct halide_thread *sampling_thread;
+
+    /** The number of threads available to run Halide code, used to
+     * report the parallel efficiency of each Func. */
+    int num_threads;
+
+    /** The id of the Func each thread running Halide code is in. A
+     * thread claims a slot when it starts running a pipeline or a
+     * task of a parallel loop, and frees it when it's done. Each
+     * sample bills every Func that some thread is in. Free slots hold
+     * halide_profiler_outside_of_halide. */
+    struct halide_profiler_thread_slot thread_funcs[halide_profiler_max_threads];
+
+    /** Whether the profiler thread reads the hardware performance
+     * counters of each thread along with each sample. */
+    int counters_enabled;
 };
 
 /** Profiler func ids with special meanings. */
@@ -1597,7 +1870,11 @@ enum {
     /// Set current_func to this value to tell the profiling thread to
     /// halt. It will start up again next time you run a pipeline with
     /// profiling enabled.
-    halide_profiler_please_stop = -2
+    halide_profiler_please_stop = -2,
+    /// A thread's slot takes this value while the thread waits for a
+    /// parallel loop it launched. The loop's tasks, including those
+    /// it runs itself, are billed through slots of their own.
+    halide_profiler_waiting = -3
 };
 
 /** Get a pointer to the global profiler state for programmatic
@@ -1627,6 +1904,16 @@ void halide_profiler_shutdown();
  * reset. Also happens at process exit. */
 extern void halide_profiler_report(void *user_context);
 
+/** Turn sampling of per-thread hardware performance counters on or
+ * off. Each sample attributes the counter deltas of each thread to the
+ * Func it is in, and halide_profiler_report prints them. Counters may
+ * also be turned on by setting the environment variable
+ * HL_PROFILER_COUNTERS to 1 before the first profiled pipeline runs.
+ * Only supported on x86 Linux, where threads that cannot open
+ * counters (e.g. due to /proc/sys/kernel/perf_event_paranoid) are not
+ * counted; elsewhere enabling counters is an error. */
+extern int halide_profiler_enable_counters(void *user_context, bool enable);
+
 /// \name "Float16" functions
 /// These functions operate of bits (``uint16_t``) representing a half
 /// precision floating point number (IEEE-754 2008 binary16).
@@ -65,6 +65,8 @@ WEAK bool buffer_has_shape(const halide_buffer_t *buf, const halide_dimension_t
     return true;
 }
 
+struct FuncStats;
+
 struct CacheEntry {
     CacheEntry *next;
     CacheEntry *more_recent;
@@ -74,6 +76,16 @@ struct CacheEntry {
     uint8_t *key;
     uint32_t hash;
     uint32_t in_use_count; // 0 if none returned from halide_cache_lookup
+    // Time taken to compute the stored data, in nanoseconds.
+    uint64_t compute_time;
+    // Total bytes of host storage held by the tuple buffers.
+    uint64_t bytes;
+    // Entries with the lowest priority are evicted first. Under the
+    // LRU policy this is the global use clock the last time the entry
+    // was stored or looked up, which orders entries across shards.
+    uint64_t priority;
+    // Counters for the memoized Func this entry belongs to.
+    FuncStats *func_stats;
     uint32_t tuple_count;
     // The shape of the computed data. There may be more data allocated than this.
     int32_t dimensions;
@@ -82,7 +94,7 @@ struct CacheEntry {
     halide_buffer_t *buf;
 
     bool init(const uint8_t *cache_key, size_t cache_key_size,
-              uint32_t key_hash,
+              uint32_t key_hash, uint64_t compute_ns,
               const halide_buffer_t *computed_bounds_buf,
               int32_t tuples, halide_buffer_t **tuple_buffers);
     void destroy(void *user_context);
@@ -93,6 +105,11 @@ struct CacheEntry {
 struct CacheBlockHeader {
     CacheEntry *entry;
     uint32_t hash;
+    // When the cache miss that allocated this block happened. Used to
+    // measure how long the memoized Func took to compute.
+    int64_t miss_time;
+    // Counters for the memoized Func that missed.
+    FuncStats *func_stats;
 };
 
 // Each host block has extra space to store a header just before the
@@ -111,7 +128,8 @@ WEAK CacheBlockHeader *get_pointer_to_header(uint8_t * host) {
 }
 
 WEAK bool CacheEntry::init(const uint8_t *cache_key, size_t cache_key_size,
-                           uint32_t key_hash, const halide_buffer_t *computed_bounds_buf,
+                           uint32_t key_hash, uint64_t compute_ns,
+                           const halide_buffer_t *computed_bounds_buf,
                            int32_t tuples, halide_buffer_t **tuple_buffers) {
     next = NULL;
     more_recent = NULL;
@@ -119,6 +137,10 @@ WEAK bool CacheEntry::init(const uint8_t *cache_key, size_t cache_key_size,
     key_size = cache_key_size;
     hash = key_hash;
     in_use_count = 0;
+    compute_time = compute_ns;
+    bytes = 0;
+    priority = 0;
+    func_stats = NULL;
     tuple_count = tuples;
     dimensions = computed_bounds_buf->dimensions;
 
@@ -165,6 +187,7 @@ WEAK bool CacheEntry::init(const uint8_t *cache_key, size_t cache_key_size,
         for (int j = 0; j < dimensions; j++) {
             buf[i].dim[j] = tuple_buffers[i]->dim[j];
         }
+        bytes += buf[i].size_in_bytes();
     }
     return true;
 }
@@ -177,57 +200,252 @@ WEAK void CacheEntry::destroy(void *user_context) {
     halide_free(user_context, metadata_storage);
 }
 
-WEAK uint32_t djb_hash(const uint8_t *key, size_t key_size)  {
-    uint32_t h = 5381;
-    for (size_t i = 0; i < key_size; i++) {
-        h = (h << 5) + h + key[i];
+WEAK __attribute__((always_inline)) uint64_t hash_mix(uint64_t h, uint64_t k) {
+    const uint64_t m = UINT64_C(0xc6a4a7935bd1e995);
+    k *= m;
+    k ^= k >> 47;
+    k *= m;
+    h ^= k;
+    h *= m;
+    return h;
+}
+
+// A word-at-a-time hash in the style of MurmurHash64A. Keys are
+// mostly made of 32- and 64-bit scalar parameter values, so consuming
+// eight bytes per step is much faster than hashing a byte at a
+// time. The shape of the computed region is folded in too, so that
+// entries which share a key but cover different regions (e.g. Funcs
+// memoized inside a loop) spread out across shards and buckets.
+WEAK __attribute__((always_inline)) uint64_t hash_bytes(const uint8_t *key, size_t key_size) {
+    uint64_t h = UINT64_C(0x9e3779b97f4a7c15) ^ key_size;
+    size_t words = key_size / sizeof(uint64_t);
+    for (size_t i = 0; i < words; i++) {
+        uint64_t k;
+        memcpy(&k, key + i * sizeof(uint64_t), sizeof(uint64_t));
+        h = hash_mix(h, k);
+    }
+    size_t tail = key_size - words * sizeof(uint64_t);
+    if (tail) {
+        uint64_t k = 0;
+        memcpy(&k, key + words * sizeof(uint64_t), tail);
+        h = hash_mix(h, k);
     }
     return h;
 }
 
-WEAK halide_mutex memoization_lock = { { 0 } };
+WEAK __attribute__((always_inline)) uint32_t hash_finish(uint64_t h) {
+    h ^= h >> 47;
+    h *= UINT64_C(0xc6a4a7935bd1e995);
+    h ^= h >> 47;
+    return (uint32_t)(h ^ (h >> 32));
+}
+
+WEAK uint32_t hash_key(const uint8_t *key, size_t key_size,
+                       const halide_buffer_t *computed_bounds) {
+    uint64_t h = hash_bytes(key, key_size);
+    for (int i = 0; i < computed_bounds->dimensions; i++) {
+        const halide_dimension_t &d = computed_bounds->dim[i];
+        h = hash_mix(h, ((uint64_t)(uint32_t)d.min << 32) | (uint32_t)d.extent);
+    }
+    return hash_finish(h);
+}
+
+template <typename T>
+__attribute__((always_inline)) void atomic_max(T *ptr, T val) {
+    T old_val = *ptr;
+    while (val > old_val) {
+        T temp = old_val;
+        old_val = __sync_val_compare_and_swap(ptr, old_val, val);
+        if (temp == old_val) {
+            return;
+        }
+    }
+}
 
+// Counts of cache operations, kept per shard and only updated with
+// the shard locked.
+struct ShardCounters {
+    uint64_t lookups, hits, misses, stores, evictions;
+};
+
+// The cache is split into shards, selected by the top bits of the
+// hash, each with its own lock, hash table and LRU chain. This lets
+// lookups from many threads proceed in parallel. The size budget is
+// shared by all shards, and pruning evicts the globally least
+// recently used entries using the use clock stamped on each entry.
 const size_t kHashTableSize = 256;
+const size_t kNumShardsLog2 = 4;
+const size_t kNumShards = 1 << kNumShardsLog2;
+
+// Per-Func counters. Cache keys generated by Memoization.cpp start
+// with the length of the memoized Func's name, followed by the name
+// packed four characters to a 32-bit word, so that prefix of the key
+// identifies the Func. The records live in an open-addressed table
+// that is only ever added to, using compare-and-swap, so finding the
+// record for a Func takes no locks. One Func's entries may be spread
+// across shards, so the operation counts are kept per shard and only
+// updated with that shard locked, which keeps threads hitting the
+// same Func from contending on one cache line. The byte counts only
+// change on stores and evictions, and are updated atomically.
+struct FuncStats {
+    halide_memoization_cache_func_stats stats;
+    uint32_t hash;
+    size_t prefix_size;
+    const uint8_t *prefix;
+    ShardCounters counters[kNumShards];
+};
+
+const size_t kFuncStatsTableSize = 1024;
 
-WEAK CacheEntry *cache_entries[kHashTableSize];
+WEAK FuncStats *func_stats_table[kFuncStatsTableSize];
 
-WEAK CacheEntry *most_recently_used = NULL;
-WEAK CacheEntry *least_recently_used = NULL;
+// Used for keys that don't start with a Func name, or if the table
+// fills up.
+WEAK FuncStats other_func_stats = {{"<other>", 0, 0, 0, 0, 0, 0, 0}, 0, 0, NULL};
+
+WEAK size_t func_key_prefix_size(const uint8_t *key, size_t key_size) {
+    uint32_t name_size;
+    if (key_size < sizeof(name_size)) {
+        return 0;
+    }
+    memcpy(&name_size, key, sizeof(name_size));
+    size_t prefix_size = sizeof(name_size) + ((name_size + 3) & ~3);
+    return (name_size == 0 || prefix_size > key_size) ? 0 : prefix_size;
+}
+
+WEAK FuncStats *new_func_stats(const uint8_t *prefix, size_t prefix_size, uint32_t h) {
+    uint32_t name_size;
+    memcpy(&name_size, prefix, sizeof(name_size));
+
+    FuncStats *f = (FuncStats *)malloc(sizeof(FuncStats) + prefix_size + name_size + 1);
+    if (!f) {
+        return NULL;
+    }
+    memset(&f->stats, 0, sizeof(f->stats));
+    memset(f->counters, 0, sizeof(f->counters));
+    f->hash = h;
+    f->prefix_size = prefix_size;
+    uint8_t *prefix_copy = (uint8_t *)(f + 1);
+    memcpy(prefix_copy, prefix, prefix_size);
+    f->prefix = prefix_copy;
+
+    // Unpack the name. Each word holds up to four characters, the
+    // first in the most significant position used.
+    char *name = (char *)(prefix_copy + prefix_size);
+    for (uint32_t i = 0; i < name_size; i += 4) {
+        uint32_t word;
+        memcpy(&word, prefix + sizeof(name_size) + i, sizeof(word));
+        uint32_t chars = min(name_size - i, (uint32_t)4);
+        for (uint32_t j = 0; j < chars; j++) {
+            name[i + j] = (char)(word >> (8 * (chars - 1 - j)));
+        }
+    }
+    name[name_size] = 0;
+    f->stats.name = name;
+    return f;
+}
+
+WEAK FuncStats *find_func_stats(const uint8_t *key, size_t key_size) {
+    size_t prefix_size = func_key_prefix_size(key, key_size);
+    if (!prefix_size) {
+        return &other_func_stats;
+    }
+    uint32_t h = hash_finish(hash_bytes(key, prefix_size));
+    for (size_t probe = 0; probe < kFuncStatsTableSize; probe++) {
+        FuncStats **slot = &func_stats_table[(h + probe) % kFuncStatsTableSize];
+        FuncStats *f = *slot;
+        if (f == NULL) {
+            FuncStats *new_f = new_func_stats(key, prefix_size, h);
+            if (!new_f) {
+                return &other_func_stats;
+            }
+            f = __sync_val_compare_and_swap(slot, (FuncStats *)NULL, new_f);
+            if (f == NULL) {
+                return new_f;
+            }
+            // Someone else claimed the slot first.
+            free(new_f);
+        }
+        if (f->hash == h && f->prefix_size == prefix_size &&
+            keys_equal(f->prefix, key, prefix_size)) {
+            return f;
+        }
+    }
+    return &other_func_stats;
+}
+
+struct CacheShard {
+    halide_mutex lock;
+    CacheEntry *entries[kHashTableSize];
+    CacheEntry *most_recently_used;
+    CacheEntry *least_recently_used;
+    ShardCounters counters;
+};
+
+WEAK CacheShard cache_shards[kNumShards];
+
+WEAK __attribute__((always_inline)) CacheShard &shard_for_hash(uint32_t h) {
+    return cache_shards[h >> (32 - kNumShardsLog2)];
+}
+
+// A Func's counters for operations on the given shard. Must be called
+// with the shard locked.
+WEAK __attribute__((always_inline)) ShardCounters &func_counters(FuncStats *f, const CacheShard &shard) {
+    return f->counters[&shard - cache_shards];
+}
+
+// Serializes pruning. Never acquired while holding a shard lock.
+WEAK halide_mutex prune_lock = { { 0 } };
+
+WEAK uint64_t cache_clock = 0;
+
+WEAK int eviction_policy = halide_memoization_cache_evict_lru;
+
+// The GreedyDual-Size inflation value: the priority of the last entry
+// evicted under the cost-aware policy. Only written under prune_lock.
+WEAK uint64_t cost_inflation = 0;
 
 // HACK for siggraph paper: default cache size is huge so we don't have to think about it
 const uint64_t kDefaultCacheSize = 1LL << 32LL;
 WEAK int64_t max_cache_size = kDefaultCacheSize;
+// Updated atomically, as stores to different shards may race.
 WEAK int64_t current_cache_size = 0;
+WEAK int64_t peak_cache_size = 0;
 
 #if CACHE_DEBUGGING
-WEAK void validate_cache() {
-    print(NULL) << "validating cache, "
+// Must be called with the shard locked.
+WEAK void validate_cache(const CacheShard &shard) {
+    print(NULL) << "validating cache shard " << (int)(&shard - cache_shards) << ", "
                 << "current size " << current_cache_size
                 << " of maximum " << max_cache_size << "\n";
     int entries_in_hash_table = 0;
     for (size_t i = 0; i < kHashTableSize; i++) {
-        CacheEntry *entry = cache_entries[i];
+        CacheEntry *entry = shard.entries[i];
         while (entry != NULL) {
             entries_in_hash_table++;
-            if (entry->more_recent == NULL && entry != most_recently_used) {
+            if (entry->more_recent == NULL && entry != shard.most_recently_used) {
                 halide_print(NULL, "cache invalid case 1\n");
                 __builtin_trap();
             }
-            if (entry->less_recent == NULL && entry != least_recently_used) {
+            if (entry->less_recent == NULL && entry != shard.least_recently_used) {
                 halide_print(NULL, "cache invalid case 2\n");
                 __builtin_trap();
             }
+            if (&shard_for_hash(entry->hash) != &shard) {
+                halide_print(NULL, "cache entry in wrong shard\n");
+                __builtin_trap();
+            }
             entry = entry->next;
         }
     }
     int entries_from_mru = 0;
-    CacheEntry *mru_chain = most_recently_used;
+    CacheEntry *mru_chain = shard.most_recently_used;
     while (mru_chain != NULL) {
         entries_from_mru++;
         mru_chain = mru_chain->less_recent;
     }
     int entries_from_lru = 0;
-    CacheEntry *lru_chain = least_recently_used;
+    CacheEntry *lru_chain = shard.least_recently_used;
     while (lru_chain != NULL) {
         entries_from_lru++;
         lru_chain = lru_chain->more_recent;
@@ -250,61 +468,636 @@ WEAK void validate_cache() {
 }
 #endif
 
+// Under the cost-aware policy, an entry's priority is its recompute
+// cost per byte plus the inflation value at the time of its last use
+// (GreedyDual-Size). Expensive, small entries are kept longest, and
+// the inflation ages out entries that are no longer used.
+WEAK uint64_t entry_priority(const CacheEntry *entry) {
+    if (eviction_policy == halide_memoization_cache_evict_cost_aware) {
+        // Fixed point, in units of 1/1024 nanoseconds per byte.
+        return cost_inflation + (entry->compute_time << 10) / max(entry->bytes, (uint64_t)1);
+    } else {
+        return __sync_add_and_fetch(&cache_clock, 1);
+    }
+}
+
+// Must be called with the shard locked.
+WEAK void touch_entry(CacheShard &shard, CacheEntry *entry) {
+    entry->priority = entry_priority(entry);
+    if (entry == shard.most_recently_used) {
+        return;
+    }
+    // Unlink from the LRU chain, if the entry is already on it.
+    if (entry->more_recent != NULL) {
+        entry->more_recent->less_recent = entry->less_recent;
+    }
+    if (entry->less_recent != NULL) {
+        entry->less_recent->more_recent = entry->more_recent;
+    } else if (shard.least_recently_used == entry) {
+        shard.least_recently_used = entry->more_recent;
+    }
+    // Make it the most recent.
+    entry->more_recent = NULL;
+    entry->less_recent = shard.most_recently_used;
+    if (shard.most_recently_used != NULL) {
+        shard.most_recently_used->more_recent = entry;
+    }
+    shard.most_recently_used = entry;
+    if (shard.least_recently_used == NULL) {
+        shard.least_recently_used = entry;
+    }
+}
+
+// Returns the entry in the shard with the lowest priority that is not
+// in use, or NULL. Must be called with the shard locked.
+WEAK CacheEntry *eviction_candidate(const CacheShard &shard) {
+    CacheEntry *entry = shard.least_recently_used;
+    if (eviction_policy == halide_memoization_cache_evict_lru) {
+        // Priorities increase along the LRU chain.
+        while (entry != NULL && entry->in_use_count != 0) {
+            entry = entry->more_recent;
+        }
+        return entry;
+    }
+    CacheEntry *best = NULL;
+    for (; entry != NULL; entry = entry->more_recent) {
+        if (entry->in_use_count == 0 &&
+            (best == NULL || entry->priority < best->priority)) {
+            best = entry;
+        }
+    }
+    return best;
+}
+
+// Must be called with the shard locked.
+WEAK void evict_entry(void *user_context, CacheShard &shard, CacheEntry *entry) {
+    uint32_t index = entry->hash % kHashTableSize;
+
+    // Remove from hash table
+    CacheEntry *prev_hash_entry = shard.entries[index];
+    if (prev_hash_entry == entry) {
+        shard.entries[index] = entry->next;
+    } else {
+        while (prev_hash_entry != NULL && prev_hash_entry->next != entry) {
+            prev_hash_entry = prev_hash_entry->next;
+        }
+        halide_assert(NULL, prev_hash_entry != NULL);
+        prev_hash_entry->next = entry->next;
+    }
+
+    // Remove from less recent chain.
+    if (shard.least_recently_used == entry) {
+        shard.least_recently_used = entry->more_recent;
+    }
+    if (entry->more_recent != NULL) {
+        entry->more_recent->less_recent = entry->less_recent;
+    }
+
+    // Remove from more recent chain.
+    if (shard.most_recently_used == entry) {
+        shard.most_recently_used = entry->less_recent;
+    }
+    if (entry->less_recent != NULL) {
+        entry->less_recent->more_recent = entry->more_recent;
+    }
+
+    // Decrease cache used amount.
+    __sync_sub_and_fetch(&current_cache_size, (int64_t)entry->bytes);
+
+    shard.counters.evictions++;
+    func_counters(entry->func_stats, shard).evictions++;
+    __sync_sub_and_fetch(&entry->func_stats->stats.bytes, entry->bytes);
+
+    // Deallocate the entry.
+    entry->destroy(user_context);
+    halide_free(user_context, entry);
+}
+
+// Adds an entry holding the given tuple buffers, which must have been
+// allocated by halide_memoization_cache_lookup, and marks it as in use
+// by the caller. Returns NULL if the entry could not be allocated, in
+// which case halide_memoization_cache_release frees the buffers
+// instead. Must be called with the shard locked.
+WEAK CacheEntry *insert_entry(void *user_context, CacheShard &shard,
+                              const uint8_t *cache_key, int32_t size, uint32_t h,
+                              int64_t compute_time, FuncStats *func_stats,
+                              halide_buffer_t *computed_bounds,
+                              int32_t tuple_count, halide_buffer_t **tuple_buffers) {
+    CacheEntry *new_entry = (CacheEntry *)halide_malloc(NULL, sizeof(CacheEntry));
+    bool inited = false;
+    if (new_entry) {
+        inited = new_entry->init(cache_key, size, h, max(compute_time, (int64_t)0),
+                                 computed_bounds, tuple_count, tuple_buffers);
+    }
+    if (!inited) {
+        // This entry is still in use by the caller. Mark it as having no cache entry
+        // so halide_memoization_cache_release can free the buffer.
+        for (int32_t i = 0; i < tuple_count; i++) {
+            get_pointer_to_header(tuple_buffers[i]->host)->entry = NULL;
+        }
+
+        if (new_entry) {
+            halide_free(user_context, new_entry);
+        }
+        return NULL;
+    }
+
+    uint32_t index = h % kHashTableSize;
+    new_entry->func_stats = func_stats;
+    new_entry->next = shard.entries[index];
+    shard.entries[index] = new_entry;
+    touch_entry(shard, new_entry);
+
+    new_entry->in_use_count = tuple_count;
+
+    for (int32_t i = 0; i < tuple_count; i++) {
+        get_pointer_to_header(tuple_buffers[i]->host)->entry = new_entry;
+    }
+
+    int64_t new_size = __sync_add_and_fetch(&current_cache_size, (int64_t)new_entry->bytes);
+    atomic_max(&peak_cache_size, new_size);
+
+    halide_memoization_cache_func_stats &stats = func_stats->stats;
+    uint64_t func_bytes = __sync_add_and_fetch(&stats.bytes, new_entry->bytes);
+    atomic_max(&stats.peak_bytes, func_bytes);
+
+    return new_entry;
+}
+
+// Must be called with no shard locked.
 WEAK void prune_cache(void *user_context) {
-#if CACHE_DEBUGGING
-    validate_cache();
-#endif
-    CacheEntry *prune_candidate = least_recently_used;
-    while (current_cache_size > max_cache_size &&
-           prune_candidate != NULL) {
-        CacheEntry *more_recent = prune_candidate->more_recent;
-
-        if (prune_candidate->in_use_count == 0) {
-            uint32_t h = prune_candidate->hash;
-            uint32_t index = h % kHashTableSize;
-
-            // Remove from hash table
-            CacheEntry *prev_hash_entry = cache_entries[index];
-            if (prev_hash_entry == prune_candidate) {
-                cache_entries[index] = prune_candidate->next;
-            } else {
-                while (prev_hash_entry != NULL && prev_hash_entry->next != prune_candidate) {
-                    prev_hash_entry = prev_hash_entry->next;
-                }
-                halide_assert(NULL, prev_hash_entry != NULL);
-                prev_hash_entry->next = prune_candidate->next;
+    ScopedMutexLock prune(&prune_lock);
+
+    while (current_cache_size > max_cache_size) {
+        // Find the shard holding the globally lowest priority entry
+        // that is not in use. Only one shard lock is held at a time.
+        CacheShard *victim_shard = NULL;
+        uint64_t lowest_priority = 0;
+        for (size_t i = 0; i < kNumShards; i++) {
+            CacheShard &shard = cache_shards[i];
+            ScopedMutexLock lock(&shard.lock);
+            CacheEntry *entry = eviction_candidate(shard);
+            if (entry != NULL && (victim_shard == NULL || entry->priority < lowest_priority)) {
+                victim_shard = &shard;
+                lowest_priority = entry->priority;
             }
+        }
+        if (victim_shard == NULL) {
+            // Everything left is in use.
+            break;
+        }
 
-            // Remove from less recent chain.
-            if (least_recently_used == prune_candidate) {
-                least_recently_used = more_recent;
-            }
-            if (more_recent != NULL) {
-                more_recent->less_recent = prune_candidate->less_recent;
+        ScopedMutexLock lock(&victim_shard->lock);
+        // The shard may have changed since we looked at it, so
+        // re-find its lowest priority entry.
+        CacheEntry *entry = eviction_candidate(*victim_shard);
+        if (entry != NULL) {
+            if (eviction_policy == halide_memoization_cache_evict_cost_aware) {
+                cost_inflation = max(cost_inflation, entry->priority);
             }
+            evict_entry(user_context, *victim_shard, entry);
+        }
+#if CACHE_DEBUGGING
+        validate_cache(*victim_shard);
+#endif
+    }
+}
 
-            // Remove from more recent chain.
-            if (most_recently_used == prune_candidate) {
-                most_recently_used = prune_candidate->less_recent;
-            }
-            if (prune_candidate->less_recent != NULL) {
-                prune_candidate->less_recent = more_recent;
+// An optional backing store that keeps memoized results in a
+// memory-mapped file, so that they survive the process exiting. Each
+// record is keyed by the cache key, the computed bounds, and a
+// fingerprint of the pipeline supplied when the file is attached, and
+// records are packed one after another following the file
+// header. Misses in memory fall back to the file, and every store is
+// also written to the file. When the file is full, records are
+// evicted under the same policy as the in-memory cache until at least
+// an eighth of the file is free, and the remaining records are then
+// compacted in one pass. Each record carries a checksum that is
+// checked when the file is attached, so that records torn by a
+// process dying part way through a store or a compaction are never
+// served.
+//
+// The file is only supported on Linux, OS X and Android (see
+// posix_cache.cpp). Elsewhere attaching one is an error.
+const uint64_t kPersistentMagic = UINT64_C(0x32304f4d454d4c48); // "HLMEMO02"
+const int64_t kDefaultPersistentSize = 1LL << 26LL;
+
+struct PersistentFileHeader {
+    uint64_t magic;
+    uint64_t file_bytes;
+    // The end of the last record, as an offset from the start of the file.
+    uint64_t used_bytes;
+    // The use clock and GreedyDual-Size inflation value for the
+    // records in the file. They are kept in the file so that record
+    // priorities remain comparable from one run to the next.
+    uint64_t clock;
+    uint64_t inflation;
+};
+
+struct PersistentRecord {
+    uint64_t record_bytes;
+    // The offset of the next record in the same index bucket, or
+    // zero. Rebuilt whenever the file is attached or compacted.
+    uint64_t next;
+    uint64_t fingerprint;
+    uint64_t priority;
+    uint64_t compute_time;
+    uint64_t data_bytes;
+    uint32_t hash;
+    uint32_t key_size;
+    int32_t dimensions;
+    // Zero while the record is waiting to be compacted away.
+    int32_t tuple_count;
+    // Covers everything in the record except next and priority, which
+    // change in place.
+    uint64_t checksum;
+    // Followed by the key, padded to a multiple of eight bytes, the
+    // computed bounds, the allocated shape of each tuple buffer, and
+    // then the contents of each tuple buffer, each padded to a
+    // multiple of eight bytes.
+};
+
+struct PersistentStore {
+    void *file;
+    PersistentFileHeader *header;
+    uint64_t fingerprint;
+    uint64_t index[kHashTableSize];
+};
+
+// Guards the persistent store. May be acquired while holding a shard
+// lock, but not the other way around.
+WEAK halide_mutex persistent_lock = { { 0 } };
+WEAK PersistentStore persistent_store;
+
+WEAK __attribute__((always_inline)) uint64_t round_up_8(uint64_t x) {
+    return (x + 7) & ~(uint64_t)7;
+}
+
+WEAK __attribute__((always_inline)) PersistentRecord *record_at(uint64_t offset) {
+    return (PersistentRecord *)((uint8_t *)persistent_store.header + offset);
+}
+
+WEAK __attribute__((always_inline)) uint8_t *record_key(PersistentRecord *record) {
+    return (uint8_t *)(record + 1);
+}
+
+// The computed bounds, followed by the allocated shape of each tuple buffer.
+WEAK __attribute__((always_inline)) halide_dimension_t *record_shapes(PersistentRecord *record) {
+    return (halide_dimension_t *)(record_key(record) + round_up_8(record->key_size));
+}
+
+WEAK __attribute__((always_inline)) uint8_t *record_data(PersistentRecord *record) {
+    return (uint8_t *)(record_shapes(record) + record->dimensions * (record->tuple_count + 1));
+}
+
+// Must only be called on a record whose size has been checked.
+WEAK uint64_t record_checksum(const PersistentRecord *record) {
+    const uint64_t fields[] = {
+        record->record_bytes,
+        record->fingerprint,
+        record->compute_time,
+        record->data_bytes,
+        ((uint64_t)record->hash << 32) | record->key_size,
+        ((uint64_t)(uint32_t)record->dimensions << 32) | (uint32_t)record->tuple_count,
+    };
+    // FNV-1a, a word at a time.
+    const uint64_t kPrime = UINT64_C(0x100000001b3);
+    uint64_t h = UINT64_C(0xcbf29ce484222325);
+    for (size_t i = 0; i < sizeof(fields) / sizeof(fields[0]); i++) {
+        h = (h ^ fields[i]) * kPrime;
+    }
+    const uint64_t *words = (const uint64_t *)(record + 1);
+    uint64_t count = (record->record_bytes - sizeof(PersistentRecord)) / 8;
+    for (uint64_t i = 0; i < count; i++) {
+        h = (h ^ words[i]) * kPrime;
+    }
+    return h;
+}
+
+// Must be called with persistent_lock held.
+WEAK uint64_t persistent_priority(const PersistentRecord *record) {
+    PersistentFileHeader *header = persistent_store.header;
+    if (eviction_policy == halide_memoization_cache_evict_cost_aware) {
+        return header->inflation + (record->compute_time << 10) / max(record->data_bytes, (uint64_t)1);
+    } else {
+        return ++header->clock;
+    }
+}
+
+// Relinks every record into the index, checking that the records
+// are well formed, and if verify is set, that their checksums
+// match. Returns false if the file is corrupt. Must be called with
+// persistent_lock held.
+WEAK bool rebuild_persistent_index(bool verify) {
+    PersistentFileHeader *header = persistent_store.header;
+    memset(persistent_store.index, 0, sizeof(persistent_store.index));
+    uint64_t offset = sizeof(PersistentFileHeader);
+    while (offset < header->used_bytes) {
+        PersistentRecord *record = record_at(offset);
+        if (header->used_bytes - offset < sizeof(PersistentRecord) ||
+            record->record_bytes < sizeof(PersistentRecord) ||
+            record->record_bytes > header->used_bytes - offset ||
+            (record->record_bytes & 7) != 0 ||
+            record->dimensions < 0 || record->tuple_count <= 0 ||
+            record->record_bytes != (sizeof(PersistentRecord) + round_up_8(record->key_size) +
+                                     sizeof(halide_dimension_t) * record->dimensions * (record->tuple_count + 1) +
+                                     record->data_bytes) ||
+            (verify && record->checksum != record_checksum(record))) {
+            return false;
+        }
+        uint32_t index = record->hash % kHashTableSize;
+        record->next = persistent_store.index[index];
+        persistent_store.index[index] = offset;
+        offset += record->record_bytes;
+    }
+    return offset == header->used_bytes;
+}
+
+// Must be called with persistent_lock held.
+WEAK PersistentRecord *find_persistent_record(const uint8_t *cache_key, int32_t size, uint32_t h,
+                                              const halide_buffer_t *computed_bounds,
+                                              int32_t tuple_count, halide_buffer_t **tuple_buffers) {
+    int32_t dimensions = computed_bounds->dimensions;
+    for (uint64_t offset = persistent_store.index[h % kHashTableSize]; offset != 0;) {
+        PersistentRecord *record = record_at(offset);
+        offset = record->next;
+        if (record->hash != h || record->fingerprint != persistent_store.fingerprint ||
+            record->key_size != (uint32_t)size || record->dimensions != dimensions ||
+            record->tuple_count != tuple_count ||
+            !keys_equal(record_key(record), cache_key, size)) {
+            continue;
+        }
+        halide_dimension_t *shapes = record_shapes(record);
+        bool all_bounds_equal = buffer_has_shape(computed_bounds, shapes);
+        for (int32_t i = 0; all_bounds_equal && i < tuple_count; i++) {
+            all_bounds_equal = (tuple_buffers[i]->dimensions == dimensions &&
+                                buffer_has_shape(tuple_buffers[i], shapes + (i + 1) * dimensions));
+        }
+        if (all_bounds_equal) {
+            return record;
+        }
+    }
+    return NULL;
+}
+
+// Marks the lowest priority record in the file for removal, and
+// returns its size, or zero if there are no records left. Must be
+// called with persistent_lock held.
+WEAK uint64_t evict_persistent_record() {
+    PersistentFileHeader *header = persistent_store.header;
+    PersistentRecord *victim = NULL;
+    for (uint64_t offset = sizeof(PersistentFileHeader); offset < header->used_bytes;) {
+        PersistentRecord *record = record_at(offset);
+        if (record->tuple_count != 0 && (victim == NULL || record->priority < victim->priority)) {
+            victim = record;
+        }
+        offset += record->record_bytes;
+    }
+    if (victim == NULL) {
+        return 0;
+    }
+    if (eviction_policy == halide_memoization_cache_evict_cost_aware) {
+        header->inflation = max(header->inflation, victim->priority);
+    }
+    victim->tuple_count = 0;
+    return victim->record_bytes;
+}
+
+// Slides the records that haven't been evicted down over the ones
+// that have, and relinks them into the index. Must be called with
+// persistent_lock held.
+WEAK void compact_persistent_file() {
+    PersistentFileHeader *header = persistent_store.header;
+    uint64_t end = sizeof(PersistentFileHeader);
+    for (uint64_t offset = sizeof(PersistentFileHeader); offset < header->used_bytes;) {
+        PersistentRecord *record = record_at(offset);
+        uint64_t record_bytes = record->record_bytes;
+        if (record->tuple_count != 0) {
+            if (end != offset) {
+                memmove(record_at(end), record, record_bytes);
             }
+            end += record_bytes;
+        }
+        offset += record_bytes;
+    }
+    header->used_bytes = end;
+    rebuild_persistent_index(false);
+}
+
+// Fills in the tuple buffers from the persistent store, if it holds a
+// matching record. Returns true on a hit, along with the time the
+// record originally took to compute. Must be called with the shard
+// for the key locked.
+WEAK bool persistent_load(const uint8_t *cache_key, int32_t size, uint32_t h,
+                          const halide_buffer_t *computed_bounds,
+                          int32_t tuple_count, halide_buffer_t **tuple_buffers,
+                          int64_t *compute_time) {
+    ScopedMutexLock lock(&persistent_lock);
+    if (persistent_store.header == NULL) {
+        return false;
+    }
+    PersistentRecord *record = find_persistent_record(cache_key, size, h, computed_bounds,
+                                                      tuple_count, tuple_buffers);
+    if (record == NULL) {
+        return false;
+    }
+    const uint8_t *data = record_data(record);
+    for (int32_t i = 0; i < tuple_count; i++) {
+        size_t bytes = tuple_buffers[i]->size_in_bytes();
+        memcpy(tuple_buffers[i]->host, data, bytes);
+        data += round_up_8(bytes);
+    }
+    record->priority = persistent_priority(record);
+    *compute_time = record->compute_time;
+    return true;
+}
+
+// Writes the tuple buffers to the persistent store, unless a matching
+// record is already there. Must be called with no shard locked.
+WEAK void persistent_save(const uint8_t *cache_key, int32_t size, uint32_t h,
+                          int64_t compute_time, const halide_buffer_t *computed_bounds,
+                          int32_t tuple_count, halide_buffer_t **tuple_buffers) {
+    ScopedMutexLock lock(&persistent_lock);
+    PersistentFileHeader *header = persistent_store.header;
+    if (header == NULL) {
+        return;
+    }
+
+    int32_t dimensions = computed_bounds->dimensions;
+    uint64_t data_bytes = 0;
+    for (int32_t i = 0; i < tuple_count; i++) {
+        if (tuple_buffers[i]->device_dirty() || tuple_buffers[i]->dimensions != dimensions) {
+            return;
+        }
+        data_bytes += round_up_8(tuple_buffers[i]->size_in_bytes());
+    }
+    uint64_t record_bytes = sizeof(PersistentRecord) + round_up_8(size) +
+        sizeof(halide_dimension_t) * dimensions * (tuple_count + 1) + data_bytes;
+    if (record_bytes > header->file_bytes - sizeof(PersistentFileHeader) ||
+        find_persistent_record(cache_key, size, h, computed_bounds, tuple_count, tuple_buffers)) {
+        return;
+    }
 
-            // Decrease cache used amount.
-            for (uint32_t i = 0; i < prune_candidate->tuple_count; i++) {
-                current_cache_size -= prune_candidate->buf[i].size_in_bytes();
+    uint64_t free_bytes = header->file_bytes - header->used_bytes;
+    if (free_bytes < record_bytes) {
+        // Free up more than we need, so that compaction isn't needed
+        // again on the next few stores.
+        uint64_t wanted = max(record_bytes, header->file_bytes / 8);
+        while (free_bytes < wanted) {
+            uint64_t evicted = evict_persistent_record();
+            if (evicted == 0) {
+                break;
             }
+            free_bytes += evicted;
+        }
+        compact_persistent_file();
+    }
 
-            // Deallocate the entry.
-            prune_candidate->destroy(user_context);
-            halide_free(user_context, prune_candidate);
+    uint64_t offset = header->used_bytes;
+    PersistentRecord *record = record_at(offset);
+    record->record_bytes = record_bytes;
+    record->fingerprint = persistent_store.fingerprint;
+    record->compute_time = max(compute_time, (int64_t)0);
+    record->data_bytes = data_bytes;
+    record->hash = h;
+    record->key_size = size;
+    record->dimensions = dimensions;
+    record->tuple_count = tuple_count;
+    record->priority = persistent_priority(record);
+    memcpy(record_key(record), cache_key, size);
+    memset(record_key(record) + size, 0, round_up_8(size) - size);
+    halide_dimension_t *shapes = record_shapes(record);
+    for (int32_t i = 0; i < dimensions; i++) {
+        shapes[i] = computed_bounds->dim[i];
+    }
+    for (int32_t i = 0; i < tuple_count; i++) {
+        for (int32_t j = 0; j < dimensions; j++) {
+            shapes[(i + 1) * dimensions + j] = tuple_buffers[i]->dim[j];
         }
+    }
+    uint8_t *data = record_data(record);
+    for (int32_t i = 0; i < tuple_count; i++) {
+        size_t bytes = tuple_buffers[i]->size_in_bytes();
+        memcpy(data, tuple_buffers[i]->host, bytes);
+        memset(data + bytes, 0, round_up_8(bytes) - bytes);
+        data += round_up_8(bytes);
+    }
+    record->checksum = record_checksum(record);
+
+    // Only publish the record once it is complete, so that a process
+    // that dies part way through a store leaves a valid file.
+    header->used_bytes = offset + record_bytes;
+    uint32_t index = h % kHashTableSize;
+    record->next = persistent_store.index[index];
+    persistent_store.index[index] = offset;
+}
 
-        prune_candidate = more_recent;
+#ifdef POSIX_FILES
+// These are the entry points without large file support, which take
+// the offset as a long on every posix platform we target. On 32-bit
+// targets that limits the persistent file to 2GB, which
+// attach_persistent_file checks for.
+extern "C" {
+extern int flock(int, int);
+extern long lseek(int, long, int);
+extern int ftruncate(int, long);
+extern void *mmap(void *, size_t, int, int, int, long);
+extern int munmap(void *, size_t);
+}
+
+// These have the same values on every posix platform we target.
+#define HALIDE_LOCK_EX 2
+#define HALIDE_LOCK_NB 4
+#define HALIDE_SEEK_END 2
+#define HALIDE_PROT_READ 1
+#define HALIDE_PROT_WRITE 2
+#define HALIDE_MAP_SHARED 1
+#define HALIDE_MAP_FAILED ((void *)-1)
+#endif
+
+// Must be called with persistent_lock held.
+WEAK void detach_persistent_file() {
+#ifdef POSIX_FILES
+    if (persistent_store.header != NULL) {
+        munmap(persistent_store.header, persistent_store.header->file_bytes);
+    }
+    if (persistent_store.file != NULL) {
+        // Closing the file also releases the lock on it.
+        fclose(persistent_store.file);
     }
-#if CACHE_DEBUGGING
-    validate_cache();
+#endif
+    memset(&persistent_store, 0, sizeof(persistent_store));
+}
+
+// Must be called with persistent_lock held.
+WEAK int attach_persistent_file(void *user_context, const char *path, uint64_t fingerprint, int64_t size) {
+#ifndef POSIX_FILES
+    error(user_context) << "halide_memoization_cache_set_persistent_file is not supported on this platform\n";
+    return halide_error_code_generic_error;
+#else
+    void *file = fopen(path, "r+b");
+    if (file == NULL) {
+        file = fopen(path, "w+b");
+    }
+    if (file == NULL) {
+        error(user_context) << "Could not open memoization cache file " << path << "\n";
+        return halide_error_code_generic_error;
+    }
+    int fd = fileno(file);
+    if (flock(fd, HALIDE_LOCK_EX | HALIDE_LOCK_NB) != 0) {
+        error(user_context) << "Memoization cache file " << path << " is in use by another process\n";
+        fclose(file);
+        return halide_error_code_generic_error;
+    }
+
+    int64_t existing_size = lseek(fd, 0, HALIDE_SEEK_END);
+    if (existing_size < 0) {
+        error(user_context) << "Could not get the size of memoization cache file " << path << "\n";
+        fclose(file);
+        return halide_error_code_generic_error;
+    }
+    if (size == 0) {
+        size = existing_size >= (int64_t)sizeof(PersistentFileHeader) ? existing_size : kDefaultPersistentSize;
+    }
+    size = (int64_t)round_up_8(max(size, (int64_t)sizeof(PersistentFileHeader)));
+    if ((int64_t)(long)size != size || (int64_t)(size_t)size != size) {
+        error(user_context) << "Memoization cache file size " << size << " is too large for this platform\n";
+        fclose(file);
+        return halide_error_code_generic_error;
+    }
+    if (size != existing_size && ftruncate(fd, size) != 0) {
+        error(user_context) << "Could not resize memoization cache file " << path << "\n";
+        fclose(file);
+        return halide_error_code_generic_error;
+    }
+    void *mapping = mmap(NULL, size, HALIDE_PROT_READ | HALIDE_PROT_WRITE, HALIDE_MAP_SHARED, fd, 0);
+    if (mapping == HALIDE_MAP_FAILED) {
+        error(user_context) << "Could not map memoization cache file " << path << "\n";
+        fclose(file);
+        return halide_error_code_generic_error;
+    }
+
+    persistent_store.file = file;
+    persistent_store.header = (PersistentFileHeader *)mapping;
+    persistent_store.fingerprint = fingerprint;
+
+    // Keep the records in an existing file, as long as it is intact
+    // and has not shrunk. Otherwise start afresh.
+    PersistentFileHeader *header = persistent_store.header;
+    bool valid = (existing_size <= size &&
+                  header->magic == kPersistentMagic &&
+                  header->file_bytes == (uint64_t)existing_size &&
+                  header->used_bytes >= sizeof(PersistentFileHeader) &&
+                  header->used_bytes <= header->file_bytes);
+    header->file_bytes = size;
+    if (!valid || !rebuild_persistent_index(true)) {
+        memset(header, 0, sizeof(PersistentFileHeader));
+        header->magic = kPersistentMagic;
+        header->file_bytes = size;
+        header->used_bytes = sizeof(PersistentFileHeader);
+        memset(persistent_store.index, 0, sizeof(persistent_store.index));
+    }
+    return 0;
 #endif
 }
 
@@ -317,100 +1110,163 @@ WEAK void halide_memoization_cache_set_size(void *user_context, int64_t size) {
         size = kDefaultCacheSize;
     }
 
-    ScopedMutexLock lock(&memoization_lock);
-
     max_cache_size = size;
     prune_cache(user_context);
 }
 
+WEAK int halide_memoization_cache_set_eviction_policy(void *user_context, int policy) {
+    if (policy != halide_memoization_cache_evict_lru &&
+        policy != halide_memoization_cache_evict_cost_aware) {
+        error(user_context) << "halide_memoization_cache_set_eviction_policy: unknown policy " << policy << "\n";
+        return halide_error_code_generic_error;
+    }
+
+    {
+        ScopedMutexLock prune(&prune_lock);
+        if (policy == eviction_policy) {
+            return 0;
+        }
+        eviction_policy = policy;
+        cost_inflation = 0;
+
+        // Recompute the priority of everything already in the cache
+        // under the new policy. Walking each LRU chain from least to
+        // most recent keeps the LRU order intact.
+        for (size_t i = 0; i < kNumShards; i++) {
+            CacheShard &shard = cache_shards[i];
+            ScopedMutexLock lock(&shard.lock);
+            for (CacheEntry *entry = shard.least_recently_used; entry != NULL; entry = entry->more_recent) {
+                entry->priority = entry_priority(entry);
+            }
+        }
+    }
+
+    prune_cache(user_context);
+    return 0;
+}
+
+WEAK int halide_memoization_cache_set_persistent_file(void *user_context, const char *path,
+                                                      uint64_t fingerprint, int64_t size) {
+    ScopedMutexLock lock(&persistent_lock);
+    detach_persistent_file();
+    if (path == NULL) {
+        return 0;
+    }
+    return attach_persistent_file(user_context, path, fingerprint, size);
+}
+
 WEAK int halide_memoization_cache_lookup(void *user_context, const uint8_t *cache_key, int32_t size,
                                          halide_buffer_t *computed_bounds, int32_t tuple_count, halide_buffer_t **tuple_buffers) {
-    uint32_t h = djb_hash(cache_key, size);
+    uint32_t h = hash_key(cache_key, size, computed_bounds);
     uint32_t index = h % kHashTableSize;
+    CacheShard &shard = shard_for_hash(h);
 
-    ScopedMutexLock lock(&memoization_lock);
+    {
+        ScopedMutexLock lock(&shard.lock);
 
 #if CACHE_DEBUGGING
-    debug_print_key(user_context, "halide_memoization_cache_lookup", cache_key, size);
+        debug_print_key(user_context, "halide_memoization_cache_lookup", cache_key, size);
 
-    debug_print_buffer(user_context, "computed_bounds", *computed_bounds);
+        debug_print_buffer(user_context, "computed_bounds", *computed_bounds);
 
-    {
-        for (int32_t i = 0; i < tuple_count; i++) {
-            halide_buffer_t *buf = tuple_buffers[i];
-            debug_print_buffer(user_context, "Allocation bounds", *buf);
+        {
+            for (int32_t i = 0; i < tuple_count; i++) {
+                halide_buffer_t *buf = tuple_buffers[i];
+                debug_print_buffer(user_context, "Allocation bounds", *buf);
+            }
         }
-    }
 #endif
 
-    CacheEntry *entry = cache_entries[index];
-    while (entry != NULL) {
-        if (entry->hash == h && entry->key_size == (size_t)size &&
-            keys_equal(entry->key, cache_key, size) &&
-            buffer_has_shape(computed_bounds, entry->computed_bounds) &&
-            entry->tuple_count == (uint32_t)tuple_count) {
-
-            // Check all the tuple buffers have the same bounds (they should).
-            bool all_bounds_equal = true;
-            for (int32_t i = 0; all_bounds_equal && i < tuple_count; i++) {
-                all_bounds_equal = buffer_has_shape(tuple_buffers[i], entry->buf[i].dim);
-            }
-
-            if (all_bounds_equal) {
-                if (entry != most_recently_used) {
-                    halide_assert(user_context, entry->more_recent != NULL);
-                    if (entry->less_recent != NULL) {
-                        entry->less_recent->more_recent = entry->more_recent;
-                    } else {
-                        halide_assert(user_context, least_recently_used == entry);
-                        least_recently_used = entry->more_recent;
-                    }
-                    halide_assert(user_context, entry->more_recent != NULL);
-                    entry->more_recent->less_recent = entry->less_recent;
+        CacheEntry *entry = shard.entries[index];
+        while (entry != NULL) {
+            if (entry->hash == h && entry->key_size == (size_t)size &&
+                keys_equal(entry->key, cache_key, size) &&
+                buffer_has_shape(computed_bounds, entry->computed_bounds) &&
+                entry->tuple_count == (uint32_t)tuple_count) {
 
-                    entry->more_recent = NULL;
-                    entry->less_recent = most_recently_used;
-                    if (most_recently_used != NULL) {
-                        most_recently_used->more_recent = entry;
-                    }
-                    most_recently_used = entry;
+                // Check all the tuple buffers have the same bounds (they should).
+                bool all_bounds_equal = true;
+                for (int32_t i = 0; all_bounds_equal && i < tuple_count; i++) {
+                    all_bounds_equal = buffer_has_shape(tuple_buffers[i], entry->buf[i].dim);
                 }
 
-                for (int32_t i = 0; i < tuple_count; i++) {
-                    halide_buffer_t *buf = tuple_buffers[i];
-                    *buf = entry->buf[i];
-                }
+                if (all_bounds_equal) {
+                    touch_entry(shard, entry);
+
+                    shard.counters.lookups++;
+                    shard.counters.hits++;
+                    ShardCounters &counters = func_counters(entry->func_stats, shard);
+                    counters.lookups++;
+                    counters.hits++;
 
-                entry->in_use_count += tuple_count;
+                    for (int32_t i = 0; i < tuple_count; i++) {
+                        halide_buffer_t *buf = tuple_buffers[i];
+                        *buf = entry->buf[i];
+                    }
 
-                return 0;
+                    entry->in_use_count += tuple_count;
+
+                    return 0;
+                }
             }
+            entry = entry->next;
         }
-        entry = entry->next;
-    }
 
-    for (int32_t i = 0; i < tuple_count; i++) {
-        halide_buffer_t *buf = tuple_buffers[i];
+        // The store for this miss happens once the Func has been
+        // computed. Record when the miss happened so the store can tell
+        // how expensive the Func was.
+        halide_start_clock(user_context);
+        int64_t miss_time = halide_current_time_ns(user_context);
 
-        buf->host = ((uint8_t *)halide_malloc(user_context, buf->size_in_bytes() + header_bytes()));
-        if (buf->host == NULL) {
-            for (int32_t j = i; j > 0; j--) {
-                halide_free(user_context, get_pointer_to_header(tuple_buffers[j - 1]->host));
-                tuple_buffers[j - 1]->host = NULL;
+        FuncStats *func_stats = find_func_stats(cache_key, size);
+
+        for (int32_t i = 0; i < tuple_count; i++) {
+            halide_buffer_t *buf = tuple_buffers[i];
+
+            buf->host = ((uint8_t *)halide_malloc(user_context, buf->size_in_bytes() + header_bytes()));
+            if (buf->host == NULL) {
+                for (int32_t j = i; j > 0; j--) {
+                    halide_free(user_context, get_pointer_to_header(tuple_buffers[j - 1]->host));
+                    tuple_buffers[j - 1]->host = NULL;
+                }
+                return -1;
             }
-            return -1;
+            buf->host += header_bytes();
+            CacheBlockHeader *header = get_pointer_to_header(buf->host);
+            header->hash = h;
+            header->entry = NULL;
+            header->miss_time = miss_time;
+            header->func_stats = func_stats;
         }
-        buf->host += header_bytes();
-        CacheBlockHeader *header = get_pointer_to_header(buf->host);
-        header->hash = h;
-        header->entry = NULL;
-    }
 
+        // Before computing the Func, see if an earlier run left the
+        // result in the persistent store.
+        shard.counters.lookups++;
+        ShardCounters &counters = func_counters(func_stats, shard);
+        counters.lookups++;
+        int64_t compute_time = 0;
+        if (persistent_load(cache_key, size, h, computed_bounds, tuple_count, tuple_buffers, &compute_time)) {
+            shard.counters.hits++;
+            counters.hits++;
+            insert_entry(user_context, shard, cache_key, size, h, compute_time,
+                         func_stats, computed_bounds, tuple_count, tuple_buffers);
+        } else {
+            shard.counters.misses++;
+            counters.misses++;
 #if CACHE_DEBUGGING
-    validate_cache();
+            validate_cache(shard);
 #endif
+            return 1;
+        }
+    }
+
+    // The persistent store had the result. Prune with the shard
+    // unlocked, as pruning may need to lock every shard.
+    if (current_cache_size > max_cache_size) {
+        prune_cache(user_context);
+    }
 
-    return 1;
+    return 0;
 }
 
 WEAK int halide_memoization_cache_store(void *user_context, const uint8_t *cache_key, int32_t size,
@@ -418,107 +1274,82 @@ WEAK int halide_memoization_cache_store(void *user_context, const uint8_t *cache
                                         int32_t tuple_count, halide_buffer_t **tuple_buffers) {
     debug(user_context) << "halide_memoization_cache_store\n";
 
-    uint32_t h = get_pointer_to_header(tuple_buffers[0]->host)->hash;
+    CacheBlockHeader *first_header = get_pointer_to_header(tuple_buffers[0]->host);
+    uint32_t h = first_header->hash;
+    int64_t compute_time = halide_current_time_ns(user_context) - first_header->miss_time;
 
     uint32_t index = h % kHashTableSize;
+    CacheShard &shard = shard_for_hash(h);
 
-    ScopedMutexLock lock(&memoization_lock);
+    {
+        ScopedMutexLock lock(&shard.lock);
 
 #if CACHE_DEBUGGING
-    debug_print_key(user_context, "halide_memoization_cache_store", cache_key, size);
+        debug_print_key(user_context, "halide_memoization_cache_store", cache_key, size);
 
-    debug_print_buffer(user_context, "computed_bounds", *computed_bounds);
+        debug_print_buffer(user_context, "computed_bounds", *computed_bounds);
 
-    {
-        for (int32_t i = 0; i < tuple_count; i++) {
-            halide_buffer_t *buf = tuple_buffers[i];
-            debug_print_buffer(user_context, "Allocation bounds", *buf);
+        {
+            for (int32_t i = 0; i < tuple_count; i++) {
+                halide_buffer_t *buf = tuple_buffers[i];
+                debug_print_buffer(user_context, "Allocation bounds", *buf);
+            }
         }
-    }
 #endif
 
-    CacheEntry *entry = cache_entries[index];
-    while (entry != NULL) {
-        if (entry->hash == h && entry->key_size == (size_t)size &&
-            keys_equal(entry->key, cache_key, size) &&
-            buffer_has_shape(computed_bounds, entry->computed_bounds) &&
-            entry->tuple_count == (uint32_t)tuple_count) {
-
-            bool all_bounds_equal = true;
-            bool no_host_pointers_equal = true;
-            {
-                for (int32_t i = 0; all_bounds_equal && i < tuple_count; i++) {
-                    halide_buffer_t *buf = tuple_buffers[i];
-                    all_bounds_equal = buffer_has_shape(tuple_buffers[i], entry->buf[i].dim);
-                    if (entry->buf[i].host == buf->host) {
-                        no_host_pointers_equal = false;
+        CacheEntry *entry = shard.entries[index];
+        while (entry != NULL) {
+            if (entry->hash == h && entry->key_size == (size_t)size &&
+                keys_equal(entry->key, cache_key, size) &&
+                buffer_has_shape(computed_bounds, entry->computed_bounds) &&
+                entry->tuple_count == (uint32_t)tuple_count) {
+
+                bool all_bounds_equal = true;
+                bool no_host_pointers_equal = true;
+                {
+                    for (int32_t i = 0; all_bounds_equal && i < tuple_count; i++) {
+                        halide_buffer_t *buf = tuple_buffers[i];
+                        all_bounds_equal = buffer_has_shape(tuple_buffers[i], entry->buf[i].dim);
+                        if (entry->buf[i].host == buf->host) {
+                            no_host_pointers_equal = false;
+                        }
                     }
                 }
-            }
-            if (all_bounds_equal) {
-                halide_assert(user_context, no_host_pointers_equal);
-                // This entry is still in use by the caller. Mark it as having no cache entry
-                // so halide_memoization_cache_release can free the buffer.
-                for (int32_t i = 0; i < tuple_count; i++) {
-                    get_pointer_to_header(tuple_buffers[i]->host)->entry = NULL;
+                if (all_bounds_equal) {
+                    halide_assert(user_context, no_host_pointers_equal);
+                    // This entry is still in use by the caller. Mark it as having no cache entry
+                    // so halide_memoization_cache_release can free the buffer.
+                    for (int32_t i = 0; i < tuple_count; i++) {
+                        get_pointer_to_header(tuple_buffers[i]->host)->entry = NULL;
 
+                    }
+                    return 0;
                 }
-                return 0;
             }
+            entry = entry->next;
         }
-        entry = entry->next;
-    }
-
-    uint64_t added_size = 0;
-    {
-        for (int32_t i = 0; i < tuple_count; i++) {
-            halide_buffer_t *buf = tuple_buffers[i];
-            added_size += buf->size_in_bytes();
-        }
-    }
-    current_cache_size += added_size;
-    prune_cache(user_context);
-
-    CacheEntry *new_entry = (CacheEntry *)halide_malloc(NULL, sizeof(CacheEntry));
-    bool inited = false;
-    if (new_entry) {
-        inited = new_entry->init(cache_key, size, h, computed_bounds, tuple_count, tuple_buffers);
-    }
-    if (!inited) {
-        current_cache_size -= added_size;
 
-        // This entry is still in use by the caller. Mark it as having no cache entry
-        // so halide_memoization_cache_release can free the buffer.
-        for (int32_t i = 0; i < tuple_count; i++) {
-            get_pointer_to_header(tuple_buffers[i]->host)->entry = NULL;
+        if (!insert_entry(user_context, shard, cache_key, size, h, compute_time,
+                          first_header->func_stats, computed_bounds, tuple_count, tuple_buffers)) {
+            return 0;
         }
 
-        if (new_entry) {
-            halide_free(user_context, new_entry);
-        }
-        return 0;
-    }
+        shard.counters.stores++;
+        func_counters(first_header->func_stats, shard).stores++;
 
-    new_entry->next = cache_entries[index];
-    new_entry->less_recent = most_recently_used;
-    if (most_recently_used != NULL) {
-        most_recently_used->more_recent = new_entry;
-    }
-    most_recently_used = new_entry;
-    if (least_recently_used == NULL) {
-        least_recently_used = new_entry;
+#if CACHE_DEBUGGING
+        validate_cache(shard);
+#endif
     }
-    cache_entries[index] = new_entry;
 
-    new_entry->in_use_count = tuple_count;
+    persistent_save(cache_key, size, h, compute_time, computed_bounds, tuple_count, tuple_buffers);
 
-    for (int32_t i = 0; i < tuple_count; i++) {
-        get_pointer_to_header(tuple_buffers[i]->host)->entry = new_entry;
+    // Prune with the shard unlocked, as pruning may need to lock
+    // every shard. The new entry is in use, so it won't be evicted.
+    if (current_cache_size > max_cache_size) {
+        prune_cache(user_context);
     }
 
-#if CACHE_DEBUGGING
-    validate_cache();
-#endif
     debug(user_context) << "Exiting halide_memoization_cache_store\n";
 
     return 0;
@@ -532,12 +1363,13 @@ WEAK void halide_memoization_cache_release(void *user_context, void *host) {
     if (entry == NULL) {
         halide_free(user_context, header);
     } else {
-        ScopedMutexLock lock(&memoization_lock);
+        CacheShard &shard = shard_for_hash(entry->hash);
+        ScopedMutexLock lock(&shard.lock);
 
         halide_assert(user_context, entry->in_use_count > 0);
         entry->in_use_count--;
 #if CACHE_DEBUGGING
-        validate_cache();
+        validate_cache(shard);
 #endif
     }
 
@@ -546,19 +1378,114 @@ WEAK void halide_memoization_cache_release(void *user_context, void *host) {
 
 WEAK void halide_memoization_cache_cleanup(void *user_context) {
     debug(NULL) << "halide_memoization_cache_cleanup\n";
-    for (size_t i = 0; i < kHashTableSize; i++) {
-        CacheEntry *entry = cache_entries[i];
-        cache_entries[i] = NULL;
-        while (entry != NULL) {
-            CacheEntry *next = entry->next;
-            entry->destroy(user_context);
-            halide_free(user_context, entry);
-            entry = next;
+    for (size_t s = 0; s < kNumShards; s++) {
+        CacheShard &shard = cache_shards[s];
+        for (size_t i = 0; i < kHashTableSize; i++) {
+            CacheEntry *entry = shard.entries[i];
+            shard.entries[i] = NULL;
+            while (entry != NULL) {
+                CacheEntry *next = entry->next;
+                entry->destroy(user_context);
+                halide_free(user_context, entry);
+                entry = next;
+            }
         }
+        shard.most_recently_used = NULL;
+        shard.least_recently_used = NULL;
+        memset(&shard.counters, 0, sizeof(shard.counters));
     }
     current_cache_size = 0;
-    most_recently_used = NULL;
-    least_recently_used = NULL;
+    peak_cache_size = 0;
+
+    for (size_t i = 0; i < kFuncStatsTableSize; i++) {
+        free(func_stats_table[i]);
+        func_stats_table[i] = NULL;
+    }
+    const char *other_name = other_func_stats.stats.name;
+    memset(&other_func_stats.stats, 0, sizeof(other_func_stats.stats));
+    memset(other_func_stats.counters, 0, sizeof(other_func_stats.counters));
+    other_func_stats.stats.name = other_name;
+    ScopedMutexLock lock(&persistent_lock);
+    detach_persistent_file();
+}
+
+WEAK int halide_memoization_cache_get_stats(void *user_context,
+                                            halide_memoization_cache_stats *stats,
+                                            halide_memoization_cache_func_stats *per_func,
+                                            int max_funcs) {
+    halide_memoization_cache_stats totals;
+    memset(&totals, 0, sizeof(totals));
+    for (size_t i = 0; i < kNumShards; i++) {
+        CacheShard &shard = cache_shards[i];
+        ScopedMutexLock lock(&shard.lock);
+        totals.lookups += shard.counters.lookups;
+        totals.hits += shard.counters.hits;
+        totals.misses += shard.counters.misses;
+        totals.stores += shard.counters.stores;
+        totals.evictions += shard.counters.evictions;
+        for (CacheEntry *entry = shard.least_recently_used; entry != NULL; entry = entry->more_recent) {
+            totals.entries++;
+            if (entry->in_use_count) {
+                totals.entries_in_use++;
+            }
+        }
+    }
+    totals.bytes = current_cache_size;
+    totals.peak_bytes = peak_cache_size;
+
+    int num_funcs = 0;
+    for (size_t i = 0; i <= kFuncStatsTableSize; i++) {
+        FuncStats *f = (i < kFuncStatsTableSize) ? func_stats_table[i] : &other_func_stats;
+        if (f == NULL) {
+            continue;
+        }
+        // Add up the Func's counters from every shard.
+        halide_memoization_cache_func_stats fs = f->stats;
+        for (size_t j = 0; j < kNumShards; j++) {
+            ScopedMutexLock lock(&cache_shards[j].lock);
+            const ShardCounters &c = f->counters[j];
+            fs.lookups += c.lookups;
+            fs.hits += c.hits;
+            fs.misses += c.misses;
+            fs.stores += c.stores;
+            fs.evictions += c.evictions;
+        }
+        if (f == &other_func_stats && !fs.lookups) {
+            continue;
+        }
+        if (per_func && num_funcs < max_funcs) {
+            per_func[num_funcs] = fs;
+        }
+        num_funcs++;
+    }
+    totals.num_funcs = num_funcs;
+
+    if (stats) {
+        *stats = totals;
+    }
+    return num_funcs;
+}
+
+WEAK void halide_memoization_cache_reset_stats(void *user_context) {
+    for (size_t i = 0; i < kNumShards; i++) {
+        CacheShard &shard = cache_shards[i];
+        ScopedMutexLock lock(&shard.lock);
+        memset(&shard.counters, 0, sizeof(shard.counters));
+        for (size_t j = 0; j <= kFuncStatsTableSize; j++) {
+            FuncStats *f = (j < kFuncStatsTableSize) ? func_stats_table[j] : &other_func_stats;
+            if (f != NULL) {
+                memset(&f->counters[i], 0, sizeof(f->counters[i]));
+            }
+        }
+    }
+    peak_cache_size = current_cache_size;
+
+    for (size_t i = 0; i <= kFuncStatsTableSize; i++) {
+        FuncStats *f = (i < kFuncStatsTableSize) ? func_stats_table[i] : &other_func_stats;
+        if (f != NULL) {
+            f->stats.peak_bytes = f->stats.bytes;
+        }
+    }
 }
 
 namespace {
@@ -35,6 +35,11 @@ WEAK halide_thread *halide_spawn_thread(void (*f)(void *), void *closure) {
     return NULL;
 }
 
+WEAK uint64_t halide_current_thread_id() {
+    // There is only ever one thread.
+    return 0;
+}
+
 WEAK void halide_mutex_lock(halide_mutex *mutex) {
 }
 
@@ -51,6 +56,23 @@ WEAK int halide_set_num_threads(int n) {
     return 1;
 }
 
+WEAK bool halide_thread_pool_enable_stats(bool enable) {
+    return false;
+}
+
+WEAK int halide_thread_pool_get_stats(halide_thread_pool_stats *stats,
+                                      halide_thread_pool_worker_stats *per_worker,
+                                      int max_workers) {
+    // There is no thread pool, so there is nothing to report.
+    if (stats) {
+        memset(stats, 0, sizeof(*stats));
+    }
+    return 0;
+}
+
+WEAK void halide_thread_pool_reset_stats() {
+}
+
 WEAK halide_do_task_t halide_set_custom_do_task(halide_do_task_t f) {
     halide_do_task_t result = custom_do_task;
     custom_do_task = f;
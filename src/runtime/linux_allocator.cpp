@@ -0,0 +1,2 @@
+#define LINUX
+#include "posix_allocator.cpp"
@@ -0,0 +1,2 @@
+#define LINUX
+#include "profiler.cpp"
@@ -183,6 +183,7 @@ extern int qurt_thread_create (qurt_thread_t *thread_id, qurt_thread_attr_t *att
    QURT_EOK -- Thread successfully joined with valid status value.
  */
 extern int qurt_thread_join(unsigned int tid, int *status);
+extern qurt_thread_t qurt_thread_get_id(void);
 
 /** QuRT mutex type.
 
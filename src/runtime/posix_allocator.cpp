@@ -1,12 +1,293 @@
 #include "HalideRuntime.h"
+#include "printer.h"
 #include "runtime_internal.h"
+#include "scoped_mutex_lock.h"
 
 extern "C" {
 
 extern void *malloc(size_t);
 extern void free(void *);
 
+#ifdef LINUX
+extern void *mmap(void *, size_t, int, int, int, long);
+extern int munmap(void *, size_t);
+extern int madvise(void *, size_t, int);
+#endif
+
+}
+
+namespace Halide { namespace Runtime { namespace Internal {
+
+// The default allocator can keep blocks that have been freed and hand
+// them out again, so that a pipeline realized over and over doesn't
+// go to the system allocator (and the kernel) for its scratch memory
+// every time. Free blocks are kept on lists by size class. There are
+// four size classes per power of two, so rounding wastes at most 25%.
+const int kMinSizeClassLog2 = 6;
+const int kMaxSizeClassLog2 = 30;
+const int kNumSizeClasses = (kMaxSizeClassLog2 - kMinSizeClassLog2) * 4 + 1;
+
+// The free lists are striped, with each thread using the stripe
+// selected by the address of its stack, so that allocations in
+// parallel loops rarely contend. Threads fall back to the other
+// stripes before allocating a new block.
+const int kNumStripes = 8;
+
+struct PoolStripe {
+    halide_mutex lock;
+    void *free_blocks[kNumSizeClasses];
+};
+
+WEAK PoolStripe pool_stripes[kNumStripes];
+
+// The most bytes that free blocks may hold. Zero turns pooling off,
+// and -1 means it has not been read from the environment yet.
+WEAK int64_t pool_limit = -1;
+WEAK int64_t pool_cached_bytes = 0;
+WEAK uint64_t pool_hits = 0;
+WEAK uint64_t pool_misses = 0;
+
+// Stored just before every pointer returned by halide_default_malloc.
+struct BlockHeader {
+    void *orig;
+    // The size class of a pooled block, or one of the values below.
+    int32_t size_class;
+};
+
+// A block too large, or of the wrong kind, to be pooled.
+const int32_t kUnpooled = -1;
+// A block mapped directly from the kernel. The length of the mapping
+// is stored at its start, i.e. at orig.
+const int32_t kMapped = -2;
+
+WEAK __attribute__((always_inline)) int size_class_of(size_t x) {
+    if (x <= ((size_t)1 << kMinSizeClassLog2)) {
+        return 0;
+    }
+    if (x > ((size_t)1 << kMaxSizeClassLog2)) {
+        return -1;
+    }
+    // 2^k < x <= 2^(k+1), and the next two bits pick the quarter.
+    int k = 63 - __builtin_clzll((unsigned long long)(x - 1));
+    int quarter = (int)((x - 1) >> (k - 2)) & 3;
+    return (k - kMinSizeClassLog2) * 4 + quarter + 1;
+}
+
+WEAK __attribute__((always_inline)) size_t size_of_class(int size_class) {
+    if (size_class == 0) {
+        return (size_t)1 << kMinSizeClassLog2;
+    }
+    int k = (size_class - 1) / 4 + kMinSizeClassLog2;
+    int quarter = (size_class - 1) % 4;
+    return ((size_t)1 << k) + ((size_t)(quarter + 1) << (k - 2));
+}
+
+WEAK __attribute__((always_inline)) int current_stripe() {
+    int local;
+    uint64_t addr = (uintptr_t)&local;
+    // Thread stacks are megabytes apart, so mix the upper bits.
+    return (int)(((addr >> 20) * UINT64_C(0x9e3779b97f4a7c15)) >> 61) % kNumStripes;
+}
+
+WEAK __attribute__((always_inline)) BlockHeader *get_block_header(void *ptr) {
+    return (BlockHeader *)ptr - 1;
+}
+
+// Parse a non-negative decimal byte count, which may not fit in an
+// int. Stops at the first non-digit, like atoi.
+WEAK int64_t parse_byte_count(const char *str) {
+    const int64_t max_count = 0x7fffffffffffffffLL;
+    int64_t result = 0;
+    for (; *str >= '0' && *str <= '9'; str++) {
+        int64_t digit = *str - '0';
+        if (result > (max_count - digit) / 10) {
+            return max_count;
+        }
+        result = result * 10 + digit;
+    }
+    return result;
+}
+
+WEAK int64_t current_pool_limit() {
+    if (pool_limit < 0) {
+        const char *limit = getenv("HL_MALLOC_POOL_LIMIT");
+        pool_limit = limit ? parse_byte_count(limit) : 0;
+    }
+    return pool_limit;
+}
+
+// Pop a free block of the given size class, trying the calling
+// thread's stripe first.
+WEAK void *pool_take(int size_class) {
+    int first = current_stripe();
+    for (int i = 0; i < kNumStripes; i++) {
+        PoolStripe &stripe = pool_stripes[(first + i) % kNumStripes];
+        ScopedMutexLock lock(&stripe.lock);
+        void *ptr = stripe.free_blocks[size_class];
+        if (ptr != NULL) {
+            stripe.free_blocks[size_class] = *(void **)ptr;
+            __sync_sub_and_fetch(&pool_cached_bytes, (int64_t)size_of_class(size_class));
+            return ptr;
+        }
+    }
+    return NULL;
+}
+
+// Returns false if keeping the block would exceed the limit.
+WEAK bool pool_give(void *ptr, int size_class) {
+    int64_t bytes = size_of_class(size_class);
+    int64_t limit = current_pool_limit();
+    if (__sync_add_and_fetch(&pool_cached_bytes, bytes) > limit) {
+        __sync_sub_and_fetch(&pool_cached_bytes, bytes);
+        return false;
+    }
+    PoolStripe &stripe = pool_stripes[current_stripe()];
+    ScopedMutexLock lock(&stripe.lock);
+    *(void **)ptr = stripe.free_blocks[size_class];
+    stripe.free_blocks[size_class] = ptr;
+    return true;
+}
+
+WEAK void pool_release_all(bool take_locks) {
+    for (int i = 0; i < kNumStripes; i++) {
+        PoolStripe &stripe = pool_stripes[i];
+        if (take_locks) {
+            halide_mutex_lock(&stripe.lock);
+        }
+        for (int c = 0; c < kNumSizeClasses; c++) {
+            void *ptr = stripe.free_blocks[c];
+            stripe.free_blocks[c] = NULL;
+            while (ptr != NULL) {
+                void *next = *(void **)ptr;
+                __sync_sub_and_fetch(&pool_cached_bytes, (int64_t)size_of_class(c));
+                free(get_block_header(ptr)->orig);
+                ptr = next;
+            }
+        }
+        if (take_locks) {
+            halide_mutex_unlock(&stripe.lock);
+        }
+    }
+}
+
+// Allocations at least this large are mapped directly, using
+// transparent huge pages. Zero turns this off, and -1 means it has
+// not been read from the environment yet.
+WEAK int64_t huge_page_threshold = -1;
+WEAK int huge_page_placement = halide_huge_page_placement_first_touch;
+
+WEAK int64_t current_huge_page_threshold() {
+    if (huge_page_threshold < 0) {
+#ifdef LINUX
+        const char *threshold = getenv("HL_HUGE_PAGE_THRESHOLD");
+        const char *placement = getenv("HL_HUGE_PAGE_PLACEMENT");
+        huge_page_threshold = threshold ? parse_byte_count(threshold) : 0;
+        if (placement) {
+            huge_page_placement = atoi(placement);
+        }
+#else
+        huge_page_threshold = 0;
+#endif
+    }
+    return huge_page_threshold;
+}
+
+#ifdef LINUX
+#define HALIDE_PROT_READ 1
+#define HALIDE_PROT_WRITE 2
+#define HALIDE_MAP_PRIVATE 2
+#define HALIDE_MAP_ANONYMOUS 0x20
+#define HALIDE_MAP_FAILED ((void *)-1)
+#define HALIDE_MADV_HUGEPAGE 14
+
+const size_t kHugePageSize = 2 * 1024 * 1024;
+const size_t kPageSize = 4096;
+
+// Fault in every small page of a mapping from this thread. This is
+// done serially rather than on the thread pool, as the allocation
+// may itself be made from inside a parallel task, or under a custom
+// do_par_for.
+WEAK void prefault_pages(uint8_t *start, size_t bytes) {
+    volatile uint8_t *pages = start;
+    for (size_t i = 0; i < bytes; i += kPageSize) {
+        pages[i] = 0;
+    }
+}
+
+WEAK void *huge_page_malloc(void *user_context, size_t x) {
+    const size_t alignment = halide_malloc_alignment();
+    size_t bytes = (x + alignment + kHugePageSize - 1) & ~(kHugePageSize - 1);
+
+    // Map an extra huge page so that the block can start on a huge
+    // page boundary, then unmap what's left over on either side.
+    uint8_t *mapping = (uint8_t *)mmap(NULL, bytes + kHugePageSize,
+                                       HALIDE_PROT_READ | HALIDE_PROT_WRITE,
+                                       HALIDE_MAP_PRIVATE | HALIDE_MAP_ANONYMOUS, -1, 0);
+    if (mapping == HALIDE_MAP_FAILED) {
+        return NULL;
+    }
+    uint8_t *start = (uint8_t *)(((size_t)mapping + kHugePageSize - 1) & ~(kHugePageSize - 1));
+    if (start != mapping) {
+        munmap(mapping, start - mapping);
+    }
+    size_t tail = (mapping + bytes + kHugePageSize) - (start + bytes);
+    if (tail > 0) {
+        munmap(start + bytes, tail);
+    }
+
+    // This is only a hint. If transparent huge pages are off, we
+    // still get (zeroed) memory.
+    madvise(start, bytes, HALIDE_MADV_HUGEPAGE);
+
+    if (huge_page_placement == halide_huge_page_placement_prefault) {
+        prefault_pages(start, bytes);
+    }
+
+    *(size_t *)start = bytes;
+    void *ptr = start + alignment;
+    BlockHeader *header = get_block_header(ptr);
+    header->orig = start;
+    header->size_class = kMapped;
+    return ptr;
+}
+
+WEAK void huge_page_free(BlockHeader *header) {
+    munmap(header->orig, *(size_t *)header->orig);
+}
+#endif
+
+__attribute__((destructor))
+WEAK void halide_allocator_cleanup() {
+    // Nothing else should be running by now.
+    pool_release_all(false);
+}
+
+}}} // namespace Halide::Runtime::Internal
+
+extern "C" {
+
 WEAK void *halide_default_malloc(void *user_context, size_t x) {
+#ifdef LINUX
+    int64_t threshold = current_huge_page_threshold();
+    if (threshold > 0 && (int64_t)x >= threshold) {
+        return huge_page_malloc(user_context, x);
+    }
+#endif
+
+    int size_class = kUnpooled;
+    if (current_pool_limit() > 0) {
+        size_class = size_class_of(x);
+        if (size_class >= 0) {
+            void *ptr = pool_take(size_class);
+            if (ptr != NULL) {
+                __sync_add_and_fetch(&pool_hits, 1);
+                return ptr;
+            }
+            __sync_add_and_fetch(&pool_misses, 1);
+            x = size_of_class(size_class);
+        }
+    }
+
     // Allocate enough space for aligning the pointer we return.
     const size_t alignment = halide_malloc_alignment();
     void *orig = malloc(x + alignment);
@@ -14,14 +295,60 @@ WEAK void *halide_default_malloc(void *user_context, size_t x) {
         // Will result in a failed assertion and a call to halide_error
         return NULL;
     }
-    // We want to store the original pointer prior to the pointer we return.
-    void *ptr = (void *)(((size_t)orig + alignment + sizeof(void*) - 1) & ~(alignment - 1));
-    ((void **)ptr)[-1] = orig;
+    // We want to store the original pointer, and the size class,
+    // prior to the pointer we return.
+    void *ptr = (void *)(((size_t)orig + alignment + sizeof(BlockHeader) - 1) & ~(alignment - 1));
+    BlockHeader *header = get_block_header(ptr);
+    header->orig = orig;
+    header->size_class = size_class;
     return ptr;
 }
 
 WEAK void halide_default_free(void *user_context, void *ptr) {
-    free(((void**)ptr)[-1]);
+    BlockHeader *header = get_block_header(ptr);
+#ifdef LINUX
+    if (header->size_class == kMapped) {
+        huge_page_free(header);
+        return;
+    }
+#endif
+    if (header->size_class >= 0 && pool_give(ptr, header->size_class)) {
+        return;
+    }
+    free(header->orig);
+}
+
+WEAK void halide_malloc_pool_set_limit(void *user_context, int64_t bytes) {
+    pool_limit = bytes < 0 ? 0 : bytes;
+    if (pool_cached_bytes > pool_limit) {
+        halide_malloc_pool_trim(user_context);
+    }
+}
+
+WEAK void halide_malloc_pool_trim(void *user_context) {
+    pool_release_all(true);
+}
+
+WEAK int halide_set_huge_page_policy(void *user_context, int64_t threshold,
+                                     halide_huge_page_placement_t placement) {
+#ifdef LINUX
+    huge_page_threshold = threshold < 0 ? 0 : threshold;
+    huge_page_placement = placement;
+    return 0;
+#else
+    if (threshold > 0) {
+        error(user_context) << "Huge page allocation is only supported on Linux\n";
+        return halide_error_code_generic_error;
+    }
+    return 0;
+#endif
+}
+
+WEAK void halide_malloc_pool_get_stats(void *user_context, halide_malloc_pool_stats *stats) {
+    stats->limit = current_pool_limit();
+    stats->cached_bytes = pool_cached_bytes;
+    stats->hits = pool_hits;
+    stats->misses = pool_misses;
 }
 
 }
@@ -0,0 +1,2 @@
+#define POSIX_FILES
+#include "cache.cpp"
@@ -21,6 +21,7 @@ typedef long pthread_t;
 extern int pthread_create(pthread_t *, const void * attr,
                           void *(*start_routine)(void *), void * arg);
 extern int pthread_join(pthread_t thread, void **retval);
+extern void *pthread_self();
 extern int pthread_cond_init(pthread_cond_t *cond, const void *attr);
 extern int pthread_cond_wait(pthread_cond_t *cond, pthread_mutex_t *mutex);
 extern int pthread_cond_signal(pthread_cond_t *cond);
@@ -65,6 +66,10 @@ WEAK void halide_join_thread(struct halide_thread *thread_arg) {
     free(t);
 }
 
+WEAK uint64_t halide_current_thread_id() {
+    return (uint64_t)pthread_self();
+}
+
 }
 
 namespace Halide { namespace Runtime { namespace Internal {
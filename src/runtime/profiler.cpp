@@ -14,8 +14,192 @@ WEAK halide_profiler_state *halide_profiler_get_state() {
 }
 }
 
+#ifdef LINUX
+extern "C" {
+extern int syscall(int num, ...);
+extern ssize_t read(int fd, void *buf, size_t count);
+extern void *pthread_self();
+}
+
+// The syscall number for perf_event_open. Like linux_clock, this
+// module is only used on x86:
+// -- i386 is 336
+// -- x64 is 298
+#ifndef SYS_PERF_EVENT_OPEN
+
+#ifdef BITS_64
+#define SYS_PERF_EVENT_OPEN 298
+#endif
+
+#ifdef BITS_32
+#define SYS_PERF_EVENT_OPEN 336
+#endif
+
+#endif
+#endif
+
 namespace Halide { namespace Runtime { namespace Internal {
 
+#ifdef LINUX
+
+// The fields of linux/perf_event.h's perf_event_attr that existed in
+// its first version (PERF_ATTR_SIZE_VER0). The kernel zero-fills the
+// rest.
+struct perf_event_attr_v0 {
+    uint32_t type;
+    uint32_t size;
+    uint64_t config;
+    uint64_t sample_period;
+    uint64_t sample_type;
+    uint64_t read_format;
+    uint64_t flags;
+    uint32_t wakeup_events;
+    uint32_t bp_type;
+    uint64_t bp_addr;
+};
+
+#define HALIDE_PERF_TYPE_HARDWARE 0
+#define HALIDE_PERF_FORMAT_GROUP (1 << 3)
+#define HALIDE_PERF_EXCLUDE_KERNEL (1 << 5)
+#define HALIDE_PERF_EXCLUDE_HV (1 << 6)
+
+// cycles, instructions, last-level cache misses, branch misses, in
+// the order of the fields in halide_profiler_func_stats.
+const int num_counters = 4;
+
+// The performance counters of one thread, read as a group through
+// the first counter that opened successfully.
+struct ThreadCounters {
+    void *thread;
+    int fds[num_counters];
+    int group_fd;
+    // Which counter each value of a group read is.
+    int num_values;
+    int value_counter[num_counters];
+    uint64_t last[num_counters];
+    // The change at the most recent sample.
+    uint64_t delta[num_counters];
+    int ready;
+};
+
+WEAK ThreadCounters thread_counters[halide_profiler_max_threads];
+WEAK int num_thread_counters = 0;
+
+// The index into thread_counters of the thread holding each slot of
+// halide_profiler_state::thread_funcs, or -1.
+WEAK int slot_counters[halide_profiler_max_threads];
+
+WEAK void read_thread_counters(ThreadCounters *c) {
+    uint64_t values[num_counters + 1];
+    for (int i = 0; i < c->num_values; i++) {
+        c->delta[i] = 0;
+    }
+    if (read(c->group_fd, values, sizeof(values)) < (ssize_t)sizeof(uint64_t)) {
+        return;
+    }
+    int n = min((int)values[0], c->num_values);
+    for (int i = 0; i < n; i++) {
+        c->delta[i] = values[i + 1] - c->last[i];
+        c->last[i] = values[i + 1];
+    }
+}
+
+// Returns the index of the calling thread's counters, opening them if
+// this is the first time the thread has been seen, or -1 if there is
+// no room.
+WEAK int counters_for_this_thread() {
+    void *self = pthread_self();
+    int n = min(num_thread_counters, (int)halide_profiler_max_threads);
+    for (int i = 0; i < n; i++) {
+        if (thread_counters[i].thread == self) {
+            return i;
+        }
+    }
+
+    int idx = __sync_fetch_and_add(&num_thread_counters, 1);
+    if (idx >= halide_profiler_max_threads) {
+        return -1;
+    }
+    ThreadCounters *c = thread_counters + idx;
+    c->thread = self;
+    c->group_fd = -1;
+    c->num_values = 0;
+
+    static const uint64_t configs[num_counters] = {0, 1, 3, 5};
+    for (int i = 0; i < num_counters; i++) {
+        perf_event_attr_v0 attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.type = HALIDE_PERF_TYPE_HARDWARE;
+        attr.size = sizeof(attr);
+        attr.config = configs[i];
+        attr.read_format = HALIDE_PERF_FORMAT_GROUP;
+        // Counting only user code works at the default paranoia level.
+        attr.flags = HALIDE_PERF_EXCLUDE_KERNEL | HALIDE_PERF_EXCLUDE_HV;
+        c->fds[i] = syscall(SYS_PERF_EVENT_OPEN, &attr, 0, -1, c->group_fd, 0);
+        if (c->fds[i] < 0) {
+            continue;
+        }
+        if (c->group_fd < 0) {
+            c->group_fd = c->fds[i];
+        }
+        c->value_counter[c->num_values++] = i;
+    }
+
+    if (c->group_fd >= 0) {
+        read_thread_counters(c);
+        __sync_synchronize();
+        c->ready = 1;
+    }
+    return idx;
+}
+
+// Attribute each thread's counter deltas since the last sample to the
+// Func it is in now.
+WEAK void bill_counters(halide_profiler_state *s) {
+    int n = min(num_thread_counters, (int)halide_profiler_max_threads);
+    for (int i = 0; i < n; i++) {
+        if (thread_counters[i].ready) {
+            read_thread_counters(thread_counters + i);
+        }
+    }
+    for (int i = 0; i < halide_profiler_max_threads; i++) {
+        int func_id = s->thread_funcs[i].func;
+        int c = slot_counters[i];
+        if (func_id < 0 || c < 0 || !thread_counters[c].ready) continue;
+        for (halide_profiler_pipeline_stats *p = s->pipelines; p;
+             p = (halide_profiler_pipeline_stats *)(p->next)) {
+            if (func_id >= p->first_func_id && func_id < p->first_func_id + p->num_funcs) {
+                halide_profiler_func_stats *f = p->funcs + func_id - p->first_func_id;
+                uint64_t *f_counts[] = {&f->cycles, &f->instructions, &f->cache_misses, &f->branch_misses};
+                uint64_t *p_counts[] = {&p->cycles, &p->instructions, &p->cache_misses, &p->branch_misses};
+                const ThreadCounters &tc = thread_counters[c];
+                for (int j = 0; j < tc.num_values; j++) {
+                    *f_counts[tc.value_counter[j]] += tc.delta[j];
+                    *p_counts[tc.value_counter[j]] += tc.delta[j];
+                }
+                break;
+            }
+        }
+    }
+}
+
+WEAK void close_counters() {
+    int n = min(num_thread_counters, (int)halide_profiler_max_threads);
+    for (int i = 0; i < n; i++) {
+        ThreadCounters *c = thread_counters + i;
+        for (int j = 0; j < num_counters; j++) {
+            if (c->fds[j] >= 0) {
+                close(c->fds[j]);
+            }
+        }
+        c->thread = NULL;
+        c->ready = 0;
+    }
+    num_thread_counters = 0;
+}
+
+#endif
+
 WEAK halide_profiler_pipeline_stats *find_or_create_pipeline(const char *pipeline_name, int num_funcs, const uint64_t *func_names) {
     halide_profiler_state *s = halide_profiler_get_state();
 
@@ -45,6 +229,10 @@ WEAK halide_profiler_pipeline_stats *find_or_create_pipeline(const char *pipelin
     p->num_allocs = 0;
     p->active_threads_numerator = 0;
     p->active_threads_denominator = 0;
+    p->cycles = 0;
+    p->instructions = 0;
+    p->cache_misses = 0;
+    p->branch_misses = 0;
     p->funcs = (halide_profiler_func_stats *)malloc(num_funcs * sizeof(halide_profiler_func_stats));
     if (!p->funcs) {
         free(p);
@@ -60,13 +248,18 @@ WEAK halide_profiler_pipeline_stats *find_or_create_pipeline(const char *pipelin
         p->funcs[i].stack_peak = 0;
         p->funcs[i].active_threads_numerator = 0;
         p->funcs[i].active_threads_denominator = 0;
+        p->funcs[i].cycles = 0;
+        p->funcs[i].instructions = 0;
+        p->funcs[i].cache_misses = 0;
+        p->funcs[i].branch_misses = 0;
     }
     s->first_free_id += num_funcs;
     s->pipelines = p;
     return p;
 }
 
-WEAK void bill_func(halide_profiler_state *s, int func_id, uint64_t time, int active_threads) {
+// Returns the pipeline the Func belongs to, if any.
+WEAK halide_profiler_pipeline_stats *bill_func(halide_profiler_state *s, int func_id, uint64_t time, int active_threads) {
     halide_profiler_pipeline_stats *p_prev = NULL;
     for (halide_profiler_pipeline_stats *p = s->pipelines; p;
          p = (halide_profiler_pipeline_stats *)(p->next)) {
@@ -82,14 +275,63 @@ WEAK void bill_func(halide_profiler_state *s, int func_id, uint64_t time, int ac
             f->active_threads_numerator += active_threads;
             f->active_threads_denominator += 1;
             p->time += time;
-            p->samples++;
-            p->active_threads_numerator += active_threads;
-            p->active_threads_denominator += 1;
-            return;
+            return p;
         }
         p_prev = p;
     }
     // Someone must have called reset_state while a kernel was running. Do nothing.
+    return NULL;
+}
+
+// The Funcs running at the time of one sample, and how many threads
+// are running each.
+struct ProfilerSample {
+    int funcs[halide_profiler_max_threads + 1];
+    int threads[halide_profiler_max_threads + 1];
+    int num_funcs;
+    int total_threads;
+
+    void add(int func, int count) {
+        total_threads += count;
+        for (int i = 0; i < num_funcs; i++) {
+            if (funcs[i] == func) {
+                threads[i] += count;
+                return;
+            }
+        }
+        funcs[num_funcs] = func;
+        threads[num_funcs] = count;
+        num_funcs++;
+    }
+};
+
+// Split the time since the last sample between the running Funcs in
+// proportion to the number of threads running each, so that the
+// times billed add up to wall-clock time.
+WEAK void bill_sample(halide_profiler_state *s, ProfilerSample *sample, uint64_t time) {
+    halide_profiler_pipeline_stats *pipelines[halide_profiler_max_threads + 1];
+    int pipeline_threads[halide_profiler_max_threads + 1];
+    int num_pipelines = 0;
+    for (int i = 0; i < sample->num_funcs; i++) {
+        int threads = sample->threads[i];
+        halide_profiler_pipeline_stats *p =
+            bill_func(s, sample->funcs[i], (time * threads) / sample->total_threads, threads);
+        if (!p) continue;
+        int j = 0;
+        while (j < num_pipelines && pipelines[j] != p) j++;
+        if (j == num_pipelines) {
+            pipelines[j] = p;
+            pipeline_threads[j] = 0;
+            num_pipelines++;
+        }
+        pipeline_threads[j] += threads;
+    }
+    for (int j = 0; j < num_pipelines; j++) {
+        halide_profiler_pipeline_stats *p = pipelines[j];
+        p->samples++;
+        p->active_threads_numerator += pipeline_threads[j];
+        p->active_threads_denominator += 1;
+    }
 }
 
 WEAK void sampling_profiler_thread(void *) {
@@ -102,23 +344,42 @@ WEAK void sampling_profiler_thread(void *) {
 
         uint64_t t1 = halide_current_time_ns(NULL);
         uint64_t t = t1;
+        ProfilerSample sample;
         while (1) {
-            int func, active_threads;
+            sample.num_funcs = 0;
+            sample.total_threads = 0;
+            int func = s->current_func;
             if (s->get_remote_profiler_state) {
                 // Execution has disappeared into remote code running
                 // on an accelerator (e.g. Hexagon DSP)
+                int active_threads;
                 s->get_remote_profiler_state(&func, &active_threads);
+                if (func >= 0) {
+                    sample.add(func, active_threads > 0 ? active_threads : 1);
+                }
             } else {
-                func = s->current_func;
-                active_threads = s->active_threads;
+                if (func >= 0) {
+                    sample.add(func, 1);
+                }
+                for (int i = 0; i < halide_profiler_max_threads; i++) {
+                    int f = s->thread_funcs[i].func;
+                    if (f >= 0) {
+                        sample.add(f, 1);
+                    }
+                }
+#ifdef LINUX
+                if (s->counters_enabled) {
+                    bill_counters(s);
+                }
+#endif
             }
             uint64_t t_now = halide_current_time_ns(NULL);
             if (func == halide_profiler_please_stop) {
                 break;
-            } else if (func >= 0) {
+            } else if (sample.num_funcs > 0) {
                 // Assume all time since I was last awake is due to
-                // the currently running func.
-                bill_func(s, func, t_now - t, active_threads);
+                // the currently running funcs.
+                bill_sample(s, &sample, t_now - t);
             }
             t = t_now;
 
@@ -133,6 +394,138 @@ WEAK void sampling_profiler_thread(void *) {
     halide_mutex_unlock(&s->lock);
 }
 
+WEAK void report_thread_pool_stats(void *user_context) {
+    halide_thread_pool_stats stats;
+    int num_workers = halide_thread_pool_get_stats(&stats, NULL, 0);
+    if (!stats.jobs) {
+        // Instrumentation is off, or nothing ran in parallel.
+        return;
+    }
+
+    halide_thread_pool_worker_stats *workers = NULL;
+    if (num_workers > 0) {
+        workers = (halide_thread_pool_worker_stats *)malloc(num_workers * sizeof(halide_thread_pool_worker_stats));
+        if (workers) {
+            num_workers = min(num_workers, halide_thread_pool_get_stats(&stats, workers, num_workers));
+        } else {
+            num_workers = 0;
+        }
+    }
+
+    char line_buf[1024];
+    Printer<StringStreamPrinter, sizeof(line_buf)> sstr(user_context, line_buf);
+
+    float parallelism = stats.job_task_time / (stats.job_time + 1e-10);
+    float depth = stats.queue_depth_total / (float)stats.jobs;
+    sstr << "thread pool\n"
+         << " jobs: " << stats.jobs
+         << "  tasks: " << stats.tasks
+         << "  average parallelism: " << parallelism << "\n"
+         << " average queue depth: " << depth
+         << "  peak queue depth: " << stats.queue_depth_peak << "\n";
+    halide_print(user_context, sstr.str());
+
+    for (int i = -1; i < num_workers; i++) {
+        const halide_thread_pool_worker_stats &w = (i < 0) ? stats.owners : workers[i];
+        size_t cursor = 0;
+        sstr.clear();
+        if (i < 0) {
+            sstr << "  callers: ";
+        } else {
+            sstr << "  worker " << i << ": ";
+        }
+        cursor += 14;
+        while (sstr.size() < cursor) sstr << " ";
+
+        sstr << "tasks: " << w.tasks_claimed;
+        cursor += 15;
+        while (sstr.size() < cursor) sstr << " ";
+
+        sstr << "busy: " << w.task_time / 1000000.0f;
+        sstr.erase(3);
+        sstr << "ms";
+        cursor += 18;
+        while (sstr.size() < cursor) sstr << " ";
+
+        sstr << "lock: " << w.lock_wait_time / 1000000.0f;
+        sstr.erase(3);
+        sstr << "ms";
+        cursor += 18;
+        while (sstr.size() < cursor) sstr << " ";
+
+        sstr << "sleep: " << w.sleep_time / 1000000.0f;
+        sstr.erase(3);
+        sstr << "ms";
+        cursor += 18;
+        while (sstr.size() < cursor) sstr << " ";
+
+        sstr << "wakeups: " << w.wakeups << "\n";
+        halide_print(user_context, sstr.str());
+    }
+
+    free(workers);
+}
+
+WEAK void report_memoization_cache_stats(void *user_context) {
+    halide_memoization_cache_stats stats;
+    int num_funcs = halide_memoization_cache_get_stats(user_context, &stats, NULL, 0);
+    if (!stats.lookups) {
+        // No memoized Funcs have run.
+        return;
+    }
+
+    halide_memoization_cache_func_stats *funcs = NULL;
+    if (num_funcs > 0) {
+        funcs = (halide_memoization_cache_func_stats *)malloc(num_funcs * sizeof(halide_memoization_cache_func_stats));
+        if (funcs) {
+            num_funcs = min(num_funcs, halide_memoization_cache_get_stats(user_context, &stats, funcs, num_funcs));
+        } else {
+            num_funcs = 0;
+        }
+    }
+
+    char line_buf[1024];
+    Printer<StringStreamPrinter, sizeof(line_buf)> sstr(user_context, line_buf);
+
+    sstr << "memoization cache\n"
+         << " lookups: " << stats.lookups
+         << "  hits: " << stats.hits
+         << "  misses: " << stats.misses
+         << "  stores: " << stats.stores
+         << "  evictions: " << stats.evictions << "\n"
+         << " entries: " << stats.entries
+         << "  in use: " << stats.entries_in_use
+         << "  bytes: " << stats.bytes
+         << "  peak bytes: " << stats.peak_bytes << "\n";
+    halide_print(user_context, sstr.str());
+
+    for (int i = 0; i < num_funcs; i++) {
+        const halide_memoization_cache_func_stats &f = funcs[i];
+        size_t cursor = 0;
+        sstr.clear();
+        sstr << "  " << f.name << ": ";
+        cursor += 25;
+        while (sstr.size() < cursor) sstr << " ";
+
+        int hit_percent = 0;
+        if (f.lookups != 0) {
+            hit_percent = (100 * f.hits) / f.lookups;
+        }
+        sstr << "lookups: " << f.lookups << " (" << hit_percent << "% hits)";
+        cursor += 30;
+        while (sstr.size() < cursor) sstr << " ";
+
+        sstr << "evictions: " << f.evictions;
+        cursor += 18;
+        while (sstr.size() < cursor) sstr << " ";
+
+        sstr << "bytes: " << f.bytes << " peak: " << f.peak_bytes << "\n";
+        halide_print(user_context, sstr.str());
+    }
+
+    free(funcs);
+}
+
 }}}
 
 namespace {
@@ -179,6 +572,20 @@ WEAK int halide_profiler_pipeline_start(void *user_context,
     ScopedMutexLock lock(&s->lock);
 
     if (!s->sampling_thread) {
+        for (int i = 0; i < halide_profiler_max_threads; i++) {
+            s->thread_funcs[i].func = halide_profiler_outside_of_halide;
+#ifdef LINUX
+            slot_counters[i] = -1;
+#endif
+        }
+#ifdef LINUX
+        const char *counters = getenv("HL_PROFILER_COUNTERS");
+        if (counters && atoi(counters)) {
+            s->counters_enabled = 1;
+        }
+#endif
+        const char *threads = getenv("HL_NUM_THREADS");
+        s->num_threads = threads ? atoi(threads) : halide_host_cpu_count();
         halide_start_clock(user_context);
         s->sampling_thread = halide_spawn_thread(sampling_profiler_thread, NULL);
     }
@@ -194,6 +601,42 @@ WEAK int halide_profiler_pipeline_start(void *user_context,
     return p->first_func_id;
 }
 
+// Claim a slot for the calling thread, which is about to run the
+// given Func.
+WEAK int *halide_profiler_acquire_slot(void *profiler_state, int func) {
+    halide_profiler_state *state = (halide_profiler_state *)profiler_state;
+    for (int i = 0; i < halide_profiler_max_threads; i++) {
+        int *slot = &(state->thread_funcs[i].func);
+        if (*slot == halide_profiler_outside_of_halide &&
+            __sync_bool_compare_and_swap(slot, halide_profiler_outside_of_halide, func)) {
+#ifdef LINUX
+            slot_counters[i] = state->counters_enabled ? counters_for_this_thread() : -1;
+#endif
+            return slot;
+        }
+    }
+    // There are more threads than slots. Share the slot of last resort.
+    state->current_func = func;
+    return &(state->current_func);
+}
+
+WEAK int halide_profiler_enable_counters(void *user_context, bool enable) {
+#ifdef LINUX
+    halide_profiler_get_state()->counters_enabled = enable;
+    return 0;
+#else
+    if (enable) {
+        error(user_context) << "Profiler hardware counters are only supported on x86 Linux\n";
+        return halide_error_code_generic_error;
+    }
+    return 0;
+#endif
+}
+
+WEAK void halide_profiler_release_slot_as_destructor(void *user_context, void *slot) {
+    *(volatile int *)slot = halide_profiler_outside_of_halide;
+}
+
 WEAK void halide_profiler_stack_peak_update(void *user_context,
                                             void *pipeline_state,
                                             uint64_t *f_values) {
@@ -302,7 +745,20 @@ WEAK void halide_profiler_report_unlocked(void *user_context, halide_profiler_st
              << "  runs: " << p->runs
              << "  time/run: " << t / p->runs << " ms\n";
         if (!serial) {
-            sstr << " average threads used: " << threads << "\n";
+            sstr << " average threads used: " << threads
+                 << " of " << s->num_threads << "\n";
+        }
+        if (s->counters_enabled) {
+            if (p->cycles) {
+                float ipc = p->instructions / (p->cycles + 1e-10);
+                sstr << " cycles: " << p->cycles
+                     << "  instructions: " << p->instructions
+                     << "  ipc: " << ipc << "\n"
+                     << " cache misses: " << p->cache_misses
+                     << "  branch misses: " << p->branch_misses << "\n";
+            } else {
+                sstr << " hardware counters unavailable\n";
+            }
         }
         sstr << " heap allocations: " << p->num_allocs
              << "  peak heap usage: " << p->memory_peak << " bytes\n";
@@ -355,6 +811,14 @@ WEAK void halide_profiler_report_unlocked(void *user_context, halide_profiler_st
                     sstr.erase(3);
                     cursor += 15;
                     while (sstr.size() < cursor) sstr << " ";
+
+                    int efficiency = 0;
+                    if (s->num_threads > 0) {
+                        efficiency = (int)(100 * threads / s->num_threads + 0.5f);
+                    }
+                    sstr << "efficiency: " << efficiency << "%";
+                    cursor += 18;
+                    while (sstr.size() < cursor) sstr << " ";
                 }
 
                 int alloc_avg = 0;
@@ -374,12 +838,25 @@ WEAK void halide_profiler_report_unlocked(void *user_context, halide_profiler_st
                 if (fs->stack_peak > 0) {
                     sstr << " stack: " << fs->stack_peak;
                 }
+                if (fs->cycles) {
+                    // Cache and branch misses per thousand instructions.
+                    float kinst = fs->instructions / 1000.0f + 1e-10;
+                    sstr << " ipc: " << fs->instructions / (fs->cycles + 1e-10);
+                    sstr.erase(4);
+                    sstr << " cache mpki: " << fs->cache_misses / kinst;
+                    sstr.erase(4);
+                    sstr << " branch mpki: " << fs->branch_misses / kinst;
+                    sstr.erase(4);
+                }
                 sstr << "\n";
 
                 halide_print(user_context, sstr.str());
             }
         }
     }
+
+    report_thread_pool_stats(user_context);
+    report_memoization_cache_stats(user_context);
 }
 
 WEAK void halide_profiler_report(void *user_context) {
@@ -397,6 +874,8 @@ WEAK void halide_profiler_reset_unlocked(halide_profiler_state *s) {
         free(p);
     }
     s->first_free_id = 0;
+    halide_thread_pool_reset_stats();
+    halide_memoization_cache_reset_stats(NULL);
 }
 
 WEAK void halide_profiler_reset() {
@@ -428,6 +907,10 @@ WEAK void halide_profiler_shutdown() {
     halide_profiler_report_unlocked(NULL, s);
 
     halide_profiler_reset_unlocked(s);
+
+#ifdef LINUX
+    close_counters();
+#endif
 }
 
 namespace {
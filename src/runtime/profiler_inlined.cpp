@@ -2,16 +2,20 @@
 
 extern "C" {
 
-WEAK __attribute__((always_inline)) int halide_profiler_set_current_func(halide_profiler_state *state, int tok, int t) {
+WEAK __attribute__((always_inline)) int halide_profiler_set_current_func(int *slot, int tok, int t) {
     // Use empty volatile asm blocks to prevent code motion. Otherwise
     // llvm reorders or elides the stores.
-    volatile int *ptr = &(state->current_func);
+    volatile int *ptr = slot;
     asm volatile ("":::);
     *ptr = tok + t;
     asm volatile ("":::);
     return 0;
 }
 
+WEAK __attribute__((always_inline)) int *halide_profiler_shared_slot(halide_profiler_state *state) {
+    return &(state->current_func);
+}
+
 WEAK __attribute__((always_inline)) int halide_profiler_incr_active_threads(halide_profiler_state *state) {
     volatile int *ptr = &(state->active_threads);
     asm volatile ("":::);
@@ -119,4 +119,28 @@ WEAK void halide_free(void *user_context, void *ptr) {
     halide_default_free(user_context, ptr);
 }
 
+// The pool of small buffers above is always on, and isn't
+// configurable.
+WEAK void halide_malloc_pool_set_limit(void *user_context, int64_t max_cached_bytes) {
+}
+
+WEAK void halide_malloc_pool_trim(void *user_context) {
+}
+
+WEAK int halide_set_huge_page_policy(void *user_context, int64_t threshold,
+                                     halide_huge_page_placement_t placement) {
+    if (threshold > 0) {
+        halide_error(user_context, "Huge page allocation is only supported on Linux\n");
+        return halide_error_code_generic_error;
+    }
+    return 0;
+}
+
+WEAK void halide_malloc_pool_get_stats(void *user_context, halide_malloc_pool_stats *stats) {
+    stats->limit = 0;
+    stats->cached_bytes = 0;
+    stats->hits = 0;
+    stats->misses = 0;
+}
+
 }
@@ -57,6 +57,10 @@ WEAK void halide_join_thread(struct halide_thread *thread_arg) {
     free(t);
 }
 
+WEAK uint64_t halide_current_thread_id() {
+    return qurt_thread_get_id();
+}
+
 } // extern "C"
 
 namespace Halide { namespace Runtime { namespace Internal {
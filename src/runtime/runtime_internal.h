@@ -69,6 +69,7 @@ int strncmp(const char* s, const char* t, size_t n);
 size_t strlen(const char* s);
 const char *strchr(const char* s, int c);
 void* memcpy(void* s1, const void* s2, size_t n);
+void *memmove(void *dest, const void *src, size_t n);
 int memcmp(const void* s1, const void* s2, size_t n);
 void *memset(void *s, int val, size_t n);
 // Use fopen+fileno+fclose instead of open+close - the value of the
@@ -134,6 +135,8 @@ WEAK int halide_profiler_pipeline_start(void *user_context,
                                         const char *pipeline_name,
                                         int num_funcs,
                                         const uint64_t *func_names);
+WEAK int *halide_profiler_acquire_slot(void *state, int func);
+WEAK void halide_profiler_release_slot_as_destructor(void *user_context, void *slot);
 WEAK int halide_host_cpu_count();
 
 WEAK int halide_device_and_host_malloc(void *user_context, struct halide_buffer_t *buf,
@@ -156,6 +159,10 @@ WEAK void halide_cond_signal(struct halide_cond *cond);
 WEAK void halide_cond_broadcast(struct halide_cond *cond);
 WEAK void halide_cond_wait(struct halide_cond *cond, struct halide_mutex *mutex);
 
+// An identifier for the calling thread, distinct from that of any
+// other running thread.
+WEAK uint64_t halide_current_thread_id();
+
 WEAK int halide_trace_helper(void *user_context,
                              const char *func,
                              void *value, int *coords,
@@ -163,6 +170,13 @@ WEAK int halide_trace_helper(void *user_context,
                              int code,
                              int parent_id, int value_index, int dimensions,
                              const char *trace_tag);
+WEAK int halide_trace_summary_helper(void *user_context,
+                                     const char *func,
+                                     void *value, int *coords,
+                                     int type_code, int type_bits, int type_lanes,
+                                     int code,
+                                     int parent_id, int value_index, int dimensions,
+                                     const char *trace_tag);
 
 }  // extern "C"
 
@@ -10,6 +10,10 @@ struct work {
     uint8_t *closure;
     int active_workers;
     int exit_status;
+    // Only maintained when thread pool instrumentation is on.
+    bool timed;
+    int64_t enqueue_time;
+    uint64_t task_time;
     bool running() { return next < max || active_workers > 0; }
 };
 
@@ -21,6 +25,13 @@ struct work_queue_t {
     // The desired number threads doing work.
     int desired_num_threads;
 
+    // Thread pool instrumentation. These fields are outside the
+    // zeroed region so that the counters survive a shutdown of the
+    // thread pool.
+    bool stats_enabled;
+    halide_thread_pool_stats stats;
+    halide_thread_pool_worker_stats worker_stats[MAX_THREADS];
+
     // All fields after this must be zero in the initial state. See assert_zeroed
     // Field serves both to mark the offset in struct and as layout padding.
     int zero_marker;
@@ -62,7 +73,8 @@ struct work_queue_t {
 
     // Used to check initial state is correct.
     void assert_zeroed() const {
-        // Assert that all fields except the mutex and desired hreads count are zeroed.
+        // Assert that all fields except the mutex, desired threads
+        // count and instrumentation state are zeroed.
         const char *bytes = ((const char *)&this->zero_marker);
         const char *limit = ((const char *)this) + sizeof(work_queue_t);
         while (bytes < limit && *bytes == 0) {
@@ -74,7 +86,8 @@ struct work_queue_t {
     // Return the work queue to initial state. Must be called while locked
     // and queue will remain locked.
     void reset() {
-        // Ensure all fields except the mutex and desired hreads count are zeroed.
+        // Ensure all fields except the mutex, desired threads count
+        // and instrumentation state are zeroed.
         char *bytes = ((char *)&this->zero_marker);
         char *limit = ((char *)this) + sizeof(work_queue_t);
         memset(bytes, 0, limit - bytes);
@@ -107,7 +120,20 @@ WEAK int default_desired_num_threads() {
     return desired_num_threads;
 }
 
-WEAK void worker_thread_already_locked(work *owned_job) {
+WEAK bool default_stats_enabled() {
+    char *stats_str = getenv("HL_THREAD_POOL_STATS");
+    return stats_str && atoi(stats_str) != 0;
+}
+
+// Must be called with the work queue locked.
+WEAK void record_sleep(halide_thread_pool_worker_stats *my_stats, bool timed, int64_t start) {
+    if (timed) {
+        my_stats->sleep_time += halide_current_time_ns(NULL) - start;
+        my_stats->wakeups++;
+    }
+}
+
+WEAK void worker_thread_already_locked(work *owned_job, halide_thread_pool_worker_stats *my_stats) {
     // If I'm a job owner, then I was the thread that called
     // do_par_for, and I should only stay in this function until my
     // job is complete. If I'm a lowly worker thread, I should stay in
@@ -116,6 +142,8 @@ WEAK void worker_thread_already_locked(work *owned_job) {
            : work_queue.running()) {
 
         if (work_queue.jobs == NULL) {
+            bool timed = work_queue.stats_enabled;
+            int64_t sleep_start = timed ? halide_current_time_ns(NULL) : 0;
             if (owned_job) {
                 // There are no jobs pending. Wait for the last worker
                 // to signal that the job is finished.
@@ -131,6 +159,7 @@ WEAK void worker_thread_already_locked(work *owned_job) {
                 halide_cond_wait(&work_queue.wakeup_b_team, &work_queue.mutex);
                 work_queue.a_team_size++;
             }
+            record_sleep(my_stats, timed, sleep_start);
         } else {
             // Grab the next job.
             work *job = work_queue.jobs;
@@ -151,11 +180,22 @@ WEAK void worker_thread_already_locked(work *owned_job) {
             job->active_workers++;
 
             // Release the lock and do the task.
+            bool timed = job->timed;
             halide_mutex_unlock(&work_queue.mutex);
+            int64_t task_start = timed ? halide_current_time_ns(NULL) : 0;
             int result = halide_do_task(myjob.user_context, myjob.f, myjob.next,
                                         myjob.closure);
+            int64_t task_end = timed ? halide_current_time_ns(NULL) : 0;
             halide_mutex_lock(&work_queue.mutex);
 
+            if (timed) {
+                uint64_t task_time = task_end - task_start;
+                my_stats->task_time += task_time;
+                my_stats->lock_wait_time += halide_current_time_ns(NULL) - task_end;
+                my_stats->tasks_claimed++;
+                job->task_time += task_time;
+            }
+
             // If this task failed, set the exit status on the job.
             if (result) {
                 job->exit_status = result;
@@ -173,9 +213,9 @@ WEAK void worker_thread_already_locked(work *owned_job) {
     }
 }
 
-WEAK void worker_thread(void *) {
+WEAK void worker_thread(void *arg) {
     halide_mutex_lock(&work_queue.mutex);
-    worker_thread_already_locked(NULL);
+    worker_thread_already_locked(NULL, (halide_thread_pool_worker_stats *)arg);
     halide_mutex_unlock(&work_queue.mutex);
 }
 
@@ -209,7 +249,14 @@ WEAK int halide_default_do_par_for(void *user_context, halide_task_t f,
 
     // Grab the lock. If it hasn't been initialized yet, then the
     // field will be zero-initialized because it's a static global.
+    // The unlocked read of stats_enabled is only used to decide
+    // whether to time the lock acquisition.
+    bool time_lock = work_queue.stats_enabled;
+    int64_t lock_start = time_lock ? halide_current_time_ns(NULL) : 0;
     halide_mutex_lock(&work_queue.mutex);
+    if (time_lock) {
+        work_queue.stats.owners.lock_wait_time += halide_current_time_ns(NULL) - lock_start;
+    }
 
     if (!work_queue.initialized) {
         work_queue.assert_zeroed();
@@ -223,6 +270,11 @@ WEAK int halide_default_do_par_for(void *user_context, halide_task_t f,
         work_queue.desired_num_threads = clamp_num_threads(work_queue.desired_num_threads);
         work_queue.threads_created = 0;
 
+        if (!work_queue.stats_enabled && default_stats_enabled()) {
+            halide_start_clock(user_context);
+            work_queue.stats_enabled = true;
+        }
+
         // Everyone starts on the a team.
         work_queue.a_team_size = work_queue.desired_num_threads;
 
@@ -232,8 +284,12 @@ WEAK int halide_default_do_par_for(void *user_context, halide_task_t f,
     while (work_queue.threads_created < work_queue.desired_num_threads - 1) {
         // We might need to make some new threads, if work_queue.desired_num_threads has
         // increased.
+        halide_thread_pool_worker_stats *worker_stats =
+            &work_queue.worker_stats[work_queue.threads_created];
         work_queue.threads[work_queue.threads_created++] =
-            halide_spawn_thread(worker_thread, NULL);
+            halide_spawn_thread(worker_thread, worker_stats);
+        work_queue.stats.num_workers = max(work_queue.stats.num_workers,
+                                           work_queue.threads_created);
     }
 
     // Make the job.
@@ -245,6 +301,18 @@ WEAK int halide_default_do_par_for(void *user_context, halide_task_t f,
     job.closure = closure;   // Use this closure.
     job.exit_status = 0;     // The job hasn't failed yet
     job.active_workers = 0;  // Nobody is working on this yet
+    job.timed = work_queue.stats_enabled;
+    job.enqueue_time = job.timed ? halide_current_time_ns(user_context) : 0;
+    job.task_time = 0;
+
+    if (job.timed) {
+        uint64_t depth = 1;
+        for (work *j = work_queue.jobs; j; j = j->next_job) {
+            depth++;
+        }
+        work_queue.stats.queue_depth_total += depth;
+        work_queue.stats.queue_depth_peak = max(work_queue.stats.queue_depth_peak, depth);
+    }
 
     if (!work_queue.jobs && size < work_queue.desired_num_threads) {
         // If there's no nested parallelism happening and there are
@@ -274,7 +342,14 @@ WEAK int halide_default_do_par_for(void *user_context, halide_task_t f,
     }
 
     // Do some work myself.
-    worker_thread_already_locked(&job);
+    worker_thread_already_locked(&job, &work_queue.stats.owners);
+
+    if (job.timed) {
+        work_queue.stats.jobs++;
+        work_queue.stats.tasks += size;
+        work_queue.stats.job_time += halide_current_time_ns(user_context) - job.enqueue_time;
+        work_queue.stats.job_task_time += job.task_time;
+    }
 
     halide_mutex_unlock(&work_queue.mutex);
 
@@ -321,6 +396,44 @@ WEAK void halide_shutdown_thread_pool() {
     }
 }
 
+WEAK bool halide_thread_pool_enable_stats(bool enable) {
+    halide_mutex_lock(&work_queue.mutex);
+    if (enable) {
+        halide_start_clock(NULL);
+    }
+    bool old = work_queue.stats_enabled;
+    work_queue.stats_enabled = enable;
+    halide_mutex_unlock(&work_queue.mutex);
+    return old;
+}
+
+WEAK int halide_thread_pool_get_stats(halide_thread_pool_stats *stats,
+                                      halide_thread_pool_worker_stats *per_worker,
+                                      int max_workers) {
+    halide_mutex_lock(&work_queue.mutex);
+    int num_workers = work_queue.stats.num_workers;
+    if (stats) {
+        *stats = work_queue.stats;
+    }
+    if (per_worker) {
+        for (int i = 0; i < num_workers && i < max_workers; i++) {
+            per_worker[i] = work_queue.worker_stats[i];
+        }
+    }
+    halide_mutex_unlock(&work_queue.mutex);
+    return num_workers;
+}
+
+WEAK void halide_thread_pool_reset_stats() {
+    halide_mutex_lock(&work_queue.mutex);
+    // Keep the worker count, as those threads are still alive.
+    int num_workers = work_queue.stats.num_workers;
+    memset(&work_queue.stats, 0, sizeof(work_queue.stats));
+    memset(work_queue.worker_stats, 0, sizeof(work_queue.worker_stats));
+    work_queue.stats.num_workers = num_workers;
+    halide_mutex_unlock(&work_queue.mutex);
+}
+
 WEAK halide_do_task_t halide_set_custom_do_task(halide_do_task_t f) {
     halide_do_task_t result = custom_do_task;
     custom_do_task = f;
@@ -10,136 +10,622 @@ typedef int32_t (*trace_fn)(void *, const halide_trace_event_t *);
 
 namespace Halide { namespace Runtime { namespace Internal {
 
-// A spinlock that allows for shared and exclusive access. It's
-// equivalent to a reader-writer lock, but in my case the "readers"
-// will actually be writing simultaneously to the trace buffer, so
-// that's a bad name. We use the __sync primitives used elsewhere in
-// the runtime for atomic work. They are well supported by clang.
-class SharedExclusiveSpinLock {
-    volatile uint32_t lock;
-
-    // Covers a single bit indicating one owner has exclusive
-    // access. The waiting bit can be set while the exclusive bit is
-    // set, but the bits masked by shared_mask must be zero while this
-    // bit is set.
-    const static uint32_t exclusive_held_mask = 0x80000000;
-
-    // Set to indicate a thread needs to acquire exclusive
-    // access. Other fields of the lock may be set, but no shared
-    // access request will proceed while this bit is set.
-    const static uint32_t exclusive_waiting_mask = 0x40000000;
-
-    // Count of threads currently holding shared access. Must be zero
-    // if the exclusive bit is set. Cannot increase if the waiting bit
-    // is set.
-    const static uint32_t shared_mask = 0x3fffffff;
-
-public:
-    __attribute__((always_inline)) void acquire_shared() {
-        while (1) {
-            uint32_t x = lock & shared_mask;
-            if (__sync_bool_compare_and_swap(&lock, x, x + 1)) {
-                return;
-            }
+// The most threads that get a trace buffer of their own. Any further
+// threads share the last one.
+const static int max_trace_threads = 256;
+
+// The most Funcs that can be given a sampling rate with a trace tag.
+const static int max_sampled_funcs = 64;
+
+// The most distinct parents of buffered loads and stores a trace
+// buffer keeps track of.
+const static int max_pending_parents = 8;
+
+const static int buffer_size = 256 * 1024;
+
+// A buffer of trace packets written by a single thread, so that
+// threads don't contend with each other for space, and a trace file
+// holds runs of packets from each thread. Loads and stores are
+// written to the file in batches when the buffer fills up. Other
+// events are written through immediately (see halide_default_trace),
+// so that readers always see an event after its parent and before
+// its parent ends. The buffers holding loads and stores of something
+// that ends are written out first.
+struct ThreadTraceBuffer {
+    // Held by the thread writing a packet, and while flushing. Only
+    // contended when another thread flushes all buffers, or when
+    // there are more than max_trace_threads threads.
+    volatile int lock;
+    uint32_t cursor;
+
+    // The number of loads and stores this thread has seen, for
+    // sampling. The first counter is for Funcs without a sampling rate
+    // of their own.
+    uint32_t sample_counters[max_sampled_funcs + 1];
+
+    // The parent ids of the loads and stores in the buffer, so that
+    // an end event only needs to flush the buffers of the threads
+    // that took part in what it ends. Once there are more than
+    // max_pending_parents of them, every end event flushes the
+    // buffer. Written with the lock held, but read without it by
+    // other threads: the entries that matter to an end event were
+    // written by threads that have finished with what it ends.
+    volatile int32_t pending_parents[max_pending_parents];
+    volatile int num_pending_parents;
+
+    // Packets are written in place, so keep them aligned.
+    uint8_t buf[buffer_size] __attribute__((aligned(8)));
+
+    // Write out the buffered packets. Must hold the lock.
+    void flush(void *user_context, int fd) {
+        if (cursor) {
+            bool success = (cursor == (uint32_t)write(fd, buf, cursor));
+            cursor = 0;
+            num_pending_parents = 0;
+            halide_assert(user_context, success && "Could not write to trace file");
         }
     }
 
-     __attribute__((always_inline)) void release_shared() {
-        __sync_fetch_and_sub(&lock, 1);
+    // Return space for a packet of the given size, flushing to make
+    // space if necessary. Must hold the lock.
+    uint8_t *acquire(void *user_context, int fd, uint32_t size) {
+        halide_assert(user_context, size <= buffer_size);
+        if (cursor + size > buffer_size) {
+            flush(user_context, fd);
+        }
+        uint8_t *result = buf + cursor;
+        cursor += size;
+        return result;
     }
 
-    __attribute__((always_inline)) void acquire_exclusive() {
-        while (1) {
-            // If multiple threads are trying to acquire exclusive
-            // ownership, we may need to rerequest exclusive waiting
-            // while we spin, as it gets unset whenever a thread
-            // acquires exclusive ownership.
-            __sync_fetch_and_or(&lock, exclusive_waiting_mask);
-            if (__sync_bool_compare_and_swap(&lock, exclusive_waiting_mask, exclusive_held_mask)) {
+    // Note that a load or store with the given parent is in the
+    // buffer. Must hold the lock.
+    void add_pending_parent(int32_t parent) {
+        int n = num_pending_parents;
+        for (int i = min(n, max_pending_parents) - 1; i >= 0; i--) {
+            if (pending_parents[i] == parent) {
                 return;
             }
         }
+        if (n < max_pending_parents) {
+            pending_parents[n] = parent;
+        }
+        num_pending_parents = min(n + 1, max_pending_parents + 1);
     }
 
-    __attribute__((always_inline)) void release_exclusive() {
-        __sync_fetch_and_and(&lock, ~exclusive_held_mask);
+    bool may_hold_children_of(int32_t parent) const {
+        int n = num_pending_parents;
+        if (n > max_pending_parents) {
+            return true;
+        }
+        for (int i = 0; i < n; i++) {
+            if (pending_parents[i] == parent) {
+                return true;
+            }
+        }
+        return false;
     }
-
-    SharedExclusiveSpinLock() : lock(0) {}
 };
 
-const static int buffer_size = 1024 * 1024;
+WEAK ThreadTraceBuffer *thread_trace_buffers[max_trace_threads];
 
-class TraceBuffer {
-    SharedExclusiveSpinLock lock;
-    uint32_t cursor, overage;
-    uint8_t buf[buffer_size];
+WEAK int halide_trace_file = -1; // -1 indicates uninitialized
+WEAK int halide_trace_file_lock = 0;
+WEAK bool halide_trace_file_initialized = false;
+WEAK void *halide_trace_file_internally_opened = NULL;
+WEAK bool halide_trace_chrome_format = false;
+
+// Keep every this many loads and stores of Funcs without a sampling
+// rate of their own. Set by HL_TRACE_SAMPLE.
+WEAK uint32_t trace_sample_every = 1;
+
+// Sampling rates set for individual Funcs by trace tags of the form
+// "halide_trace_sample: N". A rate of zero drops all of a Func's
+// loads and stores.
+struct FuncSampleRate {
+    uint32_t hash;
+    uint32_t every;
+    char *name;
+};
 
-    // Attempt to atomically acquire space in the buffer to write a
-    // packet. Returns NULL if the buffer was full.
-    __attribute__((always_inline)) halide_trace_packet_t *try_acquire_packet(void *user_context, uint32_t size) {
-        lock.acquire_shared();
-        halide_assert(user_context, size <= buffer_size);
-        uint32_t my_cursor = __sync_fetch_and_add(&cursor, size);
-        if (my_cursor + size > sizeof(buf)) {
-            // Don't try to back it out: instead, just allow this request to fail
-            // (along with all subsequent requests) and record the 'overage'
-            // that was added and should be ignored; then, in the next flush,
-            // remove the overage.
-            __sync_fetch_and_add(&overage, size);
-            lock.release_shared();
+WEAK FuncSampleRate func_sample_rates[max_sampled_funcs];
+WEAK int num_func_sample_rates = 0;
+WEAK int func_sample_rates_lock = 0;
+
+// Threads are numbered in the order they first emit an event, using
+// an open-addressed table keyed by their halide_current_thread_id.
+const static int thread_table_size = 2 * max_trace_threads;
+WEAK uintptr_t trace_thread_ids[thread_table_size];
+WEAK int trace_thread_indices[thread_table_size];
+WEAK int trace_num_threads = 0;
+
+WEAK int trace_thread_index() {
+    uintptr_t key = (uintptr_t)halide_current_thread_id() + 1;
+    uint32_t h = (uint32_t)key * 2654435761u;
+    for (int probe = 0; probe < thread_table_size; probe++) {
+        int i = (h + probe) & (thread_table_size - 1);
+        uintptr_t k = trace_thread_ids[i];
+        if (k == key) {
+            return trace_thread_indices[i];
+        }
+        if (k == 0) {
+            // Only this thread inserts its own id, so no other thread
+            // can be looking for this entry until it's complete.
+            if (__sync_bool_compare_and_swap(&trace_thread_ids[i], 0, key)) {
+                int idx = __sync_fetch_and_add(&trace_num_threads, 1);
+                trace_thread_indices[i] = min(idx, max_trace_threads - 1);
+                return trace_thread_indices[i];
+            }
+            // Another thread took the entry. Look at it again.
+            probe--;
+        }
+    }
+    return max_trace_threads - 1;
+}
+
+WEAK ThreadTraceBuffer *get_thread_trace_buffer(int thread) {
+    ThreadTraceBuffer *b = thread_trace_buffers[thread];
+    if (!b) {
+        ThreadTraceBuffer *new_b = (ThreadTraceBuffer *)malloc(sizeof(ThreadTraceBuffer));
+        if (!new_b) {
             return NULL;
+        }
+        new_b->lock = 0;
+        new_b->cursor = 0;
+        new_b->num_pending_parents = 0;
+        memset(new_b->sample_counters, 0, sizeof(new_b->sample_counters));
+        // The last buffer may be claimed by several threads at once.
+        b = __sync_val_compare_and_swap(&thread_trace_buffers[thread], (ThreadTraceBuffer *)NULL, new_b);
+        if (b) {
+            free(new_b);
         } else {
-            return (halide_trace_packet_t *)(buf + my_cursor);
+            b = new_b;
         }
     }
+    return b;
+}
 
-public:
+WEAK void flush_all_trace_buffers(void *user_context, int fd) {
+    for (int i = 0; i < max_trace_threads; i++) {
+        ThreadTraceBuffer *b = thread_trace_buffers[i];
+        if (b) {
+            ScopedSpinLock lock(&b->lock);
+            b->flush(user_context, fd);
+        }
+    }
+}
 
-    // Wait for all writers to finish with their packets, stall any
-    // new writers, and flush the buffer to the fd.
-    __attribute__((always_inline)) void flush(void *user_context, int fd) {
-        lock.acquire_exclusive();
-        bool success = true;
-        if (cursor) {
-            cursor -= overage;
-            success = (cursor == (uint32_t)write(fd, buf, cursor));
-            cursor = 0;
-            overage = 0;
+// Write out the buffers that may hold loads or stores with the given
+// parent.
+WEAK void flush_trace_buffers_with_children(void *user_context, int fd, int32_t parent) {
+    for (int i = 0; i < max_trace_threads; i++) {
+        ThreadTraceBuffer *b = thread_trace_buffers[i];
+        if (b && b->may_hold_children_of(parent)) {
+            ScopedSpinLock lock(&b->lock);
+            b->flush(user_context, fd);
         }
-        lock.release_exclusive();
-        halide_assert(user_context, success && "Could not write to trace file");
     }
+}
 
-    // Acquire and return a packet's worth of space in the trace
-    // buffer, flushing the trace buffer to the given fd to make space
-    // if necessary. The region acquired is protected from other
-    // threads writing or reading to it, so it must be released before
-    // a flush can occur.
-    __attribute__((always_inline)) halide_trace_packet_t *acquire_packet(void *user_context, int fd, uint32_t size) {
-        halide_trace_packet_t *packet = NULL;
-        while (!(packet = try_acquire_packet(user_context, size))) {
-            // Couldn't acquire space to write a packet. Flush and try again.
-            flush(user_context, fd);
+WEAK void free_trace_buffers() {
+    for (int i = 0; i < max_trace_threads; i++) {
+        free(thread_trace_buffers[i]);
+        thread_trace_buffers[i] = NULL;
+    }
+}
+
+WEAK uint32_t hash_func_name(const char *name) {
+    uint32_t h = 5381;
+    while (*name) {
+        h = h * 33 + (uint8_t)(*name++);
+    }
+    return h;
+}
+
+// Handle a trace tag of the form "halide_trace_sample: N".
+WEAK void set_func_sample_rate(const char *func, const char *tag) {
+    const char *prefix = "halide_trace_sample:";
+    size_t prefix_len = strlen(prefix);
+    if (!tag || strncmp(tag, prefix, prefix_len) != 0) {
+        return;
+    }
+    uint32_t every = (uint32_t)atoi(tag + prefix_len);
+    uint32_t hash = hash_func_name(func);
+
+    ScopedSpinLock lock(&func_sample_rates_lock);
+    int n = num_func_sample_rates;
+    for (int i = 0; i < n; i++) {
+        if (func_sample_rates[i].hash == hash && strcmp(func_sample_rates[i].name, func) == 0) {
+            func_sample_rates[i].every = every;
+            return;
         }
-        return packet;
     }
+    if (n == max_sampled_funcs) {
+        return;
+    }
+    size_t len = strlen(func) + 1;
+    char *name = (char *)malloc(len);
+    if (!name) {
+        return;
+    }
+    memcpy(name, func, len);
+    func_sample_rates[n].hash = hash;
+    func_sample_rates[n].every = every;
+    func_sample_rates[n].name = name;
+    // Publish the entry only once it's complete.
+    __sync_synchronize();
+    num_func_sample_rates = n + 1;
+}
 
-    // Release a packet, allowing it to be written out with flush
-    __attribute__((always_inline)) void release_packet(halide_trace_packet_t *) {
-        // Need a memory barrier to guarantee all the writes are done.
-        __sync_synchronize();
-        lock.release_shared();
+// Whether a load or store should be written to the trace.
+WEAK bool sample_trace_event(ThreadTraceBuffer *b, const halide_trace_event_t *e) {
+    int counter = 0;
+    uint32_t every = trace_sample_every;
+    int n = num_func_sample_rates;
+    if (n) {
+        uint32_t hash = hash_func_name(e->func);
+        for (int i = 0; i < n; i++) {
+            if (func_sample_rates[i].hash == hash && strcmp(func_sample_rates[i].name, e->func) == 0) {
+                counter = i + 1;
+                every = func_sample_rates[i].every;
+                break;
+            }
+        }
     }
+    if (every == 0) {
+        return false;
+    }
+    return (b->sample_counters[counter]++ % every) == 0;
+}
+
+// Aggregated tracing (Func::trace_summary). Each realization of a
+// summarized Func gets one of these, and the loads and stores to it
+// update it instead of being passed to halide_trace.
 
-    TraceBuffer() : cursor(0), overage(0) {}
+const static int max_summary_dimensions = 16;
+const static int num_summary_stripes = 8;
+const static int max_active_summaries = 1024;
+
+// Don't count how many times each element was stored to in
+// realizations with more elements than this.
+const static uint64_t max_counted_elements = 1 << 26;
+
+struct AccessSummary {
+    uint64_t count;
+    int32_t min[max_summary_dimensions], max[max_summary_dimensions];
 };
 
-WEAK TraceBuffer *halide_trace_buffer = NULL;
-WEAK int halide_trace_file = -1; // -1 indicates uninitialized
-WEAK int halide_trace_file_lock = 0;
-WEAK bool halide_trace_file_initialized = false;
-WEAK void *halide_trace_file_internally_opened = NULL;
+// Threads update different stripes of a summary, so that parallel
+// loops mostly don't contend for the same lock.
+struct SummaryStripe {
+    volatile int lock;
+    AccessSummary loads, stores;
+    bool has_values;
+    double value_min, value_max;
+};
+
+struct RealizationSummary {
+    const char *func;
+    int dimensions;
+    int32_t min[max_summary_dimensions], extent[max_summary_dimensions];
+    // The number of times each element of the realization was stored
+    // to, or NULL if the realization is too large to count.
+    uint32_t *counts;
+    uint64_t num_elements;
+    SummaryStripe stripes[num_summary_stripes];
+};
+
+WEAK RealizationSummary *active_summaries[max_active_summaries];
+
+WEAK bool trace_value_as_double(const halide_trace_event_t *e, int lane, double *result) {
+    const halide_type_t &t = e->type;
+    if (!e->value) {
+        return false;
+    }
+    if (t.code == halide_type_int) {
+        switch (t.bits) {
+        case 8: *result = ((const int8_t *)e->value)[lane]; return true;
+        case 16: *result = ((const int16_t *)e->value)[lane]; return true;
+        case 32: *result = ((const int32_t *)e->value)[lane]; return true;
+        case 64: *result = (double)((const int64_t *)e->value)[lane]; return true;
+        }
+    } else if (t.code == halide_type_uint) {
+        switch (t.bits) {
+        case 1:
+        case 8: *result = ((const uint8_t *)e->value)[lane]; return true;
+        case 16: *result = ((const uint16_t *)e->value)[lane]; return true;
+        case 32: *result = ((const uint32_t *)e->value)[lane]; return true;
+        case 64: *result = (double)((const uint64_t *)e->value)[lane]; return true;
+        }
+    } else if (t.code == halide_type_float) {
+        switch (t.bits) {
+        case 16: *result = halide_float16_bits_to_double(((const uint16_t *)e->value)[lane]); return true;
+        case 32: *result = ((const float *)e->value)[lane]; return true;
+        case 64: *result = ((const double *)e->value)[lane]; return true;
+        }
+    }
+    return false;
+}
+
+WEAK int begin_summary(const halide_trace_event_t *e) {
+    // The coordinates are min/extent pairs.
+    int dimensions = e->dimensions / 2;
+    if (dimensions > max_summary_dimensions) {
+        return 0;
+    }
+    RealizationSummary *r = (RealizationSummary *)malloc(sizeof(RealizationSummary));
+    if (!r) {
+        return 0;
+    }
+    memset(r, 0, sizeof(RealizationSummary));
+    r->func = e->func;
+    r->dimensions = dimensions;
+    r->num_elements = 1;
+    for (int i = 0; i < dimensions; i++) {
+        r->min[i] = e->coordinates[2 * i];
+        r->extent[i] = e->coordinates[2 * i + 1];
+        r->num_elements *= r->extent[i] > 0 ? r->extent[i] : 0;
+    }
+    if (r->num_elements <= max_counted_elements) {
+        r->counts = (uint32_t *)malloc(r->num_elements * sizeof(uint32_t));
+        if (r->counts) {
+            memset(r->counts, 0, r->num_elements * sizeof(uint32_t));
+        }
+    }
+    for (int i = 0; i < max_active_summaries; i++) {
+        if (!active_summaries[i] &&
+            __sync_bool_compare_and_swap(&active_summaries[i], (RealizationSummary *)NULL, r)) {
+            return i + 1;
+        }
+    }
+    free(r->counts);
+    free(r);
+    return 0;
+}
+
+WEAK void summarize_access(RealizationSummary *r, const halide_trace_event_t *e) {
+    bool is_store = (e->event == halide_trace_store);
+    int lanes = e->type.lanes;
+    int dimensions = e->dimensions / lanes;
+    if (dimensions != r->dimensions) {
+        return;
+    }
+
+    // Coordinates are stored as one vector per dimension.
+    SummaryStripe *stripe = r->stripes + (trace_thread_index() % num_summary_stripes);
+    {
+        ScopedSpinLock lock(&stripe->lock);
+        AccessSummary *a = is_store ? &stripe->stores : &stripe->loads;
+        for (int l = 0; l < lanes; l++) {
+            for (int d = 0; d < dimensions; d++) {
+                int32_t c = e->coordinates[d * lanes + l];
+                if (a->count == 0 || c < a->min[d]) a->min[d] = c;
+                if (a->count == 0 || c > a->max[d]) a->max[d] = c;
+            }
+            a->count++;
+            double v;
+            if (is_store && trace_value_as_double(e, l, &v)) {
+                if (!stripe->has_values || v < stripe->value_min) stripe->value_min = v;
+                if (!stripe->has_values || v > stripe->value_max) stripe->value_max = v;
+                stripe->has_values = true;
+            }
+        }
+    }
+
+    // Only count the first value of a Tuple, so that each element
+    // stored counts once.
+    if (!is_store || !r->counts || e->value_index != 0) {
+        return;
+    }
+    for (int l = 0; l < lanes; l++) {
+        uint64_t idx = 0, stride = 1;
+        bool in_bounds = true;
+        for (int d = 0; d < dimensions; d++) {
+            int64_t c = (int64_t)e->coordinates[d * lanes + l] - r->min[d];
+            if (c < 0 || c >= r->extent[d]) {
+                in_bounds = false;
+                break;
+            }
+            idx += c * stride;
+            stride *= r->extent[d];
+        }
+        if (in_bounds) {
+            __sync_fetch_and_add(r->counts + idx, 1);
+        }
+    }
+}
+
+template<typename T>
+WEAK void print_summary_box(T &ss, const AccessSummary &a, int dimensions) {
+    for (int d = 0; d < dimensions; d++) {
+        if (d > 0) ss << " x ";
+        ss << "[" << a.min[d] << ", " << a.max[d] << "]";
+    }
+}
+
+// Print the summary of a realization and free it.
+WEAK void end_summary(void *user_context, int id) {
+    RealizationSummary *r = active_summaries[id - 1];
+
+    // Merge the stripes into the first one.
+    SummaryStripe &total = r->stripes[0];
+    for (int s = 1; s < num_summary_stripes; s++) {
+        const SummaryStripe &stripe = r->stripes[s];
+        AccessSummary *totals[] = {&total.loads, &total.stores};
+        const AccessSummary *parts[] = {&stripe.loads, &stripe.stores};
+        for (int i = 0; i < 2; i++) {
+            if (!parts[i]->count) continue;
+            for (int d = 0; d < r->dimensions; d++) {
+                if (!totals[i]->count || parts[i]->min[d] < totals[i]->min[d]) totals[i]->min[d] = parts[i]->min[d];
+                if (!totals[i]->count || parts[i]->max[d] > totals[i]->max[d]) totals[i]->max[d] = parts[i]->max[d];
+            }
+            totals[i]->count += parts[i]->count;
+        }
+        if (stripe.has_values) {
+            if (!total.has_values || stripe.value_min < total.value_min) total.value_min = stripe.value_min;
+            if (!total.has_values || stripe.value_max > total.value_max) total.value_max = stripe.value_max;
+            total.has_values = true;
+        }
+    }
+
+    char line_buf[1024];
+    Printer<StringStreamPrinter, sizeof(line_buf)> ss(user_context, line_buf);
+    ss << r->func << ": realized ";
+    for (int d = 0; d < r->dimensions; d++) {
+        if (d > 0) ss << " x ";
+        ss << "[" << r->min[d] << ", " << r->min[d] + r->extent[d] - 1 << "]";
+    }
+    ss << "\n  stores: " << total.stores.count;
+    if (total.stores.count) {
+        ss << " in ";
+        print_summary_box(ss, total.stores, r->dimensions);
+    }
+    if (total.has_values) {
+        ss << "  values: [" << (float)total.value_min << ", " << (float)total.value_max << "]";
+    }
+    ss << "\n  loads: " << total.loads.count;
+    if (total.loads.count) {
+        ss << " in ";
+        print_summary_box(ss, total.loads, r->dimensions);
+    }
+    ss << "\n";
+
+    if (r->counts) {
+        // A histogram of how many times each element was computed,
+        // in power-of-two buckets: never, once, twice, 3-4, 5-8, ...
+        const int num_buckets = 8;
+        uint64_t buckets[num_buckets] = {0};
+        uint64_t stored = 0;
+        for (uint64_t i = 0; i < r->num_elements; i++) {
+            uint32_t c = r->counts[i];
+            int b = 0;
+            while (b < num_buckets - 1 && c > (b ? (1u << (b - 1)) : 0)) b++;
+            buckets[b]++;
+            stored += (c > 0);
+        }
+        ss << "  elements computed: " << stored << " of " << r->num_elements;
+        if (stored) {
+            ss << "  times computed:";
+            for (int b = 1; b < num_buckets; b++) {
+                if (!buckets[b]) continue;
+                uint32_t lo = b == 1 ? 1 : (1u << (b - 2)) + 1;
+                ss << " ";
+                if (b == num_buckets - 1) {
+                    ss << ">=" << lo;
+                } else if (lo == (1u << (b - 1))) {
+                    ss << lo;
+                } else {
+                    ss << lo << "-" << (1u << (b - 1));
+                }
+                ss << "x: " << buckets[b];
+            }
+        }
+        ss << "\n";
+    }
+    halide_print(user_context, ss.str());
+
+    active_summaries[id - 1] = NULL;
+    free(r->counts);
+    free(r);
+}
+
+// Append a string to a trace event, escaped for use in JSON.
+template<typename T>
+WEAK void write_json_string(T &ss, const char *str) {
+    char buf[256];
+    while (*str) {
+        size_t i = 0;
+        while (*str && i < sizeof(buf) - 2) {
+            if (*str == '"' || *str == '\\') {
+                buf[i++] = '\\';
+            }
+            buf[i++] = *str++;
+        }
+        buf[i] = 0;
+        ss << buf;
+    }
+}
+
+// Append a time in nanoseconds as microseconds, the unit Chrome
+// trace events use.
+template<typename T>
+WEAK void write_trace_timestamp(T &ss, uint64_t ns) {
+    uint64_t frac = ns % 1000;
+    ss << ns / 1000 << ".";
+    if (frac < 100) ss << "0";
+    if (frac < 10) ss << "0";
+    ss << frac;
+}
+
+// Write the begin and end of pipelines, realizations, productions
+// and consumptions as Chrome trace events, one per line. Loads,
+// stores and tags are dropped, as they would swamp the timeline.
+WEAK void write_chrome_trace_event(void *user_context, int fd, const halide_trace_event_t *e) {
+    const char *category;
+    switch (e->event) {
+    case halide_trace_begin_pipeline:
+    case halide_trace_end_pipeline:
+        category = "pipeline";
+        break;
+    case halide_trace_begin_realization:
+    case halide_trace_end_realization:
+        category = "realization";
+        break;
+    case halide_trace_produce:
+    case halide_trace_end_produce:
+        category = "produce";
+        break;
+    case halide_trace_consume:
+    case halide_trace_end_consume:
+        category = "consume";
+        break;
+    default:
+        return;
+    }
+    // Each of the events above is a begin with an even code or an
+    // end with an odd one.
+    const char *phase = (e->event & 1) ? "E" : "B";
+
+    uint64_t ns = halide_current_time_ns(user_context);
+    int tid = trace_thread_index();
+    ThreadTraceBuffer *b = get_thread_trace_buffer(tid);
+    halide_assert(user_context, b && "Could not allocate trace buffer");
+
+    char line_buf[1024];
+    Printer<StringStreamPrinter, sizeof(line_buf)> ss(user_context, line_buf);
+    ss << "{\"name\":\"";
+    write_json_string(ss, e->func);
+    ss << "\",\"cat\":\"" << category
+       << "\",\"ph\":\"" << phase << "\",\"ts\":";
+    write_trace_timestamp(ss, ns);
+    ss << ",\"pid\":0,\"tid\":" << tid << "},\n";
+
+    uint32_t size = (uint32_t)ss.size();
+    {
+        ScopedSpinLock lock(&b->lock);
+        memcpy(b->acquire(user_context, fd, size), ss.str(), size);
+    }
+
+    if (e->event == halide_trace_end_pipeline) {
+        flush_all_trace_buffers(user_context, fd);
+    }
+}
+
+// Terminate the JSON array of trace events, after naming the threads.
+WEAK void finish_chrome_trace(int fd) {
+    char line_buf[1024];
+    Printer<StringStreamPrinter, sizeof(line_buf)> ss(NULL, line_buf);
+    int n = min(trace_num_threads, max_trace_threads);
+    for (int i = 0; i < n; i++) {
+        ss.clear();
+        ss << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << i
+           << ",\"args\":{\"name\":\"thread " << i << "\"}},\n";
+        write(fd, ss.str(), ss.size());
+    }
+    ss.clear();
+    ss << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":0,\"args\":{\"name\":\"Halide\"}}\n]\n";
+    write(fd, ss.str(), ss.size());
+}
 
 }}}
 
@@ -152,7 +638,22 @@ WEAK int32_t halide_default_trace(void *user_context, const halide_trace_event_t
 
     // If we're dumping to a file, use a binary format
     int fd = halide_get_trace_file(user_context);
-    if (fd > 0) {
+    if (fd > 0 && halide_trace_chrome_format) {
+        write_chrome_trace_event(user_context, fd, e);
+    } else if (fd > 0) {
+        if (e->event == halide_trace_tag) {
+            set_func_sample_rate(e->func, e->trace_tag);
+        }
+
+        int thread = trace_thread_index();
+        ThreadTraceBuffer *b = get_thread_trace_buffer(thread);
+        halide_assert(user_context, b && "Could not allocate trace buffer");
+
+        bool is_load_or_store = (e->event == halide_trace_load || e->event == halide_trace_store);
+        if (is_load_or_store && !sample_trace_event(b, e)) {
+            return my_id;
+        }
+
         // Compute the total packet size
         uint32_t value_bytes = (uint32_t)(e->type.lanes * e->type.bytes());
         uint32_t header_bytes = (uint32_t)sizeof(halide_trace_packet_t);
@@ -160,39 +661,54 @@ WEAK int32_t halide_default_trace(void *user_context, const halide_trace_event_t
         uint32_t name_bytes = strlen(e->func) + 1;
         uint32_t trace_tag_bytes = e->trace_tag ? (strlen(e->trace_tag) + 1) : 1;
         uint32_t total_size_without_padding = header_bytes + value_bytes + coords_bytes + name_bytes + trace_tag_bytes;
-        uint32_t total_size = (total_size_without_padding + 3) & ~3;
-
-        // Claim some space to write to in the trace buffer
-        halide_trace_packet_t *packet = halide_trace_buffer->acquire_packet(user_context, fd, total_size);
-
-        if (total_size > 4096) {
-            print(NULL) << total_size << "\n";
-        }
-
-        // Write a packet into it
-        packet->size = total_size;
-        packet->id = my_id;
-        packet->type = e->type;
-        packet->event = e->event;
-        packet->parent_id = e->parent_id;
-        packet->value_index = e->value_index;
-        packet->dimensions = e->dimensions;
-        if (e->coordinates) {
-            memcpy((void *)packet->coordinates(), e->coordinates, coords_bytes);
-        }
-        if (e->value) {
-            memcpy((void *)packet->value(), e->value, value_bytes);
+        uint32_t total_size = (total_size_without_padding + 7) & ~7;
+
+        // An event that ends a realization, production or
+        // consumption must come after the loads and stores that
+        // belong to it, which may still be sitting in the buffers of
+        // the threads that did the work. Those threads have finished
+        // with it by now, so write their buffers out first. The end of
+        // the pipeline writes out everything.
+        if (e->event == halide_trace_end_pipeline) {
+            flush_all_trace_buffers(user_context, fd);
+        } else if (e->event == halide_trace_end_realization ||
+                   e->event == halide_trace_end_produce ||
+                   e->event == halide_trace_end_consume) {
+            flush_trace_buffers_with_children(user_context, fd, e->parent_id);
         }
-        memcpy((void *)packet->func(), e->func, name_bytes);
-        memcpy((void *)packet->trace_tag(), e->trace_tag ? e->trace_tag : "", trace_tag_bytes);
-
-        // Release it
-        halide_trace_buffer->release_packet(packet);
 
-        // We should also flush the trace buffer if we hit an event
-        // that might be the end of the trace.
-        if (e->event == halide_trace_end_pipeline) {
-            halide_trace_buffer->flush(user_context, fd);
+        {
+            // Claim some space to write to in this thread's buffer
+            ScopedSpinLock lock(&b->lock);
+            halide_trace_packet_t *packet = (halide_trace_packet_t *)b->acquire(user_context, fd, total_size);
+
+            // Write a packet into it
+            packet->size = total_size;
+            packet->id = my_id;
+            packet->type = e->type;
+            packet->event = e->event;
+            packet->parent_id = e->parent_id;
+            packet->value_index = e->value_index;
+            packet->dimensions = e->dimensions;
+            packet->thread = thread;
+            packet->time = halide_current_time_ns(user_context);
+            if (e->coordinates) {
+                memcpy((void *)packet->coordinates(), e->coordinates, coords_bytes);
+            }
+            if (e->value) {
+                memcpy((void *)packet->value(), e->value, value_bytes);
+            }
+            memcpy((void *)packet->func(), e->func, name_bytes);
+            memcpy((void *)packet->trace_tag(), e->trace_tag ? e->trace_tag : "", trace_tag_bytes);
+
+            // Write everything other than loads and stores through
+            // now, along with this thread's earlier packets, so that
+            // it reaches the file before any of its children.
+            if (is_load_or_store) {
+                b->add_pending_parent(e->parent_id);
+            } else {
+                b->flush(user_context, fd);
+            }
         }
 
     } else {
@@ -331,12 +847,20 @@ WEAK int halide_get_trace_file(void *user_context) {
     if (halide_trace_file < 0) {
         const char *trace_file_name = getenv("HL_TRACE_FILE");
         if (trace_file_name) {
-            void *file = fopen(trace_file_name, "ab");
+            const char *trace_format = getenv("HL_TRACE_FORMAT");
+            halide_trace_chrome_format = trace_format && strcmp(trace_format, "chrome") == 0;
+            // A JSON trace can't be appended to.
+            void *file = fopen(trace_file_name, halide_trace_chrome_format ? "wb" : "ab");
             halide_assert(user_context, file && "Failed to open trace file\n");
             halide_set_trace_file(fileno(file));
             halide_trace_file_internally_opened = file;
-            if (!halide_trace_buffer) {
-                halide_trace_buffer = (TraceBuffer *)malloc(sizeof(TraceBuffer));
+            const char *sample = getenv("HL_TRACE_SAMPLE");
+            if (sample) {
+                trace_sample_every = (uint32_t)atoi(sample);
+            }
+            halide_start_clock(user_context);
+            if (halide_trace_chrome_format) {
+                write(halide_trace_file, "[\n", 2);
             }
         } else {
             halide_set_trace_file(0);
@@ -351,13 +875,16 @@ WEAK int32_t halide_trace(void *user_context, const halide_trace_event_t *e) {
 
 WEAK int halide_shutdown_trace() {
     if (halide_trace_file_internally_opened) {
+        flush_all_trace_buffers(NULL, halide_trace_file);
+        if (halide_trace_chrome_format) {
+            finish_chrome_trace(halide_trace_file);
+            halide_trace_chrome_format = false;
+        }
         int ret = fclose(halide_trace_file_internally_opened);
         halide_trace_file = 0;
         halide_trace_file_initialized = false;
         halide_trace_file_internally_opened = NULL;
-        if (halide_trace_buffer) {
-            free(halide_trace_buffer);
-        }
+        free_trace_buffers();
         return ret;
     } else {
         return 0;
@@ -398,4 +925,42 @@ WEAK int halide_trace_helper(void *user_context,
     return halide_trace(user_context, &event);
 }
 
+// The equivalent of halide_trace_helper for Funcs scheduled with
+// trace_summary. Begin realization returns an id for the summary of
+// the realization, which later events pass as the parent id.
+WEAK int halide_trace_summary_helper(void *user_context,
+                                     const char *func,
+                                     void *value, int *coords,
+                                     int type_code, int type_bits, int type_lanes,
+                                     int code,
+                                     int parent_id, int value_index, int dimensions,
+                                     const char *trace_tag) {
+    halide_trace_event_t event;
+    event.func = func;
+    event.value = value;
+    event.coordinates = coords;
+    event.trace_tag = trace_tag;
+    event.type.code = (halide_type_code_t)type_code;
+    event.type.bits = (uint8_t)type_bits;
+    event.type.lanes = (uint16_t)type_lanes;
+    event.event = (halide_trace_event_code_t)code;
+    event.parent_id = parent_id;
+    event.value_index = value_index;
+    event.dimensions = dimensions;
+
+    if (event.event == halide_trace_begin_realization) {
+        return begin_summary(&event);
+    }
+    if (parent_id <= 0 || parent_id > max_active_summaries) {
+        // The summary could not be allocated.
+        return 0;
+    }
+    if (event.event == halide_trace_end_realization) {
+        end_summary(user_context, parent_id);
+    } else if (event.event == halide_trace_load || event.event == halide_trace_store) {
+        summarize_access(active_summaries[parent_id - 1], &event);
+    }
+    return 0;
+}
+
 }
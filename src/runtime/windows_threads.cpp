@@ -29,6 +29,7 @@ extern WIN32API void DeleteCriticalSection(CriticalSection *);
 extern WIN32API void EnterCriticalSection(CriticalSection *);
 extern WIN32API void LeaveCriticalSection(CriticalSection *);
 extern WIN32API int32_t WaitForSingleObject(Thread, int32_t timeout);
+extern WIN32API uint32_t GetCurrentThreadId();
 
 } // extern "C"
 
@@ -73,6 +74,10 @@ WEAK void halide_join_thread(halide_thread *thread_arg) {
     free(thread);
 }
 
+WEAK uint64_t halide_current_thread_id() {
+    return GetCurrentThreadId();
+}
+
 } // extern "C"
 
 namespace Halide { namespace Runtime { namespace Internal {
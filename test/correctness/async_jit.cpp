@@ -0,0 +1,149 @@
+#include "Halide.h"
+#include <stdio.h>
+
+using namespace Halide;
+
+int check(const Buffer<int> &out, const Buffer<int> &input, int k) {
+    for (int y = 0; y < out.height(); y++) {
+        for (int x = 0; x < out.width(); x++) {
+            int correct = input(x, y) + input(x + 1, y) * k;
+            if (out(x, y) != correct) {
+                printf("out(%d, %d) = %d instead of %d\n", x, y, out(x, y), correct);
+                return -1;
+            }
+        }
+    }
+    return 0;
+}
+
+int prints = 0;
+void count_prints(void *, const char *) {
+    prints++;
+}
+
+int main(int argc, char **argv) {
+    ImageParam in(Int(32), 2, "in");
+    Param<int> k("k");
+    Var x("x"), y("y"), xi("xi"), yi("yi");
+
+    // The same algorithm twice: a tiled, vectorized one compiled in the
+    // background, and a plain one to run until it's ready.
+    Func f("f"), g("g");
+    f(x, y) = in(x, y) + in(x + 1, y) * k;
+    g(x, y) = in(x, y) + in(x + 1, y) * k;
+    f.tile(x, y, xi, yi, 16, 8).vectorize(xi, 8).parallel(y);
+
+    Pipeline fallback(g);
+    fallback.compile_jit();
+
+    Pipeline p(f);
+    p.set_jit_fallback(fallback);
+
+    Target t = get_jit_target_from_environment();
+    p.compile_jit_async(t);
+    // A second target compiles after the first.
+    p.compile_jit_async(t.with_feature(Target::NoAsserts));
+
+    Buffer<int> input(65, 32);
+    input.for_each_element([&](int x, int y) { input(x, y) = x * 5 + y; });
+    in.set(input);
+
+    // Whether these run the fallback or the compiled pipeline depends
+    // on timing, but the results must be right either way.
+    for (int i = 0; i < 5; i++) {
+        k.set(i);
+        Buffer<int> out(64, 32);
+        p.realize(out, t);
+        if (check(out, input, i)) {
+            return -1;
+        }
+    }
+
+    p.wait_for_async_jit();
+    if (!p.async_jit_ready(t) || !p.async_jit_ready(t.with_feature(Target::NoAsserts))) {
+        printf("Background compilation should be finished\n");
+        return -1;
+    }
+
+    for (Target target : {t, t.with_feature(Target::NoAsserts)}) {
+        k.set(3);
+        Buffer<int> out(64, 32);
+        p.realize(out, target);
+        if (check(out, input, 3)) {
+            return -1;
+        }
+    }
+
+    // Without a fallback, realize waits for the background compilation.
+    {
+        Func h("h");
+        h(x, y) = in(x, y) + in(x + 1, y) * k;
+        h.vectorize(x, 4);
+        Pipeline q(h);
+        q.compile_jit_async(t);
+        k.set(7);
+        Buffer<int> out(64, 32);
+        q.realize(out);
+        if (check(out, input, 7)) {
+            return -1;
+        }
+    }
+
+    // The fallback runs with the handlers of the pipeline it stands
+    // in for, so every realize prints to the same place whichever one
+    // ran.
+    {
+        Func h("h"), h_fallback("h_fallback");
+        h(x, y) = print_when(x == 0 && y == 0, in(x, y) * k, "h");
+        h_fallback(x, y) = print_when(x == 0 && y == 0, in(x, y) * k, "h");
+        Pipeline q_fallback(h_fallback);
+        q_fallback.compile_jit();
+
+        Pipeline q(h);
+        q.set_jit_fallback(q_fallback);
+        q.set_custom_print(count_prints);
+        q.compile_jit_async(t);
+        for (int i = 0; i < 3; i++) {
+            Buffer<int> out(64, 32);
+            q.realize(out);
+        }
+        q.wait_for_async_jit();
+        if (prints != 3) {
+            printf("Expected 3 prints to the custom handler, got %d\n", prints);
+            return -1;
+        }
+    }
+
+    // Shape-specialized variants compile on this thread while the
+    // compilation for the second target may still be running in the
+    // background. Neither may see the other's shapes.
+    {
+        Func h("h");
+        h(x, y) = in(x, y) + in(x + 1, y) * k;
+        h.vectorize(x, 4, TailStrategy::GuardWithIf);
+        Pipeline q(h);
+        q.specialize_jit_on_shapes(2);
+        q.compile_jit_async(t);
+        q.compile_jit_async(t.with_feature(Target::NoAsserts));
+
+        struct {
+            int w, h;
+        } shapes[] = {{64, 32}, {64, 32}, {64, 32}, {13, 5}, {13, 5}, {40, 3}};
+        for (Target target : {t, t.with_feature(Target::NoAsserts)}) {
+            for (auto s : shapes) {
+                Buffer<int> shaped_input(s.w + 1, s.h);
+                shaped_input.for_each_element([&](int x, int y) { shaped_input(x, y) = x * 3 - y; });
+                in.set(shaped_input);
+                k.set(s.w);
+                Buffer<int> out(s.w, s.h);
+                q.realize(out, target);
+                if (check(out, shaped_input, s.w)) {
+                    return -1;
+                }
+            }
+        }
+    }
+
+    printf("Success!\n");
+    return 0;
+}
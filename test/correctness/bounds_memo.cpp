@@ -0,0 +1,88 @@
+#include "Halide.h"
+#include <iostream>
+#include <stdio.h>
+
+using namespace Halide;
+using namespace Halide::Internal;
+
+Expr x = Variable::make(Int(32), "x");
+Expr y = Variable::make(Int(32), "y");
+Expr a = Variable::make(Int(32), "a");
+
+// Builds a fresh copy each time, so that repeated queries are
+// structurally equal but don't share nodes.
+Expr make_expr() {
+    Expr f = Call::make(Int(32), "f", {x}, Call::Halide);
+    return Let::make("t", x * 2 + y, (Variable::make(Int(32), "t") + f) / y);
+}
+
+int check(const Interval &memoized, const Expr &e, const Scope<Interval> &scope,
+          const FuncValueBounds &fb, int line) {
+    // Outside of a BoundsMemoScope, this computes the bounds from scratch.
+    Interval correct = bounds_of_expr_in_scope(e, scope, fb);
+    if (!equal(memoized.min, correct.min) || !equal(memoized.max, correct.max)) {
+        std::cout << "Line " << line << ": bounds of " << e
+                  << " were [" << memoized.min << ", " << memoized.max
+                  << "] instead of [" << correct.min << ", " << correct.max << "]\n";
+        return -1;
+    }
+    return 0;
+}
+
+#define CHECK(i, e, s, fb)                     \
+    if (check(i, e, s, fb, __LINE__)) {        \
+        return -1;                             \
+    }
+
+int main(int argc, char **argv) {
+    FuncValueBounds fb;
+    fb[{"f", 0}] = Interval(0, 10);
+
+    Scope<Interval> s1, s2, s3;
+    s1.push("x", Interval(0, 100));
+    s1.push("y", Interval(1, 8));
+    // Same bounds for x, different ones for y.
+    s2.push("x", Interval(0, 100));
+    s2.push("y", Interval(2, 4));
+    // The divisor's bounds refer to another variable in the scope.
+    s3.push("x", Interval(0, 100));
+    s3.push("y", Interval(a, a));
+    s3.push("a", Interval(3, 5));
+
+    std::vector<Interval> results;
+    {
+        BoundsMemoScope memo;
+        for (int i = 0; i < 3; i++) {
+            results.push_back(bounds_of_expr_in_scope(make_expr(), s1, fb));
+            results.push_back(bounds_of_expr_in_scope(make_expr(), s2, fb));
+            results.push_back(bounds_of_expr_in_scope(make_expr(), s3, fb));
+            results.push_back(bounds_of_expr_in_scope(make_expr(), s1));
+        }
+        // Changing a binding the result depends on indirectly must
+        // not reuse the old result.
+        s3.pop("a");
+        s3.push("a", Interval(-5, 5));
+        results.push_back(bounds_of_expr_in_scope(make_expr(), s3, fb));
+        // Nor may changing the function value bounds.
+        fb[{"f", 0}] = Interval(-10, 10);
+        results.push_back(bounds_of_expr_in_scope(make_expr(), s1, fb));
+    }
+
+    for (int i = 0; i < 3; i++) {
+        fb[{"f", 0}] = Interval(0, 10);
+        s3.pop("a");
+        s3.push("a", Interval(3, 5));
+        CHECK(results[i * 4 + 0], make_expr(), s1, fb);
+        CHECK(results[i * 4 + 1], make_expr(), s2, fb);
+        CHECK(results[i * 4 + 2], make_expr(), s3, fb);
+        CHECK(results[i * 4 + 3], make_expr(), s1, FuncValueBounds());
+    }
+    s3.pop("a");
+    s3.push("a", Interval(-5, 5));
+    CHECK(results[12], make_expr(), s3, fb);
+    fb[{"f", 0}] = Interval(-10, 10);
+    CHECK(results[13], make_expr(), s1, fb);
+
+    printf("Success!\n");
+    return 0;
+}
@@ -0,0 +1,58 @@
+#include "Halide.h"
+#include <stdio.h>
+
+using namespace Halide;
+
+int main(int argc, char **argv) {
+    ImageParam in(Int(32), 2, "in");
+    Param<int> offset("offset");
+    Param<float> scale("scale");
+    Var x("x"), y("y");
+
+    Func f("f");
+    f(x, y) = Tuple(in(x, y) + offset, cast<float>(in(x, y)) * scale);
+
+    // The argument order doesn't have to match the order the pipeline
+    // uses them in, and unused arguments are allowed.
+    Param<int> unused("unused");
+    Callable c = f.compile_to_callable({scale, unused, in, offset});
+
+    Buffer<int> input(16, 8);
+    input.for_each_element([&](int x, int y) { input(x, y) = x * 10 + y; });
+
+    for (int i = 0; i < 3; i++) {
+        Buffer<int> out_int(16, 8);
+        Buffer<float> out_float(16, 8);
+        float s = 0.5f * i;
+        int result = c(s, 7, input, i, out_int, out_float);
+        if (result != 0) {
+            printf("Callable returned %d\n", result);
+            return -1;
+        }
+        for (int y = 0; y < 8; y++) {
+            for (int x = 0; x < 16; x++) {
+                int correct_int = input(x, y) + i;
+                float correct_float = input(x, y) * s;
+                if (out_int(x, y) != correct_int || out_float(x, y) != correct_float) {
+                    printf("out(%d, %d) = {%d, %f} instead of {%d, %f}\n",
+                           x, y, out_int(x, y), out_float(x, y), correct_int, correct_float);
+                    return -1;
+                }
+            }
+        }
+    }
+
+    // Raw halide_buffer_t pointers work too, and the bound values of
+    // the Params are ignored.
+    offset.set(1000);
+    Runtime::Buffer<int> out_int(16, 8);
+    Runtime::Buffer<float> out_float(16, 8);
+    c(1.0f, 0, input.raw_buffer(), 1, out_int, out_float.raw_buffer());
+    if (out_int(3, 2) != input(3, 2) + 1) {
+        printf("out_int(3, 2) = %d instead of %d\n", out_int(3, 2), input(3, 2) + 1);
+        return -1;
+    }
+
+    printf("Success!\n");
+    return 0;
+}
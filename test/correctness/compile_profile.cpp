@@ -0,0 +1,85 @@
+#include "Halide.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#ifndef _WIN32
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#include "test/common/halide_test_dirs.h"
+
+using namespace Halide;
+
+#ifndef _WIN32
+// The compile profile is read from the environment once, and written
+// out when the process exits, so compile in a child process.
+std::string profile_compilation(const std::string &mode, const std::string &file) {
+    Internal::ensure_no_file_exists(file);
+    pid_t pid = fork();
+    if (pid == 0) {
+        setenv("HL_COMPILE_PROFILE", mode.c_str(), 1);
+        setenv("HL_COMPILE_PROFILE_FILE", file.c_str(), 1);
+        Func f("f"), g("g");
+        Var x("x");
+        f(x) = x * 2;
+        g(x) = f(x) + f(x + 1);
+        f.compute_root();
+        g.vectorize(x, 4);
+        g.compile_jit();
+        exit(0);
+    }
+    int status = 0;
+    if (pid < 0 || waitpid(pid, &status, 0) != pid || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        printf("Compiling with HL_COMPILE_PROFILE=%s failed\n", mode.c_str());
+        exit(-1);
+    }
+    std::ifstream in(file.c_str());
+    std::stringstream contents;
+    contents << in.rdbuf();
+    return contents.str();
+}
+
+bool contains(const std::string &report, const std::string &str) {
+    if (report.find(str) == std::string::npos) {
+        printf("Compile profile does not contain \"%s\":\n%s\n", str.c_str(), report.c_str());
+        return false;
+    }
+    return true;
+}
+#endif
+
+int main(int argc, char **argv) {
+#ifdef _WIN32
+    printf("Skipping test on Windows\n");
+#else
+    // One phase from lowering, two from LLVM, and the jit.
+    const char *phases[] = {"vectorizing", "generating llvm bitcode", "llvm optimization", "jit compilation"};
+
+    std::string text = profile_compilation("1", Internal::get_test_tmp_dir() + "compile_profile.txt");
+    if (!contains(text, "Compile profile:") || !contains(text, "g: ")) {
+        return -1;
+    }
+    for (const char *phase : phases) {
+        if (!contains(text, phase)) {
+            return -1;
+        }
+    }
+
+    std::string json = profile_compilation("json", Internal::get_test_tmp_dir() + "compile_profile.json");
+    if (!contains(json, "{\"phases\": [") || !contains(json, "\"pipeline\": \"g\"")) {
+        return -1;
+    }
+    for (const char *phase : phases) {
+        if (!contains(json, std::string("\"phase\": \"") + phase)) {
+            return -1;
+        }
+    }
+#endif
+
+    printf("Success!\n");
+    return 0;
+}
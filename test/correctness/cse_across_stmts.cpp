@@ -0,0 +1,62 @@
+#include "Halide.h"
+#include <math.h>
+#include <stdio.h>
+
+using namespace Halide;
+
+// Lowering shares common subexpressions between statements. Unrolled
+// derivative pipelines that store to several buffers give it lots of
+// index math and loads to share, with stores in between that it must
+// not move loads across.
+
+int main(int argc, char **argv) {
+    const int size = 64;
+    Buffer<float> input(size + 1, "input");
+    input.for_each_element([&](int x) { input(x) = sinf(x * 0.3f) + 0.5f; });
+
+    Var x("x");
+    Func f("f"), g("g");
+    f(x) = input(x) * input(x + 1);
+    g(x) = Tuple(f(x) * 2.0f, f(x) + input(x));
+
+    RDom r(0, size);
+    Func loss("loss");
+    loss() = 0.0f;
+    loss() += g(r.x)[0] * g(r.x)[0] + g(r.x)[1];
+
+    f.compute_root().unroll(x, 4);
+    g.compute_root().unroll(x, 4);
+
+    Derivative d = propagate_adjoints(loss);
+    for (Func a : d.funcs(f)) {
+        a.compute_root().unroll(a.args()[0], 4);
+    }
+    for (Func a : d.funcs(g)) {
+        a.compute_root().unroll(a.args()[0], 4);
+    }
+    Func d_input = d(input);
+    d_input.unroll(d_input.args()[0], 4);
+
+    Buffer<float> result = d_input.realize(size + 1);
+
+    // loss = sum_x 4 f(x)^2 + f(x) + input(x), with
+    // f(x) = input(x) * input(x + 1).
+    for (int k = 0; k <= size; k++) {
+        double correct = k < size ? 1.0 : 0.0;
+        if (k < size) {
+            double fk = (double)input(k) * input(k + 1);
+            correct += (8 * fk + 1) * input(k + 1);
+        }
+        if (k > 0) {
+            double fk = (double)input(k - 1) * input(k);
+            correct += (8 * fk + 1) * input(k - 1);
+        }
+        if (fabs(result(k) - correct) > 1e-4 * (1 + fabs(correct))) {
+            printf("d_input(%d) = %f instead of %f\n", k, result(k), correct);
+            return -1;
+        }
+    }
+
+    printf("Success!\n");
+    return 0;
+}
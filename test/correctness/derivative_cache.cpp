@@ -0,0 +1,114 @@
+#include "Halide.h"
+#include <algorithm>
+#include <cmath>
+#include <stdio.h>
+
+using namespace Halide;
+
+const int size = 16;
+
+struct TestPipeline {
+    Buffer<float> in;
+    Param<float> w;
+    Func f, loss;
+    Derivative d;
+};
+
+// Builds the same loss with new names each time, so the second
+// call to propagate_adjoints can reuse the result of the first.
+void make_pipeline(TestPipeline &p, float seed, float w) {
+    p.in = Buffer<float>(size);
+    p.in.for_each_element([&](int x) { p.in(x) = std::sin(x * seed); });
+    p.w.set(w);
+
+    Var x("x");
+    Func clamped = BoundaryConditions::repeat_edge(p.in);
+    p.f(x) = p.w * clamped(x - 1) + clamped(x + 1);
+    RDom r(0, size);
+    p.loss() = 0.f;
+    p.loss() += p.f(r) * p.f(r);
+    p.d = propagate_adjoints(p.loss);
+}
+
+int check(const TestPipeline &p, float w) {
+    auto clamp_index = [](int x) { return std::min(std::max(x, 0), size - 1); };
+    std::vector<float> correct(size, 0.f);
+    for (int r = 0; r < size; r++) {
+        float f = w * p.in(clamp_index(r - 1)) + p.in(clamp_index(r + 1));
+        correct[clamp_index(r - 1)] += 2 * f * w;
+        correct[clamp_index(r + 1)] += 2 * f;
+    }
+
+    Buffer<float> d_in = p.d(p.in).realize(size);
+    for (int x = 0; x < size; x++) {
+        if (std::abs(d_in(x) - correct[x]) > 1e-4f * std::max(1.f, std::abs(correct[x]))) {
+            printf("d_in(%d) = %f instead of %f\n", x, d_in(x), correct[x]);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// Check how many times propagate_adjoints reused a cached derivative
+// since the last call.
+bool check_hits(int expected) {
+    static int last = 0;
+    int hits = Internal::derivative_cache_hits() - last;
+    last += hits;
+    if (hits != expected) {
+        printf("Expected %d cache hits instead of %d\n", expected, hits);
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char **argv) {
+    TestPipeline a, b;
+    make_pipeline(a, 0.3f, 2.0f);
+    if (!check_hits(0)) {
+        return -1;
+    }
+    make_pipeline(b, 0.7f, -0.5f);
+    if (!check_hits(1)) {
+        return -1;
+    }
+
+    if (a.d(a.in).name() == b.d(b.in).name()) {
+        printf("The two derivatives share the Func %s\n", a.d(a.in).name().c_str());
+        return -1;
+    }
+    // The adjoints of the second pipeline are keyed by its own Funcs.
+    if (a.d(a.f).name() == b.d(b.f).name()) {
+        printf("The two derivatives share the Func %s\n", a.d(a.f).name().c_str());
+        return -1;
+    }
+
+    // Realize the second one first, so that scheduling or compiling
+    // it can't have changed the first.
+    if (check(b, -0.5f) || check(a, 2.0f)) {
+        return -1;
+    }
+
+    // The cache doesn't depend on the pipelines it was filled from
+    // staying alive.
+    {
+        TestPipeline c;
+        make_pipeline(c, 0.5f, 1.5f);
+        a = b = TestPipeline();
+        TestPipeline d;
+        make_pipeline(d, 0.9f, 3.0f);
+        if (!check_hits(2) || check(d, 3.0f)) {
+            return -1;
+        }
+    }
+
+    clear_derivative_cache();
+    TestPipeline e;
+    make_pipeline(e, 0.1f, 0.25f);
+    if (!check_hits(0) || check(e, 0.25f)) {
+        return -1;
+    }
+
+    printf("Success!\n");
+    return 0;
+}
@@ -0,0 +1,119 @@
+#include "Halide.h"
+#include <stdio.h>
+#include <string>
+
+#ifndef _WIN32
+#include <dirent.h>
+#include <unistd.h>
+#endif
+
+#include "test/common/halide_test_dirs.h"
+
+using namespace Halide;
+
+Func make_pipeline() {
+    Func f("f"), g("g");
+    Var x("x"), y("y");
+    f(x, y) = x * 3 + y;
+    g(x, y) = f(x, y) + f(x + 1, y);
+    f.compute_root();
+    g.vectorize(x, 8);
+    return g;
+}
+
+bool check(const Buffer<int> &out) {
+    for (int y = 0; y < out.height(); y++) {
+        for (int x = 0; x < out.width(); x++) {
+            int correct = x * 6 + 3 + y * 2;
+            if (out(x, y) != correct) {
+                printf("out(%d, %d) = %d instead of %d\n", x, y, out(x, y), correct);
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+#ifndef _WIN32
+// Count the complete entries in the cache, optionally deleting them.
+int count_entries(const std::string &cache_dir, bool remove) {
+    int objects = 0, modules = 0;
+    DIR *dir = opendir(cache_dir.c_str());
+    if (!dir) {
+        return 0;
+    }
+    while (dirent *entry = readdir(dir)) {
+        std::string name = entry->d_name;
+        if (name.find("halide_jit_") != 0) continue;
+        if (remove) {
+            unlink((cache_dir + "/" + name).c_str());
+            continue;
+        }
+        if (name.size() > 2 && name.substr(name.size() - 2) == ".o") objects++;
+        if (name.size() > 3 && name.substr(name.size() - 3) == ".bc") modules++;
+    }
+    closedir(dir);
+    if (objects != modules) {
+        printf("Expected matching cached objects and modules, got %d and %d\n", objects, modules);
+        exit(-1);
+    }
+    return objects;
+}
+#endif
+
+int main(int argc, char **argv) {
+    std::string cache_dir = Internal::get_test_tmp_dir() + "jit_cache";
+    // Must be set before the first pipeline is compiled.
+    std::string cache_env = "HL_JIT_CACHE_DIR=" + cache_dir;
+    putenv(&cache_env[0]);
+
+#ifndef _WIN32
+    // Start from an empty cache, so that the first compilation misses.
+    count_entries(cache_dir, true);
+#endif
+
+    Buffer<int> out = make_pipeline().realize(32, 16);
+    if (!check(out)) {
+        return -1;
+    }
+
+#ifndef _WIN32
+    if (count_entries(cache_dir, false) == 0) {
+        printf("Nothing was written to the cache directory %s\n", cache_dir.c_str());
+        return -1;
+    }
+#endif
+
+    // Compile something else in between, so that the temporaries of
+    // the next compilation get different names from those of the
+    // first.
+    {
+        Func h;
+        Var x;
+        h(x) = x * 2 + 1;
+        h.realize(16);
+    }
+
+#ifndef _WIN32
+    int entries = count_entries(cache_dir, false);
+#endif
+
+    // The same pipeline again must be read from the cache rather than
+    // adding a new entry.
+    out = make_pipeline().realize(32, 16);
+    if (!check(out)) {
+        return -1;
+    }
+
+#ifndef _WIN32
+    int entries_after = count_entries(cache_dir, false);
+    if (entries_after != entries) {
+        printf("Compiling the pipeline again missed the cache: there were %d entries before and %d after\n",
+               entries, entries_after);
+        return -1;
+    }
+#endif
+
+    printf("Success!\n");
+    return 0;
+}
@@ -0,0 +1,101 @@
+#include <chrono>
+#include <stdio.h>
+#include <thread>
+#include "Halide.h"
+#include "HalideRuntime.h"
+
+using namespace Halide;
+
+#ifdef _WIN32
+#define DLLEXPORT __declspec(dllexport)
+#else
+#define DLLEXPORT
+#endif
+
+int expensive_calls = 0;
+
+// A small result that takes a long time to compute.
+extern "C" DLLEXPORT int expensive(halide_buffer_t *out) {
+    if (!out->is_bounds_query()) {
+        expensive_calls++;
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        Halide::Runtime::Buffer<uint8_t>(*out).fill(42);
+    }
+    return 0;
+}
+
+// A large result that is cheap to compute.
+extern "C" DLLEXPORT int cheap(uint8_t val, halide_buffer_t *out) {
+    if (!out->is_bounds_query()) {
+        Halide::Runtime::Buffer<uint8_t>(*out).fill(val);
+    }
+    return 0;
+}
+
+// Store the expensive result, then two cheap ones, which together
+// overflow the cache. Returns how many times the expensive result had
+// to be computed when it is requested again afterwards.
+int run(int policy) {
+    Internal::JITSharedRuntime::memoization_cache_set_eviction_policy(policy);
+    // Flush the cache, then size it to hold the expensive entry plus
+    // one cheap one.
+    Internal::JITSharedRuntime::memoization_cache_set_size(1);
+    Internal::JITSharedRuntime::memoization_cache_set_size(100 * 1024);
+
+    Var x, y;
+
+    Func e;
+    e.define_extern("expensive", {}, UInt(8), 2);
+    e.compute_root().memoize();
+    Func use_e;
+    use_e(x, y) = e(x, y);
+
+    Param<uint8_t> val;
+    Func c;
+    c.define_extern("cheap", {val}, UInt(8), 2);
+    c.compute_root().memoize();
+    Func use_c;
+    use_c(x, y) = c(x, y);
+
+    expensive_calls = 0;
+    use_e.realize(16, 16);
+    for (int i = 1; i <= 2; i++) {
+        val.set(i);
+        Buffer<uint8_t> out = use_c.realize(256, 256);
+        if (out(0, 0) != i) {
+            printf("Incorrect cheap result: %d instead of %d\n", out(0, 0), i);
+            exit(-1);
+        }
+    }
+    Buffer<uint8_t> out = use_e.realize(16, 16);
+    if (out(0, 0) != 42) {
+        printf("Incorrect expensive result: %d instead of 42\n", out(0, 0));
+        exit(-1);
+    }
+    return expensive_calls;
+}
+
+int main(int argc, char **argv) {
+    // LRU evicts the expensive entry, as it is the oldest.
+    int lru_calls = run(halide_memoization_cache_evict_lru);
+    if (lru_calls != 2) {
+        printf("Expected the LRU policy to recompute the expensive Func, "
+               "but it was computed %d times\n", lru_calls);
+        return -1;
+    }
+
+    // The cost-aware policy evicts the first cheap entry instead.
+    int cost_aware_calls = run(halide_memoization_cache_evict_cost_aware);
+    if (cost_aware_calls != 1) {
+        printf("Expected the cost-aware policy to keep the expensive Func, "
+               "but it was computed %d times\n", cost_aware_calls);
+        return -1;
+    }
+
+    // Return the cache to its defaults.
+    Internal::JITSharedRuntime::memoization_cache_set_eviction_policy(halide_memoization_cache_evict_lru);
+    Internal::JITSharedRuntime::memoization_cache_set_size(0);
+
+    printf("Success!\n");
+    return 0;
+}
@@ -0,0 +1,131 @@
+#include <stdio.h>
+#include "Halide.h"
+
+using namespace Halide;
+
+#ifdef _WIN32
+#define DLLEXPORT __declspec(dllexport)
+#else
+#define DLLEXPORT
+#endif
+
+int call_count = 0;
+
+extern "C" DLLEXPORT int count_calls_with_arg(uint8_t val, halide_buffer_t *out) {
+    if (!out->is_bounds_query()) {
+        call_count++;
+        Halide::Runtime::Buffer<uint8_t>(*out).fill(val);
+    }
+    return 0;
+}
+
+// Drop the JIT-compiled pipeline and the shared runtime, and with it
+// the in-memory cache, as if the process had been restarted. The
+// persistent file stays attached.
+void restart(Pipeline &p) {
+    p.invalidate_cache();
+    Internal::JITSharedRuntime::release_all();
+}
+
+bool check(Pipeline &p, Param<uint8_t> &val, uint8_t v, int expected_calls) {
+    val.set(v);
+    Buffer<uint8_t> out = p.realize(16, 16);
+    for (int y = 0; y < out.height(); y++) {
+        for (int x = 0; x < out.width(); x++) {
+            if (out(x, y) != v) {
+                printf("out(%d, %d) = %d instead of %d\n", x, y, out(x, y), v);
+                return false;
+            }
+        }
+    }
+    if (call_count != expected_calls) {
+        printf("Memoized Func was called %d times instead of %d\n", call_count, expected_calls);
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char **argv) {
+#ifdef _WIN32
+    printf("Persistent memoization is not supported on Windows. Skipping test\n");
+    printf("Success!\n");
+    return 0;
+#endif
+
+    Internal::TemporaryFile cache_file("memoize_persistent", ".cache");
+
+    Param<uint8_t> val;
+    Func f("f"), g("g");
+    Var x, y;
+    std::vector<ExternFuncArgument> args;
+    args.push_back(val);
+    f.define_extern("count_calls_with_arg", args, UInt(8), 2);
+    g(x, y) = f(x, y);
+    f.compute_root().memoize();
+    Pipeline p(g);
+
+    if (Internal::JITSharedRuntime::memoization_cache_set_persistent_file(cache_file.pathname(), 1, 1 << 20) != 0) {
+        printf("Could not attach the persistent cache file\n");
+        return -1;
+    }
+
+    // Miss, then an in-memory hit.
+    if (!check(p, val, 1, 1) || !check(p, val, 1, 1)) {
+        return -1;
+    }
+
+    // After a restart the result comes from the file.
+    restart(p);
+    if (!check(p, val, 1, 1)) {
+        return -1;
+    }
+    halide_memoization_cache_stats stats;
+    Internal::JITSharedRuntime::memoization_cache_get_stats(&stats);
+    if (stats.hits != 1 || stats.misses != 0) {
+        printf("Expected a hit from the persistent file, got %d hits and %d misses\n",
+               (int)stats.hits, (int)stats.misses);
+        return -1;
+    }
+
+    // Records written under another fingerprint are not used.
+    Internal::JITSharedRuntime::memoization_cache_set_persistent_file(cache_file.pathname(), 2, 1 << 20);
+    restart(p);
+    if (!check(p, val, 1, 2)) {
+        return -1;
+    }
+
+    // Shrink the file so that it only holds one record. Storing a
+    // second record evicts the least recently used one.
+    Internal::JITSharedRuntime::memoization_cache_set_persistent_file(cache_file.pathname(), 3, 600);
+    restart(p);
+    if (!check(p, val, 1, 3) || !check(p, val, 2, 4)) {
+        return -1;
+    }
+    restart(p);
+    if (!check(p, val, 2, 4) || !check(p, val, 1, 5)) {
+        return -1;
+    }
+
+    // A record damaged while the file wasn't attached, as it would be
+    // by a process dying part way through writing it, is not used.
+    Internal::JITSharedRuntime::memoization_cache_set_persistent_file("", 0);
+    FILE *file = fopen(cache_file.pathname().c_str(), "r+b");
+    if (file == NULL || fseek(file, 300, SEEK_SET) != 0) {
+        printf("Could not open the persistent cache file\n");
+        return -1;
+    }
+    int byte = fgetc(file);
+    fseek(file, 300, SEEK_SET);
+    fputc(byte ^ 0xff, file);
+    fclose(file);
+    Internal::JITSharedRuntime::memoization_cache_set_persistent_file(cache_file.pathname(), 3, 600);
+    restart(p);
+    if (!check(p, val, 1, 6)) {
+        return -1;
+    }
+
+    Internal::JITSharedRuntime::memoization_cache_set_persistent_file("", 0);
+
+    printf("Success!\n");
+    return 0;
+}
@@ -0,0 +1,68 @@
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#include "Halide.h"
+
+using namespace Halide;
+
+int main(int argc, char **argv) {
+    Param<int> p;
+    Func f("memoized_f"), g;
+    Var x, y;
+    f(x, y) = x + y + p;
+    g(x, y) = f(x, y);
+    f.compute_root().memoize();
+
+    // Miss, hit, then a miss for a new parameter value.
+    p.set(1);
+    g.realize(16, 16);
+    g.realize(16, 16);
+    p.set(2);
+    g.realize(16, 16);
+
+    halide_memoization_cache_stats stats;
+    int num_funcs = Internal::JITSharedRuntime::memoization_cache_get_stats(&stats);
+    if (num_funcs != 1) {
+        printf("Expected counters for one memoized Func, got %d\n", num_funcs);
+        return -1;
+    }
+    std::vector<halide_memoization_cache_func_stats> funcs(num_funcs);
+    Internal::JITSharedRuntime::memoization_cache_get_stats(&stats, funcs.data(), num_funcs);
+
+    const uint64_t entry_bytes = 16 * 16 * sizeof(int);
+    if (stats.lookups != 3 || stats.hits != 1 || stats.misses != 2 ||
+        stats.stores != 2 || stats.evictions != 0 ||
+        stats.entries != 2 || stats.entries_in_use != 0 ||
+        stats.bytes != 2 * entry_bytes || stats.peak_bytes != 2 * entry_bytes) {
+        printf("Unexpected cache counters: lookups %d hits %d misses %d stores %d evictions %d "
+               "entries %d in use %d bytes %d peak %d\n",
+               (int)stats.lookups, (int)stats.hits, (int)stats.misses, (int)stats.stores,
+               (int)stats.evictions, (int)stats.entries, (int)stats.entries_in_use,
+               (int)stats.bytes, (int)stats.peak_bytes);
+        return -1;
+    }
+
+    const halide_memoization_cache_func_stats &fs = funcs[0];
+    if (strcmp(fs.name, "memoized_f") != 0) {
+        printf("Per-Func counters are for %s instead of memoized_f\n", fs.name);
+        return -1;
+    }
+    if (fs.lookups != 3 || fs.hits != 1 || fs.misses != 2 || fs.stores != 2 ||
+        fs.bytes != 2 * entry_bytes) {
+        printf("Per-Func counters don't match the totals\n");
+        return -1;
+    }
+
+    // Shrinking the cache evicts everything.
+    Internal::JITSharedRuntime::memoization_cache_set_size(1);
+    Internal::JITSharedRuntime::memoization_cache_get_stats(&stats, funcs.data(), num_funcs);
+    if (stats.evictions != 2 || stats.entries != 0 || stats.bytes != 0 ||
+        funcs[0].evictions != 2 || funcs[0].bytes != 0 || funcs[0].peak_bytes != 2 * entry_bytes) {
+        printf("Evictions were not counted\n");
+        return -1;
+    }
+    Internal::JITSharedRuntime::memoization_cache_set_size(0);
+
+    printf("Success!\n");
+    return 0;
+}
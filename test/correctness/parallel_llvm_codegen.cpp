@@ -0,0 +1,67 @@
+#include "Halide.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "test/common/halide_test_dirs.h"
+
+using namespace Halide;
+
+int main(int argc, char **argv) {
+    // Must be set before anything is compiled.
+    char threads_env[] = "HL_LLVM_CODEGEN_THREADS=4";
+    putenv(threads_env);
+
+    // Several stages with parallel loops, so that the module has
+    // plenty of functions to spread across the pieces.
+    const int num_stages = 6;
+    Var x("x"), y("y");
+    std::vector<Func> stages;
+    Func input("input");
+    input(x, y) = x + y;
+    stages.push_back(input);
+    for (int i = 1; i < num_stages; i++) {
+        Func f("stage_" + std::to_string(i));
+        f(x, y) = stages.back()(x, y) * 2 + stages.back()(x + 1, y);
+        f.compute_root().parallel(y).vectorize(x, 8);
+        stages.push_back(f);
+    }
+    Func output = stages.back();
+
+    Buffer<int> result = output.realize(64, 64);
+
+    // Check against a reference computed one stage at a time.
+    for (int y = 0; y < 64; y++) {
+        for (int x = 0; x < 64; x++) {
+            std::vector<int> row(num_stages + 1);
+            for (int i = 0; i <= num_stages; i++) {
+                row[i] = x + i + y;
+            }
+            for (int s = 1; s < num_stages; s++) {
+                for (int i = 0; i + 1 < (int)row.size(); i++) {
+                    row[i] = row[i] * 2 + row[i + 1];
+                }
+                row.pop_back();
+            }
+            if (result(x, y) != row[0]) {
+                printf("result(%d, %d) = %d instead of %d\n", x, y, result(x, y), row[0]);
+                return -1;
+            }
+        }
+    }
+
+    // Static libraries get one object per piece.
+    Target target = get_host_target();
+    std::string lib_name = Internal::get_test_tmp_dir() + "parallel_llvm_codegen";
+    std::string lib_file = lib_name;
+    if (target.os == Target::Windows && !target.has_feature(Target::MinGW)) {
+        lib_file += ".lib";
+    } else {
+        lib_file += ".a";
+    }
+    Internal::ensure_no_file_exists(lib_file);
+    output.compile_to_static_library(lib_name, std::vector<Argument>(), "", target);
+    Internal::assert_file_exists(lib_file);
+
+    printf("Success!\n");
+    return 0;
+}
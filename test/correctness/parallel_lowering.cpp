@@ -0,0 +1,113 @@
+#include "Halide.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#ifndef _WIN32
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#include "test/common/halide_test_dirs.h"
+
+using namespace Halide;
+
+Func make_pipeline(ImageParam in, Param<bool> flip) {
+    Var x("x"), y("y"), xi("xi");
+
+    // Several stages computed at root, plus a specialization, give
+    // the late lowering passes plenty of independent loop nests.
+    Func a("a"), b("b"), c("c"), out("out");
+    a(x, y) = in(x, y) * 3;
+    b(x, y) = in(x, y) + y;
+    c(x, y) = a(x, y) - b(x + 1, y);
+    out(x, y) = select(flip, c(x, y) * 2, c(x, y) + a(x, y));
+
+    a.compute_root().vectorize(x, 8);
+    b.compute_root().unroll(x, 2);
+    c.compute_root().split(x, x, xi, 8, TailStrategy::GuardWithIf).vectorize(xi);
+    out.specialize(flip).vectorize(x, 4);
+    return out;
+}
+
+#ifndef _WIN32
+// Lower the pipeline in a child process. Each child starts from the
+// same state, so the names it generates only differ from one child
+// to the next if they depend on how the threads were scheduled.
+std::string lower_in_child(const std::string &file) {
+    Internal::ensure_no_file_exists(file);
+    pid_t pid = fork();
+    if (pid == 0) {
+        ImageParam in(Int(32), 2, "in");
+        Param<bool> flip("flip");
+        make_pipeline(in, flip).compile_to_lowered_stmt(file, {in, flip});
+        exit(0);
+    }
+    int status = 0;
+    if (pid < 0 || waitpid(pid, &status, 0) != pid || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        printf("Lowering in a child process failed\n");
+        exit(-1);
+    }
+    std::ifstream in(file.c_str());
+    std::stringstream contents;
+    contents << in.rdbuf();
+    return contents.str();
+}
+#endif
+
+int main(int argc, char **argv) {
+    // Must be set before anything gets lowered.
+    setenv("HL_LOWERING_THREADS", "4", 1);
+
+#ifndef _WIN32
+    // Fork before this process lowers anything, so that the children
+    // don't inherit the lowering thread pool.
+    std::string first = lower_in_child(Internal::get_test_tmp_dir() + "parallel_lowering_0.stmt");
+    std::string second = lower_in_child(Internal::get_test_tmp_dir() + "parallel_lowering_1.stmt");
+    if (first.empty() || first != second) {
+        printf("Lowering in parallel is not deterministic:\n%s\n\n%s\n", first.c_str(), second.c_str());
+        return -1;
+    }
+#endif
+
+    ImageParam in(Int(32), 2, "in");
+    Param<bool> flip("flip");
+    Func out = make_pipeline(in, flip);
+
+    Buffer<int> input(67, 20);
+    input.for_each_element([&](int x, int y) { input(x, y) = x * 7 - y * 3; });
+    in.set(input);
+
+    for (bool f : {false, true}) {
+        flip.set(f);
+        Buffer<int> result = out.realize(64, 20);
+        for (int y = 0; y < 20; y++) {
+            for (int x = 0; x < 64; x++) {
+                int av = input(x, y) * 3;
+                int cv = av - (input(x + 1, y) + y);
+                int correct = f ? cv * 2 : cv + av;
+                if (result(x, y) != correct) {
+                    printf("out(%d, %d) = %d instead of %d\n", x, y, result(x, y), correct);
+                    return -1;
+                }
+            }
+        }
+    }
+
+    // Check the passes really did run in parallel, rather than
+    // quietly falling back to running on the whole Stmt.
+    if (Internal::lowering_parallel_runs() == 0) {
+        printf("No lowering pass ran in parallel\n");
+        return -1;
+    }
+    if (Internal::lowering_serial_fallbacks() != 0) {
+        printf("%d of %d parallel lowering passes fell back to running serially\n",
+               Internal::lowering_serial_fallbacks(), Internal::lowering_parallel_runs());
+        return -1;
+    }
+
+    printf("Success!\n");
+    return 0;
+}
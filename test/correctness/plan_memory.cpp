@@ -0,0 +1,78 @@
+#include <stdio.h>
+#include "Halide.h"
+
+using namespace Halide;
+
+int mallocs = 0;
+size_t largest_malloc = 0;
+
+void *my_malloc(void *, size_t sz) {
+    mallocs++;
+    largest_malloc = std::max(largest_malloc, sz);
+    return malloc(sz);
+}
+
+void my_free(void *, void *ptr) {
+    free(ptr);
+}
+
+int main(int argc, char **argv) {
+    Target t = get_jit_target_from_environment();
+    if (t.has_gpu_feature()) {
+        printf("Memory planning does not apply to gpu targets. Skipping test\n");
+        printf("Success!\n");
+        return 0;
+    }
+
+    const int size = 256;
+    const size_t buffer_bytes = size * size * sizeof(int);
+
+    // A chain of compute_root stages, of which only two are live at
+    // a time, so the planned arena needs room for just two of them.
+    Var x, y;
+    Func stages[5];
+    stages[0](x, y) = x + y;
+    for (int i = 1; i < 5; i++) {
+        stages[i](x, y) = stages[i - 1](x, y) * 2 + stages[i - 1](size - 1 - x, y);
+    }
+    Func out;
+    out(x, y) = stages[4](x, y);
+    for (int i = 0; i < 5; i++) {
+        stages[i].compute_root();
+    }
+    out.bound(x, 0, size).bound(y, 0, size);
+    out.set_custom_allocator(my_malloc, my_free);
+
+    Buffer<int> reference = out.realize(size, size, t);
+    int unplanned_mallocs = mallocs;
+
+    mallocs = 0;
+    largest_malloc = 0;
+    Buffer<int> planned = out.realize(size, size, t.with_feature(Target::PlanMemory));
+
+    if (unplanned_mallocs != 5) {
+        printf("Expected 5 mallocs without memory planning, got %d\n", unplanned_mallocs);
+        return -1;
+    }
+    if (mallocs != 1) {
+        printf("Expected 1 malloc with memory planning, got %d\n", mallocs);
+        return -1;
+    }
+    if (largest_malloc < 2 * buffer_bytes || largest_malloc > 3 * buffer_bytes) {
+        printf("Arena of %d bytes is not sized for two live stages of %d bytes\n",
+               (int)largest_malloc, (int)buffer_bytes);
+        return -1;
+    }
+
+    for (int y = 0; y < size; y++) {
+        for (int x = 0; x < size; x++) {
+            if (planned(x, y) != reference(x, y)) {
+                printf("planned(%d, %d) = %d instead of %d\n", x, y, planned(x, y), reference(x, y));
+                return -1;
+            }
+        }
+    }
+
+    printf("Success!\n");
+    return 0;
+}
@@ -0,0 +1,124 @@
+#include "Halide.h"
+#include <stdio.h>
+
+using namespace Halide;
+using namespace Halide::Internal;
+
+class CountAllocations : public IRVisitor {
+public:
+    int registers = 0, scalars = 0, stack = 0;
+
+protected:
+    using IRVisitor::visit;
+
+    void visit(const Allocate *op) override {
+        if (op->memory_type == MemoryType::Register) {
+            registers++;
+        } else if (op->memory_type == MemoryType::Stack) {
+            if (op->extents.empty()) {
+                scalars++;
+            } else {
+                stack++;
+            }
+        }
+        IRVisitor::visit(op);
+    }
+};
+
+class CheckAllocations : public IRMutator2 {
+    int scalars, stack;
+public:
+    CheckAllocations(int scalars, int stack) : scalars(scalars), stack(stack) {}
+    using IRMutator2::mutate;
+
+    Stmt mutate(const Stmt &s) override {
+        CountAllocations c;
+        s.accept(&c);
+
+        if (c.registers != 0 || c.scalars != scalars || c.stack != stack) {
+            printf("There were %d register, %d scalar and %d stack allocations. "
+                   "There were supposed to be 0, %d and %d\n",
+                   c.registers, c.scalars, c.stack, scalars, stack);
+            exit(-1);
+        }
+
+        return s;
+    }
+};
+
+int mallocs = 0;
+
+void *counting_malloc(void *user_context, size_t x) {
+    mallocs++;
+    void *orig = malloc(x + 32);
+    void *ptr = (void *)((((size_t)orig + 32) >> 5) << 5);
+    ((void **)ptr)[-1] = orig;
+    return ptr;
+}
+
+void counting_free(void *user_context, void *ptr) {
+    free(((void **)ptr)[-1]);
+}
+
+int main(int argc, char **argv) {
+    {
+        // A Func stored in registers and accessed at constant
+        // coordinates becomes one scalar per element.
+        Func f("f"), g("g");
+        Var x("x"), y("y"), xo("xo"), xi("xi");
+
+        f(x, y) = x * 3 + y;
+        g(x, y) = f(x, y) + f(x + 1, y) * 2;
+
+        g.split(x, xo, xi, 4).unroll(xi);
+        f.compute_at(g, xo).store_in(MemoryType::Register).unroll(x);
+
+        // Five elements per tile.
+        g.add_custom_lowering_pass(new CheckAllocations(5, 0));
+
+        Buffer<int> out = g.realize(64, 16);
+        for (int y = 0; y < out.height(); y++) {
+            for (int x = 0; x < out.width(); x++) {
+                int correct = (x * 3 + y) + ((x + 1) * 3 + y) * 2;
+                if (out(x, y) != correct) {
+                    printf("out(%d, %d) = %d instead of %d\n", x, y, out(x, y), correct);
+                    return -1;
+                }
+            }
+        }
+    }
+
+    {
+        // Bounded scratch computed per tile of a parallel loop goes on
+        // the stack instead of the heap.
+        Func h("h"), out("out");
+        Var x("x"), y("y"), yo("yo"), yi("yi");
+
+        h(x, y) = x * y;
+        out(x, y) = h(x, y) + h(x, y + 1);
+
+        out.bound(x, 0, 64).split(y, yo, yi, 8).parallel(yo);
+        h.compute_at(out, yo);
+
+        out.add_custom_lowering_pass(new CheckAllocations(0, 1));
+        out.set_custom_allocator(counting_malloc, counting_free);
+
+        Buffer<int> result = out.realize(64, 64);
+        if (mallocs != 0) {
+            printf("There were %d calls to malloc. There were supposed to be none\n", mallocs);
+            return -1;
+        }
+        for (int y = 0; y < result.height(); y++) {
+            for (int x = 0; x < result.width(); x++) {
+                int correct = x * y + x * (y + 1);
+                if (result(x, y) != correct) {
+                    printf("result(%d, %d) = %d instead of %d\n", x, y, result(x, y), correct);
+                    return -1;
+                }
+            }
+        }
+    }
+
+    printf("Success!\n");
+    return 0;
+}
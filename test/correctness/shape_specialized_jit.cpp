@@ -0,0 +1,67 @@
+#include "Halide.h"
+#include <stdio.h>
+
+using namespace Halide;
+using namespace Halide::Internal;
+
+int lowerings = 0;
+
+// Counts how many times the pipeline gets lowered.
+class CountLowerings : public IRMutator2 {
+public:
+    using IRMutator2::mutate;
+    Stmt mutate(const Stmt &s) override {
+        lowerings++;
+        return s;
+    }
+};
+
+int main(int argc, char **argv) {
+    ImageParam in(Int(32), 2, "in");
+    Var x("x"), y("y");
+
+    Func f("f");
+    f(x, y) = Tuple(in(x, y) * 2 + in(x + 1, y), in(x, y) - y);
+    f.vectorize(x, 8, TailStrategy::GuardWithIf);
+
+    Pipeline p(f);
+    p.add_custom_lowering_pass(new CountLowerings);
+    p.specialize_jit_on_shapes(2);
+
+    struct {
+        int w, h;
+    } shapes[] = {
+        {32, 16}, {32, 16}, {32, 16}, {17, 5}, {17, 5}, {17, 5},
+        {40, 3}, {40, 3}, {40, 3}, {32, 16}};
+
+    for (auto s : shapes) {
+        Buffer<int> input(s.w + 1, s.h);
+        input.for_each_element([&](int x, int y) { input(x, y) = x * 3 + y * 7; });
+        in.set(input);
+
+        Buffer<int> out0(s.w, s.h), out1(s.w, s.h);
+        p.realize({out0, out1});
+
+        for (int y = 0; y < s.h; y++) {
+            for (int x = 0; x < s.w; x++) {
+                int correct0 = input(x, y) * 2 + input(x + 1, y);
+                int correct1 = input(x, y) - y;
+                if (out0(x, y) != correct0 || out1(x, y) != correct1) {
+                    printf("%dx%d: f(%d, %d) = {%d, %d} instead of {%d, %d}\n",
+                           s.w, s.h, x, y, out0(x, y), out1(x, y), correct0, correct1);
+                    return -1;
+                }
+            }
+        }
+    }
+
+    // The generic pipeline, plus one variant for each of the first
+    // two recurring shapes. The third shape is over the limit.
+    if (lowerings != 3) {
+        printf("Pipeline was lowered %d times instead of 3\n", lowerings);
+        return -1;
+    }
+
+    printf("Success!\n");
+    return 0;
+}
@@ -0,0 +1,55 @@
+#include "Halide.h"
+#include <stdio.h>
+#include <string>
+
+using namespace Halide;
+
+std::string output;
+
+extern "C" void my_print(void *user_context, const char *message) {
+    output += message;
+}
+
+bool check(const std::string &expected) {
+    if (output.find(expected) == std::string::npos) {
+        printf("Summary is missing \"%s\":\n%s", expected.c_str(), output.c_str());
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char **argv) {
+    Func f("f"), g("g");
+    Var x("x"), y("y");
+    RDom r(0, 5);
+
+    // The first five columns of f are computed twice. The update
+    // also loads them once.
+    f(x, y) = x + y;
+    f(r, y) += 1;
+    g(x, y) = f(x, y) + f(x + 1, y);
+
+    f.compute_root().trace_summary();
+    g.vectorize(x, 4);
+    g.set_custom_print(my_print);
+
+    g.realize(12, 4);
+
+    if (!check("f: realized [0, 12] x [0, 3]") ||
+        !check("stores: 72 in [0, 12] x [0, 3]") ||
+        !check("loads: 116 in [0, 12] x [0, 3]") ||
+        !check("elements computed: 52 of 52") ||
+        !check("times computed: 1x: 32 2x: 20")) {
+        return -1;
+    }
+
+    // Nothing else about f should have been traced.
+    if (output.find("Store f") != std::string::npos ||
+        output.find("Load f") != std::string::npos) {
+        printf("Individual events were traced:\n%s", output.c_str());
+        return -1;
+    }
+
+    printf("Success!\n");
+    return 0;
+}
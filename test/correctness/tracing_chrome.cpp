@@ -0,0 +1,81 @@
+#include "Halide.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <fstream>
+#include <set>
+#include <sstream>
+#include <string>
+
+#include "test/common/halide_test_dirs.h"
+
+using namespace Halide;
+
+int main(int argc, char **argv) {
+    std::string trace_file = Internal::get_test_tmp_dir() + "tracing_chrome.json";
+    Internal::ensure_no_file_exists(trace_file);
+
+    // Must be set before the first traced event opens the file.
+    std::string file_env = "HL_TRACE_FILE=" + trace_file;
+    putenv(&file_env[0]);
+    char format_env[] = "HL_TRACE_FORMAT=chrome";
+    putenv(format_env);
+
+    Func f("f"), g("g");
+    Var x, y;
+    f(x, y) = x + y;
+    g(x, y) = f(x, y) + f(x + 1, y);
+    f.compute_at(g, y).trace_realizations();
+    g.parallel(y).trace_realizations();
+
+    g.realize(100, 100);
+
+    // Each line is a trace event. Loads and stores are not written.
+    std::ifstream in(trace_file.c_str());
+    std::string line;
+    if (!std::getline(in, line) || line != "[") {
+        printf("The trace should be a JSON array\n");
+        return -1;
+    }
+
+    int begins = 0, ends = 0, f_produces = 0;
+    std::set<std::string> tids;
+    while (std::getline(in, line)) {
+        if (line.find("\"cat\":\"load\"") != std::string::npos ||
+            line.find("\"cat\":\"store\"") != std::string::npos) {
+            printf("Unexpected event: %s\n", line.c_str());
+            return -1;
+        }
+        if (line.find("\"ph\":\"B\"") != std::string::npos) {
+            begins++;
+        } else if (line.find("\"ph\":\"E\"") != std::string::npos) {
+            ends++;
+        } else {
+            continue;
+        }
+        if (line.find("\"name\":\"f\",\"cat\":\"produce\",\"ph\":\"B\"") != std::string::npos) {
+            f_produces++;
+        }
+        size_t tid = line.find("\"tid\":");
+        if (tid == std::string::npos || line.find("\"ts\":") == std::string::npos) {
+            printf("Malformed event: %s\n", line.c_str());
+            return -1;
+        }
+        tids.insert(line.substr(tid));
+    }
+
+    printf("%d begin events, %d end events, %d threads\n", begins, ends, (int)tids.size());
+
+    if (begins != ends) {
+        printf("Every begin event should have an end event\n");
+        return -1;
+    }
+
+    // f is produced once per row of g.
+    if (f_produces != 100) {
+        printf("f was produced %d times instead of 100\n", f_produces);
+        return -1;
+    }
+
+    printf("Success!\n");
+    return 0;
+}
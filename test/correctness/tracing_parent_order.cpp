@@ -0,0 +1,82 @@
+#include "Halide.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fstream>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "test/common/halide_test_dirs.h"
+
+using namespace Halide;
+
+int main(int argc, char **argv) {
+    std::string trace_file = Internal::get_test_tmp_dir() + "tracing_parent_order.bin";
+    Internal::ensure_no_file_exists(trace_file);
+
+    // Must be set before the first traced event opens the file.
+    std::string file_env = "HL_TRACE_FILE=" + trace_file;
+    putenv(&file_env[0]);
+
+    // Loads and stores happen on worker threads, inside realizations
+    // and productions begun on the main thread.
+    Func f("f"), g("g");
+    Var x, y;
+    f(x, y) = x + y;
+    g(x, y) = f(x, y) + f(x + 1, y);
+    f.compute_root().parallel(y).trace_loads().trace_stores().trace_realizations();
+    g.parallel(y).trace_stores();
+
+    g.realize(64, 256);
+
+    // Every packet must come after its parent, and before its parent
+    // ends, as that's the order util/HalideTraceViz needs.
+    std::ifstream in(trace_file.c_str(), std::ios::binary);
+    std::set<int> live;
+    std::vector<char> packet;
+    halide_trace_packet_t header;
+    int packets = 0;
+    while (in.read((char *)&header, sizeof(header))) {
+        packet.resize(header.size);
+        memcpy(&packet[0], &header, sizeof(header));
+        if (!in.read(&packet[sizeof(header)], header.size - sizeof(header))) {
+            printf("Truncated packet\n");
+            return -1;
+        }
+        const halide_trace_packet_t *p = (const halide_trace_packet_t *)&packet[0];
+        packets++;
+        if (p->event == halide_trace_begin_pipeline) {
+            live.insert(p->id);
+            continue;
+        }
+        if (!live.count(p->parent_id)) {
+            printf("Event %d of %s (id %d) came before its parent %d began, or after it ended\n",
+                   p->event, p->func(), p->id, p->parent_id);
+            return -1;
+        }
+        switch (p->event) {
+        case halide_trace_begin_realization:
+        case halide_trace_produce:
+        case halide_trace_consume:
+            live.insert(p->id);
+            break;
+        case halide_trace_end_realization:
+        case halide_trace_end_produce:
+        case halide_trace_end_consume:
+        case halide_trace_end_pipeline:
+            live.erase(p->parent_id);
+            break;
+        default:
+            break;
+        }
+    }
+
+    if (packets == 0 || !live.empty()) {
+        printf("Read %d packets, and %d events were never ended\n", packets, (int)live.size());
+        return -1;
+    }
+
+    printf("Success!\n");
+    return 0;
+}
@@ -0,0 +1,75 @@
+#include "Halide.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "test/common/halide_test_dirs.h"
+
+using namespace Halide;
+
+int main(int argc, char **argv) {
+    std::string trace_file = Internal::get_test_tmp_dir() + "tracing_sampling.bin";
+    Internal::ensure_no_file_exists(trace_file);
+
+    // Must be set before the first traced event opens the file.
+    std::string file_env = "HL_TRACE_FILE=" + trace_file;
+    putenv(&file_env[0]);
+    char sample_env[] = "HL_TRACE_SAMPLE=10";
+    putenv(sample_env);
+
+    Func f("f"), g("g"), h("h");
+    Var x, y;
+    f(x, y) = x + y;
+    g(x, y) = f(x, y) * 2;
+    h(x, y) = g(x, y) + 1;
+    f.compute_root().trace_stores();
+    // g keeps none of its stores, and h keeps them all.
+    g.compute_root().trace_stores().add_trace_tag("halide_trace_sample: 0");
+    h.trace_stores().add_trace_tag("halide_trace_sample: 1");
+
+    h.realize(100, 100);
+
+    // Read back the packets written so far. The end of the pipeline
+    // flushed them.
+    std::ifstream in(trace_file.c_str(), std::ios::binary);
+    std::map<std::string, int> stores;
+    std::vector<char> packet;
+    uint64_t last_time = 0;
+    halide_trace_packet_t header;
+    while (in.read((char *)&header, sizeof(header))) {
+        if (header.size < sizeof(header) || header.size % 8 != 0) {
+            printf("Bad packet size %u\n", header.size);
+            return -1;
+        }
+        packet.resize(header.size);
+        memcpy(&packet[0], &header, sizeof(header));
+        if (!in.read(&packet[sizeof(header)], header.size - sizeof(header))) {
+            printf("Truncated packet\n");
+            return -1;
+        }
+        const halide_trace_packet_t *p = (const halide_trace_packet_t *)&packet[0];
+        // Everything ran on this thread, so the packets are in order.
+        if (p->time < last_time) {
+            printf("Packet times went backwards\n");
+            return -1;
+        }
+        last_time = p->time;
+        if (p->event == halide_trace_store) {
+            stores[p->func()]++;
+        }
+    }
+
+    printf("stores kept: f %d g %d h %d\n", stores["f"], stores["g"], stores["h"]);
+
+    if (stores["f"] != 1000 || stores["g"] != 0 || stores["h"] != 10000) {
+        printf("Expected 1000 stores of f, none of g and 10000 of h\n");
+        return -1;
+    }
+
+    printf("Success!\n");
+    return 0;
+}
@@ -0,0 +1,22 @@
+#include <stdio.h>
+#include "Halide.h"
+
+using namespace Halide;
+
+int main(int argc, char **argv) {
+    Func f, g;
+    Var x, y, xo, xi;
+
+    f(x, y) = x + y;
+    g(x, y) = f(x, y) + f(x + 1, y);
+
+    // The loops over f and g's inner tiles aren't unrolled, so f is
+    // accessed at non-constant coordinates.
+    g.split(x, xo, xi, 4);
+    f.compute_at(g, xo).store_in(MemoryType::Register);
+
+    Buffer<int> im = g.realize(64, 16);
+
+    printf("Should have gotten an error about accessing registers at non-constant coordinates!\n");
+    return -1;
+}
@@ -0,0 +1,89 @@
+#include "HalideRuntime.h"
+#include "HalideBuffer.h"
+
+#include <stdio.h>
+
+#include "malloc_pool.h"
+
+using namespace Halide::Runtime;
+
+bool run(Buffer<float> &in, Buffer<float> &out) {
+    if (malloc_pool(in, out)) {
+        printf("Non zero exit code\n");
+        return false;
+    }
+    for (int y = 0; y < out.height(); y++) {
+        for (int x = 0; x < out.width(); x++) {
+            float correct = in(x, y) * 4.0f + 1.0f;
+            if (out(x, y) != correct) {
+                printf("out(%d, %d) = %f instead of %f\n", x, y, out(x, y), correct);
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+int main(int argc, char **argv) {
+    Buffer<float> in(256, 256), out(256, 256);
+    in.for_each_element([&](int x, int y) { in(x, y) = (float)(x + y); });
+
+    // Nothing is pooled while there's no limit.
+    halide_malloc_pool_set_limit(NULL, 0);
+    if (!run(in, out)) {
+        return -1;
+    }
+    halide_malloc_pool_stats stats;
+    halide_malloc_pool_get_stats(NULL, &stats);
+    if (stats.hits != 0 || stats.misses != 0 || stats.cached_bytes != 0) {
+        printf("The pool was used while disabled\n");
+        return -1;
+    }
+
+    // The first call fills the pool, and later calls reuse its blocks.
+    halide_malloc_pool_set_limit(NULL, 16 * 1024 * 1024);
+    if (!run(in, out)) {
+        return -1;
+    }
+    halide_malloc_pool_get_stats(NULL, &stats);
+    uint64_t misses = stats.misses;
+    if (misses < 2 || stats.cached_bytes < 2 * 256 * 256 * (int64_t)sizeof(float)) {
+        printf("Expected the first call to add two blocks to the pool, got %d misses and %d bytes cached\n",
+               (int)misses, (int)stats.cached_bytes);
+        return -1;
+    }
+
+    const int iters = 10;
+    for (int i = 0; i < iters; i++) {
+        if (!run(in, out)) {
+            return -1;
+        }
+    }
+    halide_malloc_pool_get_stats(NULL, &stats);
+    if (stats.misses != misses || stats.hits < 2 * iters) {
+        printf("Expected repeated calls to reuse pooled blocks, got %d hits and %d misses\n",
+               (int)stats.hits, (int)stats.misses);
+        return -1;
+    }
+
+    halide_malloc_pool_trim(NULL);
+    halide_malloc_pool_get_stats(NULL, &stats);
+    if (stats.cached_bytes != 0) {
+        printf("%d bytes still cached after trimming\n", (int)stats.cached_bytes);
+        return -1;
+    }
+
+    // Lowering the limit below the size of one block stops pooling.
+    halide_malloc_pool_set_limit(NULL, 1024);
+    if (!run(in, out)) {
+        return -1;
+    }
+    halide_malloc_pool_get_stats(NULL, &stats);
+    if (stats.cached_bytes != 0) {
+        printf("Pooled blocks larger than the limit\n");
+        return -1;
+    }
+
+    printf("Success!\n");
+    return 0;
+}
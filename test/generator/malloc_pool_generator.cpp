@@ -0,0 +1,26 @@
+#include "Halide.h"
+
+namespace {
+
+class MallocPool : public Halide::Generator<MallocPool> {
+public:
+    Input<Buffer<float>> input{"input", 2};
+    Output<Buffer<float>> output{"output", 2};
+
+    void generate() {
+        // Two intermediates too large for the stack, so each call
+        // makes two heap allocations.
+        Var x, y;
+        Func f, g;
+        f(x, y) = input(x, y) * 2.0f;
+        g(x, y) = f(x, y) + 1.0f;
+        output(x, y) = g(x, y) + f(x, y);
+
+        f.compute_root();
+        g.compute_root();
+    }
+};
+
+}  // namespace
+
+HALIDE_REGISTER_GENERATOR(MallocPool, malloc_pool)
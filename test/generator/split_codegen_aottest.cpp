@@ -0,0 +1,48 @@
+#include "HalideRuntime.h"
+#include "HalideBuffer.h"
+
+#include <algorithm>
+#include <stdio.h>
+
+#include "split_codegen.h"
+#include "split_codegen_with_offset_42.h"
+
+using namespace Halide::Runtime;
+
+const int kSize = 64;
+
+// Both libraries were compiled in several pieces with the same Func
+// names. That this links at all is most of the test.
+int main(int argc, char **argv) {
+    Buffer<int32_t> input(kSize, kSize), output(kSize, kSize), output_42(kSize, kSize);
+
+    input.for_each_element([&](int x, int y) {
+        input(x, y) = (x * 7 + y * 13) % 31;
+    });
+
+    split_codegen(input, output);
+    split_codegen_with_offset_42(input, output_42);
+
+    auto clamp = [](int v) { return std::min(std::max(v, 0), kSize - 1); };
+    for (int y = 0; y < kSize; y++) {
+        for (int x = 0; x < kSize; x++) {
+            int correct = 0;
+            for (int dy = -1; dy <= 1; dy++) {
+                for (int dx = -1; dx <= 1; dx++) {
+                    correct += input(clamp(x + dx), clamp(y + dy));
+                }
+            }
+            if (output(x, y) != correct) {
+                printf("output(%d, %d) = %d instead of %d\n", x, y, output(x, y), correct);
+                return -1;
+            }
+            if (output_42(x, y) != correct + 42) {
+                printf("output_42(%d, %d) = %d instead of %d\n", x, y, output_42(x, y), correct + 42);
+                return -1;
+            }
+        }
+    }
+
+    printf("Success!\n");
+    return 0;
+}
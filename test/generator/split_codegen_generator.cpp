@@ -0,0 +1,41 @@
+#include "Halide.h"
+
+#include <stdlib.h>
+
+namespace {
+
+// Compile the libraries in several pieces, so that the test checks
+// that two libraries split the same way can be linked into one
+// binary. This must happen before anything is compiled.
+int set_codegen_threads = []() {
+    static char env[] = "HL_LLVM_CODEGEN_THREADS=4";
+    return putenv(env);
+}();
+
+class SplitCodegen : public Halide::Generator<SplitCodegen> {
+public:
+    GeneratorParam<int32_t> offset{ "offset", 0 };
+    Input<Buffer<int32_t>>  input{ "input", 2 };
+    Output<Buffer<int32_t>> output{ "output", 2 };
+
+    void generate() {
+        // Several stages with parallel loops, so that there are
+        // plenty of closures and string constants to spread across
+        // the pieces.
+        Var x("x"), y("y");
+        Func clamped = Halide::BoundaryConditions::repeat_edge(input);
+        Func blur_x("blur_x"), blur_y("blur_y");
+        blur_x(x, y) = clamped(x - 1, y) + clamped(x, y) + clamped(x + 1, y);
+        blur_y(x, y) = blur_x(x, y - 1) + blur_x(x, y) + blur_x(x, y + 1);
+        output(x, y) = blur_y(x, y) + offset;
+
+        blur_x.compute_root().parallel(y).vectorize(x, 8);
+        blur_y.compute_root().parallel(y).vectorize(x, 8);
+        output.parallel(y).vectorize(x, 8);
+    }
+};
+
+}  // namespace
+
+HALIDE_REGISTER_GENERATOR(SplitCodegen, split_codegen)
+HALIDE_REGISTER_GENERATOR_ALIAS(split_codegen_with_offset_42, split_codegen, { { "offset", "42" }})
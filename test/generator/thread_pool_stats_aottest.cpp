@@ -0,0 +1,73 @@
+#include "HalideRuntime.h"
+#include "HalideBuffer.h"
+
+#include <stdio.h>
+#include <vector>
+
+#include "thread_pool_stats.h"
+
+using namespace Halide::Runtime;
+
+int main(int argc, char **argv) {
+    Buffer<float> out(64, 64);
+
+    // Nothing should be recorded while instrumentation is off.
+    halide_thread_pool_enable_stats(false);
+    if (thread_pool_stats(out)) {
+        printf("Non zero exit code\n");
+        return -1;
+    }
+    halide_thread_pool_stats stats;
+    halide_thread_pool_get_stats(&stats, NULL, 0);
+    if (stats.jobs != 0) {
+        printf("Thread pool stats recorded while disabled\n");
+        return -1;
+    }
+
+    halide_thread_pool_enable_stats(true);
+    const int iters = 10;
+    for (int i = 0; i < iters; i++) {
+        if (thread_pool_stats(out)) {
+            printf("Non zero exit code\n");
+            return -1;
+        }
+    }
+
+    int num_workers = halide_thread_pool_get_stats(&stats, NULL, 0);
+    std::vector<halide_thread_pool_worker_stats> workers(num_workers);
+    halide_thread_pool_get_stats(&stats, workers.data(), num_workers);
+
+    // One outer job plus one inner job per column, per iteration.
+    const uint64_t expected_jobs = iters * (1 + 64);
+    if (stats.jobs != expected_jobs) {
+        printf("Expected %d jobs, got %d\n", (int)expected_jobs, (int)stats.jobs);
+        return -1;
+    }
+
+    // Every task must have been claimed by exactly one thread.
+    uint64_t claimed = stats.owners.tasks_claimed;
+    for (const auto &w : workers) {
+        claimed += w.tasks_claimed;
+    }
+    const uint64_t expected_tasks = iters * (64 + 64 * 64);
+    if (stats.tasks != expected_tasks || claimed != expected_tasks) {
+        printf("Expected %d tasks, got %d run and %d claimed\n",
+               (int)expected_tasks, (int)stats.tasks, (int)claimed);
+        return -1;
+    }
+
+    if (stats.queue_depth_peak < 2) {
+        printf("Nested parallelism should have produced a queue depth of at least 2\n");
+        return -1;
+    }
+
+    halide_thread_pool_reset_stats();
+    halide_thread_pool_get_stats(&stats, NULL, 0);
+    if (stats.jobs != 0 || stats.owners.tasks_claimed != 0) {
+        printf("Thread pool stats were not reset\n");
+        return -1;
+    }
+
+    printf("Success!\n");
+    return 0;
+}
@@ -0,0 +1,21 @@
+#include "Halide.h"
+
+namespace {
+
+class ThreadPoolStats : public Halide::Generator<ThreadPoolStats> {
+public:
+    Output<Buffer<float>> output{"output", 2};
+
+    void generate() {
+        // A job with nested parallelism, so that both the callers
+        // and the workers have something to record.
+        Var x, y;
+
+        output(x, y) = sqrt(sqrt(x*y));
+        output.parallel(x).parallel(y);
+    }
+};
+
+}  // namespace
+
+HALIDE_REGISTER_GENERATOR(ThreadPoolStats, thread_pool_stats)
@@ -0,0 +1,116 @@
+#include "Halide.h"
+#include <cstdio>
+#include <cstring>
+#include "halide_benchmark.h"
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+using namespace Halide;
+using namespace Halide::Tools;
+
+struct Result {
+    double time;
+    // Or -1 if the counter isn't available.
+    long long tlb_misses;
+};
+
+// Counts data TLB misses on this thread and the threads it starts
+// from now on. Returns -1 if the counter isn't available.
+int open_tlb_miss_counter() {
+#ifdef __linux__
+    perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HW_CACHE;
+    attr.config = (PERF_COUNT_HW_CACHE_DTLB |
+                   (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                   (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+    attr.inherit = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return (int)syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+#else
+    return -1;
+#endif
+}
+
+Result run(Pipeline &p, const char *threshold, const char *placement) {
+    // The runtime reads these when it's created.
+    static char threshold_buf[64], placement_buf[64];
+    snprintf(threshold_buf, sizeof(threshold_buf), "HL_HUGE_PAGE_THRESHOLD=%s", threshold);
+    snprintf(placement_buf, sizeof(placement_buf), "HL_HUGE_PAGE_PLACEMENT=%s", placement);
+    putenv(threshold_buf);
+    putenv(placement_buf);
+    p.invalidate_cache();
+    Internal::JITSharedRuntime::release_all();
+
+    int counter = open_tlb_miss_counter();
+    p.compile_jit();
+    Buffer<float> out(4096, 4096);
+    Result result;
+    result.time = benchmark(3, 3, [&]() { p.realize(out); });
+    result.tlb_misses = -1;
+#ifdef __linux__
+    if (counter >= 0) {
+        // The counts of the thread pool's workers are only added in
+        // once they exit.
+        Internal::JITSharedRuntime::release_all();
+        if (read(counter, &result.tlb_misses, sizeof(result.tlb_misses)) != sizeof(result.tlb_misses)) {
+            result.tlb_misses = -1;
+        }
+        close(counter);
+    }
+#endif
+    return result;
+}
+
+int main(int argc, char **argv) {
+#ifndef __linux__
+    printf("Huge page allocation is only supported on Linux. Skipping test\n");
+    printf("Success!\n");
+    return 0;
+#endif
+
+    // A large intermediate read in transposed order, so that
+    // neighbouring accesses land on different small pages and the
+    // consumer is bound by TLB misses.
+    Func f, g;
+    Var x, y, xi, yi;
+    f(x, y) = cast<float>(x + y);
+    g(x, y) = f(y, x) + f(y, x + 1) + f(y + 1, x);
+
+    f.compute_root().parallel(y).vectorize(x, 8);
+    g.parallel(y, 16).vectorize(x, 8);
+
+    Pipeline p(g);
+
+    Result small_pages = run(p, "0", "0");
+    Result huge_pages = run(p, "16777216", "0");
+    Result huge_pages_prefaulted = run(p, "16777216", "1");
+
+    printf("Small pages: %f ms, %lld data TLB misses\n",
+           small_pages.time * 1e3, small_pages.tlb_misses);
+    printf("Huge pages: %f ms, %lld data TLB misses\n",
+           huge_pages.time * 1e3, huge_pages.tlb_misses);
+    printf("Huge pages, prefaulted: %f ms, %lld data TLB misses\n",
+           huge_pages_prefaulted.time * 1e3, huge_pages_prefaulted.tlb_misses);
+
+    // Transparent huge pages may be disabled on this machine, in
+    // which case all three should behave about the same. Timings are
+    // too noisy on a loaded machine to fail on.
+    if (small_pages.tlb_misses < 0) {
+        printf("Data TLB misses could not be counted on this machine\n");
+    } else if (huge_pages.tlb_misses >= small_pages.tlb_misses) {
+        printf("Warning: huge pages did not reduce data TLB misses\n");
+    }
+    if (huge_pages.time > small_pages.time * 1.5 || huge_pages_prefaulted.time > small_pages.time * 1.5) {
+        printf("Warning: huge page allocation was slower than small pages\n");
+    }
+
+    printf("Success!\n");
+    return 0;
+}
@@ -0,0 +1,79 @@
+#include "Halide.h"
+#include <cstdio>
+#include <thread>
+#include "halide_benchmark.h"
+
+using namespace Halide;
+using namespace Halide::Tools;
+
+int main(int argc, char **argv) {
+    // f is memoized inside the parallel loop over rows of g, so once
+    // the cache is warm every row of g is one cache hit, each with a
+    // distinct computed region. Lookup throughput should scale with
+    // the number of threads rather than serializing on a single lock.
+    Param<int> p;
+    Func f, g;
+    Var x, y;
+    f(x, y) = x * y + p;
+    g(x, y) = f(x, y);
+    f.compute_at(g, y).memoize();
+    g.parallel(y);
+
+    Pipeline pipe(g);
+    p.set(17);
+
+    const int rows = 1 << 14;
+    Buffer<int> out(4, rows);
+
+    int max_threads = std::thread::hardware_concurrency();
+    double single_thread_time = 0, multi_thread_time = 0;
+    for (int t : {1, max_threads}) {
+        std::ostringstream ss;
+        ss << "HL_NUM_THREADS=" << t;
+        std::string str = ss.str();
+        // putenv keeps a pointer to the string, so it must outlive the
+        // loop.
+        static char buf[32];
+        memset(buf, 0, sizeof(buf));
+        memcpy(buf, str.c_str(), str.size());
+        putenv(buf);
+        pipe.invalidate_cache();
+        Halide::Internal::JITSharedRuntime::release_all();
+        pipe.compile_jit();
+
+        // Warm up the cache.
+        pipe.realize(out);
+
+        double time = benchmark([&]() { pipe.realize(out); });
+        printf("%d threads: %f Mlookups/s\n", t, rows / (time * 1e6));
+        if (t == 1) {
+            single_thread_time = time;
+        } else {
+            multi_thread_time = time;
+        }
+    }
+
+    for (int y = 0; y < rows; y++) {
+        for (int x = 0; x < 4; x++) {
+            if (out(x, y) != x * y + 17) {
+                printf("out(%d, %d) = %d instead of %d\n", x, y, out(x, y), x * y + 17);
+                return -1;
+            }
+        }
+    }
+
+    if (max_threads < 4) {
+        printf("Too few cores to measure scaling of memoization cache lookups\n");
+    } else {
+        double speedup = single_thread_time / multi_thread_time;
+        printf("Speedup with %d threads: %f\n", max_threads, speedup);
+        // Timing on a shared machine is too noisy to fail on, so just
+        // report poor scaling.
+        if (speedup < 2) {
+            printf("Warning: memoization cache lookups are not scaling with the number of threads\n");
+        }
+    }
+
+    printf("Success!\n");
+    return 0;
+}
@@ -332,6 +332,28 @@ int main(int argc, char **argv) {
         }
     }
 
+    {
+        printf("Running memoized heap allocation test...\n");
+        // The memoized Func's buffer comes from the cache, but is
+        // still a heap allocation of its own.
+        const int size_x = 1000;
+        const int size_y = 1000;
+
+        Func f13("f_13"), g9("g_9");
+        g9(x, y) = x;
+        f13(x, y) = g9(x-1, y) + g9(x, y-1);
+        g9.compute_root().memoize();
+
+        f13.set_custom_print(&my_print);
+
+        reset_stats();
+        f13.realize(size_x, size_y, t);
+        int total = (size_x+1)*(size_y+1)*sizeof(int);
+        if (check_error(total, 1, total, 0) != 0) {
+            return -1;
+        }
+    }
+
     printf("Success!\n");
     return 0;
 }
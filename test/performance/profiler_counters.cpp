@@ -0,0 +1,83 @@
+#include "Halide.h"
+#include <stdio.h>
+#include <string.h>
+
+using namespace Halide;
+
+bool unavailable = false;
+float compute_mpki = -1, gather_mpki = -1;
+void my_print(void *, const char *msg) {
+    if (strstr(msg, "hardware counters unavailable")) {
+        unavailable = true;
+    }
+    const char *mpki = strstr(msg, "cache mpki: ");
+    if (!mpki) return;
+    float val;
+    if (sscanf(mpki, "cache mpki: %f", &val) != 1) return;
+    if (strstr(msg, " compute: ")) {
+        compute_mpki = val;
+    } else if (strstr(msg, " gather: ")) {
+        gather_mpki = val;
+    }
+}
+
+int main(int argc, char **argv) {
+    Target t = get_jit_target_from_environment();
+    if (t.os != Target::Linux || t.arch != Target::X86) {
+        printf("Hardware counters are only supported on x86 Linux\n");
+        printf("Success!\n");
+        return 0;
+    }
+
+    // Must be set before the profiler starts up.
+    char env[] = "HL_PROFILER_COUNTERS=1";
+    putenv(env);
+
+    // A stage that stays in registers, and a stage that gathers at
+    // pseudo-random addresses from a table too big for the cache.
+    const int table_size = 64 * 1024 * 1024;
+    Buffer<int> table(table_size);
+    table.fill(0);
+
+    Func compute("compute"), gather("gather"), out("out");
+    Var x, y;
+
+    Expr e = cast<float>(x + y);
+    for (int i = 0; i < 100; i++) {
+        e = sin(e);
+    }
+    compute(x, y) = e;
+
+    Expr idx = (x * 1103515245 + y * 12345) & (table_size - 1);
+    gather(x, y) = table(idx);
+    out(x, y) = compute(x, y) + gather(x, y);
+
+    compute.compute_at(out, y);
+    gather.compute_at(out, y);
+    out.parallel(y);
+
+    out.set_custom_print(&my_print);
+    out.realize(2048, 2048, t.with_feature(Target::Profile));
+
+    if (unavailable) {
+        printf("Hardware counters are unavailable on this machine\n");
+        printf("Success!\n");
+        return 0;
+    }
+
+    printf("cache misses per thousand instructions: compute %f gather %f\n",
+           compute_mpki, gather_mpki);
+
+    if (compute_mpki < 0 || gather_mpki < 0) {
+        printf("The profiler report didn't contain counters for compute and gather\n");
+        return -1;
+    }
+
+    if (gather_mpki <= compute_mpki) {
+        printf("gather should have a higher cache miss rate than compute\n");
+        return -1;
+    }
+
+    printf("Success!\n");
+    return 0;
+}
@@ -0,0 +1,66 @@
+#include "Halide.h"
+#include <stdio.h>
+
+using namespace Halide;
+
+int percentage = -1, efficiency = -1;
+float threads = 0;
+void my_print(void *, const char *msg) {
+    float this_ms, this_threads;
+    int this_percentage, this_efficiency;
+    int val = sscanf(msg, " expensive: %fms (%d%%) threads: %f efficiency: %d%%",
+                     &this_ms, &this_percentage, &this_threads, &this_efficiency);
+    if (val == 4) {
+        percentage = this_percentage;
+        threads = this_threads;
+        efficiency = this_efficiency;
+    }
+}
+
+int main(int argc, char **argv) {
+    // Each task of a parallel loop computes a cheap Func and then an
+    // expensive one. With several tasks running at once, some thread
+    // is nearly always starting the cheap Func while others are deep
+    // in the expensive one, so the time must be attributed per thread.
+    Func cheap("cheap"), expensive("expensive"), out("out");
+    Var x, y;
+
+    cheap(x, y) = cast<float>(x + y);
+    Expr e = cheap(x, y);
+    for (int i = 0; i < 200; i++) {
+        e = sin(e);
+    }
+    expensive(x, y) = e;
+    out(x, y) = expensive(x, y) + cheap(x, y);
+
+    out.parallel(y);
+    cheap.compute_at(out, y);
+    expensive.compute_at(out, y);
+
+    out.set_custom_print(&my_print);
+
+    Target t = get_jit_target_from_environment().with_feature(Target::Profile);
+    out.realize(1000, 1000, t);
+
+    printf("expensive: %d%% of the time, %f threads, %d%% efficiency\n", percentage, threads, efficiency);
+
+    if (percentage < 0) {
+        printf("The profiler report didn't contain a line for expensive\n");
+        return -1;
+    }
+
+    if (percentage < 70) {
+        printf("Percentage of runtime spent in expensive: %d\n"
+               "This is suspiciously low. It should be more like 95%%\n",
+               percentage);
+        return -1;
+    }
+
+    if (efficiency <= 0 || efficiency > 100) {
+        printf("Parallel efficiency of %d%% is out of range\n", efficiency);
+        return -1;
+    }
+
+    printf("Success!\n");
+    return 0;
+}
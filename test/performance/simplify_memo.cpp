@@ -0,0 +1,109 @@
+#include "Halide.h"
+#include <chrono>
+#include <iostream>
+#include <stdlib.h>
+
+#include "halide_benchmark.h"
+
+using namespace Halide;
+using namespace Halide::Internal;
+using namespace Halide::Tools;
+
+// Something like the bounds of an unrolled, clamped stencil. Each call
+// builds a fresh Expr, so repeats are structurally equal but don't
+// share nodes.
+Expr make_bounds_expr(int i) {
+    Expr x = Variable::make(Int(32), "x");
+    Expr y = Variable::make(Int(32), "y");
+    Expr w = Variable::make(Int(32), "w");
+    Expr e = x * 8 + (i % 8);
+    for (int j = 0; j < 16; j++) {
+        e = min(max(e * 3 + y - j, 0), w + j) / 2 + (x - j) * 2;
+    }
+    return e;
+}
+
+double simplify_all(const std::vector<Expr> &exprs, bool memoize) {
+    return benchmark([&]() {
+        std::unique_ptr<SimplifyMemoScope> scope;
+        if (memoize) {
+            scope.reset(new SimplifyMemoScope);
+        }
+        for (const Expr &e : exprs) {
+            simplify(e);
+        }
+    });
+}
+
+// The gradient of a deep stencil pipeline, which has lots of shared
+// subexpressions. Returns the time in ms to differentiate and lower
+// it. Builds a fresh pipeline each time so nothing is reused between
+// calls.
+double gradient_time() {
+    ImageParam in(Float(32), 1, "in");
+    Var x("x");
+    std::vector<Func> layers;
+    Func clamped = BoundaryConditions::repeat_edge(in);
+    layers.push_back(clamped);
+    for (int i = 0; i < 8; i++) {
+        Func f("layer_" + std::to_string(i));
+        Func prev = layers.back();
+        f(x) = tanh(prev(x - 1) * 0.25f + prev(x) * 0.5f + prev(x + 1) * 0.25f);
+        layers.push_back(f);
+    }
+    RDom r(0, 64);
+    Func loss("loss");
+    loss() = 0.f;
+    loss() += layers.back()(r.x) * layers.back()(r.x);
+
+    auto t1 = std::chrono::high_resolution_clock::now();
+    Derivative d = propagate_adjoints(loss);
+    Func grad = d(clamped);
+    Pipeline(grad).compile_to_module({in}, "grad");
+    auto t2 = std::chrono::high_resolution_clock::now();
+
+    return std::chrono::duration<double, std::milli>(t2 - t1).count();
+}
+
+int main(int argc, char **argv) {
+    {
+        std::vector<Expr> exprs;
+        for (int i = 0; i < 256; i++) {
+            exprs.push_back(make_bounds_expr(i));
+        }
+
+        double t_plain = simplify_all(exprs, false);
+        double t_memo = simplify_all(exprs, true);
+
+        std::cout << "Simplifying repeated bounds expressions:\n"
+                  << "  without memo: " << t_plain * 1e3 << " ms\n"
+                  << "  with memo:    " << t_memo * 1e3 << " ms\n";
+
+        if (t_memo > t_plain) {
+            std::cout << "Warning: memoized simplification was slower\n";
+        }
+    }
+
+    {
+        // Set HL_SIMPLIFY_MEMO=0 to turn off the memo that
+        // propagate_adjoints and lowering use internally. The first
+        // run is a warm-up.
+        gradient_time();
+        double t_memo = gradient_time();
+        setenv("HL_SIMPLIFY_MEMO", "0", 1);
+        double t_plain = gradient_time();
+        unsetenv("HL_SIMPLIFY_MEMO");
+
+        std::cout << "Differentiating and lowering a deep stencil:\n"
+                  << "  without memo: " << t_plain << " ms\n"
+                  << "  with memo:    " << t_memo << " ms\n"
+                  << "  speed-up:     " << t_plain / t_memo << "x\n";
+
+        if (t_memo > t_plain) {
+            std::cout << "Warning: memoized simplification was slower\n";
+        }
+    }
+
+    std::cout << "Success!\n";
+    return 0;
+}